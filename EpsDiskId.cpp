@@ -16,11 +16,13 @@ const int DSK_VERSION = 5;
 
 
 //--------------------------------------------------------------------------------------------------------
-BOOL APIENTRY DllMain( HANDLE, DWORD  ul_reason_for_call, LPVOID )
+BOOL APIENTRY DllMain( HANDLE hModule, DWORD  ul_reason_for_call, LPVOID )
 {
     if( ul_reason_for_call == DLL_PROCESS_ATTACH )
     {
-
+            // the background refresher is started by the first xp_DiskId, not here: creating
+            // and waiting on threads under the loader lock can deadlock the server
+        ::DisableThreadLibraryCalls( (HMODULE)hModule );
     }
     return TRUE;
 }
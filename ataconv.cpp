@@ -0,0 +1,363 @@
+/** @file
+  * EpsDiskId/ataconv.cpp
+  *
+  * Decoding kernels for the identity strings drives report.
+  */
+
+#include <string.h>
+
+#include "ataconv.h"
+
+#if defined(_MSC_VER) && ( defined(_M_IX86) || defined(_M_X64) )
+#   include <intrin.h>
+#   include <tmmintrin.h>
+#   define ATACONV_HAVE_SSSE3
+#   define ATACONV_SSSE3_TARGET
+#   define ATACONV_ALIGN16          __declspec(align(16))
+#elif defined(__GNUC__) && ( defined(__i386__) || defined(__x86_64__) )
+#   include <cpuid.h>
+#   include <tmmintrin.h>
+#   define ATACONV_HAVE_SSSE3
+#   define ATACONV_SSSE3_TARGET     __attribute__((target("ssse3")))
+#   define ATACONV_ALIGN16          __attribute__((aligned(16)))
+#endif
+
+namespace Utils
+{
+    typedef size_t (*hex_flip_kernel_t)( const char *src, size_t cch, char *dst, size_t cbDst );
+    typedef void   (*swap_copy_kernel_t)( const unsigned __int8 *field, size_t first, size_t count, char *dst );
+    typedef size_t (*string_length_kernel_t)( const unsigned __int8 *field, size_t cb );
+    typedef size_t (*leading_blanks_kernel_t)( const char *s, size_t n );
+
+    //----------------------------------------------------------------------------------------------------------------------
+    static inline unsigned hexValue( unsigned char c )
+    {
+        if( c >= '0' && c <= '9' )
+        {
+            return c - '0';
+        }
+        c |= 0x20;
+        if( c >= 'a' && c <= 'f' )
+        {
+            return c - 'a' + 10;
+        }
+        return 0;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // pairs of the 4-digit groups from position i on, as the scalar reference does them
+    static size_t hexFlipTail( const char *src, size_t i, size_t cch, char *dst, size_t out, size_t cbDst )
+    {
+        for( ; i < cch; i += 4 )
+        {
+            for( int j = 1; j >= 0; j-- )
+            {
+                const size_t   k  = i + j * 2;
+                const unsigned hi = ( k     < cch ) ? hexValue( (unsigned char)src[k] )     : 0;
+                const unsigned lo = ( k + 1 < cch ) ? hexValue( (unsigned char)src[k + 1] ) : 0;
+                const unsigned v  = hi * 16 + lo;
+
+                if( v > 0 )
+                {
+                    if( out + 1 >= cbDst )
+                    {
+                        return out;
+                    }
+                    dst[out++] = (char)v;
+                }
+            }
+        }
+        return out;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static size_t hexFlipScalar( const char *src, size_t cch, char *dst, size_t cbDst )
+    {
+        const size_t out = hexFlipTail( src, 0, cch, dst, 0, cbDst );
+        dst[out] = '\0';
+        return out;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static void swapCopyScalar( const unsigned __int8 *field, size_t first, size_t count, char *dst )
+    {
+        for( size_t i = 0; i < count; i++ )
+        {
+            dst[i] = (char)field[( first + i ) ^ 1];
+        }
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static size_t stringLengthScalar( const unsigned __int8 *field, size_t cb )
+    {
+        size_t length = 0;
+        for( size_t k = 0; k < cb; k++ )
+        {
+            const unsigned __int8 c = field[k ^ 1];
+            if( 0 == c )
+            {
+                return k;
+            }
+            if( ' ' != c || 0 == k )
+            {
+                length = k + 1;
+            }
+        }
+        return length;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static size_t leadingBlanksScalar( const char *s, size_t n )
+    {
+        size_t i = 0;
+        while( i < n && ' ' == s[i] )
+        {
+            i++;
+        }
+        return i;
+    }
+
+#if defined(ATACONV_HAVE_SSSE3)
+    //----------------------------------------------------------------------------------------------------------------------
+       // s_compact[m]: pshufb control moving the bytes selected by bit mask m to the front, in order
+    static ATACONV_ALIGN16 unsigned __int8 s_compact[256][16];
+    static unsigned __int8                 s_compactCount[256];
+
+    static ATACONV_ALIGN16 const unsigned __int8 s_swapPairs[16] = { 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14 };
+    static ATACONV_ALIGN16 const unsigned __int8 s_flipPairs[16] = { 1, 0, 3, 2, 5, 4, 7, 6,
+                                                                     0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 };
+
+    static inline unsigned lowestBit( unsigned mask )
+    {
+#if defined(_MSC_VER)
+        unsigned long index = 0;
+        ::_BitScanForward( &index, mask );
+        return index;
+#else
+        return (unsigned)__builtin_ctz( mask );
+#endif
+    }
+    static inline unsigned highestBit( unsigned mask )
+    {
+#if defined(_MSC_VER)
+        unsigned long index = 0;
+        ::_BitScanReverse( &index, mask );
+        return index;
+#else
+        return 31U - (unsigned)__builtin_clz( mask );
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // 16 hex digits (4 groups) per step: digit values, pairs combined with pmaddubsw, pair order
+       // flipped within each group, zero bytes squeezed out through s_compact
+    ATACONV_SSSE3_TARGET
+    static size_t hexFlipSsse3( const char *src, size_t cch, char *dst, size_t cbDst )
+    {
+        const __m128i zero     = _mm_setzero_si128();
+        const __m128i digit0   = _mm_set1_epi8( '0' - 1 );
+        const __m128i digit9   = _mm_set1_epi8( '9' + 1 );
+        const __m128i lowerA   = _mm_set1_epi8( 'a' - 1 );
+        const __m128i lowerF   = _mm_set1_epi8( 'f' + 1 );
+        const __m128i caseBit  = _mm_set1_epi8( 0x20 );
+        const __m128i offDigit = _mm_set1_epi8( '0' );
+        const __m128i offAlpha = _mm_set1_epi8( 'a' - 10 );
+        const __m128i weights  = _mm_set1_epi16( 0x0110 );     // 16 * first digit + second digit
+        const __m128i flip     = _mm_load_si128( (const __m128i *)s_flipPairs );
+
+        size_t i   = 0;
+        size_t out = 0;
+
+        for( ; i + 16 <= cch && out + 8 < cbDst; i += 16 )
+        {
+            const __m128i c       = _mm_loadu_si128( (const __m128i *)( src + i ) );
+            const __m128i lc      = _mm_or_si128( c, caseBit );
+            const __m128i isDigit = _mm_and_si128( _mm_cmpgt_epi8( c, digit0 ), _mm_cmplt_epi8( c, digit9 ) );
+            const __m128i isAlpha = _mm_and_si128( _mm_cmpgt_epi8( lc, lowerA ), _mm_cmplt_epi8( lc, lowerF ) );
+            const __m128i value   = _mm_or_si128( _mm_and_si128( isDigit, _mm_sub_epi8( c, offDigit ) ),
+                                                  _mm_and_si128( isAlpha, _mm_sub_epi8( lc, offAlpha ) ) );
+
+            __m128i bytes = _mm_packus_epi16( _mm_maddubs_epi16( value, weights ), zero );
+            bytes = _mm_shuffle_epi8( bytes, flip );
+
+            const unsigned keep = ~(unsigned)_mm_movemask_epi8( _mm_cmpeq_epi8( bytes, zero ) ) & 0xFF;
+            bytes = _mm_shuffle_epi8( bytes, _mm_load_si128( (const __m128i *)s_compact[keep] ) );
+            _mm_storel_epi64( (__m128i *)( dst + out ), bytes );
+            out += s_compactCount[keep];
+        }
+        out = hexFlipTail( src, i, cch, dst, out, cbDst );
+        dst[out] = '\0';
+        return out;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    ATACONV_SSSE3_TARGET
+    static void swapCopySsse3( const unsigned __int8 *field, size_t first, size_t count, char *dst )
+    {
+        size_t i = 0;
+        if( ( first & 1 ) && count > 0 )
+        {
+            dst[0] = (char)field[first ^ 1];        // odd start: the rest is word aligned
+            i = 1;
+        }
+        const __m128i swap = _mm_load_si128( (const __m128i *)s_swapPairs );
+        for( ; i + 16 <= count; i += 16 )
+        {
+            const __m128i words = _mm_loadu_si128( (const __m128i *)( field + first + i ) );
+            _mm_storeu_si128( (__m128i *)( dst + i ), _mm_shuffle_epi8( words, swap ) );
+        }
+        for( ; i < count; i++ )
+        {
+            dst[i] = (char)field[( first + i ) ^ 1];
+        }
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    ATACONV_SSSE3_TARGET
+    static size_t stringLengthSsse3( const unsigned __int8 *field, size_t cb )
+    {
+        const __m128i swap   = _mm_load_si128( (const __m128i *)s_swapPairs );
+        const __m128i zero   = _mm_setzero_si128();
+        const __m128i blanks = _mm_set1_epi8( ' ' );
+
+        size_t length = 0;
+        size_t k      = 0;
+        for( ; k + 16 <= cb; k += 16 )
+        {
+            const __m128i  c        = _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i *)( field + k ) ), swap );
+            const unsigned nul      = (unsigned)_mm_movemask_epi8( _mm_cmpeq_epi8( c, zero ) );
+            unsigned       nonBlank = ~(unsigned)_mm_movemask_epi8( _mm_cmpeq_epi8( c, blanks ) ) & 0xFFFF;
+
+            if( 0 == k )
+            {
+                nonBlank |= 1;                      // the first character stays
+            }
+            if( 0 != nul )
+            {
+                return k + lowestBit( nul );
+            }
+            if( 0 != nonBlank )
+            {
+                length = k + highestBit( nonBlank ) + 1;
+            }
+        }
+        for( ; k < cb; k++ )
+        {
+            const unsigned __int8 c = field[k ^ 1];
+            if( 0 == c )
+            {
+                return k;
+            }
+            if( ' ' != c || 0 == k )
+            {
+                length = k + 1;
+            }
+        }
+        return length;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    ATACONV_SSSE3_TARGET
+    static size_t leadingBlanksSsse3( const char *s, size_t n )
+    {
+        const __m128i blanks = _mm_set1_epi8( ' ' );
+
+        size_t i = 0;
+        for( ; i + 16 <= n; i += 16 )
+        {
+            const unsigned other = ~(unsigned)_mm_movemask_epi8(
+                                        _mm_cmpeq_epi8( _mm_loadu_si128( (const __m128i *)( s + i ) ), blanks ) ) & 0xFFFF;
+            if( 0 != other )
+            {
+                return i + lowestBit( other );
+            }
+        }
+        return i + leadingBlanksScalar( s + i, n - i );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static bool cpuHasSsse3()
+    {
+#if defined(_MSC_VER)
+        int info[4] = { 0 };
+        ::__cpuid( info, 1 );
+        return 0 != ( info[2] & (1 << 9) );
+#else
+        unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+        if( !__get_cpuid( 1, &eax, &ebx, &ecx, &edx ) )
+        {
+            return false;
+        }
+        return 0 != ( ecx & bit_SSSE3 );
+#endif
+    }
+#endif // ATACONV_HAVE_SSSE3
+
+    //----------------------------------------------------------------------------------------------------------------------
+    struct ataconv_kernels_t
+    {
+        hex_flip_kernel_t           hexFlip;
+        swap_copy_kernel_t          swapCopy;
+        string_length_kernel_t      stringLength;
+        leading_blanks_kernel_t     leadingBlanks;
+    };
+
+    static ataconv_kernels_t selectKernels( bool bVector )
+    {
+        ataconv_kernels_t kernels = { hexFlipScalar, swapCopyScalar, stringLengthScalar, leadingBlanksScalar };
+#if defined(ATACONV_HAVE_SSSE3)
+        if( bVector && cpuHasSsse3() )
+        {
+            for( unsigned m = 0; m < 256; m++ )
+            {
+                unsigned __int8 n = 0;
+                ::memset( s_compact[m], 0x80, sizeof(s_compact[m]) );
+                for( unsigned __int8 b = 0; b < 8; b++ )
+                {
+                    if( m & ( 1U << b ) )
+                    {
+                        s_compact[m][n++] = b;
+                    }
+                }
+                s_compactCount[m] = n;
+            }
+            kernels.hexFlip       = hexFlipSsse3;
+            kernels.swapCopy      = swapCopySsse3;
+            kernels.stringLength  = stringLengthSsse3;
+            kernels.leadingBlanks = leadingBlanksSsse3;
+        }
+#endif
+        return kernels;
+    }
+
+       // chosen during the CRT static initialisation of the DLL, before any caller can run
+    static ataconv_kernels_t s_kernels = selectKernels( true );
+
+    //----------------------------------------------------------------------------------------------------------------------
+    bool ataconvUseVector( bool bVector )
+    {
+        s_kernels = selectKernels( bVector );
+        return s_kernels.hexFlip != hexFlipScalar;
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t hexFlipDecode( const char *src, size_t cch, char *dst, size_t cbDst )
+    {
+        if( nullptr == dst || 0 == cbDst )
+        {
+            return 0;
+        }
+        if( nullptr == src )
+        {
+            *dst = '\0';
+            return 0;
+        }
+        return s_kernels.hexFlip( src, cch, dst, cbDst );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void ataSwapCopy( const unsigned __int8 *field, size_t first, size_t count, char *dst )
+    {
+        s_kernels.swapCopy( field, first, count, dst );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t ataStringLength( const unsigned __int8 *field, size_t cb )
+    {
+        return s_kernels.stringLength( field, cb );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t countLeadingBlanks( const char *s, size_t n )
+    {
+        return s_kernels.leadingBlanks( s, n );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+};
@@ -0,0 +1,44 @@
+/** @file
+  * EpsDiskId/ataconv.h
+  *
+  * Decoding kernels for the identity strings drives report.
+  *
+  * All of them run in one linear pass and write into a buffer the caller provides.  On x86/x64 an
+  * SSSE3 version handles 16 input bytes per step; it is picked once, during the static
+  * initialisation of the DLL, when the CPU has SSSE3, and the scalar version is used otherwise.
+  * Both give the same result for every input.
+  */
+
+#ifndef __Utils_ATACONV_
+#define __Utils_ATACONV_
+
+#include <stddef.h>
+
+namespace Utils
+{
+       //  Serial number as some storage drivers return it in STORAGE_DEVICE_DESCRIPTOR: each pair of
+       //  hex digits is one character, and the two characters of every 4-digit group come in swapped
+       //  order.  Characters other than hex digits count as 0, so does a position past cch; a pair
+       //  that decodes to 0 is dropped.  dst receives at most cbDst-1 bytes and a NUL.
+       //  Returns the number of bytes written, NUL not counted.
+    size_t  hexFlipDecode( const char *src, size_t cch, char *dst, size_t cbDst );
+
+       //  dst[i] = field[(first + i) ^ 1] for i < count: characters of an ATA string field, whose
+       //  words hold their first character in the high byte, in reading order.  No NUL is added.
+    void    ataSwapCopy( const unsigned __int8 *field, size_t first, size_t count, char *dst );
+
+       //  Length of an ATA string field of cb bytes, a whole number of words, in reading order: up to
+       //  the first NUL, otherwise up to the last non-blank.  The first character is never trimmed,
+       //  so an all-blank field has length 1.
+    size_t  ataStringLength( const unsigned __int8 *field, size_t cb );
+
+       //  Number of blanks at the start of s[0, n); n if all of them are
+    size_t  countLeadingBlanks( const char *s, size_t n );
+
+       //  For tests and benchmarks: the scalar kernels when bVector is false, otherwise the SSSE3 ones
+       //  where the CPU has them.  Not to be called while a decode runs.  Returns whether the SSSE3
+       //  kernels are in use now.
+    bool    ataconvUseVector( bool bVector );
+};
+
+#endif
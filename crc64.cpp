@@ -1,39 +1,241 @@
 //  crc64.cpp
 
 
+#include <string.h>
+
 #include "crc64.h"
 
-static unsigned __int64 CRCtbl[256] =
-{ 
-0x0 ,0xb32e4cbe03a75f6f ,0xf4843657a840a05b ,0x47aa7ae9abe7ff34 ,0x7bd0c384ff8f5e33 ,0xc8fe8f3afc28015c ,0x8f54f5d357cffe68 ,0x3c7ab96d5468a107 ,0xf7a18709ff1ebc66 ,0x448fcbb7fcb9e309 ,0x325b15e575e1c3d ,0xb00bfde054f94352 ,0x8c71448d0091e255 ,0x3f5f08330336bd3a ,0x78f572daa8d1420e ,0xcbdb3e64ab761d61 ,
-0x7d9ba13851336649 ,0xceb5ed8652943926 ,0x891f976ff973c612 ,0x3a31dbd1fad4997d ,0x64b62bcaebc387a ,0xb5652e02ad1b6715 ,0xf2cf54eb06fc9821 ,0x41e11855055bc74e ,0x8a3a2631ae2dda2f ,0x39146a8fad8a8540 ,0x7ebe1066066d7a74 ,0xcd905cd805ca251b ,0xf1eae5b551a2841c ,0x42c4a90b5205db73 ,0x56ed3e2f9e22447 ,
-0xb6409f5cfa457b28 ,0xfb374270a266cc92 ,0x48190ecea1c193fd ,0xfb374270a266cc9 ,0xbc9d3899098133a6 ,0x80e781f45de992a1 ,0x33c9cd4a5e4ecdce ,0x7463b7a3f5a932fa ,0xc74dfb1df60e6d95 ,0xc96c5795d7870f4 ,0xbfb889c75edf2f9b ,0xf812f32ef538d0af ,0x4b3cbf90f69f8fc0 ,0x774606fda2f72ec7 ,0xc4684a43a15071a8 ,
-0x83c230aa0ab78e9c ,0x30ec7c140910d1f3 ,0x86ace348f355aadb ,0x3582aff6f0f2f5b4 ,0x7228d51f5b150a80 ,0xc10699a158b255ef ,0xfd7c20cc0cdaf4e8 ,0x4e526c720f7dab87 ,0x9f8169ba49a54b3 ,0xbad65a25a73d0bdc ,0x710d64410c4b16bd ,0xc22328ff0fec49d2 ,0x85895216a40bb6e6 ,0x36a71ea8a7ace989 ,0xadda7c5f3c4488e ,
-0xb9f3eb7bf06317e1 ,0xfe5991925b84e8d5 ,0x4d77dd2c5823b7ba ,0x64b62bcaebc387a1 ,0xd7986774e864d8ce ,0x90321d9d438327fa ,0x231c512340247895 ,0x1f66e84e144cd992 ,0xac48a4f017eb86fd ,0xebe2de19bc0c79c9 ,0x58cc92a7bfab26a6 ,0x9317acc314dd3bc7 ,0x2039e07d177a64a8 ,0x67939a94bc9d9b9c ,0xd4bdd62abf3ac4f3 ,
-0xe8c76f47eb5265f4 ,0x5be923f9e8f53a9b ,0x1c4359104312c5af ,0xaf6d15ae40b59ac0 ,0x192d8af2baf0e1e8 ,0xaa03c64cb957be87 ,0xeda9bca512b041b3 ,0x5e87f01b11171edc ,0x62fd4976457fbfdb ,0xd1d305c846d8e0b4 ,0x96797f21ed3f1f80 ,0x2557339fee9840ef ,0xee8c0dfb45ee5d8e ,0x5da24145464902e1 ,0x1a083bacedaefdd5 ,
-0xa9267712ee09a2ba ,0x955cce7fba6103bd ,0x267282c1b9c65cd2 ,0x61d8f8281221a3e6 ,0xd2f6b4961186fc89 ,0x9f8169ba49a54b33 ,0x2caf25044a02145c ,0x6b055fede1e5eb68 ,0xd82b1353e242b407 ,0xe451aa3eb62a1500 ,0x577fe680b58d4a6f ,0x10d59c691e6ab55b ,0xa3fbd0d71dcdea34 ,0x6820eeb3b6bbf755 ,0xdb0ea20db51ca83a ,
-0x9ca4d8e41efb570e ,0x2f8a945a1d5c0861 ,0x13f02d374934a966 ,0xa0de61894a93f609 ,0xe7741b60e174093d ,0x545a57dee2d35652 ,0xe21ac88218962d7a ,0x5134843c1b317215 ,0x169efed5b0d68d21 ,0xa5b0b26bb371d24e ,0x99ca0b06e7197349 ,0x2ae447b8e4be2c26 ,0x6d4e3d514f59d312 ,0xde6071ef4cfe8c7d ,0x15bb4f8be788911c ,
-0xa6950335e42fce73 ,0xe13f79dc4fc83147 ,0x521135624c6f6e28 ,0x6e6b8c0f1807cf2f ,0xdd45c0b11ba09040 ,0x9aefba58b0476f74 ,0x29c1f6e6b3e0301b ,0xc96c5795d7870f42 ,0x7a421b2bd420502d ,0x3de861c27fc7af19 ,0x8ec62d7c7c60f076 ,0xb2bc941128085171 ,0x192d8af2baf0e1e ,0x4638a2468048f12a ,0xf516eef883efae45 ,
-0x3ecdd09c2899b324 ,0x8de39c222b3eec4b ,0xca49e6cb80d9137f ,0x7967aa75837e4c10 ,0x451d1318d716ed17 ,0xf6335fa6d4b1b278 ,0xb199254f7f564d4c ,0x2b769f17cf11223 ,0xb4f7f6ad86b4690b ,0x7d9ba1385133664 ,0x4073c0fa2ef4c950 ,0xf35d8c442d53963f ,0xcf273529793b3738 ,0x7c0979977a9c6857 ,0x3ba3037ed17b9763 ,
-0x888d4fc0d2dcc80c ,0x435671a479aad56d ,0xf0783d1a7a0d8a02 ,0xb7d247f3d1ea7536 ,0x4fc0b4dd24d2a59 ,0x3886b22086258b5e ,0x8ba8fe9e8582d431 ,0xcc0284772e652b05 ,0x7f2cc8c92dc2746a ,0x325b15e575e1c3d0 ,0x8175595b76469cbf ,0xc6df23b2dda1638b ,0x75f16f0cde063ce4 ,0x498bd6618a6e9de3 ,0xfaa59adf89c9c28c ,
-0xbd0fe036222e3db8 ,0xe21ac88218962d7 ,0xc5fa92ec8aff7fb6 ,0x76d4de52895820d9 ,0x317ea4bb22bfdfed ,0x8250e80521188082 ,0xbe2a516875702185 ,0xd041dd676d77eea ,0x4aae673fdd3081de ,0xf9802b81de97deb1 ,0x4fc0b4dd24d2a599 ,0xfceef8632775faf6 ,0xbb44828a8c9205c2 ,0x86ace348f355aad ,0x34107759db5dfbaa ,
-0x873e3be7d8faa4c5 ,0xc094410e731d5bf1 ,0x73ba0db070ba049e ,0xb86133d4dbcc19ff ,0xb4f7f6ad86b4690 ,0x4ce50583738cb9a4 ,0xffcb493d702be6cb ,0xc3b1f050244347cc ,0x709fbcee27e418a3 ,0x3735c6078c03e797 ,0x841b8ab98fa4b8f8 ,0xadda7c5f3c4488e3 ,0x1ef430e13fe3d78c ,0x595e4a08940428b8 ,0xea7006b697a377d7 ,
-0xd60abfdbc3cbd6d0 ,0x6524f365c06c89bf ,0x228e898c6b8b768b ,0x91a0c532682c29e4 ,0x5a7bfb56c35a3485 ,0xe955b7e8c0fd6bea ,0xaeffcd016b1a94de ,0x1dd181bf68bdcbb1 ,0x21ab38d23cd56ab6 ,0x9285746c3f7235d9 ,0xd52f0e859495caed ,0x6601423b97329582 ,0xd041dd676d77eeaa ,0x636f91d96ed0b1c5 ,0x24c5eb30c5374ef1 ,
-0x97eba78ec690119e ,0xab911ee392f8b099 ,0x18bf525d915feff6 ,0x5f1528b43ab810c2 ,0xec3b640a391f4fad ,0x27e05a6e926952cc ,0x94ce16d091ce0da3 ,0xd3646c393a29f297 ,0x604a2087398eadf8 ,0x5c3099ea6de60cff ,0xef1ed5546e415390 ,0xa8b4afbdc5a6aca4 ,0x1b9ae303c601f3cb ,0x56ed3e2f9e224471 ,0xe5c372919d851b1e ,
-0xa26908783662e42a ,0x114744c635c5bb45 ,0x2d3dfdab61ad1a42 ,0x9e13b115620a452d ,0xd9b9cbfcc9edba19 ,0x6a978742ca4ae576 ,0xa14cb926613cf817 ,0x1262f598629ba778 ,0x55c88f71c97c584c ,0xe6e6c3cfcadb0723 ,0xda9c7aa29eb3a624 ,0x69b2361c9d14f94b ,0x2e184cf536f3067f ,0x9d36004b35545910 ,0x2b769f17cf112238 ,
-0x9858d3a9ccb67d57 ,0xdff2a94067518263 ,0x6cdce5fe64f6dd0c ,0x50a65c93309e7c0b ,0xe388102d33392364 ,0xa4226ac498dedc50 ,0x170c267a9b79833f ,0xdcd7181e300f9e5e ,0x6ff954a033a8c131 ,0x28532e49984f3e05 ,0x9b7d62f79be8616a ,0xa707db9acf80c06d ,0x14299724cc279f02 ,0x5383edcd67c06036 ,0xe0ada17364673f59
-};
+#if defined(_MSC_VER) && ( defined(_M_IX86) || defined(_M_X64) )
+#   include <intrin.h>
+#   include <wmmintrin.h>
+#   define CRC64_HAVE_CLMUL
+#   define CRC64_CLMUL_TARGET
+#   define CRC64_ALIGN16        __declspec(align(16))
+#elif defined(__GNUC__) && ( defined(__i386__) || defined(__x86_64__) )
+#   include <cpuid.h>
+#   include <wmmintrin.h>
+#   define CRC64_HAVE_CLMUL
+#   define CRC64_CLMUL_TARGET   __attribute__((target("pclmul,sse2")))
+#   define CRC64_ALIGN16        __attribute__((aligned(16)))
+#endif
+
+    //  byte-at-a-time table, generated at compile time (see crc64.h)
+static const unsigned __int64 (&CRCtbl)[256] = Crc64Table< Crc64Xz >::tbl;
 
 //-------------------------------------------------------------------------------------------------
-__int64  crc64( const void *data, const size_t length  )
+//  Slicing-by-16 tables: s_tbl16[k][i] is the CRC register after byte i is followed by k zero bytes.
+//  s_tbl16[0] is CRCtbl itself.  The tables and the kernel selection are built once, during the
+//  CRT static initialisation of the DLL, so no caller can observe them half-filled.
+static unsigned __int64 s_tbl16[16][256];
+
+    //  s_x2n[k] = x^(2^k) mod P, bit-reflected; used by crc64_combine
+static unsigned __int64 s_x2n[64];
+
+typedef unsigned __int64 (*crc64_kernel_t)( unsigned __int64 crc, const unsigned char *p, size_t len );
+
+//-------------------------------------------------------------------------------------------------
+static unsigned __int64 crc64_bytewise( unsigned __int64 crc, const unsigned char *p, size_t len )
+{
+    for( ; len > 0; len--, p++ )
+    {
+        crc = CRCtbl[ (crc ^ *p) & 0xff ] ^ crc >> 8;
+    }
+    return crc;
+}
+//-------------------------------------------------------------------------------------------------
+//  Portable fallback: 16 bytes per step, little-endian hosts (x86/x64) only.
+static unsigned __int64 crc64_slice16( unsigned __int64 crc, const unsigned char *p, size_t len )
+{
+    while( len >= 16 )
+    {
+        unsigned __int64 lo = 0;
+        ::memcpy( &lo, p, sizeof(lo) );
+        lo ^= crc;
+
+        crc = s_tbl16[15][  lo        & 0xff ] ^ s_tbl16[14][ (lo >>  8) & 0xff ] ^
+              s_tbl16[13][ (lo >> 16) & 0xff ] ^ s_tbl16[12][ (lo >> 24) & 0xff ] ^
+              s_tbl16[11][ (lo >> 32) & 0xff ] ^ s_tbl16[10][ (lo >> 40) & 0xff ] ^
+              s_tbl16[ 9][ (lo >> 48) & 0xff ] ^ s_tbl16[ 8][  lo >> 56         ] ^
+              s_tbl16[ 7][ p[ 8] ] ^ s_tbl16[ 6][ p[ 9] ] ^ s_tbl16[ 5][ p[10] ] ^ s_tbl16[ 4][ p[11] ] ^
+              s_tbl16[ 3][ p[12] ] ^ s_tbl16[ 2][ p[13] ] ^ s_tbl16[ 1][ p[14] ] ^ s_tbl16[ 0][ p[15] ];
+        p   += 16;
+        len -= 16;
+    }
+    return crc64_bytewise( crc, p, len );
+}
+//-------------------------------------------------------------------------------------------------
+#if defined(CRC64_HAVE_CLMUL)
+//  Folding constants for the reflected polynomial: { x^(D+63) mod P, x^(D-1) mod P }, bit-reflected,
+//  where D is the folding distance in bits.  The low qword of a 16-byte block holds the higher
+//  powers, so it is multiplied by the first constant.
+CRC64_ALIGN16 static const unsigned __int64 s_kFold512[2] = { 0x6ae3efbb9dd441f3ULL, 0x081f6054a7842df4ULL };
+CRC64_ALIGN16 static const unsigned __int64 s_kFold384[2] = { 0xb5ea1af9c013aca4ULL, 0x69a35d91c3730254ULL };
+CRC64_ALIGN16 static const unsigned __int64 s_kFold256[2] = { 0x60095b008a9efa44ULL, 0x3be653a30fe1af51ULL };
+CRC64_ALIGN16 static const unsigned __int64 s_kFold128[2] = { 0xe05dd497ca393ae4ULL, 0xdabe95afc7875f40ULL };
+
+CRC64_CLMUL_TARGET
+static inline __m128i crc64_fold( __m128i acc, __m128i k, __m128i next )
+{
+    return _mm_xor_si128( _mm_xor_si128( _mm_clmulepi64_si128( acc, k, 0x00 ),
+                                         _mm_clmulepi64_si128( acc, k, 0x11 ) ), next );
+}
+//-------------------------------------------------------------------------------------------------
+//  PCLMULQDQ kernel: four 128-bit lanes are folded 64 bytes at a time, merged into one lane and
+//  then folded 16 bytes at a time.  The remaining 128-bit lane has the same CRC as everything
+//  folded into it, so it is finished through the table together with the unaligned tail.
+CRC64_CLMUL_TARGET
+static unsigned __int64 crc64_clmul( unsigned __int64 crc, const unsigned char *p, size_t len )
+{
+    if( len < 64 )
+    {
+        return crc64_slice16( crc, p, len );
+    }
+    unsigned __int64 first[2] = { 0, 0 };
+    ::memcpy( first, p, sizeof(first) );
+    first[0] ^= crc;
+
+    __m128i x0 = _mm_loadu_si128( (const __m128i *)first );
+    __m128i x1 = _mm_loadu_si128( (const __m128i *)(p + 16) );
+    __m128i x2 = _mm_loadu_si128( (const __m128i *)(p + 32) );
+    __m128i x3 = _mm_loadu_si128( (const __m128i *)(p + 48) );
+    p   += 64;
+    len -= 64;
+
+    const __m128i k512 = _mm_load_si128( (const __m128i *)s_kFold512 );
+    while( len >= 64 )
+    {
+        x0 = crc64_fold( x0, k512, _mm_loadu_si128( (const __m128i *)(p +  0) ) );
+        x1 = crc64_fold( x1, k512, _mm_loadu_si128( (const __m128i *)(p + 16) ) );
+        x2 = crc64_fold( x2, k512, _mm_loadu_si128( (const __m128i *)(p + 32) ) );
+        x3 = crc64_fold( x3, k512, _mm_loadu_si128( (const __m128i *)(p + 48) ) );
+        p   += 64;
+        len -= 64;
+    }
+
+    const __m128i k128 = _mm_load_si128( (const __m128i *)s_kFold128 );
+    __m128i x = crc64_fold( x0, _mm_load_si128( (const __m128i *)s_kFold384 ), x3 );
+    x = _mm_xor_si128( x, crc64_fold( x1, _mm_load_si128( (const __m128i *)s_kFold256 ), _mm_setzero_si128() ) );
+    x = _mm_xor_si128( x, crc64_fold( x2, k128, _mm_setzero_si128() ) );
+
+    while( len >= 16 )
+    {
+        x = crc64_fold( x, k128, _mm_loadu_si128( (const __m128i *)p ) );
+        p   += 16;
+        len -= 16;
+    }
+
+    unsigned char rest[16];
+    _mm_storeu_si128( (__m128i *)rest, x );
+
+    return crc64_bytewise( crc64_slice16( 0, rest, sizeof(rest) ), p, len );
+}
+//-------------------------------------------------------------------------------------------------
+static bool crc64_cpu_has_clmul()
+{
+#if defined(_MSC_VER)
+    int info[4] = { 0 };
+    ::__cpuid( info, 1 );
+    return ( info[2] & (1 << 1) ) && ( info[3] & (1 << 26) );  // PCLMULQDQ && SSE2
+#else
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if( !__get_cpuid( 1, &eax, &ebx, &ecx, &edx ) )
+    {
+        return false;
+    }
+    return ( ecx & bit_PCLMUL ) && ( edx & bit_SSE2 );
+#endif
+}
+#endif // CRC64_HAVE_CLMUL
+//-------------------------------------------------------------------------------------------------
+//  a * b mod P for bit-reflected polynomials (bit 63 is x^0)
+static unsigned __int64 crc64_multmodp( unsigned __int64 a, unsigned __int64 b )
+{
+    unsigned __int64 m = 1ULL << 63;
+    unsigned __int64 p = 0;
+
+    for( ;; )
+    {
+        if( a & m )
+        {
+            p ^= b;
+            if( 0 == (a & (m - 1)) )
+            {
+                break;
+            }
+        }
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ (unsigned __int64)s_i64POLYNOM : b >> 1;
+    }
+    return p;
+}
+//-------------------------------------------------------------------------------------------------
+//  x^(n * 2^k) mod P
+static unsigned __int64 crc64_x2nmodp( size_t n, unsigned k )
 {
-    unsigned __int64 crc = 0xffffffffffffffff;
-    unsigned char *pdata = (unsigned char *)data;
+    unsigned __int64 p = 1ULL << 63;
 
-    for( size_t i = 0; i < length; i++, pdata++ ) 
+    for( ; n; n >>= 1, k++ )
+    {
+        if( n & 1 )
+        {
+            p = crc64_multmodp( s_x2n[k & 63], p );
+        }
+    }
+    return p;
+}
+//-------------------------------------------------------------------------------------------------
+static crc64_kernel_t crc64_select_kernel()
+{
+    s_x2n[0] = 1ULL << 62;                          // x^1
+    for( int k = 1; k < 64; k++ )
+    {
+        s_x2n[k] = crc64_multmodp( s_x2n[k-1], s_x2n[k-1] );
+    }
+
+    ::memcpy( s_tbl16[0], CRCtbl, sizeof(CRCtbl) );
+    for( int k = 1; k < 16; k++ )
+    {
+        for( int i = 0; i < 256; i++ )
+        {
+            s_tbl16[k][i] = CRCtbl[ s_tbl16[k-1][i] & 0xff ] ^ s_tbl16[k-1][i] >> 8;
+        }
+    }
+#if defined(CRC64_HAVE_CLMUL)
+    if( crc64_cpu_has_clmul() )
     {
-        crc = CRCtbl[ (crc ^ *pdata) & 0xff ] ^ crc >> 8;
+        return crc64_clmul;
     }
-    return crc ^ 0xffffffffffffffff;
+#endif
+    return crc64_slice16;
+}
+
+static const crc64_kernel_t s_crc64_kernel = crc64_select_kernel();
+
+//-------------------------------------------------------------------------------------------------
+__int64  crc64( const void *data, const size_t length  )
+{
+    return crc64_final( crc64_update( crc64_init(), data, length ) );
+}
+//-------------------------------------------------------------------------------------------------
+unsigned __int64  crc64_init()
+{
+    return Crc64Xz::init;
+}
+//-------------------------------------------------------------------------------------------------
+unsigned __int64  crc64_update( unsigned __int64 crc, const void *data, const size_t length )
+{
+    return s_crc64_kernel( crc, (const unsigned char *)data, length );
+}
+//-------------------------------------------------------------------------------------------------
+__int64  crc64_final( unsigned __int64 crc )
+{
+    return crc ^ Crc64Xz::xorout;
+}
+//-------------------------------------------------------------------------------------------------
+//  The register inversions of A and B cancel out, so the combination is just crcA shifted over
+//  lenB zero bytes, xor crcB (the same identity zlib uses for crc32_combine).
+__int64  crc64_combine( __int64 crcA, __int64 crcB, const size_t lenB )
+{
+    return crc64_multmodp( crc64_x2nmodp( lenB, 3 ), (unsigned __int64)crcA ) ^ (unsigned __int64)crcB;
 }
 //-------------------------------------------------------------------------------------------------
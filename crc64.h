@@ -5,8 +5,135 @@
 #ifndef __CRC64P_H_INCLUDED
 #define __CRC64P_H_INCLUDED
 
+#include <stddef.h>
+
 __int64  crc64( const void *data, const size_t len  );
 
+    //  streaming interface: crc64( d, n ) == crc64_final( crc64_update( crc64_init(), d, n ) )
+unsigned __int64  crc64_init();
+unsigned __int64  crc64_update( unsigned __int64 crc, const void *data, const size_t len );
+__int64           crc64_final( unsigned __int64 crc );
+
+    //  crc64 of A followed by B, given crc64(A), crc64(B) and the length of B in bytes
+__int64  crc64_combine( __int64 crcA, __int64 crcB, const size_t lenB );
+
 static const __int64 s_i64POLYNOM = 0xC96C5795D7870F42;
 
+//-------------------------------------------------------------------------------------------------
+//  Compile-time CRC-64 tables.  A model is described by its polynomial (bit-reflected when
+//  Reflected is true), the initial register value and the final xor.  Table entries are
+//  instantiated as integral constants, so Crc64Table<Model>::tbl is emitted as read-only data.
+template< unsigned __int64 Poly, bool Reflected, unsigned __int64 Init, unsigned __int64 XorOut >
+struct Crc64Model
+{
+    static const unsigned __int64 poly      = Poly;
+    static const bool             reflected = Reflected;
+    static const unsigned __int64 init      = Init;
+    static const unsigned __int64 xorout    = XorOut;
+};
+
+    //  CRC-64/XZ: the model crc64() has always used
+typedef Crc64Model< (unsigned __int64)s_i64POLYNOM, true, 0xffffffffffffffffULL, 0xffffffffffffffffULL >  Crc64Xz;
+    //  CRC-64/ECMA-182: same polynomial, MSB first, no inversion
+typedef Crc64Model< 0x42F0E1EBA9EA3693ULL, false, 0ULL, 0ULL >                                            Crc64Ecma182;
+
+namespace Crc64Detail
+{
+    template< unsigned __int64 Poly, unsigned __int64 Crc, int Bits >
+    struct ReflectedStep
+    {
+        static const unsigned __int64 value =
+            ReflectedStep< Poly, (Crc & 1) ? (Crc >> 1) ^ Poly : (Crc >> 1), Bits - 1 >::value;
+    };
+    template< unsigned __int64 Poly, unsigned __int64 Crc >
+    struct ReflectedStep< Poly, Crc, 0 >
+    {
+        static const unsigned __int64 value = Crc;
+    };
+
+    template< unsigned __int64 Poly, unsigned __int64 Crc, int Bits >
+    struct NormalStep
+    {
+        static const unsigned __int64 value =
+            NormalStep< Poly, (Crc >> 63) ? (Crc << 1) ^ Poly : (Crc << 1), Bits - 1 >::value;
+    };
+    template< unsigned __int64 Poly, unsigned __int64 Crc >
+    struct NormalStep< Poly, Crc, 0 >
+    {
+        static const unsigned __int64 value = Crc;
+    };
+
+        //  register after feeding byte B into Crc, computed bit by bit
+    template< class Model, unsigned __int64 Crc, unsigned char B >
+    struct Feed
+    {
+        static const unsigned __int64 value = Model::reflected
+            ? ReflectedStep< Model::poly, Crc ^ B, 8 >::value
+            : NormalStep< Model::poly, Crc ^ ((unsigned __int64)B << 56), 8 >::value;
+    };
+
+    template< class Model, int I >
+    struct Entry
+    {
+        static const unsigned __int64 value = Feed< Model, 0, (unsigned char)I >::value;
+    };
+
+        //  standard check value: CRC of the ASCII string "123456789"
+    template< class Model >
+    struct Check
+    {
+        static const unsigned __int64 value =
+            Feed< Model, Feed< Model, Feed< Model, Feed< Model, Feed< Model, Feed< Model, Feed< Model,
+            Feed< Model, Feed< Model, Model::init, '1' >::value, '2' >::value, '3' >::value, '4' >::value,
+            '5' >::value, '6' >::value, '7' >::value, '8' >::value, '9' >::value ^ Model::xorout;
+    };
+};
+
+template< class Model >
+struct Crc64Table
+{
+    static const unsigned __int64 tbl[256];
+};
+
+#define CRC64_TBL_E(i)    Crc64Detail::Entry< Model, (i) >::value
+#define CRC64_TBL_E4(i)   CRC64_TBL_E(i),  CRC64_TBL_E((i)+1),  CRC64_TBL_E((i)+2),  CRC64_TBL_E((i)+3)
+#define CRC64_TBL_E16(i)  CRC64_TBL_E4(i), CRC64_TBL_E4((i)+4), CRC64_TBL_E4((i)+8), CRC64_TBL_E4((i)+12)
+#define CRC64_TBL_E64(i)  CRC64_TBL_E16(i), CRC64_TBL_E16((i)+16), CRC64_TBL_E16((i)+32), CRC64_TBL_E16((i)+48)
+
+template< class Model >
+const unsigned __int64 Crc64Table< Model >::tbl[256] =
+{
+    CRC64_TBL_E64(0), CRC64_TBL_E64(64), CRC64_TBL_E64(128), CRC64_TBL_E64(192)
+};
+
+#undef CRC64_TBL_E64
+#undef CRC64_TBL_E16
+#undef CRC64_TBL_E4
+#undef CRC64_TBL_E
+
+    //  the published check values of both models
+static_assert( Crc64Detail::Check< Crc64Xz >::value      == 0x995DC9BBDF1939FAULL, "CRC-64/XZ check value" );
+static_assert( Crc64Detail::Check< Crc64Ecma182 >::value == 0x6C40DF5F0B497347ULL, "CRC-64/ECMA-182 check value" );
+    //  entries 20 and 34 only look truncated in the old hand-pasted table: they have a leading zero nibble
+static_assert( Crc64Detail::Entry< Crc64Xz, 20 >::value  == 0x064B62BCAEBC387AULL, "CRC-64/XZ table entry 20" );
+static_assert( Crc64Detail::Entry< Crc64Xz, 34 >::value  == 0x0FB374270A266CC9ULL, "CRC-64/XZ table entry 34" );
+
+//-------------------------------------------------------------------------------------------------
+//  Table-driven CRC for any model, e.g. crc64_calc< Crc64Ecma182 >( data, len ).
+//  crc64() uses the hardware/slicing kernels for Crc64Xz and is the function to call for duuid.
+template< class Model >
+unsigned __int64 crc64_calc( const void *data, const size_t len )
+{
+    const unsigned __int64 *tbl = Crc64Table< Model >::tbl;
+    const unsigned char    *p   = (const unsigned char *)data;
+    unsigned __int64        crc = Model::init;
+
+    for( size_t i = 0; i < len; i++, p++ )
+    {
+        crc = Model::reflected ? tbl[ (crc ^ *p) & 0xff ] ^ crc >> 8
+                               : tbl[ (crc >> 56 ^ *p) & 0xff ] ^ crc << 8;
+    }
+    return crc ^ Model::xorout;
+}
+
 #endif // __CRC64P_H_INCLUDED
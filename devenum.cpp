@@ -0,0 +1,232 @@
+/** @file
+  * EpsDiskId/devenum.cpp
+  *
+  * Lists the storage devices that actually exist instead of probing a fixed range of names.
+  */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#ifdef _WIN32
+#   include <windows.h>
+#   include <winioctl.h>
+#   include <setupapi.h>
+#else
+#   include <dirent.h>
+#   include <unistd.h>
+#endif
+
+#include "devenum.h"
+
+#ifdef _MSC_VER
+#pragma warning (disable : 4996)
+#endif
+
+namespace Utils
+{
+    //----------------------------------------------------------------------------------------------------------------------
+    device_t &nextDevice( std::vector<device_t> &devices, size_t &count )
+    {
+        if( count == devices.size() )
+        {
+            devices.push_back( device_t() );
+        }
+        return devices[count++];
+    }
+#ifdef _WIN32
+    //----------------------------------------------------------------------------------------------------------------------
+    static bool deviceLess( const device_t &a, const device_t &b )
+    {
+        return a.index < b.index;
+    }
+
+       //  GUID_DEVINTERFACE_DISK from ntddstor.h
+    static const GUID s_guidDiskInterface = { 0x53f56307, 0xb6bf, 0x11d0, { 0x94, 0xf2, 0x00, 0xa0, 0xc9, 0x1e, 0xfb, 0x8b } };
+
+    //----------------------------------------------------------------------------------------------------------------------
+    //  DeviceNumber of an interface path, i.e. the N of \\.\PhysicalDriveN; opening with no access
+    //  rights is enough for IOCTL_STORAGE_GET_DEVICE_NUMBER
+    static int getDeviceNumber( const wchar_t *interfacePath )
+    {
+        HANDLE hDevice = ::CreateFileW( interfacePath, 0, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL );
+
+        if( INVALID_HANDLE_VALUE == hDevice )
+        {
+            return -1;
+        }
+        STORAGE_DEVICE_NUMBER number;
+        DWORD                 cbBytesReturned = 0;
+
+        ::memset( &number, 0, sizeof(number) );
+
+        const BOOL ok = ::DeviceIoControl( hDevice, IOCTL_STORAGE_GET_DEVICE_NUMBER, NULL, 0,
+                                           &number, sizeof(number), &cbBytesReturned, NULL );
+        ::CloseHandle( hDevice );
+
+        return ok ? (int)number.DeviceNumber : -1;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool enumPhysicalDrives( std::vector<device_t> &devices )
+    {
+        HDEVINFO hDevInfo = ::SetupDiGetClassDevsW( &s_guidDiskInterface, NULL, NULL, DIGCF_PRESENT | DIGCF_DEVICEINTERFACE );
+
+        if( INVALID_HANDLE_VALUE == hDevInfo )
+        {
+            devices.clear();
+            return false;
+        }
+           //  the usual interface path fits on the stack; only a longer one takes the heap
+        DWORD              fixed[256];
+        std::vector<DWORD> large;
+        DWORD             *detail   = fixed;
+        DWORD              cbDetail = sizeof(fixed);
+        size_t             count    = 0;
+        bool               ok       = true;
+
+        for( DWORD i = 0; ; i++ )
+        {
+            SP_DEVICE_INTERFACE_DATA ifData;
+
+            ::memset( &ifData, 0, sizeof(ifData) );
+            ifData.cbSize = sizeof(ifData);
+
+            if( !::SetupDiEnumDeviceInterfaces( hDevInfo, NULL, &s_guidDiskInterface, i, &ifData ) )
+            {
+                ok = ( ERROR_NO_MORE_ITEMS == ::GetLastError() );
+                break;
+            }
+            DWORD cbRequired = 0;
+
+            ::SetupDiGetDeviceInterfaceDetailW( hDevInfo, &ifData, NULL, 0, &cbRequired, NULL );
+            if( cbRequired > cbDetail )
+            {
+                large.resize( ( cbRequired + sizeof(DWORD) - 1 ) / sizeof(DWORD) );
+                detail   = &large[0];
+                cbDetail = (DWORD)( large.size() * sizeof(DWORD) );
+            }
+            PSP_DEVICE_INTERFACE_DETAIL_DATA_W pDetail = (PSP_DEVICE_INTERFACE_DETAIL_DATA_W)detail;
+            pDetail->cbSize = sizeof(SP_DEVICE_INTERFACE_DETAIL_DATA_W);
+
+            if( !::SetupDiGetDeviceInterfaceDetailW( hDevInfo, &ifData, pDetail, cbDetail, NULL, NULL ) )
+            {
+                continue;
+            }
+            const int number = getDeviceNumber( pDetail->DevicePath );
+            if( number < 0 )
+            {
+                continue;
+            }
+            wchar_t driveName [256] = {0};
+            ::_snwprintf( driveName, _countof(driveName)-1, L"\\\\.\\PhysicalDrive%d", number );
+
+            device_t &dev = nextDevice( devices, count );
+            dev.index = number;
+            dev.path  = driveName;
+        }
+        ::SetupDiDestroyDeviceInfoList( hDevInfo );
+        devices.resize( count );
+
+        std::sort( devices.begin(), devices.end(), deviceLess );
+        return ok;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    //  every SCSI/ATA port driver registers itself as HKLM\HARDWARE\DEVICEMAP\Scsi\Scsi Port N
+    bool enumScsiPorts( std::vector<device_t> &devices )
+    {
+        HKEY   hScsi = NULL;
+        size_t count = 0;
+        if( ERROR_SUCCESS != ::RegOpenKeyExW( HKEY_LOCAL_MACHINE, L"HARDWARE\\DEVICEMAP\\Scsi", 0, KEY_READ, &hScsi ) )
+        {
+            devices.clear();
+            return false;
+        }
+        for( DWORD i = 0; ; i++ )
+        {
+            wchar_t keyName [256] = {0};
+            DWORD   cchName       = _countof(keyName);
+
+            const LONG rc = ::RegEnumKeyExW( hScsi, i, keyName, &cchName, NULL, NULL, NULL, NULL );
+            if( ERROR_SUCCESS != rc )
+            {
+                break;
+            }
+            int port = -1;
+            if( 1 != ::swscanf( keyName, L"Scsi Port %d", &port ) || port < 0 )
+            {
+                continue;
+            }
+            wchar_t driveName [256] = {0};
+            ::_snwprintf( driveName, _countof(driveName)-1, L"\\\\.\\Scsi%d:", port );
+
+            device_t &dev = nextDevice( devices, count );
+            dev.index = port;
+            dev.path  = driveName;
+        }
+        ::RegCloseKey( hScsi );
+        devices.resize( count );
+
+        std::sort( devices.begin(), devices.end(), deviceLess );
+        return true;
+    }
+#else
+    //----------------------------------------------------------------------------------------------------------------------
+    //  sda < sdb < ... < sdz < sdaa, nvme0n1 < nvme1n1 < nvme10n1
+    static bool blockNameLess( const std::string &a, const std::string &b )
+    {
+        if( a.size() != b.size() )
+        {
+            return a.size() < b.size();
+        }
+        return a < b;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool enumPhysicalDrives( std::vector<device_t> &devices )
+    {
+        DIR *dir = ::opendir( "/sys/block" );
+        if( nullptr == dir )
+        {
+            devices.clear();
+            return false;
+        }
+        std::vector<std::string> names;
+
+        for( struct dirent *ent = ::readdir( dir ); nullptr != ent; ent = ::readdir( dir ) )
+        {
+            if( '.' == ent->d_name[0] )
+            {
+                continue;
+            }
+               //  only block devices with a backing device node have a "device" link
+            std::string link = std::string( "/sys/block/" ) + ent->d_name + "/device";
+            if( 0 != ::access( link.c_str(), F_OK ) )
+            {
+                continue;
+            }
+            names.push_back( ent->d_name );
+        }
+        ::closedir( dir );
+
+        std::sort( names.begin(), names.end(), blockNameLess );
+
+        size_t count = 0;
+        for( size_t i = 0; i < names.size(); i++ )
+        {
+            device_t &dev = nextDevice( devices, count );
+            dev.index = (int)i;
+            dev.name  = names[i];
+            dev.path.assign( "/dev/" ).append( names[i] );
+        }
+        devices.resize( count );
+        return true;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool enumScsiPorts( std::vector<device_t> &devices )
+    {
+        devices.clear();
+        return false;
+    }
+#endif
+};
@@ -0,0 +1,48 @@
+/** @file
+  * EpsDiskId/devenum.h
+  *
+  * Lists the storage devices that actually exist instead of probing a fixed range of names.
+  *
+  * Windows: disk device interfaces (SetupAPI) mapped to their \\.\PhysicalDriveN number, and the
+  *          SCSI ports registered under HKLM\HARDWARE\DEVICEMAP\Scsi.
+  * Linux:   entries of /sys/block that are backed by a device (loop, ram, dm-* etc. are skipped).
+  */
+
+#ifndef __Utils_DEVENUM_
+#define __Utils_DEVENUM_
+
+#include <vector>
+#include <string>
+
+namespace Utils
+{
+#ifdef _WIN32
+    typedef std::wstring    device_path_t;
+#else
+    typedef std::string     device_path_t;
+#endif
+
+    struct device_t
+    {
+        int             index;      // N of \\.\PhysicalDriveN / \\.\ScsiN: , position in /sys/block on Linux
+#ifdef _WIN32
+        device_path_t   path;       // name to pass to CreateFileW
+#else
+        device_path_t   path;       // /dev/<name>
+        std::string     name;       // <name> under /sys/block
+#endif
+        device_t() : index( -1 ) {}
+    };
+
+       //  Both return false when the OS could not be asked; the caller then falls back to probing
+       //  the fixed range.  On success the list is sorted by index and may legitimately be empty.
+    bool    enumPhysicalDrives( std::vector<device_t> &devices );
+    bool    enumScsiPorts( std::vector<device_t> &devices );
+
+       //  Next entry of a list being refilled, count of them written so far: entries already there
+       //  are written over in place, so a list kept from one call to the next reuses the storage of
+       //  its paths.  The caller resizes the list to count when done.
+    device_t   &nextDevice( std::vector<device_t> &devices, size_t &count );
+};
+
+#endif
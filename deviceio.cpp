@@ -0,0 +1,438 @@
+/** @file
+  * EpsDiskId/deviceio.cpp
+  *
+  * The live device backend: requests go to the OS.
+  */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#   include <windows.h>
+#else
+#   include <errno.h>
+#   include <fcntl.h>
+#   include <stdint.h>
+#   include <unistd.h>
+#   include <sys/ioctl.h>
+#   include <scsi/sg.h>
+#   include <linux/nvme_ioctl.h>
+#endif
+
+#include "deviceio.h"
+#include "nvme.h"
+#include "osutil.h"
+
+namespace Utils
+{
+#define  DEVICE_ATTRIBUTE_MAX   4096    // sysfs attributes are at most a page
+
+#ifdef _WIN32
+    struct overlapped_io_t;
+#endif
+
+    class LiveDeviceIo : public DeviceIo
+    {
+        public:
+#ifdef _WIN32
+            LiveDeviceIo() : m_pFree( nullptr ) {}
+            ~LiveDeviceIo();
+#endif
+            virtual bool    listDevices( bool scsiPorts, std::vector<device_t> &devices );
+            virtual void   *open( const device_path_t &path, unsigned long access, bool bOverlapped, unsigned long &error );
+            virtual bool    control( void *hDevice, unsigned long code, const void *pIn, unsigned long cbIn,
+                                     void *pOut, unsigned long cbOut, unsigned long &cbReturned,
+                                     unsigned long timeoutMs, unsigned long &error );
+            virtual void    close( void *hDevice );
+            virtual bool    readAttribute( const device_path_t &path, std::string &text, unsigned long &error );
+
+        private:
+#ifdef _WIN32
+            bool            controlOverlapped( void *hDevice, unsigned long code, const void *pIn, unsigned long cbIn,
+                                               void *pOut, unsigned long cbOut, unsigned long &cbReturned,
+                                               unsigned long timeoutMs, unsigned long &error );
+            overlapped_io_t    *takeBlock( size_t cbData, unsigned long &error );
+            void                giveBlock( overlapped_io_t *io );
+
+            OsLock              m_lock;
+            overlapped_io_t    *m_pFree;        // request blocks back from completed requests
+#else
+            bool            scsiRead( int fd, const void *pCdb, unsigned long cbCdb, void *pOut, unsigned long cbOut,
+                                      unsigned long &cbReturned, unsigned long timeoutMs, unsigned long &error );
+            bool            nvmeAdmin( int fd, const void *pCommand, unsigned long cbCommand, void *pOut, unsigned long cbOut,
+                                       unsigned long &cbReturned, unsigned long timeoutMs, unsigned long &error );
+#endif
+    };
+
+       // constructed with the module and shared by every prober
+    static LiveDeviceIo s_liveDeviceIo;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    DeviceIo &liveDeviceIo()
+    {
+        return s_liveDeviceIo;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool LiveDeviceIo::listDevices( bool scsiPorts, std::vector<device_t> &devices )
+    {
+        return scsiPorts ? enumScsiPorts( devices ) : enumPhysicalDrives( devices );
+    }
+
+#ifdef _WIN32
+       // Request block of an overlapped IOCTL.  Input and output live here rather than in the caller's
+       // buffers: when a driver ignores the cancel the block is left to it and never freed.  A block
+       // that comes back is kept, event and all, for a later request.
+    struct overlapped_io_t
+    {
+        OVERLAPPED          ov;
+        size_t              cbData;     // room in data
+        overlapped_io_t    *pNext;      // in LiveDeviceIo::m_pFree
+        unsigned char       data[1];
+    };
+
+#define  DISK_CANCEL_GRACE_MS   100     // time a driver gets to complete a cancelled request
+#define  DEVICE_IO_BLOCK_MIN    4096    // room of the smallest block, so that most requests fit any kept one
+
+    //----------------------------------------------------------------------------------------------------------------------
+    LiveDeviceIo::~LiveDeviceIo()
+    {
+        while( nullptr != m_pFree )
+        {
+            overlapped_io_t *io = m_pFree;
+            m_pFree = io->pNext;
+            ::CloseHandle( io->ov.hEvent );
+            ::free( io );
+        }
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // a kept block with room for cbData, or a new one
+    overlapped_io_t *LiveDeviceIo::takeBlock( size_t cbData, unsigned long &error )
+    {
+        {
+            OsLockGuard guard( m_lock );
+            for( overlapped_io_t **pp = &m_pFree; nullptr != *pp; pp = &(*pp)->pNext )
+            {
+                if( (*pp)->cbData >= cbData )
+                {
+                    overlapped_io_t *io = *pp;
+                    *pp = io->pNext;
+                    return io;
+                }
+            }
+        }
+        const size_t     cbRoom = ( cbData > DEVICE_IO_BLOCK_MIN ) ? cbData : DEVICE_IO_BLOCK_MIN;
+        overlapped_io_t *io     = (overlapped_io_t *)::malloc( offsetof(overlapped_io_t, data) + cbRoom );
+        if( nullptr == io )
+        {
+            error = ERROR_NOT_ENOUGH_MEMORY;
+            return nullptr;
+        }
+        io->cbData    = cbRoom;
+        io->pNext     = nullptr;
+        io->ov.hEvent = ::CreateEventW( NULL, TRUE, FALSE, NULL );
+        if( NULL == io->ov.hEvent )
+        {
+            error = ::GetLastError();
+            ::free( io );
+            return nullptr;
+        }
+        return io;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void LiveDeviceIo::giveBlock( overlapped_io_t *io )
+    {
+        OsLockGuard guard( m_lock );
+        io->pNext = m_pFree;
+        m_pFree   = io;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void *LiveDeviceIo::open( const device_path_t &path, unsigned long access, bool bOverlapped, unsigned long &error )
+    {
+        HANDLE hDevice = ::CreateFileW( path.c_str(), access, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                                        OPEN_EXISTING, bOverlapped ? FILE_FLAG_OVERLAPPED : 0, NULL );
+        if( INVALID_HANDLE_VALUE == hDevice )
+        {
+            error = ::GetLastError();
+            return nullptr;
+        }
+        error = ERROR_SUCCESS;
+        return hDevice;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void LiveDeviceIo::close( void *hDevice )
+    {
+        if( nullptr != hDevice )
+        {
+            ::CloseHandle( hDevice );
+        }
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool LiveDeviceIo::control( void *hDevice, unsigned long code, const void *pIn, unsigned long cbIn,
+                                void *pOut, unsigned long cbOut, unsigned long &cbReturned,
+                                unsigned long timeoutMs, unsigned long &error )
+    {
+        cbReturned = 0;
+        if( DEVICE_IO_INFINITE != timeoutMs )
+        {
+            return controlOverlapped( hDevice, code, pIn, cbIn, pOut, cbOut, cbReturned, timeoutMs, error );
+        }
+        DWORD      cb = 0;
+        const BOOL ok = ::DeviceIoControl( hDevice, code, const_cast<void*>( pIn ), cbIn, pOut, cbOut, &cb, NULL );
+
+        cbReturned = cb;
+        error      = ok ? ERROR_SUCCESS : ::GetLastError();
+        return FALSE != ok;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // DeviceIoControl on a handle opened for overlapped I/O, cancelled when it overruns timeoutMs
+    bool LiveDeviceIo::controlOverlapped( void *hDevice, unsigned long code, const void *pIn, unsigned long cbIn,
+                                          void *pOut, unsigned long cbOut, unsigned long &cbReturned,
+                                          unsigned long timeoutMs, unsigned long &error )
+    {
+        overlapped_io_t *io = takeBlock( (size_t)cbIn + cbOut, error );
+        if( nullptr == io )
+        {
+            return false;
+        }
+        const HANDLE hEvent = io->ov.hEvent;
+        ::memset( &io->ov, 0, sizeof(io->ov) );
+        io->ov.hEvent = hEvent;
+        ::ResetEvent( hEvent );
+        unsigned char *pInCopy  = io->data;
+        unsigned char *pOutCopy = io->data + cbIn;
+
+        if( nullptr != pIn && cbIn > 0 )
+        {
+            ::memcpy( pInCopy, pIn, cbIn );
+        }
+
+        BOOL  ok  = ::DeviceIoControl( hDevice, code, nullptr != pIn ? pInCopy : NULL, cbIn,
+                                       nullptr != pOut ? pOutCopy : NULL, cbOut, NULL, &io->ov );
+        DWORD err = ok ? ERROR_SUCCESS : ::GetLastError();
+
+        if( !ok && ERROR_IO_PENDING == err )
+        {
+            if( WAIT_TIMEOUT == ::WaitForSingleObject( io->ov.hEvent, (DWORD)timeoutMs ) )
+            {
+                ::CancelIo( hDevice );
+
+                error = DEVICE_IO_TIMEOUT;
+                if( WAIT_TIMEOUT == ::WaitForSingleObject( io->ov.hEvent, DISK_CANCEL_GRACE_MS ) )
+                {
+                    return false;                   // io still belongs to the driver
+                }
+                giveBlock( io );
+                return false;
+            }
+            ok = TRUE;
+        }
+
+        DWORD cb = 0;
+        if( ok )
+        {
+            ok  = ::GetOverlappedResult( hDevice, &io->ov, &cb, FALSE );
+            err = ok ? ERROR_SUCCESS : ::GetLastError();
+        }
+        if( ok )
+        {
+            if( cb > cbOut )
+            {
+                cb = cbOut;
+            }
+            if( nullptr != pOut )
+            {
+                ::memcpy( pOut, pOutCopy, cb );
+            }
+            cbReturned = cb;
+        }
+        giveBlock( io );
+        error = err;
+
+        return FALSE != ok;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool LiveDeviceIo::readAttribute( const device_path_t &path, std::string &text, unsigned long &error )
+    {
+        HANDLE hFile = ::CreateFileW( path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL );
+        if( INVALID_HANDLE_VALUE == hFile )
+        {
+            error = ::GetLastError();
+            return false;
+        }
+        char  buffer[DEVICE_ATTRIBUTE_MAX];
+        DWORD cbRead = 0;
+        const BOOL ok = ::ReadFile( hFile, buffer, sizeof(buffer), &cbRead, NULL );
+
+        error = ok ? ERROR_SUCCESS : ::GetLastError();
+        ::CloseHandle( hFile );
+        if( ok )
+        {
+            text.assign( buffer, cbRead );
+        }
+        return FALSE != ok;
+    }
+#else
+#define  DEVICE_HOST_TIMED_OUT     0x03    // DID_TIME_OUT
+#define  DEVICE_DRIVER_TIMED_OUT   0x06    // DRIVER_TIMEOUT
+#define  DEVICE_NVME_HOST_ABORTED  0x371   // status of a command the host aborted, e.g. on its timeout
+
+       // file descriptors are kept off 0, so that a valid handle is never nullptr
+    static int descriptorOf( void *hDevice )
+    {
+        return (int)(intptr_t)hDevice - 1;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void *LiveDeviceIo::open( const device_path_t &path, unsigned long access, bool, unsigned long &error )
+    {
+        const int flags = ( DEVICE_IO_READ_WRITE == ( access & DEVICE_IO_READ_WRITE ) ) ? O_RDWR : O_RDONLY;
+        const int fd    = ::open( path.c_str(), flags | O_NONBLOCK | O_CLOEXEC );
+        if( fd < 0 )
+        {
+            error = (unsigned long)errno;
+            return nullptr;
+        }
+        error = 0;
+        return (void *)(intptr_t)( fd + 1 );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void LiveDeviceIo::close( void *hDevice )
+    {
+        if( nullptr != hDevice )
+        {
+            ::close( descriptorOf( hDevice ) );
+        }
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool LiveDeviceIo::control( void *hDevice, unsigned long code, const void *pIn, unsigned long cbIn,
+                                void *pOut, unsigned long cbOut, unsigned long &cbReturned,
+                                unsigned long timeoutMs, unsigned long &error )
+    {
+        const int fd = descriptorOf( hDevice );
+
+        cbReturned = 0;
+        if( SG_IO == code )
+        {
+            return scsiRead( fd, pIn, cbIn, pOut, cbOut, cbReturned, timeoutMs, error );
+        }
+        if( NVME_IOCTL_ADMIN_CMD == code )
+        {
+            return nvmeAdmin( fd, pIn, cbIn, pOut, cbOut, cbReturned, timeoutMs, error );
+        }
+        if( nullptr != pIn && nullptr != pOut && cbIn > 0 )
+        {
+            ::memcpy( pOut, pIn, ( cbIn < cbOut ) ? cbIn : cbOut );
+        }
+        if( ::ioctl( fd, code, pOut ) < 0 )
+        {
+            error = (unsigned long)errno;
+            return false;
+        }
+        cbReturned = cbOut;
+        error      = 0;
+        return true;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // A SCSI command that reads from the device.  A recovered error still carries the data, which
+       // is how some SATL answer an ATA PASS-THROUGH.
+    bool LiveDeviceIo::scsiRead( int fd, const void *pCdb, unsigned long cbCdb, void *pOut, unsigned long cbOut,
+                                 unsigned long &cbReturned, unsigned long timeoutMs, unsigned long &error )
+    {
+        unsigned char sense[32] = {0};
+        sg_io_hdr_t   hdr;
+
+        if( nullptr == pCdb || 0 == cbCdb || cbCdb > 16 )
+        {
+            error = EINVAL;
+            return false;
+        }
+        ::memset( &hdr, 0, sizeof(hdr) );
+        hdr.interface_id    = 'S';
+        hdr.dxfer_direction = SG_DXFER_FROM_DEV;
+        hdr.cmd_len         = (unsigned char)cbCdb;
+        hdr.cmdp            = (unsigned char *)const_cast<void *>( pCdb );
+        hdr.dxfer_len       = (unsigned int)cbOut;
+        hdr.dxferp          = pOut;
+        hdr.mx_sb_len       = sizeof(sense);
+        hdr.sbp             = sense;
+        hdr.timeout         = ( DEVICE_IO_INFINITE == timeoutMs ) ? 0 : (unsigned int)timeoutMs;     // 0: the kernel default
+
+        if( ::ioctl( fd, SG_IO, &hdr ) < 0 )
+        {
+            error = ( ETIMEDOUT == errno ) ? DEVICE_IO_TIMEOUT : (unsigned long)errno;
+            return false;
+        }
+        const unsigned senseKey = ( hdr.sb_len_wr < 3 ) ? 0 :
+                                  ( ( sense[0] & 0x7f ) >= 0x72 ) ? ( sense[1] & 0x0f ) : ( sense[2] & 0x0f );
+        if( 0 != hdr.host_status || ( 0 != hdr.status && 1 != senseKey ) )
+        {
+            const bool timedOut = ( DEVICE_HOST_TIMED_OUT == hdr.host_status ) ||
+                                  ( DEVICE_DRIVER_TIMED_OUT == ( hdr.driver_status & 0x0f ) );
+            error = timedOut ? DEVICE_IO_TIMEOUT : EIO;
+            return false;
+        }
+        cbReturned = ( hdr.resid > 0 && (unsigned long)hdr.resid < cbOut ) ? cbOut - (unsigned long)hdr.resid : cbOut;
+        error      = 0;
+        return true;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // An admin command that reads from the controller.  The ioctl returns the NVMe status when the
+       // controller completed the command with an error.
+    bool LiveDeviceIo::nvmeAdmin( int fd, const void *pCommand, unsigned long cbCommand, void *pOut, unsigned long cbOut,
+                                  unsigned long &cbReturned, unsigned long timeoutMs, unsigned long &error )
+    {
+        if( nullptr == pCommand || sizeof(nvme_admin_t) != cbCommand )
+        {
+            error = EINVAL;
+            return false;
+        }
+        const nvme_admin_t *command = (const nvme_admin_t *)pCommand;
+        struct nvme_admin_cmd cmd;
+
+        ::memset( &cmd, 0, sizeof(cmd) );
+        cmd.opcode     = command->opcode;
+        cmd.nsid       = command->nsid;
+        cmd.cdw10      = command->cdw10;
+        cmd.cdw11      = command->cdw11;
+        cmd.addr       = (unsigned long long)(uintptr_t)pOut;
+        cmd.data_len   = (unsigned int)cbOut;
+        cmd.timeout_ms = ( DEVICE_IO_INFINITE == timeoutMs ) ? 0 : (unsigned int)timeoutMs;   // 0: the kernel default
+
+        const int status = ::ioctl( fd, NVME_IOCTL_ADMIN_CMD, &cmd );
+        if( status < 0 )
+        {
+            error = ( ETIMEDOUT == errno ) ? DEVICE_IO_TIMEOUT : (unsigned long)errno;
+            return false;
+        }
+        if( 0 != status )
+        {
+            error = ( DEVICE_NVME_HOST_ABORTED == ( status & 0x7ff ) ) ? DEVICE_IO_TIMEOUT : EIO;
+            return false;
+        }
+        cbReturned = cbOut;
+        error      = 0;
+        return true;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool LiveDeviceIo::readAttribute( const device_path_t &path, std::string &text, unsigned long &error )
+    {
+        const int fd = ::open( path.c_str(), O_RDONLY | O_CLOEXEC );
+        if( fd < 0 )
+        {
+            error = (unsigned long)errno;
+            return false;
+        }
+        char          buffer[DEVICE_ATTRIBUTE_MAX];
+        const ssize_t cb = ::read( fd, buffer, sizeof(buffer) );
+
+        error = ( cb < 0 ) ? (unsigned long)errno : 0;
+        ::close( fd );
+        if( cb >= 0 )
+        {
+            text.assign( buffer, (size_t)cb );
+        }
+        return cb >= 0;
+    }
+#endif
+    //----------------------------------------------------------------------------------------------------------------------
+};
@@ -0,0 +1,69 @@
+/** @file
+  * EpsDiskId/deviceio.h
+  *
+  * The device requests of the probes behind one interface.
+  *
+  * DiskInfo and SysfsProbe open devices and send them IOCTLs only through a DeviceIo (see their
+  * setDeviceIo()):
+  *     the live backend            passes the requests to the OS (CreateFileW / DeviceIoControl,
+  *                                 open / ioctl on Linux)
+  *     DeviceIoRecorder            passes them to another backend and keeps every request and
+  *                                 answer for a trace file (devtrace.h)
+  *     DeviceIoReplayer            answers from such a trace, without any hardware
+  *
+  * Handles are opaque to the caller; only the backend that opened one may use or close it.
+  *
+  * Linux: errors are errno values, except DEVICE_IO_TIMEOUT.  A control() with code SG_IO takes
+  * the CDB as input and returns the data the device sent; the backend builds the sg_io_hdr and
+  * passes the timeout to the kernel.  NVME_IOCTL_ADMIN_CMD likewise takes an nvme_admin_t (nvme.h)
+  * and returns the data the controller sent.  Any other code is an ioctl() whose argument is pOut,
+  * with the input copied to its start first.
+  */
+
+#ifndef __Utils_DEVICEIO_
+#define __Utils_DEVICEIO_
+
+#include <string>
+#include <vector>
+
+#include "devenum.h"
+
+namespace Utils
+{
+#define  DEVICE_IO_INFINITE     0xffffffffUL    // control() waits as long as the request takes
+#define  DEVICE_IO_TIMEOUT      1460UL          // ERROR_TIMEOUT: the request did not complete in time
+
+       //  access of open(), as CreateFileW takes it
+#define  DEVICE_IO_READ_WRITE   0xC0000000UL    // GENERIC_READ | GENERIC_WRITE
+#define  DEVICE_IO_QUERY        0UL             // no access rights: enough for most queries
+
+    class DeviceIo
+    {
+        public:
+            virtual ~DeviceIo() {}
+
+               //  physical drives or SCSI ports; false when they could not be listed, see devenum.h
+            virtual bool    listDevices( bool scsiPorts, std::vector<device_t> &devices ) = 0;
+
+               //  nullptr and error set on failure.  bOverlapped: the handle is used with timeouts
+               //  other than DEVICE_IO_INFINITE.
+            virtual void   *open( const device_path_t &path, unsigned long access, bool bOverlapped, unsigned long &error ) = 0;
+
+               //  One IOCTL.  On success cbReturned bytes of pOut are valid; on failure error is set,
+               //  DEVICE_IO_TIMEOUT when timeoutMs passed first.
+            virtual bool    control( void *hDevice, unsigned long code, const void *pIn, unsigned long cbIn,
+                                     void *pOut, unsigned long cbOut, unsigned long &cbReturned,
+                                     unsigned long timeoutMs, unsigned long &error ) = 0;
+
+            virtual void    close( void *hDevice ) = 0;
+
+               //  Contents of a small file such as a sysfs attribute, read without opening a device;
+               //  false and error set when it cannot be read
+            virtual bool    readAttribute( const device_path_t &path, std::string &text, unsigned long &error ) = 0;
+    };
+
+       //  The backend that talks to the OS; one per process, it lives as long as the module
+    DeviceIo   &liveDeviceIo();
+};
+
+#endif
@@ -0,0 +1,753 @@
+/** @file
+  * EpsDiskId/devtrace.cpp
+  *
+  * Traces of device requests: recorded from any DeviceIo, replayed without the hardware.
+  */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <pthread.h>
+#   include <time.h>
+#   include <unistd.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   define  _snprintf  snprintf
+#endif
+
+#include "devtrace.h"
+#include "probestats.h"
+#include "crc64.h"
+
+#ifdef _MSC_VER
+#pragma warning (disable : 4996)
+#endif
+
+namespace Utils
+{
+       //  A mapped trace file
+    struct device_trace_map_t
+    {
+#ifdef _WIN32
+        HANDLE              hFile;
+        HANDLE              hMapping;
+#endif
+        const void         *view;
+        size_t              cb;
+    };
+
+    //----------------------------------------------------------------------------------------------------------------------
+    static void sleepUs( unsigned __int64 us )
+    {
+        if( 0 == us )
+        {
+            return;
+        }
+#ifdef _WIN32
+        ::Sleep( (DWORD)( ( us + 999 ) / 1000 ) );
+#else
+        struct timespec ts;
+        ts.tv_sec  = (time_t)( us / 1000000 );
+        ts.tv_nsec = (long)( us % 1000000 ) * 1000;
+        ::nanosleep( &ts, nullptr );
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // paths are kept as ASCII; anything else becomes '?'
+    static std::string tracePath( const device_path_t &path )
+    {
+        std::string narrow( path.size(), '?' );
+        for( size_t i = 0; i < path.size(); i++ )
+        {
+            const unsigned long c = (unsigned long)path[i];
+            if( c > 0 && c < 0x80 )
+            {
+                narrow[i] = (char)c;
+            }
+        }
+        return narrow;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static device_path_t devicePath( const std::string &narrow )
+    {
+        device_path_t path( narrow.size(), 0 );
+        for( size_t i = 0; i < narrow.size(); i++ )
+        {
+            path[i] = (unsigned char)narrow[i];
+        }
+        return path;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // the recorded path a request of a replicated drive stands for: every "#k" removed
+    static std::string recordedPath( const device_path_t &path )
+    {
+        std::string narrow = tracePath( path );
+        for( size_t at = narrow.find( '#' ); std::string::npos != at; at = narrow.find( '#', at ) )
+        {
+            size_t end = at + 1;
+            while( end < narrow.size() && narrow[end] >= '0' && narrow[end] <= '9' )
+            {
+                end++;
+            }
+            narrow.erase( at, end - at );
+        }
+        return narrow;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static size_t padded( size_t cb )
+    {
+        return ( cb + 7 ) & ~(size_t)7;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static std::string recordPath( const device_trace_record_t *pRecord )
+    {
+        return std::string( (const char *)( pRecord + 1 ), pRecord->cchPath );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static std::string answerKey( const std::string &path, unsigned long code )
+    {
+        char suffix[16] = {0};
+        ::_snprintf( suffix, sizeof(suffix) - 1, "|%08lx", code );
+        return path + suffix;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static std::string answerKey( const std::string &path, unsigned long code, const void *pIn, unsigned long cbIn )
+    {
+        const unsigned __int64 crc = (unsigned __int64)::crc64( nullptr != pIn ? pIn : "", nullptr != pIn ? cbIn : 0 );
+        char suffix[48] = {0};
+        ::_snprintf( suffix, sizeof(suffix) - 1, "|%lu|%08lx%08lx", cbIn,
+                     (unsigned long)( crc >> 32 ), (unsigned long)( crc & 0xffffffffUL ) );
+        return answerKey( path, code ) + suffix;
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------
+    DeviceIoRecorder::DeviceIoRecorder( DeviceIo &inner )
+        : m_inner( inner )
+        , m_nRecords( 0 )
+    {
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    DeviceIoRecorder::~DeviceIoRecorder()
+    {
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // called with the lock held
+    void DeviceIoRecorder::append( unsigned kind, const std::string &path, unsigned long code, unsigned long error,
+                                   unsigned __int64 latencyUs, int index, const void *pIn, unsigned long cbIn,
+                                   const void *pOut, unsigned long cbOut )
+    {
+        const size_t cchPath = ( path.size() < 0xffff ) ? path.size() : 0xffff;
+        const size_t cbBody  = sizeof(device_trace_record_t) + cchPath + ( nullptr != pIn ? cbIn : 0 ) + ( nullptr != pOut ? cbOut : 0 );
+        const size_t at      = m_records.size();
+
+        device_trace_record_t record;
+        ::memset( &record, 0, sizeof(record) );
+        record.cbRecord  = (unsigned __int32)padded( cbBody );
+        record.kind      = (unsigned __int16)kind;
+        record.cchPath   = (unsigned __int16)cchPath;
+        record.code      = (unsigned __int32)code;
+        record.error     = (unsigned __int32)error;
+        record.latencyUs = ( latencyUs > 0xffffffffUL ) ? 0xffffffffUL : (unsigned __int32)latencyUs;
+        record.index     = index;
+        record.cbIn      = ( nullptr != pIn ) ? (unsigned __int32)cbIn : 0;
+        record.cbOut     = ( nullptr != pOut ) ? (unsigned __int32)cbOut : 0;
+
+        m_records.resize( at + record.cbRecord, 0 );
+        unsigned __int8 *p = &m_records[at];
+        ::memcpy( p, &record, sizeof(record) );
+        p += sizeof(record);
+        ::memcpy( p, path.data(), cchPath );
+        p += cchPath;
+        if( 0 != record.cbIn )
+        {
+            ::memcpy( p, pIn, record.cbIn );
+            p += record.cbIn;
+        }
+        if( 0 != record.cbOut )
+        {
+            ::memcpy( p, pOut, record.cbOut );
+        }
+        m_nRecords++;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool DeviceIoRecorder::listDevices( bool scsiPorts, std::vector<device_t> &devices )
+    {
+        const unsigned __int64 start = ProbeStats::nowUs();
+        const bool             ok    = m_inner.listDevices( scsiPorts, devices );
+        const unsigned __int64 us    = ProbeStats::nowUs() - start;
+
+        OsLockGuard guard( m_lock );
+        for( size_t i = 0; ok && i < devices.size(); i++ )
+        {
+            append( DEVICE_TRACE_LIST, tracePath( devices[i].path ), scsiPorts ? 1 : 0, 0, 0, devices[i].index, nullptr, 0, nullptr, 0 );
+        }
+        append( DEVICE_TRACE_LIST_END, std::string(), scsiPorts ? 1 : 0, ok ? 0 : 1, us, -1, nullptr, 0, nullptr, 0 );
+        return ok;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void *DeviceIoRecorder::open( const device_path_t &path, unsigned long access, bool bOverlapped, unsigned long &error )
+    {
+        const std::string      narrow = tracePath( path );
+        const unsigned __int64 start  = ProbeStats::nowUs();
+        void                  *handle = m_inner.open( path, access, bOverlapped, error );
+        const unsigned __int64 us     = ProbeStats::nowUs() - start;
+
+        OsLockGuard guard( m_lock );
+        append( DEVICE_TRACE_OPEN, narrow, access, nullptr != handle ? 0 : error, us, -1, nullptr, 0, nullptr, 0 );
+        if( nullptr != handle )
+        {
+            m_paths[handle] = narrow;
+        }
+        return handle;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool DeviceIoRecorder::control( void *hDevice, unsigned long code, const void *pIn, unsigned long cbIn,
+                                    void *pOut, unsigned long cbOut, unsigned long &cbReturned,
+                                    unsigned long timeoutMs, unsigned long &error )
+    {
+        std::string path;
+        {
+            OsLockGuard guard( m_lock );
+            std::map<void*, std::string>::const_iterator it = m_paths.find( hDevice );
+            if( m_paths.end() != it )
+            {
+                path = it->second;
+            }
+        }
+        const unsigned __int64 start = ProbeStats::nowUs();
+        const bool             ok    = m_inner.control( hDevice, code, pIn, cbIn, pOut, cbOut, cbReturned, timeoutMs, error );
+        const unsigned __int64 us    = ProbeStats::nowUs() - start;
+
+        OsLockGuard guard( m_lock );
+        append( DEVICE_TRACE_CONTROL, path, code, ok ? 0 : error, us, -1, pIn, cbIn,
+                ok ? pOut : nullptr, ok ? cbReturned : 0 );
+        return ok;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void DeviceIoRecorder::close( void *hDevice )
+    {
+        {
+            OsLockGuard guard( m_lock );
+            m_paths.erase( hDevice );
+        }
+        m_inner.close( hDevice );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool DeviceIoRecorder::readAttribute( const device_path_t &path, std::string &text, unsigned long &error )
+    {
+        const unsigned __int64 start = ProbeStats::nowUs();
+        const bool             ok    = m_inner.readAttribute( path, text, error );
+        const unsigned __int64 us    = ProbeStats::nowUs() - start;
+
+        OsLockGuard guard( m_lock );
+        append( DEVICE_TRACE_READ, tracePath( path ), 0, ok ? 0 : error, us, -1, nullptr, 0,
+                ok ? text.data() : nullptr, ok ? (unsigned long)text.size() : 0 );
+        return ok;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t DeviceIoRecorder::records() const
+    {
+        OsLockGuard guard( m_lock );
+        return m_nRecords;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void DeviceIoRecorder::clear()
+    {
+        OsLockGuard guard( m_lock );
+        m_records.clear();
+        m_nRecords = 0;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void DeviceIoRecorder::build( std::vector<unsigned __int8> &file ) const
+    {
+        OsLockGuard guard( m_lock );
+
+        device_trace_header_t header;
+        ::memset( &header, 0, sizeof(header) );
+        ::memcpy( header.magic, DEVICE_TRACE_MAGIC, sizeof(header.magic) );
+        header.version    = DEVICE_TRACE_VERSION;
+        header.cbHeader   = sizeof(header);
+        header.count      = (unsigned __int32)m_nRecords;
+        header.cbRecords  = (unsigned __int32)m_records.size();
+        header.crcRecords = (unsigned __int64)::crc64( m_records.empty() ? nullptr : &m_records[0], m_records.size() );
+        header.crcHeader  = (unsigned __int64)::crc64( &header, offsetof( device_trace_header_t, crcHeader ) );
+
+        file.resize( sizeof(header) + m_records.size() );
+        ::memcpy( &file[0], &header, sizeof(header) );
+        if( !m_records.empty() )
+        {
+            ::memcpy( &file[sizeof(header)], &m_records[0], m_records.size() );
+        }
+    }
+#ifdef _WIN32
+    //----------------------------------------------------------------------------------------------------------------------
+    bool DeviceIoRecorder::save( const wchar_t *path ) const
+    {
+        std::vector<unsigned __int8> file;
+        build( file );
+
+        wchar_t suffix[64] = {0};
+        ::_snwprintf( suffix, _countof(suffix)-1, L".%lu.%lu.tmp", ::GetCurrentProcessId(), ::GetCurrentThreadId() );
+        const std::wstring temp = std::wstring( path ) + suffix;
+
+        HANDLE hFile = ::CreateFileW( temp.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+        if( INVALID_HANDLE_VALUE == hFile )
+        {
+            return false;
+        }
+        DWORD cbWritten = 0;
+        bool  ok = ::WriteFile( hFile, &file[0], (DWORD)file.size(), &cbWritten, NULL ) && cbWritten == file.size() &&
+                   ::FlushFileBuffers( hFile );
+        ::CloseHandle( hFile );
+
+        if( !ok || !::MoveFileExW( temp.c_str(), path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) )
+        {
+            ::DeleteFileW( temp.c_str() );
+            return false;
+        }
+        return true;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool DeviceIoReplayer::load( const wchar_t *path )
+    {
+        unmap();
+
+        HANDLE hFile = ::CreateFileW( path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+        if( INVALID_HANDLE_VALUE == hFile )
+        {
+            return false;
+        }
+        LARGE_INTEGER size;
+        if( !::GetFileSizeEx( hFile, &size ) || size.QuadPart < (LONGLONG)sizeof(device_trace_header_t) || size.QuadPart >= 0x7fffffff )
+        {
+            ::CloseHandle( hFile );
+            return false;
+        }
+        HANDLE hMapping = ::CreateFileMappingW( hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+        const void *view = ( NULL != hMapping ) ? ::MapViewOfFile( hMapping, FILE_MAP_READ, 0, 0, 0 ) : NULL;
+        if( NULL == view )
+        {
+            if( NULL != hMapping )
+            {
+                ::CloseHandle( hMapping );
+            }
+            ::CloseHandle( hFile );
+            return false;
+        }
+        m_map = new device_trace_map_t;
+        m_map->hFile    = hFile;
+        m_map->hMapping = hMapping;
+        m_map->view     = view;
+        m_map->cb       = (size_t)size.QuadPart;
+
+        if( !index( (const unsigned __int8*)view, m_map->cb ) )
+        {
+            unmap();
+            return false;
+        }
+        return true;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void DeviceIoReplayer::unmap()
+    {
+        if( nullptr != m_map )
+        {
+            ::UnmapViewOfFile( m_map->view );
+            ::CloseHandle( m_map->hMapping );
+            ::CloseHandle( m_map->hFile );
+            delete m_map;
+            m_map = nullptr;
+        }
+    }
+#else
+    //----------------------------------------------------------------------------------------------------------------------
+    bool DeviceIoRecorder::save( const char *path ) const
+    {
+        std::vector<unsigned __int8> file;
+        build( file );
+
+        char suffix[64] = {0};
+        ::snprintf( suffix, sizeof(suffix), ".%lu.%lu.tmp", (unsigned long)::getpid(), (unsigned long)::pthread_self() );
+        const std::string temp = std::string( path ) + suffix;
+
+        int fd = ::open( temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+        if( fd < 0 )
+        {
+            return false;
+        }
+        bool ok = ( (ssize_t)file.size() == ::write( fd, &file[0], file.size() ) ) && 0 == ::fsync( fd );
+        ::close( fd );
+
+        if( !ok || 0 != ::rename( temp.c_str(), path ) )
+        {
+            ::unlink( temp.c_str() );
+            return false;
+        }
+        return true;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool DeviceIoReplayer::load( const char *path )
+    {
+        unmap();
+
+        int fd = ::open( path, O_RDONLY | O_CLOEXEC );
+        if( fd < 0 )
+        {
+            return false;
+        }
+        struct stat st;
+        void       *view = MAP_FAILED;
+        if( 0 == ::fstat( fd, &st ) && st.st_size >= (off_t)sizeof(device_trace_header_t) && st.st_size < 0x7fffffff )
+        {
+            view = ::mmap( nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        }
+        ::close( fd );                              // the mapping stays valid
+        if( MAP_FAILED == view )
+        {
+            return false;
+        }
+        m_map = new device_trace_map_t;
+        m_map->view = view;
+        m_map->cb   = (size_t)st.st_size;
+
+        if( !index( (const unsigned __int8*)view, m_map->cb ) )
+        {
+            unmap();
+            return false;
+        }
+        return true;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void DeviceIoReplayer::unmap()
+    {
+        if( nullptr != m_map )
+        {
+            ::munmap( const_cast<void*>( m_map->view ), m_map->cb );
+            delete m_map;
+            m_map = nullptr;
+        }
+    }
+#endif
+
+    //----------------------------------------------------------------------------------------------------------------------
+    DeviceIoReplayer::DeviceIoReplayer()
+        : m_map( nullptr )
+        , m_nLatencyPercent( 0 )
+        , m_nExtraUs( 0 )
+        , m_nFailPermille( 0 )
+        , m_nFailError( 0 )
+        , m_nRandom( 1 )
+        , m_nFleet( 0 )
+    {
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    DeviceIoReplayer::~DeviceIoReplayer()
+    {
+        unmap();
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool DeviceIoReplayer::attach( const void *data, size_t cb )
+    {
+        unmap();
+        return index( (const unsigned __int8*)data, cb );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // checks the trace and indexes its records in place
+    bool DeviceIoReplayer::index( const unsigned __int8 *data, size_t cb )
+    {
+        for( int i = 0; i < 2; i++ )
+        {
+            m_lists[i] = replay_list_t();
+        }
+        m_opens.clear();
+        m_exact.clear();
+        m_byCode.clear();
+        m_reads.clear();
+
+        device_trace_header_t header;
+        if( nullptr == data || cb < sizeof(header) )
+        {
+            return false;
+        }
+        ::memcpy( &header, data, sizeof(header) );
+
+        if( 0 != ::memcmp( header.magic, DEVICE_TRACE_MAGIC, sizeof(header.magic) ) ||
+            header.crcHeader != (unsigned __int64)::crc64( &header, offsetof( device_trace_header_t, crcHeader ) ) ||
+            header.version   != DEVICE_TRACE_VERSION ||
+            header.cbHeader  != sizeof(header) ||
+            cb - sizeof(header) < header.cbRecords ||
+            header.crcRecords != (unsigned __int64)::crc64( data + sizeof(header), header.cbRecords ) )
+        {
+            return false;
+        }
+        const unsigned __int8 *p    = data + sizeof(header);
+        size_t                 left = header.cbRecords;
+        bool                   listing[2] = { false, false };
+
+        for( unsigned __int32 i = 0; i < header.count; i++ )
+        {
+            const device_trace_record_t *pRecord = (const device_trace_record_t *)p;
+            if( left < sizeof(device_trace_record_t) || pRecord->cbRecord > left || 0 != pRecord->cbRecord % 8 ||
+                pRecord->cbRecord < sizeof(device_trace_record_t) + (size_t)pRecord->cchPath + pRecord->cbIn + pRecord->cbOut )
+            {
+                return false;
+            }
+            const size_t   s    = ( 0 != pRecord->code ) ? 1 : 0;
+            replay_list_t &list = m_lists[s];
+
+            switch( pRecord->kind )
+            {
+                case DEVICE_TRACE_LIST:
+                    if( !listing[s] )
+                    {
+                        list.devices.clear();
+                        listing[s] = true;
+                    }
+                    list.devices.push_back( pRecord );
+                    break;
+                case DEVICE_TRACE_LIST_END:
+                    if( !listing[s] )
+                    {
+                        list.devices.clear();
+                    }
+                    listing[s]    = false;
+                    list.recorded = true;
+                    list.listed   = ( 0 == pRecord->error );
+                    break;
+                case DEVICE_TRACE_OPEN:
+                    m_opens[recordPath( pRecord )].records.push_back( pRecord );
+                    break;
+                case DEVICE_TRACE_CONTROL:
+                {
+                    const std::string path = recordPath( pRecord );
+                    const void       *pIn  = (const char *)( pRecord + 1 ) + pRecord->cchPath;
+                    m_exact[answerKey( path, pRecord->code, pIn, pRecord->cbIn )].records.push_back( pRecord );
+                    m_byCode[answerKey( path, pRecord->code )].records.push_back( pRecord );
+                    break;
+                }
+                case DEVICE_TRACE_READ:
+                    m_reads[recordPath( pRecord )].records.push_back( pRecord );
+                    break;
+            }
+            p    += pRecord->cbRecord;
+            left -= pRecord->cbRecord;
+        }
+        return true;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void DeviceIoReplayer::setLatency( unsigned percent, unsigned long extraUs )
+    {
+        m_nLatencyPercent = percent;
+        m_nExtraUs        = extraUs;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void DeviceIoReplayer::setFailures( unsigned permille, unsigned long error, unsigned long seed )
+    {
+        m_nFailPermille = ( permille > 1000 ) ? 1000 : permille;
+        m_nFailError    = error;
+        m_nRandom       = (unsigned __int64)seed * 2654435761U + 0x9e3779b97f4a7c15ULL;   // never 0 for xorshift
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void DeviceIoReplayer::setFleetSize( unsigned long nDrives )
+    {
+        m_nFleet = nDrives;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // called with the lock held
+    const device_trace_record_t *DeviceIoReplayer::next( std::map<std::string, replay_queue_t> &answers, const std::string &key )
+    {
+        std::map<std::string, replay_queue_t>::iterator it = answers.find( key );
+        if( answers.end() == it || it->second.records.empty() )
+        {
+            return nullptr;
+        }
+        replay_queue_t &queue = it->second;
+        const device_trace_record_t *pRecord = queue.records[queue.next];
+        queue.next = ( queue.next + 1 ) % queue.records.size();
+        return pRecord;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // called with the lock held; xorshift64, so a seed replays the same failures in the same order
+    bool DeviceIoReplayer::inject( unsigned long &error )
+    {
+        if( 0 == m_nFailPermille )
+        {
+            return false;
+        }
+        m_nRandom ^= m_nRandom << 13;
+        m_nRandom ^= m_nRandom >> 7;
+        m_nRandom ^= m_nRandom << 17;
+        if( m_nRandom % 1000 >= m_nFailPermille )
+        {
+            return false;
+        }
+        error = m_nFailError;
+        return true;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // false when the delay would pass timeoutMs; the caller has then waited timeoutMs
+    bool DeviceIoReplayer::wait( const device_trace_record_t *pRecord, unsigned long timeoutMs )
+    {
+        const unsigned __int64 us = (unsigned __int64)pRecord->latencyUs * m_nLatencyPercent / 100 + m_nExtraUs;
+
+        if( DEVICE_IO_INFINITE != timeoutMs && us > (unsigned __int64)timeoutMs * 1000 )
+        {
+            sleepUs( (unsigned __int64)timeoutMs * 1000 );
+            return false;
+        }
+        sleepUs( us );
+        return true;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool DeviceIoReplayer::listDevices( bool scsiPorts, std::vector<device_t> &devices )
+    {
+        const replay_list_t &list = m_lists[scsiPorts ? 1 : 0];
+
+        devices.clear();
+        if( !list.recorded || !list.listed )
+        {
+            return false;                           // the fixed range of names is probed, as when it was recorded
+        }
+        const size_t nRecorded = list.devices.size();
+        const size_t nDevices  = ( !scsiPorts && 0 != m_nFleet && 0 != nRecorded ) ? m_nFleet : nRecorded;
+        int          maxIndex  = -1;
+
+        for( size_t i = 0; i < nRecorded; i++ )
+        {
+            maxIndex = ( list.devices[i]->index > maxIndex ) ? list.devices[i]->index : maxIndex;
+        }
+        devices.resize( nDevices );
+        for( size_t k = 0; k < nDevices; k++ )
+        {
+            const device_trace_record_t *pRecord = list.devices[k % nRecorded];
+            std::string                  path    = recordPath( pRecord );
+            device_t                    &device  = devices[k];
+
+            device.index = pRecord->index;
+            if( k >= nRecorded )
+            {
+                   //  "#k" keeps the paths apart; open() drops it again
+                char suffix[32] = {0};
+                ::_snprintf( suffix, sizeof(suffix) - 1, "#%lu", (unsigned long)k );
+                path        += suffix;
+                device.index = maxIndex + 1 + (int)( k - nRecorded );
+            }
+            device.path = devicePath( path );
+#ifndef _WIN32
+            device.name = path.substr( path.rfind( '/' ) + 1 );
+#endif
+        }
+        return true;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void *DeviceIoReplayer::open( const device_path_t &path, unsigned long, bool, unsigned long &error )
+    {
+        const std::string narrow = recordedPath( path );
+
+        const device_trace_record_t *pRecord = nullptr;
+        {
+            OsLockGuard guard( m_lock );
+            if( inject( error ) )
+            {
+                return nullptr;
+            }
+            pRecord = next( m_opens, narrow );
+        }
+        if( nullptr == pRecord )
+        {
+            error = DEVICE_TRACE_NO_DEVICE;
+            return nullptr;
+        }
+        wait( pRecord, DEVICE_IO_INFINITE );
+        if( 0 != pRecord->error )
+        {
+            error = pRecord->error;
+            return nullptr;
+        }
+        error = 0;
+        return new std::string( narrow );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool DeviceIoReplayer::control( void *hDevice, unsigned long code, const void *pIn, unsigned long cbIn,
+                                    void *pOut, unsigned long cbOut, unsigned long &cbReturned,
+                                    unsigned long timeoutMs, unsigned long &error )
+    {
+        const std::string &path = *(const std::string *)hDevice;
+        const device_trace_record_t *pRecord = nullptr;
+
+        cbReturned = 0;
+        {
+            OsLockGuard guard( m_lock );
+            if( inject( error ) )
+            {
+                return false;
+            }
+            pRecord = next( m_exact, answerKey( path, code, pIn, cbIn ) );
+            if( nullptr == pRecord )
+            {
+                pRecord = next( m_byCode, answerKey( path, code ) );
+            }
+        }
+        if( nullptr == pRecord )
+        {
+            error = DEVICE_TRACE_NO_ANSWER;
+            return false;
+        }
+        if( !wait( pRecord, timeoutMs ) )
+        {
+            error = DEVICE_IO_TIMEOUT;
+            return false;
+        }
+        if( 0 != pRecord->error )
+        {
+            error = pRecord->error;
+            return false;
+        }
+        const unsigned long cb = ( pRecord->cbOut < cbOut ) ? pRecord->cbOut : cbOut;
+        if( nullptr != pOut && 0 != cb )
+        {
+            ::memcpy( pOut, (const char *)( pRecord + 1 ) + pRecord->cchPath + pRecord->cbIn, cb );
+        }
+        cbReturned = cb;
+        error      = 0;
+        return true;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void DeviceIoReplayer::close( void *hDevice )
+    {
+        delete (std::string *)hDevice;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool DeviceIoReplayer::readAttribute( const device_path_t &path, std::string &text, unsigned long &error )
+    {
+        const device_trace_record_t *pRecord = nullptr;
+        {
+            OsLockGuard guard( m_lock );
+            if( inject( error ) )
+            {
+                return false;
+            }
+            pRecord = next( m_reads, recordedPath( path ) );
+        }
+        if( nullptr == pRecord )
+        {
+            error = DEVICE_TRACE_NO_DEVICE;
+            return false;
+        }
+        wait( pRecord, DEVICE_IO_INFINITE );
+        if( 0 != pRecord->error )
+        {
+            error = pRecord->error;
+            return false;
+        }
+        text.assign( (const char *)( pRecord + 1 ) + pRecord->cchPath + pRecord->cbIn, pRecord->cbOut );
+        error = 0;
+        return true;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+};
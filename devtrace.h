@@ -0,0 +1,195 @@
+/** @file
+  * EpsDiskId/devtrace.h
+  *
+  * Traces of device requests: recorded from any DeviceIo, replayed without the hardware.
+  *
+  * File layout (little endian, every record starts on an 8 byte boundary):
+  *     device_trace_header_t
+  *     count records of  device_trace_record_t + path + input + output, zero padded to 8 bytes
+  *
+  * A listing is stored as one DEVICE_TRACE_LIST record per device and a DEVICE_TRACE_LIST_END;
+  * an IOCTL carries the path its handle was opened with, so requests can be matched to devices
+  * without handles, and a file read (a sysfs attribute) its contents.  Paths are stored as ASCII.
+  * The replayer maps the file and serves answers from the mapping; it is written like a snapshot
+  * (snapfile.h), to a temporary name first.
+  *
+  * A request is answered with the next recorded answer to the same path, code and input bytes;
+  * when the input differs (a drive number, a timeout) the next answer to the same path and code
+  * is used.  Answers of a key are served in turn and start over once all were used.
+  */
+
+#ifndef __Utils_DEVTRACE_
+#define __Utils_DEVTRACE_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "deviceio.h"
+#include "osutil.h"
+
+namespace Utils
+{
+#define  DEVICE_TRACE_MAGIC         "EPSDIOTR"
+#define  DEVICE_TRACE_VERSION       1
+
+       //  errors of requests the trace holds no answer to
+#define  DEVICE_TRACE_NO_DEVICE     2UL         // ERROR_FILE_NOT_FOUND
+#define  DEVICE_TRACE_NO_ANSWER     50UL        // ERROR_NOT_SUPPORTED
+
+    enum device_trace_kind_t
+    {
+        DEVICE_TRACE_LIST       = 1,    // index, path; code: 1 for SCSI ports
+        DEVICE_TRACE_LIST_END   = 2,    // code as above; error 0 if the devices were listed
+        DEVICE_TRACE_OPEN       = 3,    // path; code: access
+        DEVICE_TRACE_CONTROL    = 4,    // path of the handle; code: IOCTL
+        DEVICE_TRACE_READ       = 5     // path; output: the contents
+    };
+
+#pragma pack(push, 1)
+    struct device_trace_header_t
+    {
+        char                magic[8];           // DEVICE_TRACE_MAGIC, no terminator
+        unsigned __int32    version;            // DEVICE_TRACE_VERSION
+        unsigned __int32    cbHeader;           // sizeof(device_trace_header_t)
+        unsigned __int32    count;
+        unsigned __int32    cbRecords;          // bytes of all records
+        unsigned __int64    crcRecords;         // crc64 of all records
+        unsigned __int64    crcHeader;          // crc64 of the bytes above
+    };
+
+    struct device_trace_record_t
+    {
+        unsigned __int32    cbRecord;           // this header, path, input and output with padding
+        unsigned __int16    kind;               // device_trace_kind_t
+        unsigned __int16    cchPath;
+        unsigned __int32    code;
+        unsigned __int32    error;              // 0 on success
+        unsigned __int32    latencyUs;
+        __int32             index;              // device index of a DEVICE_TRACE_LIST, else -1
+        unsigned __int32    cbIn;
+        unsigned __int32    cbOut;              // bytes returned
+    };
+#pragma pack(pop)
+
+#ifdef _WIN32
+    typedef wchar_t device_trace_path_char_t;
+#else
+    typedef char    device_trace_path_char_t;
+#endif
+
+       //  Passes every request to another backend and keeps a copy of it and its answer
+    class DeviceIoRecorder : public DeviceIo
+    {
+        public:
+            explicit DeviceIoRecorder( DeviceIo &inner );
+            virtual ~DeviceIoRecorder();
+
+            virtual bool    listDevices( bool scsiPorts, std::vector<device_t> &devices );
+            virtual void   *open( const device_path_t &path, unsigned long access, bool bOverlapped, unsigned long &error );
+            virtual bool    control( void *hDevice, unsigned long code, const void *pIn, unsigned long cbIn,
+                                     void *pOut, unsigned long cbOut, unsigned long &cbReturned,
+                                     unsigned long timeoutMs, unsigned long &error );
+            virtual void    close( void *hDevice );
+            virtual bool    readAttribute( const device_path_t &path, std::string &text, unsigned long &error );
+
+            size_t  records() const;
+            void    clear();
+
+               //  the trace as a file holds it
+            void    build( std::vector<unsigned __int8> &file ) const;
+            bool    save( const device_trace_path_char_t *path ) const;
+
+        private:
+                                DeviceIoRecorder( const DeviceIoRecorder& );
+            DeviceIoRecorder&   operator=( const DeviceIoRecorder& );
+
+            void    append( unsigned kind, const std::string &path, unsigned long code, unsigned long error,
+                            unsigned __int64 latencyUs, int index, const void *pIn, unsigned long cbIn,
+                            const void *pOut, unsigned long cbOut );
+
+            DeviceIo                        &m_inner;
+            mutable OsLock                   m_lock;
+            std::vector<unsigned __int8>     m_records;
+            unsigned long                    m_nRecords;
+            std::map<void*, std::string>     m_paths;       // path of every handle still open
+    };
+
+       //  Answers requests from a trace.  Configure before the first request; the requests
+       //  themselves may come from any number of threads.
+    class DeviceIoReplayer : public DeviceIo
+    {
+        public:
+            DeviceIoReplayer();
+            virtual ~DeviceIoReplayer();
+
+               //  Maps the file and keeps it mapped; false if it is missing, of another version or
+               //  fails a checksum
+            bool    load( const device_trace_path_char_t *path );
+               //  a trace in memory (e.g. DeviceIoRecorder::build()), which must outlive the replayer
+            bool    attach( const void *data, size_t cb );
+
+               //  Delay of an answer: percent of its recorded latency plus extraUs (default 0 and 0,
+               //  answer at once).  An answer that would miss the caller's timeout fails with
+               //  DEVICE_IO_TIMEOUT once the timeout has passed.
+            void    setLatency( unsigned percent, unsigned long extraUs );
+
+               //  Fails about permille of 1000 opens and requests with error, drawn from seed
+            void    setFailures( unsigned permille, unsigned long error, unsigned long seed );
+
+               //  Lists nDrives physical drives (0: as recorded); drive k answers like recorded drive
+               //  k modulo the number recorded, under a path, name and index of its own ("#k" is
+               //  appended to the recorded ones and ignored wherever it appears in a later request)
+            void    setFleetSize( unsigned long nDrives );
+
+            virtual bool    listDevices( bool scsiPorts, std::vector<device_t> &devices );
+            virtual void   *open( const device_path_t &path, unsigned long access, bool bOverlapped, unsigned long &error );
+            virtual bool    control( void *hDevice, unsigned long code, const void *pIn, unsigned long cbIn,
+                                     void *pOut, unsigned long cbOut, unsigned long &cbReturned,
+                                     unsigned long timeoutMs, unsigned long &error );
+            virtual void    close( void *hDevice );
+            virtual bool    readAttribute( const device_path_t &path, std::string &text, unsigned long &error );
+
+        private:
+                                DeviceIoReplayer( const DeviceIoReplayer& );
+            DeviceIoReplayer&   operator=( const DeviceIoReplayer& );
+
+            struct replay_queue_t
+            {
+                std::vector<const device_trace_record_t*>   records;
+                size_t                                      next;
+
+                replay_queue_t() : next( 0 ) {}
+            };
+            struct replay_list_t
+            {
+                std::vector<const device_trace_record_t*>   devices;
+                bool                                        recorded;
+                bool                                        listed;
+
+                replay_list_t() : recorded( false ), listed( false ) {}
+            };
+
+            bool                            index( const unsigned __int8 *data, size_t cb );
+            void                            unmap();
+            const device_trace_record_t    *next( std::map<std::string, replay_queue_t> &answers, const std::string &key );
+            bool                            inject( unsigned long &error );
+            bool                            wait( const device_trace_record_t *pRecord, unsigned long timeoutMs );
+
+            OsLock                                  m_lock;
+            struct device_trace_map_t              *m_map;
+            replay_list_t                           m_lists[2];         // physical drives, SCSI ports
+            std::map<std::string, replay_queue_t>   m_opens;            // by path
+            std::map<std::string, replay_queue_t>   m_exact;            // by path, code and input
+            std::map<std::string, replay_queue_t>   m_byCode;           // by path and code
+            std::map<std::string, replay_queue_t>   m_reads;            // by path
+            unsigned                                m_nLatencyPercent;
+            unsigned long                           m_nExtraUs;
+            unsigned                                m_nFailPermille;
+            unsigned long                           m_nFailError;
+            unsigned __int64                        m_nRandom;
+            unsigned long                           m_nFleet;
+    };
+};
+
+#endif
@@ -0,0 +1,311 @@
+/** @file
+  * EpsDiskId/diskbench.cpp
+  *
+  * Timings of the decoding and hashing paths that every enumeration runs through.
+  */
+
+#include <string.h>
+
+#include "diskbench.h"
+#include "diskid.h"
+#include "identify.h"
+#include "ataconv.h"
+#include "probestats.h"
+#include "crc64.h"
+#ifndef _WIN32
+#   include "diskrows.h"
+#   include "rowemit.h"
+#endif
+
+namespace Utils
+{
+#define  DISK_BENCH_FIXTURES  4
+
+       //  drives as they commonly answer IDENTIFY: serials with and without leading blanks
+    struct bench_drive_t
+    {
+        const char     *model;
+        const char     *serial;
+        const char     *firmware;
+        __int64         sectors;
+    };
+
+    static const bench_drive_t s_drives[DISK_BENCH_FIXTURES] =
+    {
+        { "WDC WD10EZEX-08WN4A0",       "     WD-WCC6Y3HK1234",  "01.01A01",  1953525168LL },
+        { "ST2000DM008-2FR102",         "            ZFL0ABCD",  "0001",      3907029168LL },
+        { "Samsung SSD 860 EVO 500GB",  "S3Z2NB0K123456A",       "RVT02B6Q",  976773168LL  },
+        { "INTEL SSDSC2BB240G4",        "BTWL412345678ABC",      "D2010370",  468862128LL  },
+    };
+
+       //  a point of the run: time and allocations so far
+    struct bench_mark_t
+    {
+        unsigned __int64    us;
+        unsigned __int64    allocs;
+    };
+
+    struct bench_fixtures_t
+    {
+        unsigned __int8     sectors[DISK_BENCH_FIXTURES][2 * IDENTIFY_SECTOR_WORDS];
+        char                hexSerials[DISK_BENCH_FIXTURES][2 * 20 + 1];    // 20 characters as STORAGE_DEVICE_DESCRIPTOR may hold them
+        disk_t              disks[DISK_BENCH_FIXTURES];
+        unsigned __int8     block[4096];
+    };
+
+    //----------------------------------------------------------------------------------------------------------------------
+       // ATA string field: blank padded, two characters per word with the first in the high byte
+    static void putAtaString( unsigned __int8 *sector, size_t firstWord, size_t words, const char *text )
+    {
+        const size_t cch = ::strlen( text );
+        for( size_t i = 0; i < 2 * words; i++ )
+        {
+            sector[2 * firstWord + ( i ^ 1 )] = (unsigned __int8)( i < cch ? text[i] : ' ' );
+        }
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static void putWord( unsigned __int8 *sector, size_t word, unsigned value )
+    {
+        sector[2 * word]     = (unsigned __int8)( value & 0xff );
+        sector[2 * word + 1] = (unsigned __int8)( ( value >> 8 ) & 0xff );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static void buildFixtures( bench_fixtures_t &fx )
+    {
+        static const char hex[] = "0123456789abcdef";
+
+        ::memset( fx.sectors, 0, sizeof(fx.sectors) );
+        ::memset( fx.hexSerials, 0, sizeof(fx.hexSerials) );
+        for( size_t d = 0; d < DISK_BENCH_FIXTURES; d++ )
+        {
+            const bench_drive_t &drive  = s_drives[d];
+            unsigned __int8     *sector = fx.sectors[d];
+
+            putWord( sector, 0, 0x0040 );                                   // fixed disk
+            putAtaString( sector, 10, 10, drive.serial );
+            putWord( sector, 21, 16 );                                      // 8 KiB buffer
+            putAtaString( sector, 23, 4, drive.firmware );
+            putAtaString( sector, 27, 20, drive.model );
+            putWord( sector, 60, (unsigned)( drive.sectors & 0xffff ) );
+            putWord( sector, 61, (unsigned)( ( drive.sectors >> 16 ) & 0xffff ) );
+            putWord( sector, 83, 0x0400 );                                  // 48-bit addressing
+            for( size_t w = 0; w < 4; w++ )
+            {
+                putWord( sector, 100 + w, (unsigned)( ( drive.sectors >> ( 16 * w ) ) & 0xffff ) );
+            }
+
+               //  the hex form swaps the two characters of every pair
+            char padded[21] = {0};
+            ::memset( padded, ' ', 20 );
+            ::memcpy( padded, drive.serial, ::strlen( drive.serial ) );
+            for( size_t i = 0; i < 20; i++ )
+            {
+                const unsigned char c = (unsigned char)padded[i ^ 1];
+                fx.hexSerials[d][2 * i]     = hex[c >> 4];
+                fx.hexSerials[d][2 * i + 1] = hex[c & 0x0f];
+            }
+
+            DiskInfo::GetIdeInfo( (int)d, sector, fx.disks[d] );
+        }
+        for( size_t i = 0; i < sizeof(fx.block); i++ )
+        {
+            fx.block[i] = (unsigned __int8)( i * 131 + 7 );
+        }
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static bench_mark_t mark( alloc_count_fn allocations )
+    {
+        bench_mark_t at;
+        at.allocs = ( nullptr != allocations ) ? allocations() : 0;
+        at.us     = ProbeStats::nowUs();
+        return at;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // adds what was spent since start
+    static void addSpent( bench_mark_t &spent, const bench_mark_t &start, alloc_count_fn allocations )
+    {
+        const bench_mark_t now = mark( allocations );
+        spent.us     += now.us - start.us;
+        spent.allocs += now.allocs - start.allocs;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static void addResult( std::vector<bench_result_t> &results, const char *name, unsigned long iterations,
+                           unsigned long cbPerOp, const bench_mark_t &spent, alloc_count_fn allocations )
+    {
+        bench_result_t result;
+        result.name        = name;
+        result.iterations  = iterations;
+        result.cbPerOp     = cbPerOp;
+        result.nsPerOp     = ( 0 == iterations ) ? 0.0 : (double)spent.us * 1000.0 / iterations;
+        result.mbPerSec    = ( 0 == spent.us ) ? 0.0 : (double)cbPerOp * iterations / (double)spent.us;
+        result.allocsPerOp = ( nullptr == allocations ) ? -1.0 : ( 0 == iterations ) ? 0.0 : (double)spent.allocs / iterations;
+        results.push_back( result );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // one timed stretch: from start to now
+    static void addSince( std::vector<bench_result_t> &results, const char *name, unsigned long iterations,
+                          unsigned long cbPerOp, const bench_mark_t &start, alloc_count_fn allocations )
+    {
+        bench_mark_t spent = { 0, 0 };
+        addSpent( spent, start, allocations );
+        addResult( results, name, iterations, cbPerOp, spent, allocations );
+    }
+#ifndef _WIN32
+    //----------------------------------------------------------------------------------------------------------------------
+       // xp_DiskId rows sent to the ODS stand-in, one operation per row: the per-column calls, strlen()
+       // and crc64 every call used to make, against rows built once and streamed by a RowEmitter
+    static void benchRows( const bench_fixtures_t &fx, unsigned long iterations, std::vector<bench_result_t> &results,
+                           alloc_count_fn allocations )
+    {
+        const size_t        nBatch = 1024;          // rows the stand-in keeps before it is emptied
+        std::vector<disk_t> disks( fx.disks, fx.disks + DISK_BENCH_FIXTURES );
+        std::vector<int>    owners( disks.size(), -1 );
+        SRV_PROC           *pSrvProc = odsCreate();
+        unsigned long       cbRow = 0;
+        bench_mark_t        spent = { 0, 0 };
+
+        for( size_t d = 0; d < disks.size(); d++ )
+        {
+            cbRow += (unsigned long)( sizeof(int) + ::strlen( disks[d].model ) + 1 + ::strlen( disks[d].serial ) + 1 + 2 * sizeof(__int64) );
+        }
+        cbRow /= DISK_BENCH_FIXTURES;
+
+        for( unsigned long done = 0; done < iterations; done += nBatch )
+        {
+            const unsigned long n = ( iterations - done < nBatch ) ? iterations - done : nBatch;
+            odsReset( pSrvProc );
+
+            const bench_mark_t start = mark( allocations );
+            srv_describe( pSrvProc, 1, "controller", SRV_NULLTERM, SRVINT4,    sizeof(int),     SRVINT4,    sizeof(int),     NULL );
+            srv_describe( pSrvProc, 2, "model",      SRV_NULLTERM, SRVVARCHAR, 32,              SRVVARCHAR, 32,              NULL );
+            srv_describe( pSrvProc, 3, "serial",     SRV_NULLTERM, SRVVARCHAR, 32,              SRVVARCHAR, 32,              NULL );
+            srv_describe( pSrvProc, 4, "duuid",      SRV_NULLTERM, SRVINT8,    sizeof(__int64), SRVINT8,    sizeof(int),     NULL );
+            srv_describe( pSrvProc, 5, "size",       SRV_NULLTERM, SRVINT8,    sizeof(__int64), SRVINT8,    sizeof(__int64), NULL );
+            for( unsigned long i = 0; i < n; i++ )
+            {
+                const disk_t &disk  = disks[i % DISK_BENCH_FIXTURES];
+                __int64       duuid = ::crc64( &disk, sizeof(disk_t) );
+
+                srv_setcollen ( pSrvProc, 1, sizeof(disk.num_controller) );
+                srv_setcoldata( pSrvProc, 1, (void*)&disk.num_controller );
+                srv_setcollen ( pSrvProc, 2, (int)::strlen( disk.model ) + 1 );
+                srv_setcoldata( pSrvProc, 2, (void*)disk.model );
+                srv_setcollen ( pSrvProc, 3, (int)::strlen( disk.serial ) + 1 );
+                srv_setcoldata( pSrvProc, 3, (void*)disk.serial );
+                srv_setcollen ( pSrvProc, 4, sizeof(duuid) );
+                srv_setcoldata( pSrvProc, 4, &duuid );
+                srv_setcollen ( pSrvProc, 5, sizeof(disk.sectors) );
+                srv_setcoldata( pSrvProc, 5, (void*)&disk.sectors );
+                srv_sendrow( pSrvProc );
+            }
+            addSpent( spent, start, allocations );
+        }
+        addResult( results, "xp_DiskId rows, per column", iterations, cbRow, spent, allocations );
+
+           //  the rows as a snapshot holds them: built once, outside the timing
+        std::vector<disk_t> batch( nBatch );
+        std::vector<int>    batchOwners( nBatch, -1 );
+        for( size_t i = 0; i < nBatch; i++ )
+        {
+            batch[i] = disks[i % DISK_BENCH_FIXTURES];
+        }
+        DiskRows rows;
+        rows.assign( batch, batchOwners );
+
+        spent.us     = 0;
+        spent.allocs = 0;
+        for( unsigned long done = 0; done < iterations; done += nBatch )
+        {
+            const unsigned long n = ( iterations - done < nBatch ) ? iterations - done : nBatch;
+            odsReset( pSrvProc );
+
+            const bench_mark_t start = mark( allocations );
+            RowEmitter emitter( pSrvProc, n );
+            for( int col = 0; col < DISK_COLUMNS; col++ )
+            {
+                bindDiskColumn( emitter, rows, col );
+            }
+            emitter.send();
+            addSpent( spent, start, allocations );
+        }
+        addResult( results, "xp_DiskId rows, bound once", iterations, cbRow, spent, allocations );
+
+        odsDestroy( pSrvProc );
+    }
+#endif
+    //----------------------------------------------------------------------------------------------------------------------
+    void runDiskBenchmarks( unsigned long iterations, std::vector<bench_result_t> &results, alloc_count_fn allocations )
+    {
+        bench_fixtures_t *fx = new bench_fixtures_t;
+        volatile unsigned __int64 sink = 0;         // keeps the results alive
+        bench_mark_t start;
+
+        buildFixtures( *fx );
+        results.clear();
+
+        start = mark( allocations );
+        for( unsigned long i = 0; i < iterations; i++ )
+        {
+            sink += (unsigned __int64)::crc64( &fx->disks[i % DISK_BENCH_FIXTURES], sizeof(disk_t) );
+        }
+        addSince( results, "crc64 disk_t", iterations, sizeof(disk_t), start, allocations );
+
+        start = mark( allocations );
+        for( unsigned long i = 0; i < iterations; i++ )
+        {
+            sink += (unsigned __int64)::crc64( fx->block, sizeof(fx->block) );
+        }
+        addSince( results, "crc64 4 KiB", iterations, sizeof(fx->block), start, allocations );
+
+        start = mark( allocations );
+        for( unsigned long i = 0; i < iterations; i++ )
+        {
+            const IdentifyView id( fx->sectors[i % DISK_BENCH_FIXTURES] );
+            char model[64]  = {0};
+            char serial[32] = {0};
+            char fw[16]     = {0};
+            sink += id.model().copyTo( model, sizeof(model) ) + id.serial().copyTo( serial, sizeof(serial) ) +
+                    id.firmware().copyTo( fw, sizeof(fw) );
+        }
+        addSince( results, "ATA strings", iterations, 2 * ( 20 + 10 + 4 ), start, allocations );
+
+        start = mark( allocations );
+        for( unsigned long i = 0; i < iterations; i++ )
+        {
+            disk_t disk;
+            DiskInfo::GetIdeInfo( 0, fx->sectors[i % DISK_BENCH_FIXTURES], disk );
+            sink += (unsigned __int64)disk.sectors;
+        }
+        addSince( results, "GetIdeInfo", iterations, 2 * IDENTIFY_SECTOR_WORDS, start, allocations );
+
+        start = mark( allocations );
+        for( unsigned long i = 0; i < iterations; i++ )
+        {
+            const char *hexSerial = fx->hexSerials[i % DISK_BENCH_FIXTURES];
+            char        serial[64] = {0};
+            const size_t cch = hexFlipDecode( hexSerial, 2 * 20, serial, sizeof(serial) );
+            sink += cch + countLeadingBlanks( serial, cch );
+        }
+        addSince( results, "descriptor serial", iterations, 2 * 20, start, allocations );
+
+        start = mark( allocations );
+        for( unsigned long i = 0; i < iterations; i++ )
+        {
+            sink += DiskInfo::getHardDriveComputerID( fx->disks[i % DISK_BENCH_FIXTURES] );
+        }
+        addSince( results, "getHardDriveComputerID", iterations, 20, start, allocations );
+
+        start = mark( allocations );
+        for( unsigned long i = 0; i < iterations; i++ )
+        {
+            sink += DiskInfo::getFingerprint( fx->disks[i % DISK_BENCH_FIXTURES], FINGERPRINT_HASH128 ).lo;
+        }
+        addSince( results, "getFingerprint hash128", iterations, 20 + 40 + 8 + 8, start, allocations );
+
+#ifndef _WIN32
+        benchRows( *fx, iterations, results, allocations );
+#endif
+        delete fx;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+};
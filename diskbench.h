@@ -0,0 +1,46 @@
+/** @file
+  * EpsDiskId/diskbench.h
+  *
+  * Timings of the decoding and hashing paths that every enumeration runs through.
+  *
+  * Each benchmark repeats one operation over a small set of fixtures (IDENTIFY sectors and
+  * descriptor serial numbers of a few common drives) and reports the time per operation and
+  * the throughput.  Nothing here touches a device, so the numbers only depend on the code and
+  * the CPU, and two builds can be compared on the same machine (xp_DiskIdBench).  On Linux the
+  * xp_DiskId rows are also sent to the ODS stand-in (odsstub.h), the old way and through a
+  * RowEmitter.
+  *
+  * Where the caller can count heap allocations (the Linux runner in tools/ replaces operator new)
+  * each result also carries the allocations per operation, which unlike the times are the same
+  * on every run and can be checked against tools/diskbench.baseline.
+  */
+
+#ifndef __Utils_DISKBENCH_
+#define __Utils_DISKBENCH_
+
+#include <vector>
+
+namespace Utils
+{
+#define  DISK_BENCH_DEFAULT_ITERATIONS  100000
+
+    struct bench_result_t
+    {
+        const char         *name;
+        unsigned long       iterations;
+        unsigned long       cbPerOp;        // input bytes one operation reads
+        double              nsPerOp;
+        double              mbPerSec;       // cbPerOp * operations per second / 10^6
+        double              allocsPerOp;    // heap allocations per operation, -1 when not counted
+    };
+
+       //  Allocations made by the process so far
+    typedef unsigned __int64 (*alloc_count_fn)();
+
+       //  runs every benchmark for the given number of operations, in a fixed order; allocations
+       //  are counted only with a counter
+    void    runDiskBenchmarks( unsigned long iterations, std::vector<bench_result_t> &results,
+                               alloc_count_fn allocations = nullptr );
+};
+
+#endif
@@ -0,0 +1,220 @@
+/** @file
+  * EpsDiskId/diskcache.cpp
+  *
+  * Process-wide cache of the last drive enumeration.
+  */
+
+#ifdef _WIN32
+#   include <windows.h>
+#else
+#   include <sched.h>
+#endif
+
+#include "diskcache.h"
+
+namespace Utils
+{
+    //----------------------------------------------------------------------------------------------------------------------
+       // the interlocked calls are full barriers, which the epoch check in acquire() relies on
+    static long atomicIncrement( volatile long *p )
+    {
+#ifdef _WIN32
+        return ::InterlockedIncrement( p );
+#else
+        return __sync_add_and_fetch( p, 1 );
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static long atomicDecrement( volatile long *p )
+    {
+#ifdef _WIN32
+        return ::InterlockedDecrement( p );
+#else
+        return __sync_sub_and_fetch( p, 1 );
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static long atomicLoad( volatile long *p )
+    {
+#ifdef _WIN32
+        return ::InterlockedCompareExchange( p, 0, 0 );
+#else
+        return __sync_fetch_and_add( p, 0 );
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static disk_snapshot_t *atomicSwap( disk_snapshot_t * volatile *p, disk_snapshot_t *value )
+    {
+#ifdef _WIN32
+        return (disk_snapshot_t*)::InterlockedExchangePointer( (PVOID volatile*)p, value );
+#else
+        return __sync_lock_test_and_set( p, value );
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static void yieldThread()
+    {
+#ifdef _WIN32
+        ::Sleep( 0 );
+#else
+        ::sched_yield();
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    DiskCache::DiskCache( unsigned long nTtlMs, ProbeStats *pStats )
+        : m_current( nullptr )
+        , m_epoch( 0 )
+        , m_generation( 0 )
+        , m_nTtlMs( nTtlMs )
+        , m_pStats( pStats )
+    {
+        m_readers[0] = 0;
+        m_readers[1] = 0;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    DiskCache::~DiskCache()
+    {
+        release( m_current );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void DiskCache::setTtl( unsigned long nTtlMs )
+    {
+        m_nTtlMs = nTtlMs;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    const disk_snapshot_t *DiskCache::acquire( unsigned long &generation ) const
+    {
+        generation = (unsigned long)atomicLoad( const_cast<volatile long*>( &m_generation ) );
+
+            // register in the current epoch; retry if a writer flipped it meanwhile, so that
+            // a writer waiting on this parity is sure to see us before we read m_current
+        long epoch = 0;
+        for( ;; )
+        {
+            epoch = atomicLoad( const_cast<volatile long*>( &m_epoch ) );
+            atomicIncrement( &m_readers[epoch & 1] );
+            if( epoch == atomicLoad( const_cast<volatile long*>( &m_epoch ) ) )
+            {
+                break;
+            }
+            atomicDecrement( &m_readers[epoch & 1] );
+        }
+        disk_snapshot_t *snapshot = m_current;
+        if( snapshot != nullptr )
+        {
+            atomicIncrement( &snapshot->refs );
+        }
+        atomicDecrement( &m_readers[epoch & 1] );
+
+        if( snapshot == nullptr )
+        {
+            return nullptr;
+        }
+            // unsigned difference stays right across the 49.7 day tick wrap-around
+        unsigned long nTtlMs = m_nTtlMs;
+        if( 0 == nTtlMs || tickCount() - snapshot->dwTaken >= nTtlMs )
+        {
+            release( snapshot );
+            return nullptr;
+        }
+        return snapshot;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void DiskCache::release( const disk_snapshot_t *snapshot )
+    {
+        if( snapshot != nullptr &&
+            0 == atomicDecrement( &const_cast<disk_snapshot_t*>( snapshot )->refs ) )
+        {
+            delete snapshot;
+        }
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // caller holds the writer lock
+    void DiskCache::publish( disk_snapshot_t *snapshot )
+    {
+        disk_snapshot_t *old = atomicSwap( &m_current, snapshot );
+
+            // readers that may have read the old pointer all registered under the old epoch
+        long epoch = atomicIncrement( &m_epoch ) - 1;
+        while( atomicLoad( &m_readers[epoch & 1] ) != 0 )
+        {
+            yieldThread();
+        }
+        release( old );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void DiskCache::store( const std::vector<disk_t> &lst_disk, const std::vector<int> &devices, unsigned long generation )
+    {
+        disk_snapshot_t *snapshot = new disk_snapshot_t;
+        snapshot->disks      = lst_disk;
+        snapshot->devices    = devices;
+        snapshot->generation = generation;
+        snapshot->refs       = 1;               // the cache's own reference
+        snapshot->devices.resize( lst_disk.size(), -1 );
+        snapshot->rows.assign( snapshot->disks, snapshot->devices, m_pStats );
+
+        OsLockGuard guard( m_lock );
+        if( generation != (unsigned long)m_generation )
+        {
+            delete snapshot;
+            return;
+        }
+        snapshot->dwTaken = tickCount();
+        publish( snapshot );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool DiskCache::patchDevice( int device, const std::vector<disk_t> &lst_disk, unsigned long generation )
+    {
+        OsLockGuard guard( m_lock );
+
+            // only writers change m_current, and they all hold the lock
+        const disk_snapshot_t *current = m_current;
+        if( nullptr == current || generation != (unsigned long)m_generation )
+        {
+            return true;
+        }
+        disk_snapshot_t *snapshot = new disk_snapshot_t;
+        snapshot->dwTaken    = current->dwTaken;
+        snapshot->generation = current->generation;
+        snapshot->refs       = 1;
+
+            // records stay ordered by drive, the new ones take the place of the old
+        bool bInserted = false;
+        for( size_t i = 0; i < current->disks.size(); i++ )
+        {
+            const int owner = current->devices[i];
+            if( owner < 0 )
+            {
+                delete snapshot;
+                return false;
+            }
+            if( !bInserted && owner >= device )
+            {
+                snapshot->disks.insert( snapshot->disks.end(), lst_disk.begin(), lst_disk.end() );
+                snapshot->devices.resize( snapshot->disks.size(), device );
+                bInserted = true;
+            }
+            if( owner != device )
+            {
+                snapshot->disks.push_back( current->disks[i] );
+                snapshot->devices.push_back( owner );
+            }
+        }
+        if( !bInserted )
+        {
+            snapshot->disks.insert( snapshot->disks.end(), lst_disk.begin(), lst_disk.end() );
+            snapshot->devices.resize( snapshot->disks.size(), device );
+        }
+        snapshot->rows.assign( snapshot->disks, snapshot->devices, m_pStats );
+        publish( snapshot );
+        return true;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void DiskCache::invalidate()
+    {
+        OsLockGuard guard( m_lock );
+        atomicIncrement( &m_generation );
+        publish( nullptr );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+};
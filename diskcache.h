@@ -0,0 +1,107 @@
+/** @file
+  * EpsDiskId/diskcache.h
+  *
+  * Process-wide cache of the last drive enumeration.
+  *
+  * The hardware behind a server changes rarely, yet every xp_DiskId call used to run the whole
+  * IOCTL sweep.  DiskCache keeps the last complete result for ttl milliseconds as an immutable
+  * snapshot; invalidate() drops it so the next call probes again.
+  *
+  * Readers never block: acquire() pins the current snapshot with two interlocked increments and
+  * no lock, so any number of sessions can stream it while a writer publishes the next one.  A
+  * writer swaps the pointer, flips the reader epoch and waits only for readers that were inside
+  * acquire() at that moment (a few instructions) before dropping its reference to the old
+  * snapshot; a snapshot somebody still streams lives on until its last pin is released.
+  */
+
+#ifndef __Utils_DISKCACHE_
+#define __Utils_DISKCACHE_
+
+#include <vector>
+
+#include "diskid.h"
+#include "diskrows.h"
+#include "osutil.h"
+
+namespace Utils
+{
+#define  DISK_CACHE_DEFAULT_TTL_MS   60000UL    // 1 minute
+
+       //  One published enumeration; never modified once stored
+    struct disk_snapshot_t
+    {
+        std::vector<disk_t>     disks;
+        std::vector<int>        devices;        // physical drive of each record, -1 if unknown
+        DiskRows                rows;           // disks as xp_DiskId sends them
+        unsigned long           dwTaken;        // tick count of store()
+        unsigned long           generation;
+        volatile long           refs;
+    };
+
+    class DiskCache
+    {
+        public:
+               //  pStats: where the duuid of every stored record is timed (nullptr = nowhere)
+            explicit DiskCache( unsigned long nTtlMs = DISK_CACHE_DEFAULT_TTL_MS, ProbeStats *pStats = nullptr );
+            ~DiskCache();
+
+               //  0 turns caching off: acquire() always misses
+            void            setTtl( unsigned long nTtlMs );
+            unsigned long   ttl() const                 { return m_nTtlMs; }
+
+               //  Pins and returns the current snapshot if it is younger than the TTL, else nullptr.
+               //  generation receives the value to pass to store() for the result about to be
+               //  probed.  Every non-null result must be given back to release().
+            const disk_snapshot_t  *acquire( unsigned long &generation ) const;
+            static void             release( const disk_snapshot_t *snapshot );
+
+               //  Publishes lst_disk unless invalidate() was called after the acquire() that returned
+               //  generation; an enumeration begun before the invalidation must not bring back what
+               //  the caller just threw away.  devices gives the physical drive of each record
+               //  (DiskInfo::deviceOf); patchDevice() needs it.
+            void            store( const std::vector<disk_t> &lst_disk, const std::vector<int> &devices, unsigned long generation );
+
+               //  Publishes a copy of the current snapshot with the records of physical drive device
+               //  replaced by lst_disk (empty: the drive is gone).  The snapshot keeps its age, so the
+               //  TTL still forces a full sweep now and then.  True if patched or if there is nothing
+               //  to patch (no snapshot, or generation outdated); false if the snapshot holds records
+               //  of unknown origin and only a full sweep can bring it up to date.
+            bool            patchDevice( int device, const std::vector<disk_t> &lst_disk, unsigned long generation );
+
+            void            invalidate();
+
+        private:
+                            DiskCache( const DiskCache& );
+            DiskCache&      operator=( const DiskCache& );
+
+            void            publish( disk_snapshot_t *snapshot );
+
+            OsLock                      m_lock;         // serialises writers only
+            disk_snapshot_t * volatile  m_current;
+            mutable volatile long       m_readers[2];   // readers inside acquire(), by epoch parity
+            volatile long               m_epoch;
+            volatile long               m_generation;
+            volatile unsigned long      m_nTtlMs;
+            ProbeStats                 *m_pStats;
+    };
+
+       //  Scoped pin of the current snapshot
+    class DiskSnapshotPin
+    {
+        public:
+            explicit DiskSnapshotPin( const DiskCache &cache ) : m_generation( 0 ), m_snapshot( cache.acquire( m_generation ) ) {}
+            ~DiskSnapshotPin()                          { DiskCache::release( m_snapshot ); }
+
+            const disk_snapshot_t  *get() const         { return m_snapshot; }
+            unsigned long           generation() const  { return m_generation; }
+
+        private:
+                            DiskSnapshotPin( const DiskSnapshotPin& );
+            DiskSnapshotPin& operator=( const DiskSnapshotPin& );
+
+            unsigned long           m_generation;
+            const disk_snapshot_t  *m_snapshot;
+    };
+};
+
+#endif
@@ -0,0 +1,163 @@
+/** @file
+  * EpsDiskId/diskfilter.cpp
+  *
+  * Which drives and columns an xp_DiskId call asks for.
+  */
+
+#include <ctype.h>
+#include <string.h>
+
+#include "diskfilter.h"
+#include "ataconv.h"
+
+namespace Utils
+{
+    //----------------------------------------------------------------------------------------------------------------------
+    disk_filter_t::disk_filter_t()
+        : nFirst( -1 )
+        , nLast( -1 )
+    {
+        for( int col = 0; col < DISK_COLUMNS; col++ )
+        {
+            columns.push_back( col );
+        }
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    unsigned disk_filter_t::sent() const
+    {
+        unsigned mask = 0;
+        for( size_t c = 0; c < columns.size(); c++ )
+        {
+            mask |= DISK_COL_BIT( columns[c] );
+        }
+        return mask;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    unsigned disk_filter_t::needed() const
+    {
+        return sent() | ( pattern.empty() ? 0 : DISK_COL_BIT( DISK_COL_MODEL ) | DISK_COL_BIT( DISK_COL_SERIAL ) );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // column names are compared as T-SQL compares identifiers by default, in any case
+    static bool sameName( const char *name, const char *s, size_t n )
+    {
+        if( ::strlen( name ) != n )
+        {
+            return false;
+        }
+        for( size_t i = 0; i < n; i++ )
+        {
+            if( ::tolower( (unsigned char)name[i] ) != ::tolower( (unsigned char)s[i] ) )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool disk_filter_t::parseColumns( const std::string &list )
+    {
+        std::vector<int> parsed;
+        unsigned         seen = 0;
+        size_t           at   = 0;
+
+        while( at <= list.size() )
+        {
+            size_t end = list.find( ',', at );
+            if( std::string::npos == end )
+            {
+                end = list.size();
+            }
+            size_t first = at;
+            size_t last  = end;
+            while( first < last && ::isspace( (unsigned char)list[first] ) )    first++;
+            while( last > first && ::isspace( (unsigned char)list[last - 1] ) ) last--;
+
+            int col = 0;
+            while( col < DISK_COLUMNS && !sameName( diskColumnName( col ), list.c_str() + first, last - first ) )
+            {
+                col++;
+            }
+            if( col == DISK_COLUMNS || 0 != ( seen & DISK_COL_BIT( col ) ) )
+            {
+                return false;
+            }
+            seen |= DISK_COL_BIT( col );
+            parsed.push_back( col );
+            at = end + 1;
+        }
+        columns.swap( parsed );
+        return true;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // value of a text column without the NUL and the blanks around it
+    static bool matchText( const char *text, size_t stride, const __int32 *lengths, size_t row, const char *pattern )
+    {
+        const char *value = text + row * stride;
+        size_t      cb    = ( lengths[row] > 0 ) ? (size_t)lengths[row] - 1 : 0;
+        size_t      lead  = countLeadingBlanks( value, cb );
+
+        while( cb > lead && ' ' == value[cb - 1] )
+        {
+            cb--;
+        }
+        return likeMatch( value + lead, cb - lead, pattern );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void disk_filter_t::select( const DiskRows &_rows, const std::vector<int> &owners, std::vector<size_t> &rows ) const
+    {
+        rows.clear();
+        for( size_t i = 0; i < _rows.size(); i++ )
+        {
+            if( !allDevices() && ( i >= owners.size() || owners[i] < nFirst || owners[i] > nLast ) )
+            {
+                continue;
+            }
+            if( !pattern.empty() &&
+                !matchText( _rows.model(),  _rows.modelStride(),  _rows.modelLengths(),  i, pattern.c_str() ) &&
+                !matchText( _rows.serial(), _rows.serialStride(), _rows.serialLengths(), i, pattern.c_str() ) )
+            {
+                continue;
+            }
+            rows.push_back( i );
+        }
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // greedy with one backtrack point: on a mismatch the last % takes one more character
+    bool likeMatch( const char *text, size_t cb, const char *pattern )
+    {
+        size_t      t     = 0;
+        const char *p     = pattern;
+        const char *pStar = nullptr;
+        size_t      tStar = 0;
+
+        while( t < cb )
+        {
+            if( '%' == *p )
+            {
+                pStar = ++p;
+                tStar = t;
+            }
+            else if( '\0' != *p && ( '_' == *p || ::tolower( (unsigned char)*p ) == ::tolower( (unsigned char)text[t] ) ) )
+            {
+                p++;
+                t++;
+            }
+            else if( nullptr != pStar )
+            {
+                p = pStar;
+                t = ++tStar;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        while( '%' == *p )
+        {
+            p++;
+        }
+        return '\0' == *p;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+};
@@ -0,0 +1,59 @@
+/** @file
+  * EpsDiskId/diskfilter.h
+  *
+  * Which drives and columns an xp_DiskId call asks for.
+  *
+  * xp_DiskId [ @first int [, @last int [, @pattern varchar [, @columns varchar ]]]]
+  *     @first, @last   physical drive numbers (\\.\PhysicalDriveN), both included; @last defaults
+  *                     to @first, @first to 0.  Without them every drive is listed.
+  *     @pattern        LIKE pattern (% any run, _ any character, case-insensitive) matched against
+  *                     the model and the serial with their surrounding blanks removed; a drive is
+  *                     listed when either matches.
+  *     @columns        comma separated names of the columns to send, in the order to send them,
+  *                     e.g. 'serial,size'.  Without it all five are sent as before.
+  * NULL stands for a parameter left out.
+  *
+  * A call that names drives probes only those when the cache has no snapshot, and a call that
+  * leaves out the duuid does not hash any record for it.
+  */
+
+#ifndef __Utils_DISKFILTER_
+#define __Utils_DISKFILTER_
+
+#include <string>
+#include <vector>
+
+#include "diskrows.h"
+
+namespace Utils
+{
+    struct disk_filter_t
+    {
+        int                 nFirst;         // drive range, nFirst < 0 for every drive
+        int                 nLast;
+        std::string         pattern;        // empty for any drive
+        std::vector<int>    columns;        // disk_column_t, in the order sent
+
+        disk_filter_t();
+
+        bool        allDevices() const      { return nFirst < 0; }
+        bool        allRows() const         { return allDevices() && pattern.empty(); }
+
+           //  DISK_COL_BIT()s of the columns to send, and of the ones the filter itself reads
+        unsigned    sent() const;
+        unsigned    needed() const;
+
+           //  replaces the columns by a list like "serial, size"; false if a name is unknown,
+           //  repeated or the list is empty, and then the columns are left as they were
+        bool        parseColumns( const std::string &list );
+
+           //  rows of _rows (built with at least needed()) that pass, in order;
+           //  owners: physical drive of each row
+        void        select( const DiskRows &_rows, const std::vector<int> &owners, std::vector<size_t> &rows ) const;
+    };
+
+       //  SQL LIKE without escapes over text[0, cb): % any run, _ any one character, letters in any case
+    bool    likeMatch( const char *text, size_t cb, const char *pattern );
+};
+
+#endif
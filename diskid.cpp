@@ -37,6 +37,17 @@
 
 
 #include "diskid.h"
+#include "devenum.h"
+#include "probepool.h"
+#include "scratchpool.h"
+#include "probestrategy.h"
+#include "probediag.h"
+#include "probestats.h"
+#include "deviceio.h"
+#include "identify.h"
+#include "nvme.h"
+#include "ataconv.h"
+#include "crc64.h"
 
 #define  TITLE   "DiskId32"
 
@@ -56,6 +67,8 @@ using namespace std;
 #define  FILE_DEVICE_SCSI              0x0000001b
 #define  IOCTL_SCSI_MINIPORT_IDENTIFY  ((FILE_DEVICE_SCSI << 16) + 0x0501)
 #define  IOCTL_SCSI_MINIPORT 0x0004D008  //  see NTDDSCSI.H for definition
+#define  IOCTL_SCSI_GET_ADDRESS 0x00041018  //  see NTDDSCSI.H for definition
+#define  IOCTL_STORAGE_QUERY_PROPERTY   CTL_CODE(IOCTL_STORAGE_BASE, 0x0500, METHOD_BUFFERED, FILE_ANY_ACCESS)
 
    //  Bits returned in the fCapabilities member of GETVERSIONOUTPARAMS 
 #define  CAP_IDE_ID_FUNCTION             1  // ATA ID command supported
@@ -64,15 +77,363 @@ using namespace std;
 
 namespace Utils
 {
+        //----------------------------------------------------------------------------------------------------------------------
+    DeviceIo &DiskInfo::io() const
+    {
+        return ( nullptr != m_pIo ) ? *m_pIo : liveDeviceIo();
+    }
+        //----------------------------------------------------------------------------------------------------------------------
+       // Devices to probe: what the backend reports, or the old fixed range of names if it could not be asked
+    void DiskInfo::listDevices( bool scsiPorts, std::vector<device_t> &devices ) const
+    {
+        if( io().listDevices( scsiPorts, devices ) )
+        {
+            return;
+        }
+        size_t count = 0;
+        for( int i = 0; i < MAX_IDE_DRIVES; i++ )
+        {
+            wchar_t driveName [256] = {0};
+
+            ::_snwprintf( driveName, _countof(driveName)-1, scsiPorts ? L"\\\\.\\Scsi%d:" : L"\\\\.\\PhysicalDrive%d", i );
+
+            device_t &dev = nextDevice( devices, count );
+            dev.index = i;
+            dev.path  = driveName;
+        }
+        devices.resize( count );
+    }
+
+        //----------------------------------------------------------------------------------------------------------------------
+       // milliseconds until a GetTickCount() deadline, <= 0 once it has passed (wrap-around safe)
+    static long msUntil( DWORD dwDeadline )
+    {
+        return (long)( dwDeadline - ::GetTickCount() );
+    }
+        //----------------------------------------------------------------------------------------------------------------------
+       // serial number must be alphanumeric (but there can be leading spaces on IBM drives)
+    static bool plausibleSerial( const char *serial, size_t cb )
+    {
+        const size_t lead = countLeadingBlanks( serial, ::strnlen( serial, cb ) );
+        const size_t rest = cb - lead;
+        return ( rest > 0  && ::isalnum( (unsigned char)serial[lead] ) ) ||
+               ( rest > 19 && ::isalnum( (unsigned char)serial[lead + 19] ) );
+    }
+        //----------------------------------------------------------------------------------------------------------------------
+    static int ioctlPhase( unsigned long dwIoControlCode )
+    {
+        switch( dwIoControlCode )
+        {
+            case DFP_GET_VERSION:                       return PROBE_PHASE_GET_VERSION;
+            case DFP_RECEIVE_DRIVE_DATA:                return PROBE_PHASE_RECEIVE_DRIVE_DATA;
+            case IOCTL_SCSI_MINIPORT:                   return PROBE_PHASE_SCSI_MINIPORT;
+            case IOCTL_STORAGE_QUERY_PROPERTY:          return PROBE_PHASE_QUERY_PROPERTY;
+            case IOCTL_STORAGE_GET_MEDIA_SERIAL_NUMBER: return PROBE_PHASE_MEDIA_SERIAL;
+        }
+        return PROBE_PHASE_OTHER_IOCTL;
+    }
+        //----------------------------------------------------------------------------------------------------------------------
+#define  DISK_IO_BUFFER_SIZE       16000                        // output of the storage property and media serial queries
+#define  DISK_REQUEST_BUFFER_SIZE  ( 128 + NVME_IDENTIFY_SIZE ) // input of the NVMe Identify query
+#define  DISK_TEXT_BUFFER_SIZE     1024                         // serial numbers decoded from ioBuffer
+
+    struct DiskInfo::probe_state_t
+    {
+        unsigned long               dwCallDeadline;         // GetTickCount() values
+        unsigned long               dwDeviceDeadline;
+        bool                        bDeviceTimedOut;
+        bool                        bSerialFound;           // a plausible serial was read; the media serial is not asked
+        int                         nDevice;                // index of the device being probed, for the statistics
+        std::string                 identity;               // mediumIdentity() of the medium being probed
+        unsigned __int8             idOutCmd[ sizeof(SENDCMDOUTPARAMS) + IDENTIFY_BUFFER_SIZE - 1 ];
+        char                        ioBuffer[ DISK_IO_BUFFER_SIZE ];
+        unsigned __int8             requestBuffer[ DISK_REQUEST_BUFFER_SIZE ];
+        char                        textBuffer[ DISK_TEXT_BUFFER_SIZE ];
+
+        probe_state_t() { reset( 0 ); }
+
+           // ready for a call; the buffers are left as the last one did
+        void reset( unsigned long dwDeadline )
+        {
+            dwCallDeadline   = dwDeadline;
+            dwDeviceDeadline = dwDeadline;
+            bDeviceTimedOut  = false;
+            bSerialFound     = false;
+            nDevice          = -1;
+        }
+    };
+        //----------------------------------------------------------------------------------------------------------------------
+       // Result of one device probe run on a pool worker
+#define  PROBE_SLOT_PENDING   0
+#define  PROBE_SLOT_COMPLETE  1
+
+    struct DiskInfo::probe_slot_t
+    {
+        disk_t                      disks[PROBE_PORT_RECORDS];
+        size_t                      nDisks;
+        bool                        done;
+        bool                        abort;
+        bool                        timedOut;
+        volatile long               state;      // the caller reads a slot only once it is complete
+
+        probe_slot_t() : nDisks( 0 ), done( false ), abort( false ), timedOut( false ), state( PROBE_SLOT_PENDING ) {}
+    };
+        //----------------------------------------------------------------------------------------------------------------------
+       // What the calls of one engine reuse instead of allocating: probe states, the batches of
+       // finished sweeps and device lists
+    struct DiskInfo::probe_scratch_t
+    {
+        ScratchPool<probe_state_t>          states;
+        ScratchPool<probe_batch_t>          batches;
+        ScratchPool<std::vector<device_t> > deviceLists;
+
+           // a batch a worker may still be using is left to the last of them
+        void giveBatch( probe_batch_t *batch );
+    };
+        //----------------------------------------------------------------------------------------------------------------------
+       // One sweep handed to the pool.  It owns copies of everything the workers read, because a worker
+       // stuck in a hung device may still be running after runProbes() has returned.  A batch whose
+       // workers all finished is kept by the engine for its next sweep.
+    struct DiskInfo::probe_batch_t : public ProbeTasks
+    {
+        DiskInfo                    engine;         // settings, and the scratch of the workers
+        probe_fn                    fn;
+        std::vector<device_t>       devices;
+        std::vector<probe_slot_t>   slots;
+        unsigned long               dwCallDeadline;
+
+        probe_batch_t() : fn( nullptr ), dwCallDeadline( 0 ) {}
+
+        virtual void runTask( size_t index )
+        {
+            probe_slot_t                  &slot = slots[index];
+            ScratchHold<probe_state_t>     st( engine.m_pScratch->states );
+            disk_span_t                    out( slot.disks, _countof(slot.disks) );
+
+            st->reset( dwCallDeadline );
+            engine.beginDevice( *st, devices[index] );
+            slot.done     = (engine.*fn)( *st, devices[index], out, slot.abort );
+            slot.nDisks   = out.stored();
+            slot.timedOut = st->bDeviceTimedOut;
+
+            ::InterlockedExchange( &slot.state, PROBE_SLOT_COMPLETE );
+        }
+    };
+        //----------------------------------------------------------------------------------------------------------------------
+    void DiskInfo::probe_scratch_t::giveBatch( probe_batch_t *batch )
+    {
+        if( batch->reusable() )
+        {
+            batches.give( batch );
+        }
+        else
+        {
+            batch->release();
+        }
+    }
+        //----------------------------------------------------------------------------------------------------------------------
+    bool DiskInfo::knownUnsupported( const device_t &device, unsigned request, const std::string &identity ) const
+    {
+        return nullptr != m_pStrategy && m_pStrategy->isUnsupported( device, request, identity );
+    }
+        //----------------------------------------------------------------------------------------------------------------------
+       // a request that ran out of time says nothing about the device and is not remembered
+    void DiskInfo::markUnsupported( const probe_state_t &st, const device_t &device, unsigned request, const std::string &identity ) const
+    {
+        if( nullptr != m_pStrategy && !st.bDeviceTimedOut )
+        {
+            m_pStrategy->setUnsupported( device, request, identity );
+        }
+    }
+        //----------------------------------------------------------------------------------------------------------------------
+       // Runs one probe method over all devices, one after another or on up to m_nMaxParallelProbes
+       // threads.  Either way the records come out in device order, and a probe that sets abort ends
+       // the method with false after the records of the devices before it.  Devices that miss their
+       // deadline, or are not reached before the call budget runs out, are reported and skipped.
+       // Records are appended to out; with pStorage, out is first moved into it, grown by the most
+       // the devices can give, so that nothing is dropped.
+    bool DiskInfo::runProbes( probe_fn fn, const std::vector<device_t> &devices, disk_span_t &out, std::vector<disk_t> *pStorage,
+                              probe_report_t &report, unsigned long dwCallDeadline ) const
+    {
+        bool done = false;
+
+            // SCSI ports hold several drives, so their records cannot be tied to one physical drive
+        const bool bPhysical = ( fn != &DiskInfo::probeScsiPort );
+
+        if( nullptr != pStorage )
+        {
+            pStorage->resize( out.count + devices.size() * ( bPhysical ? PROBE_DRIVE_RECORDS : PROBE_PORT_RECORDS ) );
+            out.data     = pStorage->empty() ? nullptr : pStorage->data();
+            out.capacity = pStorage->size();
+        }
+
+        if( 0 == m_nTotalTimeoutMs && ( m_nMaxParallelProbes <= 1 || devices.size() <= 1 ) )
+        {
+            ScratchHold<probe_state_t> st( m_pScratch->states );
+
+            st->reset( dwCallDeadline );
+            for( size_t d = 0; d < devices.size(); d++ )
+            {
+                bool abort = false;
+
+                beginDevice( *st, devices[d] );
+                if( (this->*fn)( *st, devices[d], out, abort ) )
+                {
+                    done = true;
+                }
+                report.deviceOf.resize( out.stored(), bPhysical ? devices[d].index : -1 );
+                if( st->bDeviceTimedOut )
+                {
+                    reportTimedOut( report, devices[d] );
+                }
+                if( abort )
+                {
+                    done = false;
+                    break;
+                }
+            }
+            return done;
+        }
+
+           // with a call budget the pool is used even for one worker, so that a device hanging
+           // in CreateFile can be abandoned
+        probe_batch_t *batch = m_pScratch->batches.take();
+        batch->engine           = *this;
+        batch->fn               = fn;
+        batch->devices          = devices;
+        batch->dwCallDeadline   = dwCallDeadline;
+        batch->slots.assign( devices.size(), probe_slot_t() );
+
+        long budget = ( 0 == m_nTotalTimeoutMs ) ? (long)PROBE_POOL_INFINITE : msUntil( dwCallDeadline );
+        if( budget < 0 )
+        {
+            budget = 0;
+        }
+        ProbePool( m_nMaxParallelProbes ).run( devices.size(), batch, (unsigned long)budget );
+
+        for( size_t d = 0; d < batch->slots.size(); d++ )
+        {
+            probe_slot_t &slot = batch->slots[d];
+
+            if( PROBE_SLOT_COMPLETE != ::InterlockedCompareExchange( &slot.state, PROBE_SLOT_COMPLETE, PROBE_SLOT_COMPLETE ) )
+            {
+                reportTimedOut( report, devices[d] );       // still running or never started
+                continue;
+            }
+            for( size_t i = 0; i < slot.nDisks; i++ )
+            {
+                out.push( slot.disks[i] );
+            }
+            report.deviceOf.resize( out.stored(), bPhysical ? devices[d].index : -1 );
+            if( slot.timedOut )
+            {
+                reportTimedOut( report, devices[d] );
+            }
+            if( slot.abort )
+            {
+                m_pScratch->giveBatch( batch );
+                return false;
+            }
+            if( slot.done )
+            {
+                done = true;
+            }
+        }
+        m_pScratch->giveBatch( batch );
+        return done;
+    }
+        //----------------------------------------------------------------------------------------------------------------------
+    void DiskInfo::reportTimedOut( probe_report_t &report, const device_t &device ) const
+    {
+        diagnose( PROBE_OP_TIMED_OUT, device.index, 0 );
+        report.timedOut.push_back( device.index );
+    }
+        //----------------------------------------------------------------------------------------------------------------------
+    void DiskInfo::diagnose( int op, int device, unsigned long error ) const
+    {
+        if( nullptr != m_pDiagnostics )
+        {
+            m_pDiagnostics->record( (probe_op_t)op, device, error );
+        }
+    }
+        //----------------------------------------------------------------------------------------------------------------------
+    bool DiskInfo::budgetSpent( unsigned long dwCallDeadline ) const
+    {
+        return 0 != m_nTotalTimeoutMs && msUntil( dwCallDeadline ) <= 0;
+    }
+        //----------------------------------------------------------------------------------------------------------------------
+       // Start the clock of the next device: its own timeout, but never past the call budget
+    void DiskInfo::beginDevice( probe_state_t &st, const device_t &device ) const
+    {
+        st.bDeviceTimedOut = false;
+        st.nDevice         = device.index;
+        if( !m_bTimed )
+        {
+            return;
+        }
+        st.dwDeviceDeadline = ::GetTickCount() + ( m_nDeviceTimeoutMs ? m_nDeviceTimeoutMs : 0x7fffffffUL );
+
+        if( m_nTotalTimeoutMs && (long)( st.dwDeviceDeadline - st.dwCallDeadline ) > 0 )
+        {
+            st.dwDeviceDeadline = st.dwCallDeadline;
+        }
+    }
+        //----------------------------------------------------------------------------------------------------------------------
+       // SRB_IO_CONTROL::Timeout is in seconds; the miniport gives up on its own no later than our deadline
+    unsigned long DiskInfo::srbTimeout() const
+    {
+        if( !m_bTimed || 0 == m_nDeviceTimeoutMs )
+        {
+            return 10000;
+        }
+        return ( m_nDeviceTimeoutMs + 999 ) / 1000;
+    }
+        //----------------------------------------------------------------------------------------------------------------------
+       // DeviceIoControl bounded by the current device deadline.  Fails with ERROR_TIMEOUT (and sets
+       // st.bDeviceTimedOut) when the deadline has passed or the request does not finish before it.
+       // With deadlines the handles are opened for overlapped I/O, so that the backend can abandon a request.
+    int DiskInfo::ioControl( probe_state_t &st, void *hDevice, unsigned long dwIoControlCode, void *lpInBuffer, unsigned long nInBufferSize,
+                             void *lpOutBuffer, unsigned long nOutBufferSize, unsigned long *lpBytesReturned ) const
+    {
+        ProbeStatScope timer( m_pStats, ioctlPhase( dwIoControlCode ), st.nDevice );
+
+        unsigned long timeoutMs = DEVICE_IO_INFINITE;
+        if( m_bTimed )
+        {
+            const long remaining = msUntil( st.dwDeviceDeadline );
+            if( remaining <= 0 )
+            {
+                st.bDeviceTimedOut = true;
+                ::SetLastError( ERROR_TIMEOUT );
+                return FALSE;
+            }
+            timeoutMs = (unsigned long)remaining;
+        }
+        unsigned long cbReturned = 0;
+        unsigned long err        = ERROR_SUCCESS;
+        const bool    ok         = io().control( hDevice, dwIoControlCode, lpInBuffer, nInBufferSize,
+                                                 lpOutBuffer, nOutBufferSize, cbReturned, timeoutMs, err );
+        if( !ok && m_bTimed && DEVICE_IO_TIMEOUT == err )
+        {
+            st.bDeviceTimedOut = true;
+        }
+        if( nullptr != lpBytesReturned )
+        {
+            *lpBytesReturned = cbReturned;
+        }
+        ::SetLastError( ok ? ERROR_SUCCESS : err );
+
+        return ok ? TRUE : FALSE;
+    }
 
         //----------------------------------------------------------------------------------------------------------------------
        // DoIDENTIFY
        // FUNCTION: Send an IDENTIFY command to the drive
        // bDriveNum = 0-3
        // bIDCmd = IDE_ATA_IDENTIFY or IDE_ATAPI_IDENTIFY
-    bool DiskInfo::DoIDENTIFY ( void * hPhysicalDriveIOCTL, PSENDCMDINPARAMS pSCIP,
+    bool DiskInfo::DoIDENTIFY ( probe_state_t &st, void * hPhysicalDriveIOCTL, PSENDCMDINPARAMS pSCIP,
                      PSENDCMDOUTPARAMS pSCOP, unsigned __int8 bIDCmd, unsigned __int8 bDriveNum,
-                     unsigned __int32 * lpcbBytesReturned )
+                     unsigned __int32 * lpcbBytesReturned ) const
     {
         if( nullptr == pSCIP )
         {
@@ -93,218 +454,75 @@ namespace Utils
        pSCIP->bDriveNumber            = bDriveNum;
        pSCIP->cBufferSize             = IDENTIFY_BUFFER_SIZE;
 
-       return( ::DeviceIoControl( hPhysicalDriveIOCTL, DFP_RECEIVE_DRIVE_DATA,
+       return( ioControl( st, hPhysicalDriveIOCTL, DFP_RECEIVE_DRIVE_DATA,
                    (LPVOID) pSCIP,
                    sizeof(SENDCMDINPARAMS) - 1,
                    (LPVOID) pSCOP,
                    sizeof(SENDCMDOUTPARAMS) + IDENTIFY_BUFFER_SIZE - 1,
-                   (LPDWORD)lpcbBytesReturned, NULL) ? true : false );
+                   (LPDWORD)lpcbBytesReturned ) ? true : false );
     }
     //----------------------------------------------------------------------------------------------------------------------
-    bool DiskInfo::GetIdeInfo( const int drive, unsigned __int32 diskdata [256], disk_t &_disk )
+       // SMART IDENTIFY through the drive itself; the handle must be open for read and write
+    bool DiskInfo::identifyAta( probe_state_t &st, void *hPhysicalDriveIOCTL, const device_t &device, disk_t &_disk ) const
     {
-        if( drive < 0 )
-        {
-            return false;
-        }
-       char string1 [1024] = {0};
-
-       ::memset( &_disk, 0, sizeof( _disk ) );
-
-          //  copy the hard drive serial number to the buffer
-       char tmp [1024] = {0};
-       ::strncpy( tmp, ConvertToString( diskdata, 10, 19 ), sizeof(tmp)-1 );
-       size_t ctr = 0;
-       // cut off frontal spaces
-       for( size_t i = 0; i < strlen(tmp); i++ )
-       {
-           if( tmp[i] != ' ' )
-           {
-               ctr = i;
-               break;
-           }
-       }
-       strncpy_s( string1, sizeof(string1)-1, &tmp[ctr], strlen(&tmp[ctr]) );
-
-       //  serial number must be alphanumeric(but there can be leading spaces on IBM drives)
-       if( 0 == m_szHardDriveSerialNumber [0] && (isalnum (string1 [0]) || isalnum (string1 [19])) )
-       {
-          ::memset( m_szHardDriveSerialNumber, 0, sizeof(m_szHardDriveSerialNumber)/sizeof(m_szHardDriveSerialNumber[0]) );
-          ::strncpy_s( m_szHardDriveSerialNumber, sizeof(m_szHardDriveSerialNumber)-1, string1, strlen(string1) );
-
-          ::memset( m_szHardDriveModelNumber, 0, sizeof(m_szHardDriveModelNumber)/sizeof(m_szHardDriveModelNumber[0]) );
-          ::strncpy( m_szHardDriveModelNumber, ConvertToString( diskdata, 27, 46 ), sizeof(m_szHardDriveModelNumber)-1 );
-       }
-       switch (drive / 2)
-       {
-          case 0: _disk.num_controller = 0; break;  //Primary Controller
-          case 1: _disk.num_controller = 1; break;  //Secondary Controller
-          case 2: _disk.num_controller = 2; break;  //Tertiary Controller
-          case 3: _disk.num_controller = 3; break;  //Quaternary Controller
-       }
-       switch (drive % 2)
-       {
-            case 0: _disk.master_slave = true; break;
-            case 1: _disk.master_slave = false; break;
-       }
-
-       ::strncpy( _disk.model,    ConvertToString (diskdata, 27, 46), sizeof(_disk.model)-1 );
-       ::strncpy( _disk.serial,   ConvertToString (diskdata, 10, 19), sizeof(_disk.serial)-1 );
-       ::strncpy( _disk.revision, ConvertToString (diskdata, 23, 26), sizeof(_disk.revision)-1 );
-
-       _disk.buffer = diskdata [21] * 512;
-
-       if( diskdata [0] & 0x0080 )
-       {
-           _disk.type = 0; // REMOVABLE_DISK;
-       }else if( diskdata [0] & 0x0040 )
-       {
-           _disk.type = 1; // FIXED_DISK;
-       }else
-       {
-           _disk.type = -1; // UNKNOWN_DISK;
-       }
-            //  calculate size based on 28 bit or 48 bit addressing
-            //  48 bit addressing is reflected by bit 10 of word 83
-        if (diskdata [83] & 0x400) 
-        {
-            _disk.sectors = diskdata [103] * 65536I64 * 65536I64 * 65536I64 + 
-                            diskdata [102] * 65536I64 * 65536I64 + 
-                            diskdata [101] * 65536I64 + 
-                            diskdata [100];
-        }else
-        {
-            _disk.sectors = diskdata [61] * 65536 + diskdata [60];
-        }
-            //  there are 512 bytes in a sector
-        _disk.size = _disk.sectors * 512;
-
-        return true;
-    }
-    //----------------------------------------------------------------------------------------------------------------------
-    char *DiskInfo::ConvertToString( unsigned __int32 diskdata [256], int firstIndex, int lastIndex )
-    {
-       int position = 0;
-       memset( m_cv, 0, sizeof(m_cv) );
+       bool done = false;
+       const int drive = device.index;
 
-          //  each integer has two characters stored in it backwards
-       for(int index = firstIndex; index <= lastIndex; index++)
+       if( knownUnsupported( device, PROBE_NO_SMART ) )
        {
-             //  get high byte for 1st character
-          m_cv [position] = (char) (diskdata [index] / 256);
-          position++;
-
-             //  get low byte for 2nd character
-          m_cv [position] = (char) (diskdata [index] % 256);
-          position++;
+           return false;
        }
-          //  end the string 
-       m_cv[position] = '\0';
-
-          //  cut off the trailing blanks
-       for(int index = position - 1; index > 0 && ' ' == m_cv[index]; index-- )
-       {
-          m_cv [index] = '\0';
+       GETVERSIONOUTPARAMS VersionParams;
+       unsigned __int32    cbBytesReturned = 0;
+
+          // Get the version, etc of PhysicalDrive IOCTL
+       ::memset ((void*) &VersionParams, 0, sizeof(VersionParams));
+
+       if ( ! ioControl (st, hPhysicalDriveIOCTL, DFP_GET_VERSION,
+                 NULL, 
+                 0,
+                 &VersionParams,
+                 sizeof(VersionParams),
+                 (LPDWORD)&cbBytesReturned) )
+       {         
+            diagnose( PROBE_OP_GET_VERSION, drive, ::GetLastError() );
+            markUnsupported( st, device, PROBE_NO_SMART );
+            return false;
        }
-       return m_cv;
-    }
-    //----------------------------------------------------------------------------------------------------------------------
-    bool DiskInfo::ReadPhysicalDriveInNTWithAdminRights( std::vector<disk_t> &lst_disk )
-    {
-       bool done = false;
-       int drive = 0;
-       lst_disk.clear();
 
-       for(drive = 0; drive < MAX_IDE_DRIVES; drive++)
+          // If there is a IDE device at number "drive" issue commands
+          // to the device
+       if (VersionParams.bIDEDeviceMap > 0)
        {
-          HANDLE hPhysicalDriveIOCTL = 0;
-          wchar_t szMsg[512] = {0};
-
-             //  Try to get a handle to PhysicalDrive IOCTL, report failure
-             //  and exit if can't.
-          wchar_t driveName [256]={0};
-
-          ::_snwprintf( driveName, _countof(driveName)-1, L"\\\\.\\PhysicalDrive%d", drive);
-
-             //  Windows NT, Windows 2000, must have admin rights
-          hPhysicalDriveIOCTL = CreateFileW (driveName,
-                                   GENERIC_READ | GENERIC_WRITE, 
-                                   FILE_SHARE_READ | FILE_SHARE_WRITE , NULL,
-                                   OPEN_EXISTING, 0, NULL);
-
-          if( hPhysicalDriveIOCTL == INVALID_HANDLE_VALUE )
-          {
-              _snwprintf( szMsg, _countof(szMsg)-1,
-                          L"Unable to open physical drive %d, error code: 0x%lX\n",
-                          drive, GetLastError () );
-              errors.push_back( szMsg );
-              return false;
-          }
-
-          if (hPhysicalDriveIOCTL != INVALID_HANDLE_VALUE)
+          BYTE             bIDCmd = 0;   // IDE or ATAPI IDENTIFY cmd
+          SENDCMDINPARAMS  scip;
+          //SENDCMDOUTPARAMS OutCmd;
+
+          // Now, get the ID sector for all IDE devices in the system.
+             // If the device is ATAPI use the IDE_ATAPI_IDENTIFY command,
+             // otherwise use the IDE_ATA_IDENTIFY command
+          bIDCmd = (drive < 8 && (VersionParams.bIDEDeviceMap >> drive & 0x10)) ? \
+                    IDE_ATAPI_IDENTIFY : IDE_ATA_IDENTIFY;
+
+          ::memset (&scip, 0, sizeof(scip));
+          ::memset (st.idOutCmd, 0, sizeof(st.idOutCmd));
+
+          if ( DoIDENTIFY (st, hPhysicalDriveIOCTL, 
+                     &scip, 
+                     (PSENDCMDOUTPARAMS)&st.idOutCmd, 
+                     (BYTE) bIDCmd,
+                     (BYTE) drive,
+                     &cbBytesReturned))
           {
-             GETVERSIONOUTPARAMS VersionParams;
-             unsigned __int32    cbBytesReturned = 0;
-
-                // Get the version, etc of PhysicalDrive IOCTL
-             ::memset ((void*) &VersionParams, 0, sizeof(VersionParams));
-
-             if ( ! DeviceIoControl (hPhysicalDriveIOCTL, DFP_GET_VERSION,
-                       NULL, 
-                       0,
-                       &VersionParams,
-                       sizeof(VersionParams),
-                       (LPDWORD)&cbBytesReturned, NULL) )
-             {         
-                  ::_snwprintf( szMsg, sizeof(szMsg)-1, L"DFP_GET_VERSION failed for drive %d\n", drive );
-                  errors.push_back( szMsg );
-                  continue;
-             }
-
-                // If there is a IDE device at number "drive" issue commands
-                // to the device
-             if (VersionParams.bIDEDeviceMap > 0)
-             {
-                BYTE             bIDCmd = 0;   // IDE or ATAPI IDENTIFY cmd
-                SENDCMDINPARAMS  scip;
-                //SENDCMDOUTPARAMS OutCmd;
-
-                // Now, get the ID sector for all IDE devices in the system.
-                   // If the device is ATAPI use the IDE_ATAPI_IDENTIFY command,
-                   // otherwise use the IDE_ATA_IDENTIFY command
-                bIDCmd = (VersionParams.bIDEDeviceMap >> drive & 0x10) ? \
-                          IDE_ATAPI_IDENTIFY : IDE_ATA_IDENTIFY;
-
-                ::memset (&scip, 0, sizeof(scip));
-                ::memset (m_szIdOutCmd, 0, sizeof(m_szIdOutCmd));
-
-                if ( DoIDENTIFY (hPhysicalDriveIOCTL, 
-                           &scip, 
-                           (PSENDCMDOUTPARAMS)&m_szIdOutCmd, 
-                           (BYTE) bIDCmd,
-                           (BYTE) drive,
-                           &cbBytesReturned))
-                {
-                   unsigned __int32 diskdata [256] = {0};
-                   USHORT *pIdSector = (USHORT *)((PSENDCMDOUTPARAMS) m_szIdOutCmd) -> bBuffer;
-
-                   for( int ijk = 0; ijk < 256; ijk++ )
-                   {
-                      diskdata [ijk] = pIdSector [ijk];
-                   }
-                   disk_t _disk;
-                   done = GetIdeInfo( drive, diskdata, _disk );
-
-                   if( done )
-                   {
-                       lst_disk.push_back( _disk );
-                   }
-                }
-            }
-            CloseHandle (hPhysicalDriveIOCTL);
+             ProbeStatScope timer( m_pStats, PROBE_PHASE_PARSE, st.nDevice );
+             done = GetIdeInfo( drive, ((PSENDCMDOUTPARAMS) st.idOutCmd) -> bBuffer, _disk );
+             st.bSerialFound = st.bSerialFound || plausibleSerial( _disk.serial, sizeof(_disk.serial) );
           }
        }
-
+       if( !done )
+       {
+           markUnsupported( st, device, PROBE_NO_SMART );
+       }
        return done;
     }
     //----------------------------------------------------------------------------------------------------------------------
@@ -347,7 +565,9 @@ typedef enum _STORAGE_QUERY_TYPE
 typedef enum _STORAGE_PROPERTY_ID 
 {
     StorageDeviceProperty = 0,
-    StorageAdapterProperty
+    StorageAdapterProperty,
+    StorageAdapterProtocolSpecificProperty = 49,
+    StorageDeviceProtocolSpecificProperty = 50
 } STORAGE_PROPERTY_ID, *PSTORAGE_PROPERTY_ID;
 
 //
@@ -378,9 +598,6 @@ typedef struct _STORAGE_PROPERTY_QUERY {
 } STORAGE_PROPERTY_QUERY, *PSTORAGE_PROPERTY_QUERY;
 
 
-#define IOCTL_STORAGE_QUERY_PROPERTY   CTL_CODE(IOCTL_STORAGE_BASE, 0x0500, METHOD_BUFFERED, FILE_ANY_ACCESS)
-
-
 //
 // Device property descriptor - this is really just a rehash of the inquiry
 // data retrieved from a scsi device
@@ -487,202 +704,261 @@ typedef struct _STORAGE_DEVICE_DESCRIPTOR
 } STORAGE_DEVICE_DESCRIPTOR, *PSTORAGE_DEVICE_DESCRIPTOR;
 
 
+//
+// Protocol specific data of StorageAdapterProtocolSpecificProperty and
+// StorageDeviceProtocolSpecificProperty (Windows 10): follows the query header
+// on input and the descriptor header on output.  For NVMe Identify the request
+// value is the CNS and the sub value the NSID.
+//
+
+#define  DISK_BUS_NVME              17      // BusTypeNvme
+#define  DISK_PROTOCOL_NVME         3       // ProtocolTypeNvme
+#define  DISK_NVME_DATA_IDENTIFY    1       // NVMeDataTypeIdentify
+
+typedef struct _STORAGE_PROTOCOL_SPECIFIC_DATA 
+{
+    ULONG ProtocolType;
+    ULONG DataType;
+    ULONG ProtocolDataRequestValue;
+    ULONG ProtocolDataRequestSubValue;
+
+    //
+    // Offset of the data buffer from the start of this structure, and its size
+    //
+
+    ULONG ProtocolDataOffset;
+    ULONG ProtocolDataLength;
+
+    ULONG FixedProtocolReturnData;
+    ULONG Reserved[3];
+
+} STORAGE_PROTOCOL_SPECIFIC_DATA, *PSTORAGE_PROTOCOL_SPECIFIC_DATA;
+
+typedef struct _STORAGE_PROTOCOL_DATA_DESCRIPTOR 
+{
+    ULONG Version;
+    ULONG Size;
+    STORAGE_PROTOCOL_SPECIFIC_DATA ProtocolSpecificData;
+
+} STORAGE_PROTOCOL_DATA_DESCRIPTOR, *PSTORAGE_PROTOCOL_DATA_DESCRIPTOR;
+
+
     //--------------------------------------------------------------------------------------------------------
-    //  function to decode the serial numbers of IDE hard drives
-    //  using the IOCTL_STORAGE_QUERY_PROPERTY command 
-    char * DiskInfo::FlipAndCodeBytes ( char * str )
+       // Storage descriptor: vendor, product, revision and serial of the drive and the bus it hangs on.
+       // Answered on a handle opened with no access rights.
+    bool DiskInfo::queryDescriptor( probe_state_t &st, void *hPhysicalDriveIOCTL, const device_t &device, disk_t &disk, int &busType ) const
     {
-        if( nullptr == str )
-        {
-            return nullptr;
-        }
-        const size_t num = ::strlen( str );
+       STORAGE_PROPERTY_QUERY query;
+       DWORD cbBytesReturned = 0;
+       char *buffer = st.ioBuffer;
 
-        ::memset( m_flipped, '\0', sizeof(m_flipped) );
+       ::memset( st.ioBuffer, 0, sizeof(st.ioBuffer) );
 
-        for( size_t i = 0; i < num; i += 4 )
-        {
-            for( int j = 1; j >= 0; j-- )
-            {
-                size_t sum = 0;
+       ::memset ((void *) & query, 0, sizeof (query));
 
-                for( int k = 0; k < 2; k++ )
-                {
-                    sum *= 16;
-                    switch (str [i + j * 2 + k])
-                    {
-                    case '0': sum += 0; break;
-                    case '1': sum += 1; break;
-                    case '2': sum += 2; break;
-                    case '3': sum += 3; break;
-                    case '4': sum += 4; break;
-                    case '5': sum += 5; break;
-                    case '6': sum += 6; break;
-                    case '7': sum += 7; break;
-                    case '8': sum += 8; break;
-                    case '9': sum += 9; break;
-                    case 'a': sum += 10; break;
-                    case 'b': sum += 11; break;
-                    case 'c': sum += 12; break;
-                    case 'd': sum += 13; break;
-                    case 'e': sum += 14; break;
-                    case 'f': sum += 15; break;
-                    case 'A': sum += 10; break;
-                    case 'B': sum += 11; break;
-                    case 'C': sum += 12; break;
-                    case 'D': sum += 13; break;
-                    case 'E': sum += 14; break;
-                    case 'F': sum += 15; break;
-                    }
-                }
-                if (sum > 0) 
-                {
-                    char sub [2] = { (char) sum, 0 };
+       query.PropertyId = StorageDeviceProperty;
+       query.QueryType = PropertyStandardQuery;
 
-                    ::strcat( m_flipped, sub );
-                }
-            }
-        }
+       if ( ! ioControl (st, hPhysicalDriveIOCTL, IOCTL_STORAGE_QUERY_PROPERTY,
+                 & query,
+                 sizeof (query),
+                 buffer,
+                 sizeof (st.ioBuffer),
+                 & cbBytesReturned) )
+       {
+            diagnose( PROBE_OP_QUERY_PROPERTY, device.index, ::GetLastError() );
+            return false;
+       }
+       ProbeStatScope timer( m_pStats, PROBE_PHASE_PARSE, st.nDevice );
+       STORAGE_DEVICE_DESCRIPTOR * descrip = (STORAGE_DEVICE_DESCRIPTOR *) buffer;
+       char serialNumber [255] = {0};
+       char modelNumber [255]  = {0};
+
+       char        *flipped = st.textBuffer;
+       const char  *ptrHex  = &buffer[descrip->SerialNumberOffset];
+       hexFlipDecode( ptrHex, ::strnlen( ptrHex, sizeof(st.ioBuffer) - descrip->SerialNumberOffset ), flipped, sizeof(st.textBuffer) );
+
+       const char *ptrSN = flipped + countLeadingBlanks( flipped, ::strnlen( flipped, 255 ) );
+       ::strncpy ( serialNumber, ptrSN, sizeof(serialNumber)-1 );
+
+       const char *ptrNM = &buffer[descrip->ProductIdOffset];
+       ptrNM += countLeadingBlanks( ptrNM, ::strnlen( ptrNM, 255 ) );
+       ::strncpy( modelNumber, ptrNM, sizeof(modelNumber)-1 );
+
+       if( plausibleSerial( serialNumber, sizeof(serialNumber) ) )
+       {
+          st.bSerialFound = true;
+       }
+
+       disk.num_controller = device.index;
+//          char size[64] = {0};
 
-        return m_flipped;
+       ::strncpy( disk.vendor,    &buffer [descrip->VendorIdOffset],        sizeof(disk.vendor) );
+       ::strncpy( disk.model,     &buffer [descrip->ProductIdOffset],       sizeof(disk.model) );
+       ::strncpy( disk.revision,  &buffer [descrip->ProductRevisionOffset], sizeof(disk.revision) );
+       ::strncpy( disk.serial,     serialNumber,                            sizeof(disk.serial) );
+//          ::strncpy( size,      &buffer[descrip->Size],                   sizeof(size) );
+
+       busType = descrip->BusType;
+       return true;
     }
-    //--------------------------------------------------------------------------------------------------------
-    bool DiskInfo::ReadPhysicalDriveInNTWithZeroRights( std::vector<disk_t> &lst_disk )
+    //----------------------------------------------------------------------------------------------------------------------
+       // vendor, model and serial: what tells one medium in a drive from the next; built in identity,
+       // the string of the probe state, whose storage is reused from call to call
+    static const std::string &mediumIdentity( const disk_t &disk, std::string &identity )
     {
-       bool done = false;
-       lst_disk.clear();
+        identity.assign( disk.vendor, ::strnlen( disk.vendor, sizeof(disk.vendor) ) ).append( 1, '|' )
+                .append( disk.model,  ::strnlen( disk.model,  sizeof(disk.model) ) ).append( 1, '|' )
+                .append( disk.serial, ::strnlen( disk.serial, sizeof(disk.serial) ) );
+        return identity;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // One NVMe Identify through the protocol specific property of the drive.  data points into
+       // st.ioBuffer and is valid until the next request.
+    bool DiskInfo::queryNvmeIdentify( probe_state_t &st, void *hPhysicalDriveIOCTL, unsigned long cns, unsigned long nsid,
+                                      const unsigned __int8 *&data ) const
+    {
+       struct nvme_query_t
+       {
+           STORAGE_PROPERTY_ID             PropertyId;
+           STORAGE_QUERY_TYPE              QueryType;
+           STORAGE_PROTOCOL_SPECIFIC_DATA  protocol;
+           unsigned __int8                 data[NVME_IDENTIFY_SIZE];
+       };
+       static_assert( sizeof(nvme_query_t) <= DISK_REQUEST_BUFFER_SIZE, "NVMe query larger than the request buffer" );
+
+       const DWORD   cbHeader        = offsetof(STORAGE_PROTOCOL_DATA_DESCRIPTOR, ProtocolSpecificData);
+       nvme_query_t &query           = *(nvme_query_t *) st.requestBuffer;
+       DWORD         cbBytesReturned = 0;
+
+       ::memset( &query, 0, sizeof(query) );
+       ::memset( st.ioBuffer, 0, sizeof(st.ioBuffer) );
+
+       query.PropertyId                           = StorageDeviceProtocolSpecificProperty;
+       query.QueryType                            = PropertyStandardQuery;
+       query.protocol.ProtocolType                = DISK_PROTOCOL_NVME;
+       query.protocol.DataType                    = DISK_NVME_DATA_IDENTIFY;
+       query.protocol.ProtocolDataRequestValue    = cns;
+       query.protocol.ProtocolDataRequestSubValue = nsid;
+       query.protocol.ProtocolDataOffset          = sizeof(STORAGE_PROTOCOL_SPECIFIC_DATA);
+       query.protocol.ProtocolDataLength          = NVME_IDENTIFY_SIZE;
+
+       if( !ioControl( st, hPhysicalDriveIOCTL, IOCTL_STORAGE_QUERY_PROPERTY, &query, sizeof(query),
+                       st.ioBuffer, cbHeader + sizeof(STORAGE_PROTOCOL_SPECIFIC_DATA) + NVME_IDENTIFY_SIZE, &cbBytesReturned ) )
+       {
+           return false;
+       }
+       const STORAGE_PROTOCOL_DATA_DESCRIPTOR *descrip = (const STORAGE_PROTOCOL_DATA_DESCRIPTOR *) st.ioBuffer;
+       const DWORD offset = descrip->ProtocolSpecificData.ProtocolDataOffset;
 
-       for( int drive = 0; drive < MAX_IDE_DRIVES; drive++)
+       if( cbBytesReturned < cbHeader + sizeof(STORAGE_PROTOCOL_SPECIFIC_DATA) ||
+           offset < sizeof(STORAGE_PROTOCOL_SPECIFIC_DATA) ||
+           descrip->ProtocolSpecificData.ProtocolDataLength < NVME_IDENTIFY_SIZE ||
+           cbHeader + offset + NVME_IDENTIFY_SIZE > cbBytesReturned )
        {
-          HANDLE hPhysicalDriveIOCTL = 0;
-         wchar_t szMsg[512] = {0};
+           ::SetLastError( ERROR_INVALID_DATA );
+           return false;
+       }
+       data = (const unsigned __int8 *) st.ioBuffer + cbHeader + offset;
+       return true;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // Model, serial and firmware of an NVMe drive from Identify Controller, which the descriptor
+       // often lacks (its serial is the EUI-64 on many drivers), and the size from Identify Namespace.
+       // The namespace is the drive's own: stornvme puts NSID n at LUN n-1.  This changes the record
+       // and with it the legacy duuid of the drive, hence DSK_VERSION 5.
+    bool DiskInfo::identifyNvme( probe_state_t &st, void *hPhysicalDriveIOCTL, const device_t &device, disk_t &disk ) const
+    {
+       const std::string     &identity = mediumIdentity( disk, st.identity );
+       const unsigned __int8 *data     = nullptr;
 
-             //  Try to get a handle to PhysicalDrive IOCTL, report failure
-             //  and exit if can't.
-          wchar_t driveName [256] = {0};
+       if( knownUnsupported( device, PROBE_NO_NVME_IDENTIFY, identity ) )
+       {
+           return false;
+       }
+       if( !queryNvmeIdentify( st, hPhysicalDriveIOCTL, NVME_CNS_CONTROLLER, 0, data ) )
+       {
+           diagnose( PROBE_OP_NVME_IDENTIFY, device.index, ::GetLastError() );
+           markUnsupported( st, device, PROBE_NO_NVME_IDENTIFY, identity );
+           return false;
+       }
+       {
+           ProbeStatScope           timer( m_pStats, PROBE_PHASE_PARSE, st.nDevice );
+           const NvmeControllerView id( data );
 
-          ::_snwprintf( driveName, _countof(driveName)-1, L"\\\\.\\PhysicalDrive%d", drive );
+           if( id.model().length > 0 )
+           {
+               id.model().copyTo( disk.model, sizeof(disk.model) );
+           }
+           if( id.serial().length > 0 )
+           {
+               id.serial().copyTo( disk.serial, sizeof(disk.serial) );
+               st.bSerialFound = st.bSerialFound || plausibleSerial( disk.serial, sizeof(disk.serial) );
+           }
+           if( id.firmware().length > 0 )
+           {
+               id.firmware().copyTo( disk.revision, sizeof(disk.revision) );
+           }
+       }
 
-             //  Windows NT, Windows 2000, Windows XP - admin rights not required
-          hPhysicalDriveIOCTL = CreateFileW (driveName, 0,
-                                   FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
-                                   OPEN_EXISTING, 0, NULL);
-          if (hPhysicalDriveIOCTL == INVALID_HANDLE_VALUE)
-          {
-              _snwprintf( szMsg, _countof(szMsg)-1,
-                  L"Unable to open physical drive %d, error code: 0x%lX", drive, GetLastError () );
-              errors.push_back( szMsg );
-          }
+       SCSI_ADDRESS address;
+       DWORD        cbBytesReturned = 0;
 
-          if( hPhysicalDriveIOCTL != INVALID_HANDLE_VALUE )
-          {
-             STORAGE_PROPERTY_QUERY query;
-             DWORD cbBytesReturned = 0;
-             char buffer [16000] = {0};
-
-             ::memset ((void *) & query, 0, sizeof (query));
-
-             query.PropertyId = StorageDeviceProperty;
-             query.QueryType = PropertyStandardQuery;
-
-             ::memset( buffer, 0, sizeof (buffer) );
-
-             if ( DeviceIoControl (hPhysicalDriveIOCTL, IOCTL_STORAGE_QUERY_PROPERTY,
-                       & query,
-                       sizeof (query),
-                       & buffer,
-                       sizeof (buffer),
-                       & cbBytesReturned, NULL) )
-             {         
-                 STORAGE_DEVICE_DESCRIPTOR * descrip = (STORAGE_DEVICE_DESCRIPTOR *) & buffer;
-                 char serialNumber [255] = {0};
-                 char modelNumber [255]  = {0};
-
-                 char* ptrSN = FlipAndCodeBytes( &buffer[descrip->SerialNumberOffset] );
-                 for( size_t i = 0; i < 255 && ' ' == *ptrSN; i++, ++ptrSN ){}
-                 ::strncpy ( serialNumber, ptrSN, sizeof(serialNumber)-1 );
-
-                 char* ptrNM = &buffer[descrip->ProductIdOffset];
-                 for( size_t i = 0; i < 255 && ' ' == *ptrNM; i++, ++ptrNM ){}
-                 ::strncpy( modelNumber, ptrNM, sizeof(modelNumber)-1 );
-
-                 if( 0 == *m_szHardDriveSerialNumber &&
-                            //  serial number must be alphanumeric
-                            //  (but there can be leading spaces on IBM drives)
-                       ( ::isalnum(serialNumber[0]) || ::isalnum(serialNumber[19])))
-                 {
-                    ::strcpy( m_szHardDriveSerialNumber, serialNumber );
-                    ::strcpy( m_szHardDriveModelNumber,  modelNumber );
-                    done = TRUE;
-                 }
-
-                 disk_t disk;
-                 disk.num_controller = drive;
-//                 char size[64] = {0};
-
-                 ::strncpy( disk.vendor,    &buffer [descrip->VendorIdOffset],        sizeof(disk.vendor) );
-                 ::strncpy( disk.model,     &buffer [descrip->ProductIdOffset],       sizeof(disk.model) );
-                 ::strncpy( disk.revision,  &buffer [descrip->ProductRevisionOffset], sizeof(disk.revision) );
-                 ::strncpy( disk.serial,     serialNumber,                            sizeof(disk.serial) );
-//                 ::strncpy( size,      &buffer[descrip->Size],                   sizeof(size) );
-
-                 lst_disk.push_back( disk );
-             }
-             else
-             {
-                  _snwprintf( szMsg, sizeof(szMsg)-1,
-                      L"DeviceIOControl IOCTL_STORAGE_QUERY_PROPERTY error = %d", GetLastError () );
-                  errors.push_back( szMsg );
-             }
-             ::memset( buffer, 0, sizeof (buffer) );
-
-             if ( DeviceIoControl (hPhysicalDriveIOCTL, IOCTL_STORAGE_GET_MEDIA_SERIAL_NUMBER,
-                       NULL,
-                       0,
-                       & buffer,
-                       sizeof (buffer),
-                       & cbBytesReturned, NULL) )
-             {         
-                 MEDIA_SERIAL_NUMBER_DATA * mediaSerialNumber = 
-                                (MEDIA_SERIAL_NUMBER_DATA *) & buffer;
-                 char serialNumber [1000] = {0};
-
-                 strncpy( serialNumber, (char *) mediaSerialNumber -> SerialNumberData, sizeof(serialNumber)-1 );
-
-                 if (0 == m_szHardDriveSerialNumber [0] &&
-                            //  serial number must be alphanumeric
-                            //  (but there can be leading spaces on IBM drives)
-                       (isalnum (serialNumber [0]) || isalnum (serialNumber [19])))
-                 {
-                    ::strncpy( m_szHardDriveSerialNumber, serialNumber, sizeof(m_szHardDriveSerialNumber)-1 );
-                    done = true;
-                 }
-             }
-             else
-             {
-                 DWORD err = GetLastError ();
-    
-                 switch (err)
-                 {
-                 case 1: 
-                 _snwprintf( szMsg, sizeof(szMsg)-1, L"DeviceIOControl IOCTL_STORAGE_GET_MEDIA_SERIAL_NUMBER error = %d The request is not valid for this device.", 
-                     GetLastError () );
-                     break;
-                 case 50:
-                 _snwprintf( szMsg, sizeof(szMsg)-1, L"DeviceIOControl IOCTL_STORAGE_GET_MEDIA_SERIAL_NUMBER error = %d The request is not supported for this device.", 
-                     GetLastError () );
-                     break;
-                 default:
-                 _snwprintf( szMsg, sizeof(szMsg)-1, L"DeviceIOControl IOCTL_STORAGE_GET_MEDIA_SERIAL_NUMBER error = %d", 
-                     GetLastError () );
-                 }
-                 errors.push_back( szMsg );
-    
-             }
-             CloseHandle (hPhysicalDriveIOCTL);
-          }
+       ::memset( &address, 0, sizeof(address) );
+       if( ioControl( st, hPhysicalDriveIOCTL, IOCTL_SCSI_GET_ADDRESS, NULL, 0, &address, sizeof(address), &cbBytesReturned ) &&
+           queryNvmeIdentify( st, hPhysicalDriveIOCTL, NVME_CNS_NAMESPACE, address.Lun + 1UL, data ) )
+       {
+           ProbeStatScope          timer( m_pStats, PROBE_PHASE_PARSE, st.nDevice );
+           const NvmeNamespaceView ns( data );
+
+           disk.size    = ns.size();
+           disk.sectors = disk.size / 512;
        }
+       return true;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // most drives reject the media serial request; once they have, it is not sent to the same medium again
+    bool DiskInfo::readMediaSerial( probe_state_t &st, void *hPhysicalDriveIOCTL, const device_t &device, const std::string &identity ) const
+    {
+       bool done = false;
+       DWORD cbBytesReturned = 0;
+       char *buffer = st.ioBuffer;
 
+       if( knownUnsupported( device, PROBE_NO_MEDIA_SERIAL, identity ) )
+       {
+           return false;
+       }
+       ::memset( st.ioBuffer, 0, sizeof(st.ioBuffer) );
+       if ( ioControl (st, hPhysicalDriveIOCTL, IOCTL_STORAGE_GET_MEDIA_SERIAL_NUMBER,
+                 NULL,
+                 0,
+                 buffer,
+                 sizeof (st.ioBuffer),
+                 & cbBytesReturned) )
+       {         
+           MEDIA_SERIAL_NUMBER_DATA * mediaSerialNumber = 
+                          (MEDIA_SERIAL_NUMBER_DATA *) buffer;
+           char *serialNumber = st.textBuffer;
+
+           ::strncpy( serialNumber, (char *) mediaSerialNumber -> SerialNumberData, sizeof(st.textBuffer)-1 );
+           serialNumber[sizeof(st.textBuffer)-1] = '\0';
+
+           if( plausibleSerial( serialNumber, sizeof(st.textBuffer) ) )
+           {
+              st.bSerialFound = true;
+              done = true;
+           }
+       }
+       else
+       {
+           DWORD err = GetLastError ();
+ 
+           if( ERROR_INVALID_FUNCTION == err || ERROR_NOT_SUPPORTED == err )
+           {
+               markUnsupported( st, device, PROBE_NO_MEDIA_SERIAL, identity );
+           }
+           diagnose( PROBE_OP_MEDIA_SERIAL, device.index, err );
+       }
        return done;
     }
 //  -----------------------------------------------------------------------------------------------------------------
@@ -693,221 +969,428 @@ typedef struct _STORAGE_DEVICE_DESCRIPTOR
 
 
 //  ----------------------------------------------------------------------------------------------
-    bool DiskInfo::ReadIdeDriveAsScsiDriveInNT( vector<disk_t> &lst_disk )
+    bool DiskInfo::ReadIdeDriveAsScsiDriveInNT( disk_span_t &out, std::vector<disk_t> *pStorage, probe_report_t &report,
+                                                unsigned long dwCallDeadline ) const
     {
-       bool done = false;
+       ScratchHold< std::vector<device_t> > ports( m_pScratch->deviceLists );
+       listDevices( true, *ports );
 
-       lst_disk.clear();
+       return runProbes( &DiskInfo::probeScsiPort, *ports, out, pStorage, report, dwCallDeadline );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // both drives (master/slave) behind one SCSI miniport
+    bool DiskInfo::probeScsiPort( probe_state_t &st, const device_t &device, disk_span_t &out, bool & ) const
+    {
+       bool done = false;
+       const int controller = device.index;
+       void *hScsiDriveIOCTL = nullptr;
+       unsigned long err = ERROR_SUCCESS;
 
-       for( int controller = 0; controller < 16; controller++ )
+       if( knownUnsupported( device, PROBE_NO_MINIPORT ) )
+       {
+           return false;
+       }
+          //  Windows NT, Windows 2000, any rights should do
+       {
+          ProbeStatScope timer( m_pStats, PROBE_PHASE_OPEN, controller );
+          hScsiDriveIOCTL = io().open( device.path, DEVICE_IO_READ_WRITE, m_bTimed, err );
+       }
+       if( nullptr == hScsiDriveIOCTL )
        {
-          HANDLE hScsiDriveIOCTL = 0;
-          wchar_t   driveName [256] = {0};
+           diagnose( PROBE_OP_OPEN_PORT, controller, err );
+       }
 
-             //  Try to get a handle to PhysicalDrive IOCTL, report failure
-             //  and exit if can't.
-          _snwprintf( driveName, sizeof(driveName)-1, L"\\\\.\\Scsi%d:", controller );
+       if (hScsiDriveIOCTL != nullptr)
+       {
+          for( int drive = 0; drive < 2; drive++ )
+          {
+             disk_t _disk;
 
-             //  Windows NT, Windows 2000, any rights should do
-          hScsiDriveIOCTL = CreateFileW( driveName,
-                                   GENERIC_READ | GENERIC_WRITE, 
-                                   FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
-                                   OPEN_EXISTING, 0, NULL);
-          if( hScsiDriveIOCTL == INVALID_HANDLE_VALUE )
+             if( identifyMiniport( st, hScsiDriveIOCTL, controller, drive, _disk ) )
+             {
+                 out.push( _disk );
+                 done = true;
+             }
+          }
+          if( !done )
           {
-              wchar_t szMsg[512] = {0};
-              _snwprintf( szMsg, sizeof(szMsg)-1,
-                  L"Unable to open SCSI controller %d, error code: 0x%lX", controller, GetLastError () );
-              errors.push_back( szMsg );
+              markUnsupported( st, device, PROBE_NO_MINIPORT );
           }
+          io().close( hScsiDriveIOCTL );
+       }
 
-          if (hScsiDriveIOCTL != INVALID_HANDLE_VALUE)
+       return done;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // IDENTIFY of drive 0 (master) or 1 (slave) through the SCSI miniport backdoor into the IDE drives
+    bool DiskInfo::identifyMiniport( probe_state_t &st, void *hScsiDriveIOCTL, int controller, int drive, disk_t &_disk ) const
+    {
+       char buffer [sizeof (SRB_IO_CONTROL) + SENDIDLENGTH];
+       SRB_IO_CONTROL *p = (SRB_IO_CONTROL *) buffer;
+       SENDCMDINPARAMS *pin =
+              (SENDCMDINPARAMS *) (buffer + sizeof (SRB_IO_CONTROL));
+       DWORD dummy;
+ 
+       memset (buffer, 0, sizeof (buffer));
+       p -> HeaderLength = sizeof (SRB_IO_CONTROL);
+       p -> Timeout = srbTimeout();
+       p -> Length = SENDIDLENGTH;
+       p -> ControlCode = IOCTL_SCSI_MINIPORT_IDENTIFY;
+       strncpy( (char *)p->Signature, "SCSIDISK", 8 );
+
+       pin -> irDriveRegs.bCommandReg = IDE_ATA_IDENTIFY;
+       pin -> bDriveNumber = (unsigned char)drive;
+
+       if (ioControl (st, hScsiDriveIOCTL, IOCTL_SCSI_MINIPORT, 
+                            buffer,
+                            sizeof (SRB_IO_CONTROL) +
+                                    sizeof (SENDCMDINPARAMS) - 1,
+                            buffer,
+                            sizeof (SRB_IO_CONTROL) + SENDIDLENGTH,
+                            &dummy))
+       {
+          SENDCMDOUTPARAMS *pOut =
+               (SENDCMDOUTPARAMS *) (buffer + sizeof (SRB_IO_CONTROL));
+          IDSECTOR *pId = (IDSECTOR *) (pOut -> bBuffer);
+          ProbeStatScope timer( m_pStats, pId -> sModelNumber [0] ? PROBE_PHASE_PARSE : -1, st.nDevice );
+          if (pId -> sModelNumber [0] && GetIdeInfo (controller * 2 + drive, pId, _disk ))
           {
-             int drive = 0;
-
-             for (drive = 0; drive < 2; drive++)
-             {
-                char buffer [sizeof (SRB_IO_CONTROL) + SENDIDLENGTH];
-                SRB_IO_CONTROL *p = (SRB_IO_CONTROL *) buffer;
-                SENDCMDINPARAMS *pin =
-                       (SENDCMDINPARAMS *) (buffer + sizeof (SRB_IO_CONTROL));
-                DWORD dummy;
-       
-                memset (buffer, 0, sizeof (buffer));
-                p -> HeaderLength = sizeof (SRB_IO_CONTROL);
-                p -> Timeout = 10000;
-                p -> Length = SENDIDLENGTH;
-                p -> ControlCode = IOCTL_SCSI_MINIPORT_IDENTIFY;
-                strncpy( (char *)p->Signature, "SCSIDISK", 8 );
-      
-                pin -> irDriveRegs.bCommandReg = IDE_ATA_IDENTIFY;
-                pin -> bDriveNumber = (unsigned char)drive;
-
-                if (DeviceIoControl (hScsiDriveIOCTL, IOCTL_SCSI_MINIPORT, 
-                                     buffer,
-                                     sizeof (SRB_IO_CONTROL) +
-                                             sizeof (SENDCMDINPARAMS) - 1,
-                                     buffer,
-                                     sizeof (SRB_IO_CONTROL) + SENDIDLENGTH,
-                                     &dummy, NULL))
-                {
-                   SENDCMDOUTPARAMS *pOut =
-                        (SENDCMDOUTPARAMS *) (buffer + sizeof (SRB_IO_CONTROL));
-                   IDSECTOR *pId = (IDSECTOR *) (pOut -> bBuffer);
-                   if (pId -> sModelNumber [0])
-                   {
-                      unsigned __int32 diskdata [256];
-                      int ijk = 0;
-                      USHORT *pIdSector = (USHORT *) pId;
-              
-                      for( ijk = 0; ijk < 256; ijk++ )
-                      {
-                         diskdata [ijk] = pIdSector [ijk];
-                      }
-                       disk_t _disk;
-
-                       done = GetIdeInfo (controller * 2 + drive, diskdata, _disk );
-                       if( done )
-                       {
-                           lst_disk.push_back( _disk );
-                       }
-                   }
-                }
-             }
-             CloseHandle (hScsiDriveIOCTL);
+             st.bSerialFound = st.bSerialFound || plausibleSerial( _disk.serial, sizeof(_disk.serial) );
+             return true;
           }
        }
+       return false;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // Miniport IDENTIFY of an ATA drive, sent to the SCSI port the drive hangs on; the record is the
+       // one the sweep over the ports would have produced for it
+    bool DiskInfo::identifyThroughPort( probe_state_t &st, void *hPhysicalDriveIOCTL, const device_t &device, disk_t &_disk ) const
+    {
+       SCSI_ADDRESS address;
+       DWORD        cbBytesReturned = 0;
+       wchar_t      portName [64]   = {0};
+
+       if( knownUnsupported( device, PROBE_NO_MINIPORT ) )
+       {
+           return false;
+       }
+       ::memset( &address, 0, sizeof(address) );
+       if( !ioControl( st, hPhysicalDriveIOCTL, IOCTL_SCSI_GET_ADDRESS, NULL, 0, &address, sizeof(address), &cbBytesReturned ) ||
+           address.TargetId > 1 )
+       {
+           markUnsupported( st, device, PROBE_NO_MINIPORT );
+           return false;
+       }
+       ::_snwprintf( portName, _countof(portName)-1, L"\\\\.\\Scsi%d:", (int)address.PortNumber );
 
+       void          *hScsiDriveIOCTL = nullptr;
+       unsigned long  err             = ERROR_SUCCESS;
+       {
+           ProbeStatScope timer( m_pStats, PROBE_PHASE_OPEN, st.nDevice );
+           hScsiDriveIOCTL = io().open( portName, DEVICE_IO_READ_WRITE, m_bTimed, err );
+       }
+       if( nullptr == hScsiDriveIOCTL )
+       {
+           return false;
+       }
+       const bool done = identifyMiniport( st, hScsiDriveIOCTL, address.PortNumber, address.TargetId, _disk );
+       if( !done )
+       {
+           markUnsupported( st, device, PROBE_NO_MINIPORT );
+       }
+       io().close( hScsiDriveIOCTL );
        return done;
     }
+    //----------------------------------------------------------------------------------------------------------------------
+       // One pass over one physical drive, replacing the three sweeps that each reopened every drive.
+       // The drive is opened once and its storage descriptor tells the bus; then only the IDENTIFY
+       // that fits is sent:
+       //     ATA / SATA / ATAPI    SMART IDENTIFY (needs read/write access, i.e. admin rights), else
+       //                           the miniport IDENTIFY through the drive's SCSI port
+       //     NVMe                  Identify Controller and Namespace, over the descriptor
+       //     anything else         the descriptor is the record (USB, SAS, RAID ...)
+       // A driver too old for the descriptor query gets SMART only, as the first sweep used to.
+       // ATA records are kept exactly as IDENTIFY fills them, since the legacy duuid is a CRC over
+       // the raw disk_t; the descriptor only stands in when IDENTIFY gives nothing.
+    bool DiskInfo::probePhysicalDrive( probe_state_t &st, const device_t &device, disk_span_t &out, bool & ) const
+    {
+       void           *hDrive      = nullptr;
+       unsigned long   err         = ERROR_SUCCESS;
+       bool    bReadWrite  = false;
+       bool    done        = false;
+
+       if( !knownUnsupported( device, PROBE_NO_SMART ) && !knownUnsupported( device, PROBE_NO_RW_OPEN ) )
+       {
+           ProbeStatScope timer( m_pStats, PROBE_PHASE_OPEN, device.index );
+           hDrive = io().open( device.path, DEVICE_IO_READ_WRITE, m_bTimed, err );
+           bReadWrite = ( nullptr != hDrive );
+           if( !bReadWrite )
+           {
+               if( ERROR_ACCESS_DENIED == err )
+               {
+                   markUnsupported( st, device, PROBE_NO_RW_OPEN );
+               }
+           }
+       }
+          //  Windows NT, Windows 2000, Windows XP - admin rights not required.  Any refusal of the
+          //  read/write open (access, sharing, write protection, a drive not ready) still leaves the
+          //  queries; only a drive that is not there is not asked twice
+       if( nullptr == hDrive && ERROR_FILE_NOT_FOUND != err && ERROR_PATH_NOT_FOUND != err )
+       {
+           ProbeStatScope timer( m_pStats, PROBE_PHASE_OPEN, device.index );
+           hDrive = io().open( device.path, DEVICE_IO_QUERY, m_bTimed, err );
+       }
+       if( nullptr == hDrive )
+       {
+           diagnose( PROBE_OP_OPEN_DRIVE, device.index, err );
+           return false;
+       }
+
+       disk_t     descr;
+       int        busType     = BusTypeUnknown;
+       const bool bDescriptor = queryDescriptor( st, hDrive, device, descr, busType );
+       const bool bAta        = !bDescriptor || BusTypeAta == busType || BusTypeSata == busType || BusTypeAtapi == busType;
+
+       if( bAta && bReadWrite )
+       {
+           disk_t _disk;
+           if( identifyAta( st, hDrive, device, _disk ) )
+           {
+               out.push( _disk );
+               done = true;
+           }
+       }
+       if( !done && bAta && bDescriptor )
+       {
+           disk_t _disk;
+           if( identifyThroughPort( st, hDrive, device, _disk ) )
+           {
+               out.push( _disk );
+               done = true;
+           }
+       }
+       if( !done && bDescriptor )
+       {
+           if( DISK_BUS_NVME == busType )
+           {
+               identifyNvme( st, hDrive, device, descr );
+           }
+           out.push( descr );
+           done = true;
+           if( !st.bSerialFound )
+           {
+               readMediaSerial( st, hDrive, device, mediumIdentity( descr, st.identity ) );
+           }
+       }
+       io().close( hDrive );
+
+       return done;
+    }
+//-------------------------------------------------------------------------------------------------------------------
+DiskInfo::DiskInfo()
+    : m_nMaxParallelProbes( 1 )
+    , m_nDeviceTimeoutMs( 0 )
+    , m_nTotalTimeoutMs( 0 )
+    , m_bTimed( false )
+    , m_pStrategy( nullptr )
+    , m_pDiagnostics( nullptr )
+    , m_pStats( nullptr )
+    , m_pIo( nullptr )
+    , m_pScratch( new probe_scratch_t )
+{
+}
+//-------------------------------------------------------------------------------------------------------------------
+DiskInfo::DiskInfo( const DiskInfo &other )
+    : m_nMaxParallelProbes( other.m_nMaxParallelProbes )
+    , m_nDeviceTimeoutMs( other.m_nDeviceTimeoutMs )
+    , m_nTotalTimeoutMs( other.m_nTotalTimeoutMs )
+    , m_bTimed( other.m_bTimed )
+    , m_pStrategy( other.m_pStrategy )
+    , m_pDiagnostics( other.m_pDiagnostics )
+    , m_pStats( other.m_pStats )
+    , m_pIo( other.m_pIo )
+    , m_pScratch( new probe_scratch_t )
+    , timedOut( other.timedOut )
+    , deviceOf( other.deviceOf )
+{
+}
 //-------------------------------------------------------------------------------------------------------------------
-unsigned __int64 DiskInfo::getHardDriveComputerID( disk_t &_disk )
+DiskInfo &DiskInfo::operator=( const DiskInfo &other )
 {
-   unsigned __int64 id = 0ULL;
+    m_nMaxParallelProbes = other.m_nMaxParallelProbes;
+    m_nDeviceTimeoutMs   = other.m_nDeviceTimeoutMs;
+    m_nTotalTimeoutMs    = other.m_nTotalTimeoutMs;
+    m_bTimed             = other.m_bTimed;
+    m_pStrategy          = other.m_pStrategy;
+    m_pDiagnostics       = other.m_pDiagnostics;
+    m_pStats             = other.m_pStats;
+    m_pIo                = other.m_pIo;
+    timedOut             = other.timedOut;
+    deviceOf             = other.deviceOf;
+    return *this;
+}
+//-------------------------------------------------------------------------------------------------------------------
+DiskInfo::~DiskInfo()
+{
+    delete m_pScratch;
+}
+//-------------------------------------------------------------------------------------------------------------------
+void DiskInfo::setMaxParallelProbes( unsigned nMaxParallel )
+{
+    m_nMaxParallelProbes = ( nMaxParallel < 1 ) ? 1 : nMaxParallel;
+}
+//-------------------------------------------------------------------------------------------------------------------
+void DiskInfo::setStrategy( ProbeStrategy *pStrategy )
+{
+    m_pStrategy = pStrategy;
+}
+//-------------------------------------------------------------------------------------------------------------------
+void DiskInfo::setDiagnostics( ProbeDiagnostics *pDiagnostics )
+{
+    m_pDiagnostics = pDiagnostics;
+}
+//-------------------------------------------------------------------------------------------------------------------
+void DiskInfo::setStats( ProbeStats *pStats )
+{
+    m_pStats = pStats;
+}
+//-------------------------------------------------------------------------------------------------------------------
+void DiskInfo::setDeviceIo( DeviceIo *pIo )
+{
+    m_pIo = pIo;
+}
+//-------------------------------------------------------------------------------------------------------------------
+void DiskInfo::setTimeouts( unsigned long nDeviceTimeoutMs, unsigned long nTotalTimeoutMs )
+{
+    m_nDeviceTimeoutMs = nDeviceTimeoutMs;
+    m_nTotalTimeoutMs  = nTotalTimeoutMs;
+    m_bTimed           = ( 0 != nDeviceTimeoutMs || 0 != nTotalTimeoutMs );
+}
+//-------------------------------------------------------------------------------------------------------------------
+bool DiskInfo::sweep( disk_span_t &out, std::vector<disk_t> *pStorage, probe_report_t &report ) const
+{
+   OSVERSIONINFO version;
+   const unsigned long dwCallDeadline = ::GetTickCount() + m_nTotalTimeoutMs;
 
-   char serial[1024] = {0};
-   strncpy_s( serial, sizeof(serial)-1, _disk.serial, strlen(_disk.serial) );
+   ::memset( &version, 0, sizeof (version) );
+   out.count = 0;
+   report.deviceOf.clear();
+   report.timedOut.clear();
 
-   if( serial[0] > 0 )
+   version.dwOSVersionInfoSize = sizeof (OSVERSIONINFO);
+   GetVersionEx (&version);
+   if( version.dwPlatformId == VER_PLATFORM_WIN32_NT )
    {
-      char *p = serial;
-
-      //  ignore first 5 characters from western digital hard drives if
-      //  the first four characters are WD-W
-      if( !strncmp (serial, "WD-W", 4))
-      { 
-          p += 5;
-      }
-      for( ; p && *p; p++ )
-      {
-         if( '-' == *p )
-         {
-             continue;
-         }
-         id *= 10;
-         switch (*p)
-         {
-            case '0': id += 0; break;
-            case '1': id += 1; break;
-            case '2': id += 2; break;
-            case '3': id += 3; break;
-            case '4': id += 4; break;
-            case '5': id += 5; break;
-            case '6': id += 6; break;
-            case '7': id += 7; break;
-            case '8': id += 8; break;
-            case '9': id += 9; break;
-            case 'a': case 'A': id += 10; break;
-            case 'b': case 'B': id += 11; break;
-            case 'c': case 'C': id += 12; break;
-            case 'd': case 'D': id += 13; break;
-            case 'e': case 'E': id += 14; break;
-            case 'f': case 'F': id += 15; break;
-            case 'g': case 'G': id += 16; break;
-            case 'h': case 'H': id += 17; break;
-            case 'i': case 'I': id += 18; break;
-            case 'j': case 'J': id += 19; break;
-            case 'k': case 'K': id += 20; break;
-            case 'l': case 'L': id += 21; break;
-            case 'm': case 'M': id += 22; break;
-            case 'n': case 'N': id += 23; break;
-            case 'o': case 'O': id += 24; break;
-            case 'p': case 'P': id += 25; break;
-            case 'q': case 'Q': id += 26; break;
-            case 'r': case 'R': id += 27; break;
-            case 's': case 'S': id += 28; break;
-            case 't': case 'T': id += 29; break;
-            case 'u': case 'U': id += 30; break;
-            case 'v': case 'V': id += 31; break;
-            case 'w': case 'W': id += 32; break;
-            case 'x': case 'X': id += 33; break;
-            case 'y': case 'Y': id += 34; break;
-            case 'z': case 'Z': id += 35; break;
-         }                            
-      }
-   }
+       ScratchHold< std::vector<device_t> > devices( m_pScratch->deviceLists );
+       listDevices( false, *devices );
 
-   id %= 100000000ULL;
-   if( strstr( serial, "IBM-") )
-   {
-      id += 300000000ULL;
-   }
-   else if (strstr (serial, "MAXTOR") ||
-            strstr (serial, "Maxtor"))
-   {
-      id += 400000000ULL;
+       runProbes( &DiskInfo::probePhysicalDrive, *devices, out, pStorage, report, dwCallDeadline );
+
+          //  drives that are not exposed as physical drives can still be reached through their port
+       if( 0 == out.count && !budgetSpent( dwCallDeadline ) )
+       {
+           ReadIdeDriveAsScsiDriveInNT( out, pStorage, report, dwCallDeadline );
+       }
    }
-   else if (strstr (serial, "WDC "))
+   return (out.count > 0);
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+bool DiskInfo::getDrivesInfo( disk_span_t &out, probe_report_t &report ) const
+{
+   return sweep( out, nullptr, report );
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+bool DiskInfo::getDrivesInfo( std::vector<disk_t> &_disk, probe_report_t &report ) const
+{
+   disk_span_t out( nullptr, 0 );
+   const bool  done = sweep( out, &_disk, report );
+
+   _disk.resize( out.stored() );
+   return done;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+bool DiskInfo::getDrivesInfo( int nFirst, int nLast, std::vector<disk_t> &_disk, probe_report_t &report ) const
+{
+   ScratchHold< std::vector<device_t> > devices( m_pScratch->deviceLists );
+   ScratchHold< std::vector<device_t> > wanted( m_pScratch->deviceLists );
+   size_t                               nWanted = 0;
+   disk_span_t                          out( nullptr, 0 );
+
+   report.deviceOf.clear();
+   report.timedOut.clear();
+
+   listDevices( false, *devices );
+   for( size_t d = 0; d < devices->size(); d++ )
    {
-      id += 500000000ULL;
+       if( (*devices)[d].index >= nFirst && (*devices)[d].index <= nLast )
+       {
+           nextDevice( *wanted, nWanted ) = (*devices)[d];
+       }
    }
-   else
+   wanted->resize( nWanted );
+   const bool done = runProbes( &DiskInfo::probePhysicalDrive, *wanted, out, &_disk, report, ::GetTickCount() + m_nTotalTimeoutMs );
+
+   _disk.resize( out.stored() );
+   return done;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+bool DiskInfo::getDriveInfo( const device_t &device, disk_span_t &out, probe_report_t &report ) const
+{
+   bool                       abort = false;
+   ScratchHold<probe_state_t> st( m_pScratch->states );
+
+   st->reset( ::GetTickCount() + m_nTotalTimeoutMs );
+   out.count = 0;
+   report.deviceOf.clear();
+   report.timedOut.clear();
+
+   beginDevice( *st, device );
+   const bool done = probePhysicalDrive( *st, device, out, abort );
+
+   if( st->bDeviceTimedOut )
    {
-      id += 600000000ULL;
+       reportTimedOut( report, device );
    }
-   return id;
+   report.deviceOf.assign( out.stored(), device.index );
+   return done;
 }
 
-DiskInfo::DiskInfo()
+//-------------------------------------------------------------------------------------------------------------------
+bool DiskInfo::getDriveInfo( const device_t &device, std::vector<disk_t> &_disk, probe_report_t &report ) const
 {
-    ::memset( m_szIdOutCmd,              0x00, sizeof(m_szIdOutCmd) );
-    ::memset( m_szHardDriveSerialNumber, '\0', sizeof(m_szHardDriveSerialNumber) );
-    ::memset( m_szHardDriveModelNumber,  '\0', sizeof(m_szHardDriveModelNumber) );
-    ::memset( m_flipped,                 '\0', sizeof(m_flipped) );
-    ::memset( m_cv,                      '\0', sizeof(m_cv) );
+   _disk.resize( PROBE_DRIVE_RECORDS );
+
+   disk_span_t out( _disk.data(), _disk.size() );
+   const bool  done = getDriveInfo( device, out, report );
+
+   _disk.resize( out.stored() );
+   return done;
 }
+
 //-------------------------------------------------------------------------------------------------------------------
 bool DiskInfo::getDrivesInfo( std::vector<disk_t> &_disk )
 {
-   bool done = false;
-   OSVERSIONINFO version;
+   probe_report_t report;
+   const bool     done = getDrivesInfo( _disk, report );
 
-   ::memset( &version, 0, sizeof (version) );
-   _disk.clear();
-   *m_szHardDriveSerialNumber = '\0';
+   timedOut.swap( report.timedOut );
+   deviceOf.swap( report.deviceOf );
+   return done;
+}
 
-   version.dwOSVersionInfoSize = sizeof (OSVERSIONINFO);
-   GetVersionEx (&version);
-   if( version.dwPlatformId == VER_PLATFORM_WIN32_NT )
-   {
-          //  this works under WinNT4 or Win2K if you have admin rights
-        done = ReadPhysicalDriveInNTWithAdminRights( _disk );
+//-------------------------------------------------------------------------------------------------------------------
+bool DiskInfo::getDriveInfo( const device_t &device, std::vector<disk_t> &_disk )
+{
+   probe_report_t report;
+   const bool     done = getDriveInfo( device, _disk, report );
 
-        //  this should work in WinNT or Win2K if previous did not work
-        //  this is kind of a backdoor via the SCSI mini port driver into
-        //     the IDE drives
-        if( ! done ) 
-        {
-            done = ReadIdeDriveAsScsiDriveInNT( _disk );
-        }
-        //  this works under WinNT4 or Win2K or WinXP if you have any right
-        if( !done )
-        {
-            done = ReadPhysicalDriveInNTWithZeroRights( _disk );
-        }
-   }
-   return (_disk.size() > 0);
+   timedOut.swap( report.timedOut );
+   deviceOf.swap( report.deviceOf );
+   return done;
 }
 
 };
-
@@ -27,9 +27,13 @@
 #ifndef __Utils_IPS_
 #define __Utils_IPS_
 
+#include <string.h>
+
 #include <vector>
 #include <string>
 
+#include "hash128.h"
+
 #define WINDOWS_KEY_LENGTH    30    // "XXXXX-XXXXX-XXXXX-XXXXX-XXXXX\x0"
 
 namespace Utils
@@ -57,6 +61,57 @@ namespace Utils
         disk_t(){ ::memset( this, 0x00, sizeof(disk_t) ); };
     };
 
+       //  Canonical identity of a drive: version byte, then model, serial and revision with leading
+       //  and trailing blanks removed (each as a length byte plus the characters), then sectors as
+       //  8 little-endian bytes.  Nothing else from disk_t takes part, so the result does not depend
+       //  on struct layout, padding or which probe method filled the record.
+#define  DISK_FINGERPRINT_VERSION   1
+#define  DISK_FINGERPRINT_MAX_SIZE  (1 + 3 * (1 + 255) + 8)
+
+    enum fingerprint_kind_t
+    {
+        FINGERPRINT_CRC64   = 0,    // CRC-64/XZ of the canonical form, in fingerprint_t::lo
+        FINGERPRINT_HASH128 = 1     // 128-bit MurmurHash3 of the canonical form
+    };
+
+    typedef hash128_t fingerprint_t;
+
+    struct device_t;
+    class  ProbeStrategy;
+    class  ProbeDiagnostics;
+    class  ProbeStats;
+    class  DeviceIo;
+
+       //  Storage the caller provides for the records of a probe call.  push() stores a record while
+       //  there is room and counts every one, so after the call count is the capacity the call
+       //  needed; records past capacity are dropped.
+    struct disk_span_t
+    {
+        disk_t  *data;
+        size_t   capacity;
+        size_t   count;
+
+        disk_span_t( disk_t *pData, size_t nCapacity ) : data( pData ), capacity( nCapacity ), count( 0 ) {}
+
+        size_t  stored() const              { return ( count < capacity ) ? count : capacity; }
+        void    push( const disk_t &disk )
+        {
+            if( count < capacity )
+            {
+                data[count] = disk;
+            }
+            count++;
+        }
+    };
+
+       //  What a probe call reports besides the records; failures are recorded in the diagnostics
+       //  ring instead (see setDiagnostics())
+    struct probe_report_t
+    {
+        std::vector<int>             timedOut;      // devices skipped for missing a deadline
+        std::vector<int>             deviceOf;      // physical drive of each stored record, -1 if found through a SCSI port
+    };
+
     class DiskInfo
     {
         private:
@@ -114,7 +169,8 @@ namespace Utils
             {
                unsigned __int32         cBufferSize;   //  Size of bBuffer in bytes
                DRIVERSTATUS  DriverStatus;  //  Driver status structure.
-               unsigned __int8          bBuffer[1];    //  Buffer of arbitrary length in which to store the data read from the                                                       // drive.
+               unsigned __int8          bBuffer[1];    //  Buffer of arbitrary length in which to store the data
+                                                       //  read from the drive.
             } SENDCMDOUTPARAMS, *PSENDCMDOUTPARAMS, *LPSENDCMDOUTPARAMS;
 
                // The following struct defines the interesting part of the IDENTIFY
@@ -198,35 +254,147 @@ namespace Utils
               unsigned long  SerialNumberData[1];
             } MEDIA_SERIAL_NUMBER_DATA, *PMEDIA_SERIAL_NUMBER_DATA;
 
+               //  IOCTL_SCSI_GET_ADDRESS output (ntddscsi.h)
+            typedef struct _SCSI_ADDRESS
+            {
+               unsigned long  Length;
+               unsigned char  PortNumber;
+               unsigned char  PathId;
+               unsigned char  TargetId;
+               unsigned char  Lun;
+            } SCSI_ADDRESS, *PSCSI_ADDRESS;
+
 #pragma pack(pop)
 
-            void WriteConstantString (char *entry, char *string){ (string); (entry); }
-            char *ConvertToString( unsigned __int32 diskdata[256], int firstIndex, int lastIndex );
-            bool ReadPhysicalDriveInNTWithAdminRights( std::vector<disk_t> &_disk );
+            void WriteConstantString (char *entry, char *string){ (void)string; (void)entry; }
             bool ReadDrivePortsInWin9X( std::vector<disk_t> &disk );
-            bool GetIdeInfo( const int drive, unsigned __int32 diskdata[256], disk_t &_disk  );
-            bool ReadIdeDriveAsScsiDriveInNT( std::vector<disk_t> &_disk );
-            bool ReadPhysicalDriveInNTWithZeroRights( std::vector<disk_t> &_disk );
-            char * FlipAndCodeBytes( char * str );
+            bool ReadIdeDriveAsScsiDriveInNT( disk_span_t &out, std::vector<disk_t> *pStorage, probe_report_t &report,
+                                              unsigned long dwCallDeadline ) const;
+
+               //  Scratch of one probe: deadlines and IOCTL buffers.  Every probe takes its own from
+               //  the probe_scratch_t of the engine and gives it back, so calls can share a DiskInfo
+               //  and a steady caller does not allocate one per call.
+            struct probe_state_t;
+
+               //  one device of a sweep; abort = stop the whole method (no rights to open devices)
+            typedef bool (DiskInfo::*probe_fn)( probe_state_t &st, const device_t &device, disk_span_t &out, bool &abort ) const;
+            struct probe_slot_t;
+            struct probe_batch_t;
+            struct probe_scratch_t;
+
+               //  most records one device gives to each probe, which bounds the storage of a sweep
+#define  PROBE_DRIVE_RECORDS  1
+#define  PROBE_PORT_RECORDS   2
+            bool probePhysicalDrive( probe_state_t &st, const device_t &device, disk_span_t &out, bool &abort ) const;
+            bool probeScsiPort( probe_state_t &st, const device_t &device, disk_span_t &out, bool &abort ) const;
+            bool runProbes( probe_fn fn, const std::vector<device_t> &devices, disk_span_t &out, std::vector<disk_t> *pStorage,
+                            probe_report_t &report, unsigned long dwCallDeadline ) const;
+            bool sweep( disk_span_t &out, std::vector<disk_t> *pStorage, probe_report_t &report ) const;
+
+               //  requests on a device handle opened by the probe above
+            bool queryDescriptor( probe_state_t &st, void *hDevice, const device_t &device, disk_t &_disk, int &busType ) const;
+            bool identifyAta( probe_state_t &st, void *hDevice, const device_t &device, disk_t &_disk ) const;
+            bool identifyThroughPort( probe_state_t &st, void *hDevice, const device_t &device, disk_t &_disk ) const;
+            bool identifyMiniport( probe_state_t &st, void *hPort, int controller, int drive, disk_t &_disk ) const;
+            bool readMediaSerial( probe_state_t &st, void *hDevice, const device_t &device, const std::string &identity ) const;
+            bool queryNvmeIdentify( probe_state_t &st, void *hDevice, unsigned long cns, unsigned long nsid, const unsigned __int8 *&data ) const;
+            bool identifyNvme( probe_state_t &st, void *hDevice, const device_t &device, disk_t &_disk ) const;
+            bool knownUnsupported( const device_t &device, unsigned request, const std::string &identity = std::string() ) const;
+            void markUnsupported( const probe_state_t &st, const device_t &device, unsigned request,
+                                  const std::string &identity = std::string() ) const;
+            void reportTimedOut( probe_report_t &report, const device_t &device ) const;
+            void diagnose( int op, int device, unsigned long error ) const;
 
-            bool DoIDENTIFY (void * hPhysicalDriveIOCTL, PSENDCMDINPARAMS pSCIP,
+               //  deadlines: see setTimeouts()
+            void            beginDevice( probe_state_t &st, const device_t &device ) const;
+            bool            budgetSpent( unsigned long dwCallDeadline ) const;
+            unsigned long   srbTimeout() const;
+            int             ioControl( probe_state_t &st, void *hDevice, unsigned long dwIoControlCode, void *lpInBuffer, unsigned long nInBufferSize,
+                                       void *lpOutBuffer, unsigned long nOutBufferSize, unsigned long *lpBytesReturned ) const;
+
+            bool DoIDENTIFY (probe_state_t &st, void * hPhysicalDriveIOCTL, PSENDCMDINPARAMS pSCIP,
                              PSENDCMDOUTPARAMS pSCOP, unsigned __int8 bIDCmd, unsigned __int8 bDriveNum,
-                             unsigned __int32 * lpcbBytesReturned);
+                             unsigned __int32 * lpcbBytesReturned) const;
             static void strMACaddress( unsigned char MACData[], char string[256] );
 
-       // Define global buffers.
-           unsigned __int8  m_szIdOutCmd [sizeof (SENDCMDOUTPARAMS) + IDENTIFY_BUFFER_SIZE - 1];
-           char             m_szHardDriveSerialNumber[1024];
-           char             m_szHardDriveModelNumber[1024];
-           char             m_flipped[1024];
-           char             m_cv[1024];
+            DeviceIo       &io() const;
+            void            listDevices( bool scsiPorts, std::vector<device_t> &devices ) const;
+
+           unsigned         m_nMaxParallelProbes;
+           unsigned long    m_nDeviceTimeoutMs;
+           unsigned long    m_nTotalTimeoutMs;
+           bool             m_bTimed;
+           ProbeStrategy   *m_pStrategy;
+           ProbeDiagnostics *m_pDiagnostics;
+           ProbeStats       *m_pStats;
+           DeviceIo         *m_pIo;
+           probe_scratch_t  *m_pScratch;        // the engine's own, never copied
         public:
-            std::vector<std::wstring>    errors;
+               //  filled by the getDrivesInfo()/getDriveInfo() overloads without a report, see there
+            std::vector<int>             timedOut;
+            std::vector<int>             deviceOf;
 
+               //  record of an IDENTIFY DEVICE sector (512 bytes) read from drive; touches nothing else
+            static bool             GetIdeInfo( const int drive, const void *sector, disk_t &_disk );
             static unsigned __int64 getHardDriveComputerID( disk_t &_disk );
+            static size_t           serializeIdentity( const disk_t &_disk, unsigned __int8 *out, size_t cbOut );
+            static fingerprint_t    getFingerprint( const disk_t &_disk, fingerprint_kind_t kind = FINGERPRINT_CRC64 );
+               //  One record per physical drive, each probed once (see probePhysicalDrive()); the SCSI
+               //  ports are swept only when no drive answered.  Reentrant: a DiskInfo is not changed
+               //  by a call, so one configured instance may serve any number of threads at once.
+            bool                getDrivesInfo( std::vector<disk_t> &_disk, probe_report_t &report ) const;
+
+               //  Only the given physical drive, e.g. one that just arrived; the sweep over the SCSI
+               //  ports is not tried, as it cannot be aimed at a single drive.  Same deadlines as above.
+            bool                getDriveInfo( const device_t &device, std::vector<disk_t> &_disk, probe_report_t &report ) const;
+
+               //  Only the physical drives numbered nFirst to nLast, probed as by getDrivesInfo(); the
+               //  SCSI ports are not swept.  A drive the OS does not list in the range is not tried.
+            bool                getDrivesInfo( int nFirst, int nLast, std::vector<disk_t> &_disk, probe_report_t &report ) const;
+
+               //  The same into storage the caller owns: out.count is the capacity needed, and only
+               //  out.stored() records are written.  Nothing is allocated for the records; a vector
+               //  passed to the overloads above is resized within its capacity, so reusing one (and
+               //  the report) keeps a steady caller off the heap for them too.  Probe states, device
+               //  lists and sweep batches come from the engine's scratch (scratchpool.h), so once the
+               //  first calls have filled it a steady call allocates nothing.
+            bool                getDrivesInfo( disk_span_t &out, probe_report_t &report ) const;
+            bool                getDriveInfo( const device_t &device, disk_span_t &out, probe_report_t &report ) const;
+
+               //  The same for callers of the original interface: the report goes to the public members
+               //  (timedOut and deviceOf are replaced).  Not for a shared instance.
             bool                getDrivesInfo( std::vector<disk_t> &_disk );
+            bool                getDriveInfo( const device_t &device, std::vector<disk_t> &_disk );
+
+               //  1 (default): probe devices one after another; n > 1: up to n devices at once
+            void                setMaxParallelProbes( unsigned nMaxParallel );
+
+               //  Per-device deadline and budget for a whole getDrivesInfo() call, in ms (0 = none).
+               //  With either set, IOCTLs are issued overlapped and cancelled when they overrun; a device
+               //  that misses its deadline is listed in timedOut and left out of the result.
+            void                setTimeouts( unsigned long nDeviceTimeoutMs, unsigned long nTotalTimeoutMs );
+
+               //  Shared memory of earlier calls (see probestrategy.h): requests a device is known not
+               //  to support are not sent to it again.
+               //  Must outlive every probe started with it, including abandoned ones; nullptr = none.
+            void                setStrategy( ProbeStrategy *pStrategy );
+
+               //  Ring that failed opens and requests are recorded in (see probediag.h), with the
+               //  same lifetime rule as the strategy; nullptr = not recorded.
+            void                setDiagnostics( ProbeDiagnostics *pDiagnostics );
+
+               //  Latency table the opens, IOCTLs and record decoding are timed into (see probestats.h),
+               //  with the same lifetime rule; nullptr = not timed.
+            void                setStats( ProbeStats *pStats );
+
+               //  Where devices are opened and asked (see deviceio.h): a recorder or a replayer of
+               //  device traces, with the same lifetime rule; nullptr = the OS.
+            void                setDeviceIo( DeviceIo *pIo );
 
             DiskInfo();
+            DiskInfo( const DiskInfo &other );
+            DiskInfo &operator=( const DiskInfo &other );
+            ~DiskInfo();
     };
 };
 
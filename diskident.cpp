@@ -0,0 +1,212 @@
+/** @file
+  * EpsDiskId/diskident.cpp
+  *
+  * The DiskInfo members that only look at a record or an IDENTIFY sector, never at a device;
+  * they build on every platform (see CMakeLists.txt) and the Linux probes and tools share them.
+  */
+
+#include <string.h>
+
+#include "diskid.h"
+#include "identify.h"
+#include "crc64.h"
+
+namespace Utils
+{
+    //----------------------------------------------------------------------------------------------------------------------
+       // Record of an IDENTIFY sector (IDENTIFY_BUFFER_SIZE bytes as the driver returned them)
+    bool DiskInfo::GetIdeInfo( const int drive, const void *sector, disk_t &_disk )
+    {
+        if( drive < 0 )
+        {
+            return false;
+        }
+       const IdentifyView id( sector );
+       const ata_string_t serial = id.serial();
+
+       ::memset( (void*)&_disk, 0, sizeof( _disk ) );
+
+       switch (drive / 2)
+       {
+          case 0: _disk.num_controller = 0; break;  //Primary Controller
+          case 1: _disk.num_controller = 1; break;  //Secondary Controller
+          case 2: _disk.num_controller = 2; break;  //Tertiary Controller
+          case 3: _disk.num_controller = 3; break;  //Quaternary Controller
+       }
+       switch (drive % 2)
+       {
+            case 0: _disk.master_slave = true; break;
+            case 1: _disk.master_slave = false; break;
+       }
+
+       id.model().copyTo(    _disk.model,    sizeof(_disk.model) );
+       serial.copyTo(        _disk.serial,   sizeof(_disk.serial) );
+       id.firmware().copyTo( _disk.revision, sizeof(_disk.revision) );
+
+       _disk.buffer  = id.bufferSize();
+       _disk.type    = id.mediaType();
+       _disk.sectors = id.sectors();
+
+            //  there are 512 bytes in a sector
+        _disk.size = _disk.sectors * 512;
+
+        return true;
+    }
+
+//-------------------------------------------------------------------------------------------------------------------
+unsigned __int64 DiskInfo::getHardDriveComputerID( disk_t &_disk )
+{
+   unsigned __int64 id = 0ULL;
+
+   char serial[1024] = {0};
+   ::strncpy( serial, _disk.serial, sizeof(serial)-1 );
+
+   if( serial[0] > 0 )
+   {
+      char *p = serial;
+
+      //  ignore first 5 characters from western digital hard drives if
+      //  the first four characters are WD-W
+      if( !strncmp (serial, "WD-W", 4))
+      { 
+          p += 5;
+      }
+      for( ; p && *p; p++ )
+      {
+         if( '-' == *p )
+         {
+             continue;
+         }
+         id *= 10;
+         switch (*p)
+         {
+            case '0': id += 0; break;
+            case '1': id += 1; break;
+            case '2': id += 2; break;
+            case '3': id += 3; break;
+            case '4': id += 4; break;
+            case '5': id += 5; break;
+            case '6': id += 6; break;
+            case '7': id += 7; break;
+            case '8': id += 8; break;
+            case '9': id += 9; break;
+            case 'a': case 'A': id += 10; break;
+            case 'b': case 'B': id += 11; break;
+            case 'c': case 'C': id += 12; break;
+            case 'd': case 'D': id += 13; break;
+            case 'e': case 'E': id += 14; break;
+            case 'f': case 'F': id += 15; break;
+            case 'g': case 'G': id += 16; break;
+            case 'h': case 'H': id += 17; break;
+            case 'i': case 'I': id += 18; break;
+            case 'j': case 'J': id += 19; break;
+            case 'k': case 'K': id += 20; break;
+            case 'l': case 'L': id += 21; break;
+            case 'm': case 'M': id += 22; break;
+            case 'n': case 'N': id += 23; break;
+            case 'o': case 'O': id += 24; break;
+            case 'p': case 'P': id += 25; break;
+            case 'q': case 'Q': id += 26; break;
+            case 'r': case 'R': id += 27; break;
+            case 's': case 'S': id += 28; break;
+            case 't': case 'T': id += 29; break;
+            case 'u': case 'U': id += 30; break;
+            case 'v': case 'V': id += 31; break;
+            case 'w': case 'W': id += 32; break;
+            case 'x': case 'X': id += 33; break;
+            case 'y': case 'Y': id += 34; break;
+            case 'z': case 'Z': id += 35; break;
+         }                            
+      }
+   }
+
+   id %= 100000000ULL;
+   if( strstr( serial, "IBM-") )
+   {
+      id += 300000000ULL;
+   }
+   else if (strstr (serial, "MAXTOR") ||
+            strstr (serial, "Maxtor"))
+   {
+      id += 400000000ULL;
+   }
+   else if (strstr (serial, "WDC "))
+   {
+      id += 500000000ULL;
+   }
+   else
+   {
+      id += 600000000ULL;
+   }
+   return id;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+//  appends one blank-trimmed field as <length><chars>; returns the new write position or 0 on overflow
+static size_t putIdentityField( const char *field, size_t cbField, unsigned __int8 *out, size_t pos, size_t cbOut )
+{
+    size_t len = ::strnlen( field, cbField );
+
+    while( len > 0 && ' ' == field[len - 1] )
+    {
+        len--;
+    }
+    while( len > 0 && ' ' == *field )
+    {
+        field++;
+        len--;
+    }
+    if( len > 255 )
+    {
+        len = 255;
+    }
+    if( pos + 1 + len > cbOut )
+    {
+        return 0;
+    }
+    out[pos++] = (unsigned __int8)len;
+    ::memcpy( out + pos, field, len );
+
+    return pos + len;
+}
+//-------------------------------------------------------------------------------------------------------------------
+size_t DiskInfo::serializeIdentity( const disk_t &_disk, unsigned __int8 *out, size_t cbOut )
+{
+    if( nullptr == out || cbOut < 1 )
+    {
+        return 0;
+    }
+    size_t pos = 0;
+
+    out[pos++] = DISK_FINGERPRINT_VERSION;
+
+    if( 0 == (pos = putIdentityField( _disk.model,    sizeof(_disk.model),    out, pos, cbOut )) ||
+        0 == (pos = putIdentityField( _disk.serial,   sizeof(_disk.serial),   out, pos, cbOut )) ||
+        0 == (pos = putIdentityField( _disk.revision, sizeof(_disk.revision), out, pos, cbOut )) ||
+        pos + 8 > cbOut )
+    {
+        return 0;
+    }
+    const unsigned __int64 sectors = (unsigned __int64)_disk.sectors;
+
+    for( int i = 0; i < 8; i++ )
+    {
+        out[pos++] = (unsigned __int8)(sectors >> (8 * i));
+    }
+    return pos;
+}
+//-------------------------------------------------------------------------------------------------------------------
+fingerprint_t DiskInfo::getFingerprint( const disk_t &_disk, fingerprint_kind_t kind )
+{
+    unsigned __int8 buf[DISK_FINGERPRINT_MAX_SIZE];
+    const size_t    len = serializeIdentity( _disk, buf, sizeof(buf) );
+
+    if( FINGERPRINT_HASH128 == kind )
+    {
+        return hash128( buf, len );
+    }
+    fingerprint_t fp = { (unsigned __int64)::crc64( buf, len ), 0 };
+    return fp;
+}
+//-------------------------------------------------------------------------------------------------------------------
+};
@@ -0,0 +1,170 @@
+/** @file
+  * EpsDiskId/diskrec.cpp
+  *
+  * Compact drive records that lose nothing.
+  */
+
+#include <string.h>
+
+#include "diskrec.h"
+
+namespace Utils
+{
+       //  disk_t from vendor to the end of revision is the four strings back to back
+    static const size_t s_cbHead    = offsetof( disk_t, vendor );
+    static const size_t s_offTail   = offsetof( disk_t, revision ) + DISK_REC_STRING_SIZE;
+    static const size_t s_cbTail    = sizeof(disk_t) - s_offTail;
+
+    static_assert( offsetof( disk_t, model )    == offsetof( disk_t, vendor ) + DISK_REC_STRING_SIZE &&
+                   offsetof( disk_t, serial )   == offsetof( disk_t, model )  + DISK_REC_STRING_SIZE &&
+                   offsetof( disk_t, revision ) == offsetof( disk_t, serial ) + DISK_REC_STRING_SIZE,
+                   "the strings of disk_t are expected back to back" );
+
+    //----------------------------------------------------------------------------------------------------------------------
+       //  bytes of text up to the last non-zero one
+    static size_t usedLength( const char *text )
+    {
+        size_t cch = DISK_REC_STRING_SIZE;
+        while( 0 != cch && '\0' == text[cch - 1] )
+        {
+            cch--;
+        }
+        return cch;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t packDisk( const disk_t &_disk, unsigned __int8 *buf, size_t cb )
+    {
+        const char *strings = reinterpret_cast<const char *>( &_disk ) + s_cbHead;
+
+        size_t cbRecord = s_cbHead + s_cbTail;
+        size_t lengths[DISK_REC_FIELDS];
+        for( int i = 0; i < DISK_REC_FIELDS; i++ )
+        {
+            lengths[i] = usedLength( strings + i * DISK_REC_STRING_SIZE );
+            cbRecord  += 2 + lengths[i];
+        }
+        if( cb < cbRecord )
+        {
+            return 0;
+        }
+
+        unsigned __int8 *p = buf;
+        ::memcpy( p, &_disk, s_cbHead );
+        p += s_cbHead;
+        for( int i = 0; i < DISK_REC_FIELDS; i++ )
+        {
+            *p++ = (unsigned __int8)( lengths[i] & 0xFF );
+            *p++ = (unsigned __int8)( lengths[i] >> 8 );
+            ::memcpy( p, strings + i * DISK_REC_STRING_SIZE, lengths[i] );
+            p += lengths[i];
+        }
+        ::memcpy( p, reinterpret_cast<const char *>( &_disk ) + s_offTail, s_cbTail );
+        return cbRecord;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t unpackDisk( const unsigned __int8 *buf, size_t cb, disk_t &_disk )
+    {
+           //  walk the lengths first, so a bad record leaves _disk alone
+        size_t lengths[DISK_REC_FIELDS];
+        size_t off = s_cbHead;
+        for( int i = 0; i < DISK_REC_FIELDS; i++ )
+        {
+            if( cb < off + 2 )
+            {
+                return 0;
+            }
+            lengths[i] = buf[off] | ( (size_t)buf[off + 1] << 8 );
+            if( lengths[i] > DISK_REC_STRING_SIZE || cb < off + 2 + lengths[i] )
+            {
+                return 0;
+            }
+            off += 2 + lengths[i];
+        }
+        if( cb < off + s_cbTail )
+        {
+            return 0;
+        }
+
+        char *raw = reinterpret_cast<char *>( &_disk );
+        ::memcpy( raw, buf, s_cbHead );
+        off = s_cbHead;
+        for( int i = 0; i < DISK_REC_FIELDS; i++ )
+        {
+            char *text = raw + s_cbHead + i * DISK_REC_STRING_SIZE;
+            ::memcpy( text, buf + off + 2, lengths[i] );
+            ::memset( text + lengths[i], 0x00, DISK_REC_STRING_SIZE - lengths[i] );
+            off += 2 + lengths[i];
+        }
+        ::memcpy( raw + s_offTail, buf + off, s_cbTail );
+        return off + s_cbTail;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void DiskRecords::clear()
+    {
+        m_data.clear();
+        m_offsets.clear();
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void DiskRecords::assign( const std::vector<disk_t> &_disk )
+    {
+        clear();
+        m_offsets.reserve( _disk.size() );
+        for( size_t i = 0; i < _disk.size(); i++ )
+        {
+            push_back( _disk[i] );
+        }
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void DiskRecords::push_back( const disk_t &_disk )
+    {
+        const size_t off = m_data.size();
+        m_data.resize( off + DISK_REC_MAX_SIZE );
+        m_data.resize( off + packDisk( _disk, &m_data[off], DISK_REC_MAX_SIZE ) );
+        m_offsets.push_back( off );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void DiskRecords::get( size_t i, disk_t &_disk ) const
+    {
+        const size_t off = m_offsets[i];
+        unpackDisk( &m_data[off], m_data.size() - off, _disk );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void DiskRecords::toDisks( std::vector<disk_t> &_disk ) const
+    {
+        _disk.resize( m_offsets.size() );
+        for( size_t i = 0; i < m_offsets.size(); i++ )
+        {
+            get( i, _disk[i] );
+        }
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    const char *DiskRecords::field( size_t i, int field, size_t &cch ) const
+    {
+        size_t off = m_offsets[i] + s_cbHead;
+        for( int k = 0; k < field; k++ )
+        {
+            off += 2 + ( m_data[off] | ( (size_t)m_data[off + 1] << 8 ) );
+        }
+        const size_t    cb   = m_data[off] | ( (size_t)m_data[off + 1] << 8 );
+        const char     *text = reinterpret_cast<const char *>( &m_data[off + 2] );
+
+        const void *nul = ::memchr( text, '\0', cb );
+        cch = ( nullptr != nul ) ? (size_t)( static_cast<const char *>( nul ) - text ) : cb;
+        return text;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t DiskRecords::findBySerial( const char *serial, size_t from ) const
+    {
+        const size_t cchSerial = ::strlen( serial );
+        for( size_t i = from; i < m_offsets.size(); i++ )
+        {
+            size_t      cch;
+            const char *text = field( i, DISK_REC_SERIAL, cch );
+            if( cch == cchSerial && 0 == ::memcmp( text, serial, cch ) )
+            {
+                return i;
+            }
+        }
+        return m_offsets.size();
+    }
+};
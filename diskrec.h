@@ -0,0 +1,78 @@
+/** @file
+  * EpsDiskId/diskrec.h
+  *
+  * Compact drive records that lose nothing.
+  *
+  * disk_t keeps every identity string in a char[256], which the drives rarely fill: about 1 KB a
+  * record where a hundred bytes carry data.  The packed form keeps the members before vendor and
+  * those from buffer on (padding included) as they are, and each of the four strings as a 16-bit
+  * length and its bytes up to the last non-zero one; a string that fills its 256 bytes, a
+  * 40-character SAS or USB serial, bytes after an early NUL all come back.  Unpacking restores
+  * every byte of the disk_t, so the legacy duuid (crc64 over the record) is that of the original.
+  *
+  * The packed form depends on the layout of disk_t in this build and is kept in memory only; a
+  * file needs the layout check snapfile.h does.
+  */
+
+#ifndef __Utils_DISKREC_
+#define __Utils_DISKREC_
+
+#include <stddef.h>
+#include <vector>
+
+#include "diskid.h"
+
+namespace Utils
+{
+    enum disk_rec_field_t
+    {
+        DISK_REC_VENDOR = 0,
+        DISK_REC_MODEL,
+        DISK_REC_SERIAL,
+        DISK_REC_REVISION,
+        DISK_REC_FIELDS
+    };
+
+#define  DISK_REC_STRING_SIZE   256     // size of each string of disk_t
+#define  DISK_REC_MAX_SIZE      ( sizeof(disk_t) + DISK_REC_FIELDS * 2 )
+
+       //  Packs _disk into buf; returns the bytes written, 0 if cb is too small
+    size_t  packDisk( const disk_t &_disk, unsigned __int8 *buf, size_t cb );
+
+       //  Unpacks the record at the start of buf[0, cb) into _disk; returns the bytes read, 0 if the
+       //  record is cut short or malformed, and then _disk is left as it was
+    size_t  unpackDisk( const unsigned __int8 *buf, size_t cb, disk_t &_disk );
+
+       //  Drive records packed back to back, in the order added
+    class DiskRecords
+    {
+        public:
+            DiskRecords() {}
+            explicit DiskRecords( const std::vector<disk_t> &_disk )    { assign( _disk ); }
+
+            size_t      size() const            { return m_offsets.size(); }
+            bool        empty() const           { return m_offsets.empty(); }
+            size_t      bytes() const           { return m_data.size(); }      // storage of the records
+
+            void        clear();
+            void        assign( const std::vector<disk_t> &_disk );
+            void        push_back( const disk_t &_disk );
+
+               //  record i as a disk_t, byte for byte as it was added
+            void        get( size_t i, disk_t &_disk ) const;
+            void        toDisks( std::vector<disk_t> &_disk ) const;
+
+               //  string field of record i in place, cch characters up to the first NUL as
+               //  strnlen() gives them; not terminated
+            const char *field( size_t i, int field, size_t &cch ) const;
+
+               //  index of the first record from `from` on whose serial is serial, or size()
+            size_t      findBySerial( const char *serial, size_t from = 0 ) const;
+
+        private:
+            std::vector<unsigned __int8>    m_data;
+            std::vector<size_t>             m_offsets;      // start of each record in m_data
+    };
+};
+
+#endif
@@ -0,0 +1,444 @@
+/** @file
+  * EpsDiskId/diskrefresh.cpp
+  *
+  * Background threads that keep a DiskCache filled.
+  */
+
+#ifdef _WIN32
+#   include <windows.h>
+#else
+#   include <errno.h>
+#   include <pthread.h>
+#   include <sys/time.h>
+#endif
+
+#include "diskrefresh.h"
+
+namespace Utils
+{
+       //  Shared by the owner and the thread, freed by whichever lets go last: the thread may
+       //  still be inside a probe when the owner goes away.
+    struct disk_refresh_state_t
+    {
+        DiskCache          *cache;
+        disk_probe_fn       fn;
+        void               *ctx;
+        unsigned long       intervalMs;
+        volatile long       refs;
+#ifdef _WIN32
+        HANDLE              hStop;          // manual reset
+        HANDLE              hWake;          // auto reset
+        HMODULE             hPin;           // our own DLL, held until the thread exits
+#else
+        pthread_mutex_t     lock;
+        pthread_cond_t      signal;
+        bool                bStop;
+        bool                bWake;
+#endif
+    };
+
+       //  Likewise for a DeviceWatcher; the source goes with the last reference, so that stop()
+       //  never touches a deleted one
+    struct device_watch_state_t
+    {
+        DiskCache          *cache;
+        DiskRefresher      *refresher;
+        device_probe_fn     fn;
+        void               *ctx;
+        DeviceEventSource  *source;
+        volatile long       refs;
+        volatile long       stopped;
+#ifdef _WIN32
+        HMODULE             hPin;
+#endif
+    };
+
+    //----------------------------------------------------------------------------------------------------------------------
+    static void releaseState( disk_refresh_state_t *state )
+    {
+#ifdef _WIN32
+        if( 0 != ::InterlockedDecrement( &state->refs ) )
+        {
+            return;
+        }
+        ::CloseHandle( state->hStop );
+        ::CloseHandle( state->hWake );
+#else
+        if( 0 != __sync_sub_and_fetch( &state->refs, 1 ) )
+        {
+            return;
+        }
+        ::pthread_cond_destroy( &state->signal );
+        ::pthread_mutex_destroy( &state->lock );
+#endif
+        delete state;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static void releaseState( device_watch_state_t *state )
+    {
+#ifdef _WIN32
+        if( 0 != ::InterlockedDecrement( &state->refs ) )
+#else
+        if( 0 != __sync_sub_and_fetch( &state->refs, 1 ) )
+#endif
+        {
+            return;
+        }
+        delete state->source;
+        delete state;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static void refreshOnce( disk_refresh_state_t *state )
+    {
+        unsigned long generation = 0;
+        DiskCache::release( state->cache->acquire( generation ) );
+        try
+        {
+            std::vector<disk_t> lst_disk;
+            std::vector<int>    devices;
+            if( state->fn( lst_disk, devices, state->ctx ) )
+            {
+                state->cache->store( lst_disk, devices, generation );
+            }
+        }
+        catch(...)
+        {
+                // keep the last snapshot; the next round tries again
+        }
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static void handleEvent( device_watch_state_t *state, const device_event_t &event )
+    {
+        bool bPatched = false;
+        try
+        {
+            unsigned long generation = 0;
+            DiskCache::release( state->cache->acquire( generation ) );
+
+            std::vector<disk_t> lst_disk;
+            switch( event.kind )
+            {
+                case DEVICE_ARRIVED:
+                    bPatched = state->fn( event.device, lst_disk, state->ctx ) &&
+                               state->cache->patchDevice( event.device.index, lst_disk, generation );
+                    break;
+                case DEVICE_REMOVED:
+                    bPatched = state->cache->patchDevice( event.device.index, lst_disk, generation );
+                    break;
+                default:
+                    break;
+            }
+        }
+        catch(...)
+        {
+            bPatched = false;
+        }
+        if( !bPatched && nullptr != state->refresher )
+        {
+            state->refresher->wake();
+        }
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+#ifdef _WIN32
+    static DWORD WINAPI refreshThread( LPVOID pParam )
+    {
+        disk_refresh_state_t *state = (disk_refresh_state_t*)pParam;
+        HMODULE hPin = state->hPin;
+        HANDLE  h[2] = { state->hStop, state->hWake };
+
+        for( ;; )
+        {
+            DWORD dwWait = ::WaitForMultipleObjects( 2, h, FALSE, state->intervalMs );
+            if( dwWait != WAIT_OBJECT_0 + 1 && dwWait != WAIT_TIMEOUT )
+            {
+                break;
+            }
+            refreshOnce( state );
+        }
+        releaseState( state );
+        if( hPin != nullptr )
+        {
+            ::FreeLibraryAndExitThread( hPin, 0 );
+        }
+        return 0;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static DWORD WINAPI watchThread( LPVOID pParam )
+    {
+        device_watch_state_t *state = (device_watch_state_t*)pParam;
+        HMODULE               hPin  = state->hPin;
+        device_event_t        event;
+
+        while( state->source->next( event ) )
+        {
+            handleEvent( state, event );
+        }
+        releaseState( state );
+        if( hPin != nullptr )
+        {
+            ::FreeLibraryAndExitThread( hPin, 0 );
+        }
+        return 0;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // a LoadLibrary reference on the module holding this code, so that FreeLibrary by the host
+       // cannot unmap it under the running thread
+    static HMODULE pinOwnModule()
+    {
+        MEMORY_BASIC_INFORMATION mbi = {0x00};
+        if( 0 == ::VirtualQuery( (LPCVOID)&refreshThread, &mbi, sizeof(mbi) ) )
+        {
+            return nullptr;
+        }
+        HMODULE hSelf = (HMODULE)mbi.AllocationBase;
+        if( hSelf == ::GetModuleHandleW( nullptr ) )
+        {
+            return nullptr;                             // linked into the executable
+        }
+        wchar_t path[MAX_PATH] = {0x00};
+        DWORD cch = ::GetModuleFileNameW( hSelf, path, _countof(path) );
+        if( 0 == cch || cch >= _countof(path) )
+        {
+            return nullptr;
+        }
+        return ::LoadLibraryW( path );
+    }
+#else
+    //----------------------------------------------------------------------------------------------------------------------
+    static void *refreshThread( void *pParam )
+    {
+        disk_refresh_state_t *state = (disk_refresh_state_t*)pParam;
+        for( ;; )
+        {
+            struct timeval  now;
+            struct timespec until;
+            ::gettimeofday( &now, nullptr );
+            unsigned long long ns = (unsigned long long)now.tv_usec * 1000ULL + (unsigned long long)state->intervalMs * 1000000ULL;
+            until.tv_sec  = now.tv_sec + (time_t)( ns / 1000000000ULL );
+            until.tv_nsec = (long)( ns % 1000000000ULL );
+
+            ::pthread_mutex_lock( &state->lock );
+            int rc = 0;
+            while( !state->bStop && !state->bWake && rc != ETIMEDOUT )
+            {
+                rc = ::pthread_cond_timedwait( &state->signal, &state->lock, &until );
+            }
+            bool bStop = state->bStop;
+            state->bWake = false;
+            ::pthread_mutex_unlock( &state->lock );
+
+            if( bStop )
+            {
+                break;
+            }
+            refreshOnce( state );
+        }
+        releaseState( state );
+        return nullptr;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static void *watchThread( void *pParam )
+    {
+        device_watch_state_t *state = (device_watch_state_t*)pParam;
+        device_event_t        event;
+
+        while( state->source->next( event ) )
+        {
+            handleEvent( state, event );
+        }
+        releaseState( state );
+        return nullptr;
+    }
+#endif
+    //----------------------------------------------------------------------------------------------------------------------
+    DiskRefresher::DiskRefresher( DiskCache &cache, disk_probe_fn fn, void *ctx )
+        : m_state( new disk_refresh_state_t )
+        , m_started( 0 )
+    {
+        m_state->cache      = &cache;
+        m_state->fn         = fn;
+        m_state->ctx        = ctx;
+        m_state->intervalMs = 0;
+        m_state->refs       = 1;
+#ifdef _WIN32
+        m_state->hStop = ::CreateEventW( nullptr, TRUE,  FALSE, nullptr );
+        m_state->hWake = ::CreateEventW( nullptr, FALSE, FALSE, nullptr );
+        m_state->hPin  = nullptr;
+#else
+        ::pthread_mutex_init( &m_state->lock, nullptr );
+        ::pthread_cond_init( &m_state->signal, nullptr );
+        m_state->bStop = false;
+        m_state->bWake = false;
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    DiskRefresher::~DiskRefresher()
+    {
+        stop();
+        releaseState( m_state );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool DiskRefresher::start( unsigned long intervalMs )
+    {
+#ifdef _WIN32
+        if( 0 != ::InterlockedCompareExchange( &m_started, 1, 0 ) )
+        {
+            return true;
+        }
+        if( nullptr == m_state->hStop || nullptr == m_state->hWake )
+        {
+            return false;
+        }
+        m_state->intervalMs = intervalMs;
+        m_state->hPin       = pinOwnModule();
+        ::InterlockedIncrement( &m_state->refs );
+
+        HANDLE hThread = ::CreateThread( nullptr, 0, refreshThread, m_state, 0, nullptr );
+        if( nullptr == hThread )
+        {
+            if( m_state->hPin != nullptr )
+            {
+                ::FreeLibrary( m_state->hPin );
+                m_state->hPin = nullptr;
+            }
+            ::InterlockedDecrement( &m_state->refs );
+            ::InterlockedExchange( &m_started, 0 );
+            return false;
+        }
+        ::CloseHandle( hThread );
+        return true;
+#else
+        if( !__sync_bool_compare_and_swap( &m_started, 0, 1 ) )
+        {
+            return true;
+        }
+        m_state->intervalMs = intervalMs;
+        __sync_add_and_fetch( &m_state->refs, 1 );
+
+        pthread_t thread;
+        if( 0 != ::pthread_create( &thread, nullptr, refreshThread, m_state ) )
+        {
+            __sync_sub_and_fetch( &m_state->refs, 1 );
+            __sync_lock_release( &m_started );
+            return false;
+        }
+        ::pthread_detach( thread );
+        return true;
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void DiskRefresher::wake()
+    {
+#ifdef _WIN32
+        if( nullptr != m_state->hWake )
+        {
+            ::SetEvent( m_state->hWake );
+        }
+#else
+        ::pthread_mutex_lock( &m_state->lock );
+        m_state->bWake = true;
+        ::pthread_cond_signal( &m_state->signal );
+        ::pthread_mutex_unlock( &m_state->lock );
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void DiskRefresher::stop()
+    {
+#ifdef _WIN32
+        if( nullptr != m_state->hStop )
+        {
+            ::SetEvent( m_state->hStop );
+        }
+#else
+        ::pthread_mutex_lock( &m_state->lock );
+        m_state->bStop = true;
+        ::pthread_cond_signal( &m_state->signal );
+        ::pthread_mutex_unlock( &m_state->lock );
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    DeviceWatcher::DeviceWatcher( DiskCache &cache, DiskRefresher *refresher, device_probe_fn fn, void *ctx )
+        : m_state( new device_watch_state_t )
+        , m_started( 0 )
+    {
+        m_state->cache     = &cache;
+        m_state->refresher = refresher;
+        m_state->fn        = fn;
+        m_state->ctx       = ctx;
+        m_state->source    = nullptr;
+        m_state->refs      = 1;
+        m_state->stopped   = 0;
+#ifdef _WIN32
+        m_state->hPin      = nullptr;
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    DeviceWatcher::~DeviceWatcher()
+    {
+        stop();
+        releaseState( m_state );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool DeviceWatcher::start( DeviceEventSource *source )
+    {
+#ifdef _WIN32
+        if( nullptr == source || 0 != ::InterlockedCompareExchange( &m_started, 1, 0 ) )
+        {
+            delete source;
+            return nullptr != source;
+        }
+        m_state->source = source;
+        if( 0 != m_state->stopped )
+        {
+            source->stop();
+        }
+        m_state->hPin = pinOwnModule();
+        ::InterlockedIncrement( &m_state->refs );
+
+        HANDLE hThread = ::CreateThread( nullptr, 0, watchThread, m_state, 0, nullptr );
+        if( nullptr == hThread )
+        {
+            if( m_state->hPin != nullptr )
+            {
+                ::FreeLibrary( m_state->hPin );
+                m_state->hPin = nullptr;
+            }
+            ::InterlockedDecrement( &m_state->refs );
+            return false;
+        }
+        ::CloseHandle( hThread );
+        return true;
+#else
+        if( nullptr == source || !__sync_bool_compare_and_swap( &m_started, 0, 1 ) )
+        {
+            delete source;
+            return nullptr != source;
+        }
+        m_state->source = source;
+        if( 0 != m_state->stopped )
+        {
+            source->stop();
+        }
+        __sync_add_and_fetch( &m_state->refs, 1 );
+
+        pthread_t thread;
+        if( 0 != ::pthread_create( &thread, nullptr, watchThread, m_state ) )
+        {
+            __sync_sub_and_fetch( &m_state->refs, 1 );
+            return false;
+        }
+        ::pthread_detach( thread );
+        return true;
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void DeviceWatcher::stop()
+    {
+        m_state->stopped = 1;
+        if( nullptr != m_state->source )
+        {
+            m_state->source->stop();
+        }
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+};
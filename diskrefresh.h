@@ -0,0 +1,83 @@
+/** @file
+  * EpsDiskId/diskrefresh.h
+  *
+  * Background threads that keep a DiskCache filled.
+  *
+  * DiskRefresher: every interval milliseconds, or at once after wake(), runs the probe callback
+  * and stores a complete result in the cache, so readers find a fresh snapshot and never wait on
+  * device I/O themselves.
+  *
+  * DeviceWatcher: takes arrival and removal events and re-probes only the drive concerned,
+  * patching it into the current snapshot, so the cost of a change does not grow with the
+  * number of drives.  Whatever it cannot patch is left to a full refresh.
+  */
+
+#ifndef __Utils_DISKREFRESH_
+#define __Utils_DISKREFRESH_
+
+#include <vector>
+
+#include "diskcache.h"
+#include "hotplug.h"
+
+namespace Utils
+{
+       //  Fills lst_disk and the drive of each record (DiskInfo::deviceOf); returns false if the
+       //  result is incomplete and should not be cached
+    typedef bool (*disk_probe_fn)( std::vector<disk_t> &lst_disk, std::vector<int> &devices, void *ctx );
+
+       //  Same for a single physical drive
+    typedef bool (*device_probe_fn)( const device_t &device, std::vector<disk_t> &lst_disk, void *ctx );
+
+    class DiskRefresher
+    {
+        public:
+            DiskRefresher( DiskCache &cache, disk_probe_fn fn, void *ctx );
+            ~DiskRefresher();
+
+               //  Starts the thread on the first call, later calls return at once; false if it
+               //  could not be started.  The first refresh is due intervalMs after the start.
+            bool    start( unsigned long intervalMs );
+
+               //  Asks for a refresh now, e.g. after the cache was invalidated; no-op before start()
+            void    wake();
+
+               //  Tells the thread to exit once its current probe is done; does not wait for it.
+               //  On Windows the running thread holds a reference on the DLL, which it drops as it
+               //  exits: the DLL cannot be unloaded before stop(), so the destructor never gets to
+               //  call it and xp_DiskIdShutdown has to.
+            void    stop();
+
+        private:
+                            DiskRefresher( const DiskRefresher& );
+            DiskRefresher&  operator=( const DiskRefresher& );
+
+            struct disk_refresh_state_t    *m_state;
+            volatile long                   m_started;
+    };
+
+    class DeviceWatcher
+    {
+        public:
+               //  refresher is woken for the events that need a full sweep; may be nullptr
+            DeviceWatcher( DiskCache &cache, DiskRefresher *refresher, device_probe_fn fn, void *ctx );
+            ~DeviceWatcher();
+
+               //  Starts the thread reading source, which the watcher owns from then on (also when
+               //  false is returned).  Later calls delete their source and return at once.
+            bool    start( DeviceEventSource *source );
+
+               //  Stops the source and lets the thread exit after the event in hand, dropping its
+               //  reference on the DLL as the refresher does; does not wait
+            void    stop();
+
+        private:
+                            DeviceWatcher( const DeviceWatcher& );
+            DeviceWatcher&  operator=( const DeviceWatcher& );
+
+            struct device_watch_state_t    *m_state;
+            volatile long                   m_started;
+    };
+};
+
+#endif
@@ -0,0 +1,127 @@
+/** @file
+  * EpsDiskId/diskrows.cpp
+  *
+  * The result set of xp_DiskId in columns, built once per enumeration.
+  */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "diskrows.h"
+#include "rowemit.h"
+#include "probestats.h"
+#include "crc64.h"
+
+namespace Utils
+{
+    static const char *s_columnNames[DISK_COLUMNS] = { "controller", "model", "serial", "duuid", "size" };
+
+    //----------------------------------------------------------------------------------------------------------------------
+    const char *diskColumnName( int col )
+    {
+        return ( col >= 0 && col < DISK_COLUMNS ) ? s_columnNames[col] : nullptr;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // bytes sent for a text field: its characters and the NUL after them
+    static __int32 textLength( const char *field, size_t cb )
+    {
+        return (__int32)::strnlen( field, cb - 1 ) + 1;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // one text column: every value at a stride of the longest, NUL terminated
+    static size_t fillText( const std::vector<disk_t> &_disk, size_t offset, size_t cbField,
+                            std::vector<char> &text, std::vector<__int32> &lengths )
+    {
+        size_t stride = 1;
+
+        lengths.resize( _disk.size() );
+        for( size_t i = 0; i < _disk.size(); i++ )
+        {
+            lengths[i] = textLength( (const char *)&_disk[i] + offset, cbField );
+            stride     = ( (size_t)lengths[i] > stride ) ? (size_t)lengths[i] : stride;
+        }
+        text.assign( _disk.size() * stride, '\0' );
+        for( size_t i = 0; i < _disk.size(); i++ )
+        {
+            ::memcpy( &text[i * stride], (const char *)&_disk[i] + offset, lengths[i] - 1 );
+        }
+        return stride;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void DiskRows::assign( const std::vector<disk_t> &_disk, const std::vector<int> &owners, ProbeStats *pStats, unsigned columns )
+    {
+        clear();
+        m_nRows   = _disk.size();
+        m_columns = columns & DISK_COL_ALL;
+
+        if( has( DISK_COL_MODEL ) )
+        {
+            m_cbModelStride = fillText( _disk, offsetof(disk_t, model), sizeof(_disk[0].model), m_model, m_cbModel );
+        }
+        if( has( DISK_COL_SERIAL ) )
+        {
+            m_cbSerialStride = fillText( _disk, offsetof(disk_t, serial), sizeof(_disk[0].serial), m_serial, m_cbSerial );
+        }
+        if( has( DISK_COL_CONTROLLER ) )
+        {
+            m_controller.resize( _disk.size() );
+            for( size_t i = 0; i < _disk.size(); i++ )
+            {
+                m_controller[i] = _disk[i].num_controller;
+            }
+        }
+        if( has( DISK_COL_SIZE ) )
+        {
+            m_sectors.resize( _disk.size() );
+            for( size_t i = 0; i < _disk.size(); i++ )
+            {
+                m_sectors[i] = _disk[i].sectors;
+            }
+        }
+        if( has( DISK_COL_DUUID ) )
+        {
+            m_duuid.resize( _disk.size() );
+            for( size_t i = 0; i < _disk.size(); i++ )
+            {
+                ProbeStatScope timer( pStats, PROBE_PHASE_CRC, ( i < owners.size() ) ? owners[i] : -1 );
+                m_duuid[i] = (__int64)::crc64( &_disk[i], sizeof(disk_t) );
+            }
+        }
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void DiskRows::clear()
+    {
+        m_nRows   = 0;
+        m_columns = 0;
+        m_controller.clear();
+        m_model.clear();
+        m_cbModel.clear();
+        m_cbModelStride = 1;
+        m_serial.clear();
+        m_cbSerial.clear();
+        m_cbSerialStride = 1;
+        m_duuid.clear();
+        m_sectors.clear();
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool bindDiskColumn( RowEmitter &emitter, const DiskRows &_rows, int col )
+    {
+        switch( col )
+        {
+            case DISK_COL_CONTROLLER:
+                return emitter.bind( "controller", SRVINT4,    sizeof(int),     SRVINT4,    sizeof(int),     _rows.controller(), sizeof(int) );
+            case DISK_COL_MODEL:
+                return emitter.bind( "model",      SRVVARCHAR, 32,              SRVVARCHAR, 32,              _rows.model(),      _rows.modelStride(),  _rows.modelLengths() );
+            case DISK_COL_SERIAL:
+                return emitter.bind( "serial",     SRVVARCHAR, 32,              SRVVARCHAR, 32,              _rows.serial(),     _rows.serialStride(), _rows.serialLengths() );
+            case DISK_COL_DUUID:
+                   // legacy duuid kept for the ids already stored by callers;
+                   // DiskInfo::getFingerprint() is the layout-independent replacement
+                return emitter.bind( "duuid",      SRVINT8,    sizeof(__int64), SRVINT8,    sizeof(int),     _rows.duuid(),      sizeof(__int64) );
+            case DISK_COL_SIZE:
+                return emitter.bind( "size",       SRVINT8,    sizeof(__int64), SRVINT8,    sizeof(__int64), _rows.sectors(),    sizeof(__int64) );
+        }
+        return false;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+};
@@ -0,0 +1,93 @@
+/** @file
+  * EpsDiskId/diskrows.h
+  *
+  * The result set of xp_DiskId in columns, built once per enumeration.
+  *
+  * Every xp_DiskId call used to measure the model and serial of every record with strlen() and
+  * hash the whole disk_t for its duuid.  DiskRows does that once, when an enumeration is stored
+  * (see disk_snapshot_t), and keeps each column in an array of its own: the values a row emitter
+  * (rowemit.h) copies to the client, with the length of every text value beside it.
+  *
+  * Values are exactly what xp_DiskId always sent:
+  *     controller      num_controller
+  *     model, serial   the characters of the field and its terminating NUL
+  *     duuid           crc64 over the raw disk_t (legacy id, see DiskInfo::getFingerprint())
+  *     size            sectors
+  *
+  * A call that sends only some columns builds only those (see assign()); the duuid, which hashes
+  * the whole record, is the one worth leaving out.
+  */
+
+#ifndef __Utils_DISKROWS_
+#define __Utils_DISKROWS_
+
+#include <vector>
+
+#include "diskid.h"
+
+namespace Utils
+{
+    class ProbeStats;
+    class RowEmitter;
+
+       //  columns of xp_DiskId, in the order it has always sent them
+    enum disk_column_t
+    {
+        DISK_COL_CONTROLLER = 0,
+        DISK_COL_MODEL,
+        DISK_COL_SERIAL,
+        DISK_COL_DUUID,
+        DISK_COL_SIZE,
+        DISK_COLUMNS
+    };
+#define  DISK_COL_BIT( col )    ( 1u << (col) )
+#define  DISK_COL_ALL           ( DISK_COL_BIT( DISK_COLUMNS ) - 1 )
+
+       //  name of a column as xp_DiskId describes it, nullptr past the last
+    const char *diskColumnName( int col );
+
+    class DiskRows
+    {
+        public:
+            DiskRows() : m_nRows( 0 ), m_columns( 0 ), m_cbModelStride( 1 ), m_cbSerialStride( 1 ) {}
+
+               //  owners: physical drive of each record, for the crc timings of pStats (may be nullptr);
+               //  columns: DISK_COL_BIT()s of the columns to build, the others stay empty
+            void    assign( const std::vector<disk_t> &_disk, const std::vector<int> &owners, ProbeStats *pStats = nullptr,
+                            unsigned columns = DISK_COL_ALL );
+            void    clear();
+
+            size_t  size() const                        { return m_nRows; }
+            bool    empty() const                       { return 0 == m_nRows; }
+            bool    has( int col ) const                { return 0 != ( m_columns & DISK_COL_BIT( col ) ); }
+
+               //  columns; text values of row i start at i * stride and are lengths()[i] bytes long
+            const int      *controller() const          { return m_controller.empty() ? nullptr : &m_controller[0]; }
+            const char     *model() const               { return m_model.empty() ? nullptr : &m_model[0]; }
+            size_t          modelStride() const         { return m_cbModelStride; }
+            const __int32  *modelLengths() const        { return m_cbModel.empty() ? nullptr : &m_cbModel[0]; }
+            const char     *serial() const              { return m_serial.empty() ? nullptr : &m_serial[0]; }
+            size_t          serialStride() const        { return m_cbSerialStride; }
+            const __int32  *serialLengths() const       { return m_cbSerial.empty() ? nullptr : &m_cbSerial[0]; }
+            const __int64  *duuid() const               { return m_duuid.empty() ? nullptr : &m_duuid[0]; }
+            const __int64  *sectors() const             { return m_sectors.empty() ? nullptr : &m_sectors[0]; }
+
+        private:
+            size_t                  m_nRows;
+            unsigned                m_columns;      // built, DISK_COL_BIT()s
+            std::vector<int>        m_controller;
+            std::vector<char>       m_model;
+            std::vector<__int32>    m_cbModel;
+            size_t                  m_cbModelStride;
+            std::vector<char>       m_serial;
+            std::vector<__int32>    m_cbSerial;
+            size_t                  m_cbSerialStride;
+            std::vector<__int64>    m_duuid;
+            std::vector<__int64>    m_sectors;
+    };
+
+       //  describes column col of _rows to emitter as xp_DiskId has always sent it, and binds it
+    bool    bindDiskColumn( RowEmitter &emitter, const DiskRows &_rows, int col );
+};
+
+#endif
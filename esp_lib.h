@@ -16,6 +16,7 @@
 #define DBNTWIN32
 
 //Include ODS headers
+#ifdef _WIN32
 #ifdef __cplusplus
 extern "C" {
 #endif 
@@ -28,6 +29,9 @@ extern "C" {
 #ifdef __cplusplus
 }
 #endif 
+#else
+#include "odsstub.h"	// in-process stand-in, for tests and benchmarks
+#endif
 
 #define XP_NOERROR              0
 #define XP_ERROR                1
@@ -0,0 +1,89 @@
+//  hash128.cpp
+
+
+#include <string.h>
+
+#include "hash128.h"
+
+//-------------------------------------------------------------------------------------------------
+static inline unsigned __int64 rotl64( unsigned __int64 x, int r )
+{
+    return (x << r) | (x >> (64 - r));
+}
+//-------------------------------------------------------------------------------------------------
+static inline unsigned __int64 fmix64( unsigned __int64 k )
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+//-------------------------------------------------------------------------------------------------
+hash128_t  hash128( const void *data, const size_t len, const unsigned __int32 seed )
+{
+    const unsigned char    *p  = (const unsigned char *)data;
+    const size_t            nblocks = len / 16;
+    const unsigned __int64  c1 = 0x87c37b91114253d5ULL;
+    const unsigned __int64  c2 = 0x4cf5ad432745937fULL;
+
+    unsigned __int64 h1 = seed;
+    unsigned __int64 h2 = seed;
+
+    for( size_t i = 0; i < nblocks; i++, p += 16 )
+    {
+        unsigned __int64 k1 = 0;
+        unsigned __int64 k2 = 0;
+        ::memcpy( &k1, p,     sizeof(k1) );
+        ::memcpy( &k2, p + 8, sizeof(k2) );
+
+        k1 *= c1; k1 = rotl64( k1, 31 ); k1 *= c2; h1 ^= k1;
+        h1 = rotl64( h1, 27 ); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= c2; k2 = rotl64( k2, 33 ); k2 *= c1; h2 ^= k2;
+        h2 = rotl64( h2, 31 ); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    unsigned __int64 k1 = 0;
+    unsigned __int64 k2 = 0;
+
+       //  the tail from its last byte down: every case falls through to the next
+    switch( len & 15 )
+    {
+    case 15: k2 ^= (unsigned __int64)p[14] << 48;   // fall through
+    case 14: k2 ^= (unsigned __int64)p[13] << 40;   // fall through
+    case 13: k2 ^= (unsigned __int64)p[12] << 32;   // fall through
+    case 12: k2 ^= (unsigned __int64)p[11] << 24;   // fall through
+    case 11: k2 ^= (unsigned __int64)p[10] << 16;   // fall through
+    case 10: k2 ^= (unsigned __int64)p[ 9] << 8;    // fall through
+    case  9: k2 ^= (unsigned __int64)p[ 8];
+             k2 *= c2; k2 = rotl64( k2, 33 ); k2 *= c1; h2 ^= k2;
+             // fall through
+    case  8: k1 ^= (unsigned __int64)p[ 7] << 56;   // fall through
+    case  7: k1 ^= (unsigned __int64)p[ 6] << 48;   // fall through
+    case  6: k1 ^= (unsigned __int64)p[ 5] << 40;   // fall through
+    case  5: k1 ^= (unsigned __int64)p[ 4] << 32;   // fall through
+    case  4: k1 ^= (unsigned __int64)p[ 3] << 24;   // fall through
+    case  3: k1 ^= (unsigned __int64)p[ 2] << 16;   // fall through
+    case  2: k1 ^= (unsigned __int64)p[ 1] << 8;    // fall through
+    case  1: k1 ^= (unsigned __int64)p[ 0];
+             k1 *= c1; k1 = rotl64( k1, 31 ); k1 *= c2; h1 ^= k1;
+    }
+
+    h1 ^= (unsigned __int64)len;
+    h2 ^= (unsigned __int64)len;
+
+    h1 += h2;
+    h2 += h1;
+
+    h1 = fmix64( h1 );
+    h2 = fmix64( h2 );
+
+    h1 += h2;
+    h2 += h1;
+
+    hash128_t h = { h1, h2 };
+    return h;
+}
+//-------------------------------------------------------------------------------------------------
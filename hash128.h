@@ -0,0 +1,19 @@
+/*
+ * hash128.h
+ */
+
+#ifndef __HASH128_H_INCLUDED
+#define __HASH128_H_INCLUDED
+
+#include <stddef.h>
+
+struct hash128_t
+{
+    unsigned __int64  lo;
+    unsigned __int64  hi;
+};
+
+    //  MurmurHash3 x64/128 (public domain, Austin Appleby); output is the same on x86 and x64 builds
+hash128_t  hash128( const void *data, const size_t len, const unsigned __int32 seed = 0 );
+
+#endif // __HASH128_H_INCLUDED
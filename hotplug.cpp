@@ -0,0 +1,512 @@
+/** @file
+  * EpsDiskId/hotplug.cpp
+  *
+  * Disk arrival and removal events.
+  */
+
+#include <string.h>
+
+#ifdef _WIN32
+#   include <windows.h>
+#   include <dbt.h>
+#else
+#   include <errno.h>
+#   include <fcntl.h>
+#   include <poll.h>
+#   include <pthread.h>
+#   include <unistd.h>
+#   include <sys/socket.h>
+#   include <linux/netlink.h>
+#endif
+
+#include "hotplug.h"
+
+namespace Utils
+{
+    struct device_queue_sync_t
+    {
+#ifdef _WIN32
+        CRITICAL_SECTION    cs;
+        HANDLE              hReady;     // manual reset: set while events are queued or after stop()
+#else
+        pthread_mutex_t     lock;
+        pthread_cond_t      ready;
+#endif
+    };
+
+    //----------------------------------------------------------------------------------------------------------------------
+    DeviceEventQueue::DeviceEventQueue()
+        : m_sync( new device_queue_sync_t )
+        , m_bStopped( false )
+    {
+#ifdef _WIN32
+        ::InitializeCriticalSection( &m_sync->cs );
+        m_sync->hReady = ::CreateEventW( nullptr, TRUE, FALSE, nullptr );
+#else
+        ::pthread_mutex_init( &m_sync->lock, nullptr );
+        ::pthread_cond_init( &m_sync->ready, nullptr );
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    DeviceEventQueue::~DeviceEventQueue()
+    {
+#ifdef _WIN32
+        if( nullptr != m_sync->hReady )
+        {
+            ::CloseHandle( m_sync->hReady );
+        }
+        ::DeleteCriticalSection( &m_sync->cs );
+#else
+        ::pthread_cond_destroy( &m_sync->ready );
+        ::pthread_mutex_destroy( &m_sync->lock );
+#endif
+        delete m_sync;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void DeviceEventQueue::push( const device_event_t &event )
+    {
+#ifdef _WIN32
+        ::EnterCriticalSection( &m_sync->cs );
+        m_events.push_back( event );
+        ::SetEvent( m_sync->hReady );
+        ::LeaveCriticalSection( &m_sync->cs );
+#else
+        ::pthread_mutex_lock( &m_sync->lock );
+        m_events.push_back( event );
+        ::pthread_cond_signal( &m_sync->ready );
+        ::pthread_mutex_unlock( &m_sync->lock );
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool DeviceEventQueue::next( device_event_t &event )
+    {
+#ifdef _WIN32
+        if( nullptr == m_sync->hReady )
+        {
+            return false;
+        }
+        for( ;; )
+        {
+            ::EnterCriticalSection( &m_sync->cs );
+            if( m_bStopped )
+            {
+                ::LeaveCriticalSection( &m_sync->cs );
+                return false;
+            }
+            if( !m_events.empty() )
+            {
+                event = m_events.front();
+                m_events.pop_front();
+                if( m_events.empty() )
+                {
+                    ::ResetEvent( m_sync->hReady );
+                }
+                ::LeaveCriticalSection( &m_sync->cs );
+                return true;
+            }
+            ::LeaveCriticalSection( &m_sync->cs );
+            ::WaitForSingleObject( m_sync->hReady, INFINITE );
+        }
+#else
+        ::pthread_mutex_lock( &m_sync->lock );
+        while( !m_bStopped && m_events.empty() )
+        {
+            ::pthread_cond_wait( &m_sync->ready, &m_sync->lock );
+        }
+        const bool ok = !m_bStopped;
+        if( ok )
+        {
+            event = m_events.front();
+            m_events.pop_front();
+        }
+        ::pthread_mutex_unlock( &m_sync->lock );
+        return ok;
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void DeviceEventQueue::stop()
+    {
+#ifdef _WIN32
+        ::EnterCriticalSection( &m_sync->cs );
+        m_bStopped = true;
+        if( nullptr != m_sync->hReady )
+        {
+            ::SetEvent( m_sync->hReady );
+        }
+        ::LeaveCriticalSection( &m_sync->cs );
+#else
+        ::pthread_mutex_lock( &m_sync->lock );
+        m_bStopped = true;
+        ::pthread_cond_broadcast( &m_sync->ready );
+        ::pthread_mutex_unlock( &m_sync->lock );
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    //  what names a drive across enumerations: \\.\PhysicalDriveN on Windows, the kernel name on Linux
+#ifdef _WIN32
+    static const std::wstring &deviceKey( const device_t &device ) { return device.path; }
+#else
+    static const std::string  &deviceKey( const device_t &device ) { return device.name; }
+#endif
+    //----------------------------------------------------------------------------------------------------------------------
+    static const device_t *findDevice( const std::vector<device_t> &devices, const device_t &device )
+    {
+        for( size_t i = 0; i < devices.size(); i++ )
+        {
+            if( deviceKey( devices[i] ) == deviceKey( device ) )
+            {
+                return &devices[i];
+            }
+        }
+        return nullptr;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void diffDevices( const std::vector<device_t> &before, const std::vector<device_t> &after,
+                      std::vector<device_event_t> &events )
+    {
+        events.clear();
+        for( size_t i = 0; i < before.size(); i++ )
+        {
+            const device_t *now = findDevice( after, before[i] );
+            if( nullptr == now )
+            {
+                events.push_back( device_event_t( DEVICE_REMOVED, before[i] ) );
+            }
+            else if( now->index != before[i].index )
+            {
+                events.assign( 1, device_event_t() );
+                return;
+            }
+        }
+        for( size_t i = 0; i < after.size(); i++ )
+        {
+            if( nullptr == findDevice( before, after[i] ) )
+            {
+                events.push_back( device_event_t( DEVICE_ARRIVED, after[i] ) );
+            }
+        }
+    }
+
+#ifdef _WIN32
+       //  GUID_DEVINTERFACE_DISK from ntddstor.h
+    static const GUID s_guidDiskInterface = { 0x53f56307, 0xb6bf, 0x11d0, { 0x94, 0xf2, 0x00, 0xa0, 0xc9, 0x1e, 0xfb, 0x8b } };
+    static const wchar_t s_szWindowClass[] = L"EpsDiskIdDeviceChange";
+
+       //  Message-only window on its own thread, turning WM_DEVICECHANGE into queued events
+    class WinDeviceEventSource : public DeviceEventQueue
+    {
+        public:
+            WinDeviceEventSource() : m_hThread( nullptr ), m_dwThreadId( 0 ), m_hStarted( nullptr ), m_bListening( false ), m_bKnown( false ) {}
+
+            virtual ~WinDeviceEventSource()
+            {
+                stop();
+                if( nullptr != m_hThread )
+                {
+                    ::WaitForSingleObject( m_hThread, INFINITE );
+                    ::CloseHandle( m_hThread );
+                }
+            }
+            //------------------------------------------------------------------------------------------------------------------
+            bool start()
+            {
+                m_bKnown   = enumPhysicalDrives( m_known );
+                m_hStarted = ::CreateEventW( nullptr, TRUE, FALSE, nullptr );
+                if( nullptr == m_hStarted )
+                {
+                    return false;
+                }
+                m_hThread = ::CreateThread( nullptr, 0, pumpThread, this, 0, &m_dwThreadId );
+                if( nullptr != m_hThread )
+                {
+                    ::WaitForSingleObject( m_hStarted, INFINITE );
+                }
+                ::CloseHandle( m_hStarted );
+                m_hStarted = nullptr;
+                return m_bListening;
+            }
+            //------------------------------------------------------------------------------------------------------------------
+            virtual void stop()
+            {
+                DeviceEventQueue::stop();
+                if( 0 != m_dwThreadId )
+                {
+                    ::PostThreadMessageW( m_dwThreadId, WM_QUIT, 0, 0 );
+                }
+            }
+
+        private:
+            //------------------------------------------------------------------------------------------------------------------
+            void onChange()
+            {
+                std::vector<device_t>       now;
+                std::vector<device_event_t> events;
+
+                if( !enumPhysicalDrives( now ) )
+                {
+                    m_bKnown = false;
+                    push( device_event_t() );
+                    return;
+                }
+                if( m_bKnown )
+                {
+                    diffDevices( m_known, now, events );
+                }
+                else
+                {
+                    events.assign( 1, device_event_t() );
+                }
+                m_known.swap( now );
+                m_bKnown = true;
+                for( size_t i = 0; i < events.size(); i++ )
+                {
+                    push( events[i] );
+                }
+            }
+            //------------------------------------------------------------------------------------------------------------------
+            static LRESULT CALLBACK windowProc( HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam )
+            {
+                if( WM_DEVICECHANGE == uMsg && ( DBT_DEVICEARRIVAL == wParam || DBT_DEVICEREMOVECOMPLETE == wParam ) )
+                {
+                    PDEV_BROADCAST_HDR       pHdr = (PDEV_BROADCAST_HDR)lParam;
+                    WinDeviceEventSource    *self = (WinDeviceEventSource*)::GetWindowLongPtrW( hWnd, GWLP_USERDATA );
+
+                    if( nullptr != pHdr && nullptr != self && DBT_DEVTYP_DEVICEINTERFACE == pHdr->dbch_devicetype )
+                    {
+                        self->onChange();
+                    }
+                    return TRUE;
+                }
+                return ::DefWindowProcW( hWnd, uMsg, wParam, lParam );
+            }
+            //------------------------------------------------------------------------------------------------------------------
+            static DWORD WINAPI pumpThread( LPVOID pParam )
+            {
+                WinDeviceEventSource *self = (WinDeviceEventSource*)pParam;
+                MSG                   msg;
+
+                    // the message queue must exist before stop() can post WM_QUIT to it
+                ::PeekMessageW( &msg, nullptr, WM_USER, WM_USER, PM_NOREMOVE );
+
+                    // the window procedure lives in this module, so the class belongs to it too
+                MEMORY_BASIC_INFORMATION mbi = {0x00};
+                ::VirtualQuery( (LPCVOID)&windowProc, &mbi, sizeof(mbi) );
+                HINSTANCE hInstance = (HINSTANCE)mbi.AllocationBase;
+
+                WNDCLASSEXW wc = {0x00};
+                wc.cbSize        = sizeof(wc);
+                wc.lpfnWndProc   = windowProc;
+                wc.hInstance     = hInstance;
+                wc.lpszClassName = s_szWindowClass;
+                ::RegisterClassExW( &wc );          // ERROR_CLASS_ALREADY_EXISTS is fine
+
+                HWND        hWnd    = ::CreateWindowExW( 0, s_szWindowClass, L"", 0, 0, 0, 0, 0, HWND_MESSAGE, nullptr, hInstance, nullptr );
+                HDEVNOTIFY  hNotify = nullptr;
+                if( nullptr != hWnd )
+                {
+                    ::SetWindowLongPtrW( hWnd, GWLP_USERDATA, (LONG_PTR)self );
+
+                    DEV_BROADCAST_DEVICEINTERFACE_W filter;
+                    ::memset( &filter, 0, sizeof(filter) );
+                    filter.dbcc_size       = sizeof(filter);
+                    filter.dbcc_devicetype = DBT_DEVTYP_DEVICEINTERFACE;
+                    filter.dbcc_classguid  = s_guidDiskInterface;
+                    hNotify = ::RegisterDeviceNotificationW( hWnd, &filter, DEVICE_NOTIFY_WINDOW_HANDLE );
+                }
+                self->m_bListening = ( nullptr != hNotify );
+                ::SetEvent( self->m_hStarted );
+
+                if( nullptr != hNotify )
+                {
+                    while( ::GetMessageW( &msg, nullptr, 0, 0 ) > 0 )
+                    {
+                        ::DispatchMessageW( &msg );
+                    }
+                    ::UnregisterDeviceNotification( hNotify );
+                }
+                if( nullptr != hWnd )
+                {
+                    ::DestroyWindow( hWnd );
+                }
+                ::UnregisterClassW( s_szWindowClass, hInstance );
+                return 0;
+            }
+
+            HANDLE                  m_hThread;
+            DWORD                   m_dwThreadId;
+            HANDLE                  m_hStarted;
+            volatile bool           m_bListening;
+            std::vector<device_t>   m_known;        // touched by the pump thread only after start()
+            bool                    m_bKnown;
+    };
+    //----------------------------------------------------------------------------------------------------------------------
+    DeviceEventSource *createSystemDeviceEventSource()
+    {
+        WinDeviceEventSource *source = new WinDeviceEventSource;
+        if( !source->start() )
+        {
+            delete source;
+            return nullptr;
+        }
+        return source;
+    }
+#else
+       //  Kernel uevents; next() reads the socket itself, so no thread of its own is needed
+    class NetlinkDeviceEventSource : public DeviceEventSource
+    {
+        public:
+            NetlinkDeviceEventSource() : m_fd( -1 ), m_bStopped( false ), m_bKnown( false )
+            {
+                m_wake[0] = m_wake[1] = -1;
+            }
+
+            virtual ~NetlinkDeviceEventSource()
+            {
+                if( m_fd >= 0 )         ::close( m_fd );
+                if( m_wake[0] >= 0 )    ::close( m_wake[0] );
+                if( m_wake[1] >= 0 )    ::close( m_wake[1] );
+            }
+            //------------------------------------------------------------------------------------------------------------------
+            bool start()
+            {
+                m_fd = ::socket( AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT );
+                if( m_fd < 0 || 0 != ::pipe( m_wake ) )
+                {
+                    return false;
+                }
+                struct sockaddr_nl addr;
+                ::memset( &addr, 0, sizeof(addr) );
+                addr.nl_family = AF_NETLINK;
+                addr.nl_groups = 1;                 // kernel broadcasts, not the ones relayed by udevd
+                if( 0 != ::bind( m_fd, (struct sockaddr*)&addr, sizeof(addr) ) )
+                {
+                    return false;
+                }
+                m_bKnown = enumPhysicalDrives( m_known );
+                return true;
+            }
+            //------------------------------------------------------------------------------------------------------------------
+            virtual bool next( device_event_t &event )
+            {
+                while( !m_bStopped )
+                {
+                    if( !m_pending.empty() )
+                    {
+                        event = m_pending.front();
+                        m_pending.pop_front();
+                        return true;
+                    }
+                    struct pollfd fds[2];
+                    fds[0].fd = m_fd;       fds[0].events = POLLIN; fds[0].revents = 0;
+                    fds[1].fd = m_wake[0];  fds[1].events = POLLIN; fds[1].revents = 0;
+                    if( ::poll( fds, 2, -1 ) < 0 )
+                    {
+                        if( EINTR == errno )
+                        {
+                            continue;
+                        }
+                        return false;
+                    }
+                    if( fds[1].revents )
+                    {
+                        break;
+                    }
+                    char    buffer[8192];
+                    ssize_t cb = ::recv( m_fd, buffer, sizeof(buffer) - 1, MSG_DONTWAIT );
+                    if( cb < 0 )
+                    {
+                        if( ENOBUFS == errno )              // the kernel dropped uevents
+                        {
+                            m_bKnown = false;
+                            onChange();
+                        }
+                        continue;
+                    }
+                    buffer[cb] = '\0';
+                    if( isDiskEvent( buffer, (size_t)cb ) )
+                    {
+                        onChange();
+                    }
+                }
+                return false;
+            }
+            //------------------------------------------------------------------------------------------------------------------
+            virtual void stop()
+            {
+                m_bStopped = true;
+                if( m_wake[1] >= 0 )
+                {
+                    ssize_t cb = ::write( m_wake[1], "", 1 );
+                    (void)cb;
+                }
+            }
+
+        private:
+            //------------------------------------------------------------------------------------------------------------------
+            //  "add@/devices/...\0ACTION=add\0SUBSYSTEM=block\0DEVTYPE=disk\0DEVNAME=sda\0..."
+            static bool isDiskEvent( const char *msg, size_t cb )
+            {
+                bool bAction = false, bBlock = false, bDisk = false;
+                for( size_t i = 0; i < cb; i += ::strlen( msg + i ) + 1 )
+                {
+                    const char *kv = msg + i;
+                    if( 0 == ::strcmp( kv, "ACTION=add" ) || 0 == ::strcmp( kv, "ACTION=remove" ) )
+                    {
+                        bAction = true;
+                    }
+                    else if( 0 == ::strcmp( kv, "SUBSYSTEM=block" ) )
+                    {
+                        bBlock = true;
+                    }
+                    else if( 0 == ::strcmp( kv, "DEVTYPE=disk" ) )
+                    {
+                        bDisk = true;
+                    }
+                }
+                return bAction && bBlock && bDisk;
+            }
+            //------------------------------------------------------------------------------------------------------------------
+            void onChange()
+            {
+                std::vector<device_t>       now;
+                std::vector<device_event_t> events;
+
+                if( !enumPhysicalDrives( now ) )
+                {
+                    m_bKnown = false;
+                    m_pending.push_back( device_event_t() );
+                    return;
+                }
+                if( m_bKnown )
+                {
+                    diffDevices( m_known, now, events );
+                }
+                else
+                {
+                    events.assign( 1, device_event_t() );
+                }
+                m_known.swap( now );
+                m_bKnown = true;
+                m_pending.insert( m_pending.end(), events.begin(), events.end() );
+            }
+
+            int                         m_fd;
+            int                         m_wake[2];
+            volatile bool               m_bStopped;
+            std::deque<device_event_t>  m_pending;
+            std::vector<device_t>       m_known;
+            bool                        m_bKnown;
+    };
+    //----------------------------------------------------------------------------------------------------------------------
+    DeviceEventSource *createSystemDeviceEventSource()
+    {
+        NetlinkDeviceEventSource *source = new NetlinkDeviceEventSource;
+        if( !source->start() )
+        {
+            delete source;
+            return nullptr;
+        }
+        return source;
+    }
+#endif
+};
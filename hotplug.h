@@ -0,0 +1,83 @@
+/** @file
+  * EpsDiskId/hotplug.h
+  *
+  * Disk arrival and removal events.
+  *
+  * Windows: WM_DEVICECHANGE for the disk device interface, received by a message-only window.
+  * Linux:   kernel uevents of the block subsystem read from a NETLINK_KOBJECT_UEVENT socket.
+  *
+  * A notification only says that something changed; the source then lists the drives again
+  * (no device I/O) and reports the difference to the list it knew, one event per drive.
+  * DeviceEventQueue takes events from anywhere and is what tests feed instead of the OS.
+  */
+
+#ifndef __Utils_HOTPLUG_
+#define __Utils_HOTPLUG_
+
+#include <deque>
+#include <vector>
+
+#include "devenum.h"
+
+namespace Utils
+{
+    enum device_event_kind_t
+    {
+        DEVICE_ARRIVED  = 0,
+        DEVICE_REMOVED  = 1,
+        DEVICE_RESCAN   = 2     // events were lost or drives were renumbered: refresh everything
+    };
+
+    struct device_event_t
+    {
+        device_event_kind_t     kind;
+        device_t                device;     // not set for DEVICE_RESCAN
+
+        device_event_t() : kind( DEVICE_RESCAN ) {}
+        device_event_t( device_event_kind_t k, const device_t &dev ) : kind( k ), device( dev ) {}
+    };
+
+    class DeviceEventSource
+    {
+        public:
+            virtual         ~DeviceEventSource() {}
+
+               //  Blocks until the next event; false once stop() was called
+            virtual bool    next( device_event_t &event ) = 0;
+
+               //  Makes a blocked and every later next() return false; callable from any thread
+            virtual void    stop() = 0;
+    };
+
+       //  Events pushed by the program itself.  Used as is to inject events in tests, and as the
+       //  hand-over point between the Windows notification thread and the consumer.
+    class DeviceEventQueue : public DeviceEventSource
+    {
+        public:
+                            DeviceEventQueue();
+            virtual         ~DeviceEventQueue();
+
+            void            push( const device_event_t &event );
+
+            virtual bool    next( device_event_t &event );
+            virtual void    stop();
+
+        private:
+                                DeviceEventQueue( const DeviceEventQueue& );
+            DeviceEventQueue&   operator=( const DeviceEventQueue& );
+
+            struct device_queue_sync_t *m_sync;
+            std::deque<device_event_t>  m_events;
+            bool                        m_bStopped;
+    };
+
+       //  Events for the drives in before and not in after and vice versa.  A drive whose index
+       //  changed yields a single DEVICE_RESCAN instead, since records keyed by index went stale.
+    void    diffDevices( const std::vector<device_t> &before, const std::vector<device_t> &after,
+                         std::vector<device_event_t> &events );
+
+       //  Listener on the OS notifications, or nullptr if they are not available here
+    DeviceEventSource  *createSystemDeviceEventSource();
+};
+
+#endif
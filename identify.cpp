@@ -0,0 +1,81 @@
+/** @file
+  * EpsDiskId/identify.cpp
+  *
+  * Read-only view of an ATA IDENTIFY DEVICE sector.
+  */
+
+#include <string.h>
+
+#include "identify.h"
+#include "ataconv.h"
+
+namespace Utils
+{
+    //----------------------------------------------------------------------------------------------------------------------
+       // character k of a field is byte k ^ 1 of it: each word holds its first character in the high byte
+    char ata_string_t::at( size_t i ) const
+    {
+        return ( i < length ) ? (char)raw[( first + i ) ^ 1] : '\0';
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t ata_string_t::copyTo( char *dst, size_t cbDst ) const
+    {
+        if( nullptr == dst || 0 == cbDst )
+        {
+            return 0;
+        }
+        const size_t n = ( length < cbDst - 1 ) ? length : cbDst - 1;
+        ataSwapCopy( raw, first, n, dst );
+        dst[n] = '\0';
+        return n;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    ata_string_t ata_string_t::skipLeadingBlanks() const
+    {
+        ata_string_t view = *this;
+        for( size_t i = 0; i < length; i++ )
+        {
+            if( ' ' != at( i ) )
+            {
+                view.first  += i;
+                view.length -= i;
+                break;
+            }
+        }
+        return view;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    ata_string_t IdentifyView::field( size_t firstWord, size_t lastWord ) const
+    {
+        ata_string_t view;
+        view.raw    = m_raw + 2 * firstWord;
+        view.first  = 0;
+        view.length = ataStringLength( view.raw, 2 * ( lastWord - firstWord + 1 ) );
+        return view;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    int IdentifyView::mediaType() const
+    {
+        const unsigned __int16 config = word( 0 );
+        if( config & 0x0080 )
+        {
+            return 0;       // REMOVABLE_DISK
+        }
+        if( config & 0x0040 )
+        {
+            return 1;       // FIXED_DISK
+        }
+        return -1;          // UNKNOWN_DISK
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    __int64 IdentifyView::sectors() const
+    {
+        if( lba48() )
+        {
+            return (__int64)( ( (unsigned __int64)word( 103 ) << 48 ) | ( (unsigned __int64)word( 102 ) << 32 ) |
+                              ( (unsigned __int64)word( 101 ) << 16 ) |   (unsigned __int64)word( 100 ) );
+        }
+        return (__int64)( ( (unsigned __int64)word( 61 ) << 16 ) | word( 60 ) );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+};
@@ -0,0 +1,70 @@
+/** @file
+  * EpsDiskId/identify.h
+  *
+  * Read-only view of an ATA IDENTIFY DEVICE sector (256 little-endian words, 512 bytes).
+  *
+  * Fields are decoded straight from the sector the driver returned: numbers are assembled from
+  * their words on access, and string fields are described by an ata_string_t that points into the
+  * sector.  ATA strings hold two characters per word, high byte first; ata_string_t swaps them
+  * and trims in a single pass when the string is copied to its destination, so nothing is staged
+  * in between.  The sector must stay alive while views of it are used.
+  */
+
+#ifndef __Utils_IDENTIFY_
+#define __Utils_IDENTIFY_
+
+#include <stddef.h>
+
+namespace Utils
+{
+#define  IDENTIFY_SECTOR_WORDS  256
+
+       //  String field of an IDENTIFY sector: the characters [first, first + length) of the field
+       //  in reading order.  Trailing blanks are trimmed (never the first character) and the string
+       //  ends at the first NUL, as the old ConvertToString()/strncpy pair had it.
+    struct ata_string_t
+    {
+        const unsigned __int8  *raw;        // first byte of the field in the sector
+        size_t                  first;
+        size_t                  length;
+
+        char    at( size_t i ) const;                       // i-th character, 0 past the end
+        size_t  copyTo( char *dst, size_t cbDst ) const;    // NUL-terminated, truncated to cbDst-1
+
+           //  the same string without its leading blanks, unless it is all blanks
+        ata_string_t    skipLeadingBlanks() const;
+    };
+
+    class IdentifyView
+    {
+        public:
+            explicit IdentifyView( const void *sector ) : m_raw( (const unsigned __int8 *)sector ) {}
+
+            unsigned __int16    word( size_t index ) const
+            {
+                return (unsigned __int16)( m_raw[2 * index] | ( m_raw[2 * index + 1] << 8 ) );
+            }
+
+            ata_string_t    serial() const      { return field( 10, 19 ); }
+            ata_string_t    firmware() const    { return field( 23, 26 ); }
+            ata_string_t    model() const       { return field( 27, 46 ); }
+
+               //  controller buffer in bytes (word 21, in 512-byte units)
+            unsigned int    bufferSize() const  { return word( 21 ) * 512U; }
+
+               //  REMOVABLE_DISK = 0, FIXED_DISK = 1, UNKNOWN_DISK = -1 (word 0)
+            int             mediaType() const;
+
+               //  user addressable sectors: words 100-103 when 48-bit addressing is supported
+               //  (word 83 bit 10), words 60-61 otherwise
+            bool            lba48() const       { return 0 != ( word( 83 ) & 0x400 ); }
+            __int64         sectors() const;
+
+        private:
+            ata_string_t    field( size_t firstWord, size_t lastWord ) const;
+
+            const unsigned __int8  *m_raw;
+    };
+};
+
+#endif
@@ -0,0 +1,96 @@
+/** @file
+  * EpsDiskId/nvme.cpp
+  *
+  * Read-only views of the NVMe Identify data structures.
+  */
+
+#include <string.h>
+
+#include "nvme.h"
+
+namespace Utils
+{
+#define  NVME_NN_OFFSET         516     // Identify Controller: number of namespaces
+#define  NVME_FLBAS_OFFSET      26      // Identify Namespace: formatted LBA size
+#define  NVME_LBAF_OFFSET       128     // Identify Namespace: LBA format 0, 4 bytes each
+#define  NVME_LBAF_COUNT        64
+
+    //----------------------------------------------------------------------------------------------------------------------
+    static unsigned __int32 dword( const unsigned __int8 *p )
+    {
+        return (unsigned __int32)p[0] | ( (unsigned __int32)p[1] << 8 ) | ( (unsigned __int32)p[2] << 16 ) | ( (unsigned __int32)p[3] << 24 );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t nvme_string_t::copyTo( char *dst, size_t cbDst ) const
+    {
+        if( nullptr == dst || 0 == cbDst )
+        {
+            return 0;
+        }
+        const size_t n = ( length < cbDst - 1 ) ? length : cbDst - 1;
+        ::memcpy( dst, raw, n );
+        dst[n] = '\0';
+        return n;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    nvme_string_t NvmeControllerView::field( size_t offset, size_t cb ) const
+    {
+        const unsigned __int8 *p = m_raw + offset;
+        size_t first = 0;
+        size_t last  = cb;
+
+        while( first < last && ( ' ' == p[first] || '\0' == p[first] ) )
+        {
+            first++;
+        }
+        while( last > first && ( ' ' == p[last - 1] || '\0' == p[last - 1] ) )
+        {
+            last--;
+        }
+        nvme_string_t view;
+        view.raw    = p + first;
+        view.length = last - first;
+        return view;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    unsigned __int32 NvmeControllerView::namespaces() const
+    {
+        return dword( m_raw + NVME_NN_OFFSET );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    unsigned __int64 NvmeNamespaceView::blocks() const
+    {
+        return (unsigned __int64)dword( m_raw ) | ( (unsigned __int64)dword( m_raw + 4 ) << 32 );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // FLBAS bits 3:0 pick the format, bits 6:5 extend the index when there are more than 16
+    unsigned int NvmeNamespaceView::blockSize() const
+    {
+        const unsigned flbas  = m_raw[NVME_FLBAS_OFFSET];
+        const unsigned format = ( flbas & 0x0f ) | ( ( flbas & 0x60 ) >> 1 );
+        if( format >= NVME_LBAF_COUNT )
+        {
+            return 0;
+        }
+        const unsigned lbads = m_raw[NVME_LBAF_OFFSET + 4 * format + 2];
+        return ( lbads >= 9 && lbads < 32 ) ? ( 1U << lbads ) : 0;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t nvmeActiveNamespaces( const void *list, unsigned __int32 *nsids, size_t max )
+    {
+        const unsigned __int8 *p = (const unsigned __int8 *)list;
+        size_t n = 0;
+
+        for( size_t i = 0; i < NVME_NAMESPACE_LIST_MAX && n < max; i++ )
+        {
+            const unsigned __int32 nsid = dword( p + 4 * i );
+            if( 0 == nsid )
+            {
+                break;
+            }
+            nsids[n++] = nsid;
+        }
+        return n;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+};
@@ -0,0 +1,92 @@
+/** @file
+  * EpsDiskId/nvme.h
+  *
+  * Read-only views of the NVMe Identify data structures (4096 bytes each, little endian).
+  *
+  * One Identify command per CNS value:
+  *     NVME_CNS_NAMESPACE          Identify Namespace of the NSID given: size and LBA formats
+  *     NVME_CNS_CONTROLLER         Identify Controller: serial, model, firmware, number of namespaces
+  *     NVME_CNS_ACTIVE_NAMESPACES  up to 1024 active NSIDs above the one given, ascending, ended by 0
+  * All three are sent to the controller, so a controller with many namespaces is described by one
+  * Identify Controller, one namespace list and one Identify Namespace per namespace wanted.
+  *
+  * Strings are ASCII padded with blanks; unlike ATA strings they are not byte swapped.  The data
+  * must stay alive while views of it are used.
+  */
+
+#ifndef __Utils_NVME_
+#define __Utils_NVME_
+
+#include <stddef.h>
+
+namespace Utils
+{
+#define  NVME_IDENTIFY_SIZE             4096
+#define  NVME_ADMIN_IDENTIFY            0x06
+
+#define  NVME_CNS_NAMESPACE             0
+#define  NVME_CNS_CONTROLLER            1
+#define  NVME_CNS_ACTIVE_NAMESPACES     2
+
+#define  NVME_NAMESPACE_LIST_MAX        ( NVME_IDENTIFY_SIZE / 4 )
+
+       //  An admin command as DeviceIo::control( NVME_IOCTL_ADMIN_CMD ) takes it on Linux: the
+       //  backend builds the kernel's nvme_admin_cmd around it and the output buffer
+    struct nvme_admin_t
+    {
+        unsigned __int8     opcode;
+        unsigned __int8     reserved[3];
+        unsigned __int32    nsid;
+        unsigned __int32    cdw10;              // CNS of an Identify
+        unsigned __int32    cdw11;
+    };
+
+       //  String field of an Identify structure, blanks and NULs around it left out
+    struct nvme_string_t
+    {
+        const unsigned __int8  *raw;
+        size_t                  length;
+
+        size_t  copyTo( char *dst, size_t cbDst ) const;    // NUL-terminated, truncated to cbDst-1
+    };
+
+    class NvmeControllerView
+    {
+        public:
+            explicit NvmeControllerView( const void *data ) : m_raw( (const unsigned __int8 *)data ) {}
+
+            unsigned __int16    vendorId() const    { return (unsigned __int16)( m_raw[0] | ( m_raw[1] << 8 ) ); }
+            nvme_string_t       serial() const      { return field( 4, 20 ); }
+            nvme_string_t       model() const       { return field( 24, 40 ); }
+            nvme_string_t       firmware() const    { return field( 64, 8 ); }
+
+               //  NN: the highest NSID the controller may have
+            unsigned __int32    namespaces() const;
+
+        private:
+            nvme_string_t   field( size_t offset, size_t cb ) const;
+
+            const unsigned __int8  *m_raw;
+    };
+
+    class NvmeNamespaceView
+    {
+        public:
+            explicit NvmeNamespaceView( const void *data ) : m_raw( (const unsigned __int8 *)data ) {}
+
+               //  NSZE, in logical blocks of the format in use
+            unsigned __int64    blocks() const;
+               //  bytes per logical block: 2^LBADS of the format FLBAS selects, 0 if it is not valid
+            unsigned int        blockSize() const;
+
+            __int64             size() const        { return (__int64)( blocks() * blockSize() ); }
+
+        private:
+            const unsigned __int8  *m_raw;
+    };
+
+       //  NSIDs of an active namespace list, at most max of them; returns how many
+    size_t  nvmeActiveNamespaces( const void *list, unsigned __int32 *nsids, size_t max );
+};
+
+#endif
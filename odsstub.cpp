@@ -0,0 +1,314 @@
+/** @file
+  * EpsDiskId/odsstub.cpp
+  *
+  * In-process stand-in for the parts of the Open Data Services API the procedures use.
+  */
+
+#ifndef _WIN32
+
+#include <string.h>
+#include <vector>
+
+#include "odsstub.h"
+
+#define  ODS_STUB_MAX_COLUMNS   1024        // as nMaxNumFields in esp_lib.h
+
+struct ods_column_t
+{
+    std::string     name;
+    long            desttype;
+    long            destlen;
+    int             cb;             // srv_setcollen
+    const void     *data;           // srv_setcoldata
+};
+
+struct ods_param_t
+{
+    BYTE                        type;
+    std::vector<unsigned char>  data;
+    bool                        bNull;
+};
+
+struct srv_proc
+{
+    std::vector<ods_column_t>   columns;
+    std::vector<unsigned char>  rows;           // per row and column: 4 byte length, then the bytes
+    std::vector<size_t>         rowAt;          // offset of each row in rows
+    std::vector<ods_param_t>    params;
+    int                         doneStatus;
+    DBINT                       doneCount;
+    DBINT                       msgnum;
+    std::string                 message;
+    size_t                      lenCalls;       // srv_setcollen() since the reset
+    size_t                      dataCalls;      // srv_setcoldata() since the reset
+
+    srv_proc() : doneStatus( -1 ), doneCount( 0 ), msgnum( 0 ), lenCalls( 0 ), dataCalls( 0 ) {}
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+static ods_column_t *column( SRV_PROC *srvproc, int colnumber )
+{
+    if( nullptr == srvproc || colnumber < 1 || (size_t)colnumber > srvproc->columns.size() )
+    {
+        return nullptr;
+    }
+    return &srvproc->columns[colnumber - 1];
+}
+//----------------------------------------------------------------------------------------------------------------------
+int srv_describe( SRV_PROC *srvproc, int colnumber, const char *column_name, int namelen,
+                  long desttype, long destlen, long, long, void *srcdata )
+{
+    if( nullptr == srvproc || colnumber < 1 || colnumber > ODS_STUB_MAX_COLUMNS || !srvproc->rowAt.empty() )
+    {
+        return 0;
+    }
+    if( (size_t)colnumber > srvproc->columns.size() )
+    {
+        srvproc->columns.resize( colnumber );
+    }
+    ods_column_t &col = srvproc->columns[colnumber - 1];
+    col.name     = ( nullptr == column_name ) ? std::string() :
+                   ( SRV_NULLTERM == namelen ) ? std::string( column_name ) : std::string( column_name, namelen );
+    col.desttype = desttype;
+    col.destlen  = destlen;
+    col.cb       = 0;
+    col.data     = srcdata;
+    return colnumber;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int srv_setcollen( SRV_PROC *srvproc, int colnumber, int len )
+{
+    ods_column_t *col = column( srvproc, colnumber );
+    if( nullptr == col || len < 0 )
+    {
+        return FAIL;
+    }
+    srvproc->lenCalls++;
+    col->cb = len;
+    return SUCCEED;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int srv_setcoldata( SRV_PROC *srvproc, int colnumber, void *data )
+{
+    ods_column_t *col = column( srvproc, colnumber );
+    if( nullptr == col )
+    {
+        return FAIL;
+    }
+    srvproc->dataCalls++;
+    col->data = data;
+    return SUCCEED;
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // copies the row as the server would into its TDS buffer; the bound buffers are free again after
+int srv_sendrow( SRV_PROC *srvproc )
+{
+    if( nullptr == srvproc || srvproc->columns.empty() )
+    {
+        return FAIL;
+    }
+    size_t cbRow = 0;
+    for( size_t c = 0; c < srvproc->columns.size(); c++ )
+    {
+        const ods_column_t &col = srvproc->columns[c];
+        if( col.cb > 0 && nullptr == col.data )
+        {
+            return FAIL;
+        }
+        cbRow += sizeof(__int32) + col.cb;
+    }
+    const size_t at = srvproc->rows.size();
+    srvproc->rows.resize( at + cbRow );
+
+    unsigned char *p = &srvproc->rows[at];
+    for( size_t c = 0; c < srvproc->columns.size(); c++ )
+    {
+        const ods_column_t &col = srvproc->columns[c];
+        const __int32       cb  = col.cb;
+
+        ::memcpy( p, &cb, sizeof(cb) );
+        if( cb > 0 )
+        {
+            ::memcpy( p + sizeof(cb), col.data, cb );
+        }
+        p += sizeof(cb) + cb;
+    }
+    srvproc->rowAt.push_back( at );
+    return SUCCEED;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int srv_senddone( SRV_PROC *srvproc, DBUSMALLINT status, DBUSMALLINT, DBINT count )
+{
+    if( nullptr == srvproc )
+    {
+        return FAIL;
+    }
+    srvproc->doneStatus = status;
+    srvproc->doneCount  = count;
+    return SUCCEED;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int srv_sendmsg( SRV_PROC *srvproc, int, DBINT msgnum, DBTINYINT, DBTINYINT,
+                 const char *, int, DBUSMALLINT, const char *message, int msglen )
+{
+    if( nullptr == srvproc )
+    {
+        return FAIL;
+    }
+    srvproc->msgnum  = msgnum;
+    srvproc->message = ( nullptr == message ) ? std::string() :
+                       ( SRV_NULLTERM == msglen ) ? std::string( message ) : std::string( message, msglen );
+    return SUCCEED;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int srv_rpcparams( SRV_PROC *srvproc )
+{
+    return ( nullptr == srvproc ) ? 0 : (int)srvproc->params.size();
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // like the server: pbData NULL asks for type and lengths only
+int srv_paraminfo( SRV_PROC *srvproc, int n, BYTE *pbType, ULONG *pcbMaxLen, ULONG *pcbActualLen,
+                   BYTE *pbData, BOOL *pfNull )
+{
+    if( nullptr == srvproc || n < 1 || (size_t)n > srvproc->params.size() )
+    {
+        return FAIL;
+    }
+    const ods_param_t &param = srvproc->params[n - 1];
+    const ULONG        cb    = param.bNull ? 0 : (ULONG)param.data.size();
+
+    if( nullptr != pbType )       *pbType       = param.type;
+    if( nullptr != pcbMaxLen )    *pcbMaxLen    = (ULONG)param.data.size();
+    if( nullptr != pcbActualLen ) *pcbActualLen = cb;
+    if( nullptr != pfNull )       *pfNull       = param.bNull ? TRUE : FALSE;
+    if( nullptr != pbData && cb > 0 )
+    {
+        ::memcpy( pbData, &param.data[0], cb );
+    }
+    return SUCCEED;
+}
+
+namespace Utils
+{
+    //----------------------------------------------------------------------------------------------------------------------
+    SRV_PROC *odsCreate()
+    {
+        return new srv_proc;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void odsDestroy( SRV_PROC *srvproc )
+    {
+        delete srvproc;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void odsReset( SRV_PROC *srvproc )
+    {
+        srvproc->columns.clear();
+        srvproc->rows.clear();
+        srvproc->rowAt.clear();
+        srvproc->doneStatus = -1;
+        srvproc->doneCount  = 0;
+        srvproc->msgnum     = 0;
+        srvproc->message.clear();
+        srvproc->lenCalls   = 0;
+        srvproc->dataCalls  = 0;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void odsAddParam( SRV_PROC *srvproc, BYTE type, const void *data, ULONG cb, bool bNull )
+    {
+        ods_param_t param;
+        param.type  = type;
+        param.bNull = bNull;
+        if( nullptr != data && cb > 0 )
+        {
+            param.data.assign( (const unsigned char *)data, (const unsigned char *)data + cb );
+        }
+        srvproc->params.push_back( param );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // the narrowest integer type that holds value, as the server passes a literal
+    void odsAddIntParam( SRV_PROC *srvproc, long long value )
+    {
+        if( value >= -2147483647LL - 1 && value <= 2147483647LL )
+        {
+            const __int32 v = (__int32)value;
+            odsAddParam( srvproc, SRVINT4, &v, sizeof(v) );
+            return;
+        }
+        const __int64 v = value;
+        odsAddParam( srvproc, SRVINT8, &v, sizeof(v) );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void odsAddTextParam( SRV_PROC *srvproc, const char *text )
+    {
+        odsAddParam( srvproc, SRVBIGVARCHAR, text, (ULONG)::strlen( text ) );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    int odsColumns( const SRV_PROC *srvproc )
+    {
+        return (int)srvproc->columns.size();
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    std::string odsColumnName( const SRV_PROC *srvproc, int colnumber )
+    {
+        return ( colnumber < 1 || colnumber > odsColumns( srvproc ) ) ? std::string() : srvproc->columns[colnumber - 1].name;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t odsRows( const SRV_PROC *srvproc )
+    {
+        return srvproc->rowAt.size();
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t odsColumnCalls( const SRV_PROC *srvproc, size_t *dataCalls )
+    {
+        if( nullptr != dataCalls )
+        {
+            *dataCalls = srvproc->dataCalls;
+        }
+        return srvproc->lenCalls;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool odsValue( const SRV_PROC *srvproc, size_t row, int colnumber, std::string &value )
+    {
+        value.clear();
+        if( row >= srvproc->rowAt.size() || colnumber < 1 || colnumber > odsColumns( srvproc ) )
+        {
+            return false;
+        }
+        const unsigned char *p = &srvproc->rows[srvproc->rowAt[row]];
+        __int32              cb = 0;
+        for( int c = 1; ; c++ )
+        {
+            ::memcpy( &cb, p, sizeof(cb) );
+            if( c == colnumber )
+            {
+                break;
+            }
+            p += sizeof(cb) + cb;
+        }
+        value.assign( (const char *)p + sizeof(cb), cb );
+        return cb > 0;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    int odsDoneStatus( const SRV_PROC *srvproc )
+    {
+        return srvproc->doneStatus;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    DBINT odsDoneCount( const SRV_PROC *srvproc )
+    {
+        return srvproc->doneCount;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    std::string odsLastMessage( const SRV_PROC *srvproc, DBINT *msgnum )
+    {
+        if( nullptr != msgnum )
+        {
+            *msgnum = srvproc->msgnum;
+        }
+        return srvproc->message;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+};
+
+#endif
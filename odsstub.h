@@ -0,0 +1,102 @@
+/** @file
+  * EpsDiskId/odsstub.h
+  *
+  * In-process stand-in for the parts of the Open Data Services API (srv.h) the procedures use.
+  *
+  * Outside SQL Server there is no srv.h and nobody to send rows to.  This stand-in takes its
+  * place on Linux (esp_lib.h includes it instead of srv.h), so the row emitter and the code that
+  * reads parameters can be built, tested and benchmarked without a server:
+  *     srv_describe / srv_setcollen / srv_setcoldata / srv_sendrow     copy every row into the proc
+  *     srv_senddone / srv_sendmsg                                      keep the last status and messages
+  *     srv_rpcparams / srv_paraminfo                                   answer from odsAddParam()
+  * Type codes and flags have their srv.h values.  A proc is used by one thread at a time, as a
+  * client connection is.
+  */
+
+#ifndef __Utils_ODSSTUB_
+#define __Utils_ODSSTUB_
+
+#ifndef _WIN32
+
+#include <stddef.h>
+#include <string>
+
+typedef struct srv_proc     SRV_PROC;
+typedef int                 RETCODE;
+typedef unsigned char       BYTE;
+typedef unsigned long       ULONG;
+typedef int                 BOOL;
+typedef int                 DBINT;
+typedef unsigned short      DBUSMALLINT;
+typedef unsigned char       DBTINYINT;
+
+#ifndef TRUE
+#define  TRUE               1
+#define  FALSE              0
+#endif
+
+#define  SUCCEED            1
+#define  FAIL               0
+
+#define  SRV_NULLTERM       -1
+
+#define  SRVINTN            0x26
+#define  SRVVARCHAR         0x27
+#define  SRVCHAR            0x2f
+#define  SRVINT1            0x30
+#define  SRVINT2            0x34
+#define  SRVINT4            0x38
+#define  SRVFLT8            0x3e
+#define  SRVINT8            0x7f
+#define  SRVBIGVARCHAR      0xa7
+#define  SRVBIGCHAR         0xaf
+
+#define  SRV_DONE_FINAL     0x0000
+#define  SRV_DONE_MORE      0x0001
+#define  SRV_DONE_ERROR     0x0002
+#define  SRV_DONE_COUNT     0x0010
+
+#define  SRV_INFO           10
+#define  SRV_MSG_INFO       1
+#define  SRV_MSG_ERROR      2
+
+int     srv_describe( SRV_PROC *srvproc, int colnumber, const char *column_name, int namelen,
+                      long desttype, long destlen, long srctype, long srclen, void *srcdata );
+int     srv_setcollen( SRV_PROC *srvproc, int colnumber, int len );
+int     srv_setcoldata( SRV_PROC *srvproc, int colnumber, void *data );
+int     srv_sendrow( SRV_PROC *srvproc );
+int     srv_senddone( SRV_PROC *srvproc, DBUSMALLINT status, DBUSMALLINT curcmd, DBINT count );
+int     srv_sendmsg( SRV_PROC *srvproc, int msgtype, DBINT msgnum, DBTINYINT msgClass, DBTINYINT state,
+                     const char *rpcname, int rpcnamelen, DBUSMALLINT linenum, const char *message, int msglen );
+int     srv_rpcparams( SRV_PROC *srvproc );
+int     srv_paraminfo( SRV_PROC *srvproc, int n, BYTE *pbType, ULONG *pcbMaxLen, ULONG *pcbActualLen,
+                       BYTE *pbData, BOOL *pfNull );
+
+namespace Utils
+{
+    SRV_PROC   *odsCreate();
+    void        odsDestroy( SRV_PROC *srvproc );
+
+       //  drops the result set, status and messages; the parameters stay
+    void        odsReset( SRV_PROC *srvproc );
+
+       //  appends a parameter as a client would pass it; data is copied
+    void        odsAddParam( SRV_PROC *srvproc, BYTE type, const void *data, ULONG cb, bool bNull = false );
+    void        odsAddIntParam( SRV_PROC *srvproc, long long value );
+    void        odsAddTextParam( SRV_PROC *srvproc, const char *text );
+
+       //  what the procedure sent
+    int         odsColumns( const SRV_PROC *srvproc );
+    std::string odsColumnName( const SRV_PROC *srvproc, int colnumber );
+    size_t      odsRows( const SRV_PROC *srvproc );
+       //  srv_setcollen() calls since the proc was created or reset, and srv_setcoldata() calls
+    size_t      odsColumnCalls( const SRV_PROC *srvproc, size_t *dataCalls = nullptr );
+       //  value of a column in a row as sent, false if it was NULL (length 0) or is out of range
+    bool        odsValue( const SRV_PROC *srvproc, size_t row, int colnumber, std::string &value );
+    int         odsDoneStatus( const SRV_PROC *srvproc );
+    DBINT       odsDoneCount( const SRV_PROC *srvproc );
+    std::string odsLastMessage( const SRV_PROC *srvproc, DBINT *msgnum = nullptr );
+};
+
+#endif
+#endif
@@ -0,0 +1,77 @@
+/** @file
+  * EpsDiskId/osutil.cpp
+  *
+  * The few OS services the modules share: a lock and a millisecond tick.
+  */
+
+#ifdef _WIN32
+#   include <windows.h>
+#else
+#   include <pthread.h>
+#   include <time.h>
+#endif
+
+#include "osutil.h"
+
+namespace Utils
+{
+    struct os_lock_t
+    {
+#ifdef _WIN32
+        CRITICAL_SECTION    cs;
+#else
+        pthread_mutex_t     mutex;
+#endif
+    };
+
+    //----------------------------------------------------------------------------------------------------------------------
+    OsLock::OsLock()
+        : m_impl( new os_lock_t )
+    {
+#ifdef _WIN32
+        ::InitializeCriticalSection( &m_impl->cs );
+#else
+        ::pthread_mutex_init( &m_impl->mutex, nullptr );
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    OsLock::~OsLock()
+    {
+#ifdef _WIN32
+        ::DeleteCriticalSection( &m_impl->cs );
+#else
+        ::pthread_mutex_destroy( &m_impl->mutex );
+#endif
+        delete m_impl;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void OsLock::enter()
+    {
+#ifdef _WIN32
+        ::EnterCriticalSection( &m_impl->cs );
+#else
+        ::pthread_mutex_lock( &m_impl->mutex );
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void OsLock::leave()
+    {
+#ifdef _WIN32
+        ::LeaveCriticalSection( &m_impl->cs );
+#else
+        ::pthread_mutex_unlock( &m_impl->mutex );
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    unsigned long tickCount()
+    {
+#ifdef _WIN32
+        return ::GetTickCount();
+#else
+        struct timespec ts;
+        ::clock_gettime( CLOCK_MONOTONIC, &ts );
+        return (unsigned long)( ts.tv_sec * 1000UL + ts.tv_nsec / 1000000UL );
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+};
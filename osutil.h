@@ -0,0 +1,50 @@
+/** @file
+  * EpsDiskId/osutil.h
+  *
+  * The few OS services the modules share: a lock and a millisecond tick.
+  *
+  * Both map to the Win32 calls the DLL always used (CRITICAL_SECTION, GetTickCount) and to
+  * pthreads and CLOCK_MONOTONIC elsewhere.  windows.h stays out of the headers that include this.
+  */
+
+#ifndef __Utils_OSUTIL_
+#define __Utils_OSUTIL_
+
+namespace Utils
+{
+       //  A non-recursive lock for short sections; held through OsLockGuard
+    class OsLock
+    {
+        public:
+            OsLock();
+            ~OsLock();
+
+            void    enter();
+            void    leave();
+
+        private:
+                        OsLock( const OsLock& );
+            OsLock&     operator=( const OsLock& );
+
+            struct os_lock_t   *m_impl;
+    };
+
+       //  Scoped hold of an OsLock
+    class OsLockGuard
+    {
+        public:
+            explicit OsLockGuard( OsLock &lock ) : m_lock( lock )   { m_lock.enter(); }
+            ~OsLockGuard()                                          { m_lock.leave(); }
+
+        private:
+                            OsLockGuard( const OsLockGuard& );
+            OsLockGuard&    operator=( const OsLockGuard& );
+
+            OsLock         &m_lock;
+    };
+
+       //  Milliseconds of a monotonic clock; wraps like GetTickCount(), so compare differences only
+    unsigned long   tickCount();
+};
+
+#endif
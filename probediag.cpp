@@ -0,0 +1,111 @@
+/** @file
+  * EpsDiskId/probediag.cpp
+  *
+  * Failures of the probes, kept as small records in a ring of fixed size.
+  */
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#   include <windows.h>
+#else
+#   define  _snprintf  snprintf
+#endif
+
+#include "probediag.h"
+
+namespace Utils
+{
+    //----------------------------------------------------------------------------------------------------------------------
+    ProbeDiagnostics::ProbeDiagnostics()
+        : m_nRecorded( 0 )
+    {
+        ::memset( m_ring, 0, sizeof(m_ring) );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    ProbeDiagnostics::~ProbeDiagnostics()
+    {
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void ProbeDiagnostics::record( probe_op_t op, int device, unsigned long error )
+    {
+        const unsigned long dwTick = tickCount();
+
+        OsLockGuard guard( m_lock );
+        probe_diag_t &entry = m_ring[m_nRecorded % PROBE_DIAG_RING_SIZE];
+        entry.sequence = ++m_nRecorded;
+        entry.dwTick   = dwTick;
+        entry.error    = error;
+        entry.device   = device;
+        entry.op       = op;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t ProbeDiagnostics::copy( probe_diag_t *out, size_t cap ) const
+    {
+        OsLockGuard guard( m_lock );
+        const size_t held  = ( m_nRecorded < PROBE_DIAG_RING_SIZE ) ? m_nRecorded : PROBE_DIAG_RING_SIZE;
+        const size_t count = ( held < cap ) ? held : cap;
+        const size_t first = m_nRecorded - held;
+
+        for( size_t i = 0; i < count; i++ )
+        {
+            out[i] = m_ring[( first + i ) % PROBE_DIAG_RING_SIZE];
+        }
+        return count;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void ProbeDiagnostics::clear()
+    {
+        OsLockGuard guard( m_lock );
+        m_nRecorded = 0;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    const char *ProbeDiagnostics::opName( int op )
+    {
+        switch( op )
+        {
+            case PROBE_OP_OPEN_DRIVE:       return "open physical drive";
+            case PROBE_OP_OPEN_PORT:        return "open SCSI port";
+            case PROBE_OP_GET_VERSION:      return "DFP_GET_VERSION";
+            case PROBE_OP_QUERY_PROPERTY:   return "IOCTL_STORAGE_QUERY_PROPERTY";
+            case PROBE_OP_MEDIA_SERIAL:     return "IOCTL_STORAGE_GET_MEDIA_SERIAL_NUMBER";
+            case PROBE_OP_TIMED_OUT:        return "deadline";
+            case PROBE_OP_IDENTIFY:         return "ATA IDENTIFY";
+            case PROBE_OP_NVME_IDENTIFY:    return "NVMe Identify";
+        }
+        return "unknown";
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t ProbeDiagnostics::describe( const probe_diag_t &diag, char *text, size_t cb )
+    {
+        if( nullptr == text || 0 == cb )
+        {
+            return 0;
+        }
+        const char *reason = "";
+#ifdef _WIN32
+        switch( diag.error )
+        {
+            case ERROR_INVALID_FUNCTION:    reason = ", the request is not valid for this device";      break;
+            case ERROR_FILE_NOT_FOUND:      reason = ", no such device";                                 break;
+            case ERROR_ACCESS_DENIED:       reason = ", access denied";                                  break;
+            case ERROR_NOT_SUPPORTED:       reason = ", the request is not supported for this device";  break;
+        }
+#endif
+
+        int cch = 0;
+        if( PROBE_OP_TIMED_OUT == diag.op )
+        {
+            cch = ::_snprintf( text, cb - 1, "Device %d timed out and was skipped", diag.device );
+        }
+        else
+        {
+            cch = ::_snprintf( text, cb - 1, "%s failed for device %d, error %lu%s",
+                               opName( diag.op ), diag.device, diag.error, reason );
+        }
+        text[cb - 1] = '\0';
+        return ( cch < 0 || (size_t)cch >= cb ) ? ::strlen( text ) : (size_t)cch;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+};
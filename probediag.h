@@ -0,0 +1,72 @@
+/** @file
+  * EpsDiskId/probediag.h
+  *
+  * Failures of the probes, kept as small records in a ring of fixed size.
+  *
+  * A probe that cannot open a device, or has a request refused, stores what it tried, the device,
+  * the OS error and the time: a few stores under a lock, nothing formatted or allocated.  The ring
+  * keeps the last PROBE_DIAG_RING_SIZE records and overwrites the oldest.  Text is made only for a
+  * reader that asks for it (xp_DiskIdDiagnostics).
+  */
+
+#ifndef __Utils_PROBEDIAG_
+#define __Utils_PROBEDIAG_
+
+#include <stddef.h>
+
+#include "osutil.h"
+
+namespace Utils
+{
+#define  PROBE_DIAG_RING_SIZE  256
+
+    enum probe_op_t
+    {
+        PROBE_OP_OPEN_DRIVE      = 1,   // CreateFile on \\.\PhysicalDriveN
+        PROBE_OP_OPEN_PORT       = 2,   // CreateFile on \\.\ScsiN:
+        PROBE_OP_GET_VERSION     = 3,   // DFP_GET_VERSION, before the SMART IDENTIFY
+        PROBE_OP_QUERY_PROPERTY  = 4,   // IOCTL_STORAGE_QUERY_PROPERTY (device descriptor)
+        PROBE_OP_MEDIA_SERIAL    = 5,   // IOCTL_STORAGE_GET_MEDIA_SERIAL_NUMBER
+        PROBE_OP_TIMED_OUT       = 6,   // the device missed its deadline and was skipped
+        PROBE_OP_IDENTIFY        = 7,   // HDIO_GET_IDENTITY and SG_IO ATA IDENTIFY (Linux), both refused
+        PROBE_OP_NVME_IDENTIFY   = 8    // NVMe Identify Controller or Namespace
+    };
+
+    struct probe_diag_t
+    {
+        unsigned long   sequence;       // 1 for the first record since start or clear()
+        unsigned long   dwTick;         // tick count when recorded
+        unsigned long   error;          // OS error code, 0 if there is none
+        int             device;         // physical drive or SCSI port number
+        int             op;             // probe_op_t
+    };
+
+    class ProbeDiagnostics
+    {
+        public:
+            ProbeDiagnostics();
+            ~ProbeDiagnostics();
+
+            void    record( probe_op_t op, int device, unsigned long error );
+
+               //  up to cap of the records held, oldest first; returns how many were copied
+            size_t  copy( probe_diag_t *out, size_t cap ) const;
+            void    clear();
+
+               //  name of the request, e.g. "IOCTL_STORAGE_QUERY_PROPERTY"
+            static const char  *opName( int op );
+
+               //  one line about a record, NUL-terminated and truncated to cb-1; returns its length
+            static size_t       describe( const probe_diag_t &diag, char *text, size_t cb );
+
+        private:
+                                ProbeDiagnostics( const ProbeDiagnostics& );
+            ProbeDiagnostics&   operator=( const ProbeDiagnostics& );
+
+            mutable OsLock              m_lock;
+            probe_diag_t                m_ring[PROBE_DIAG_RING_SIZE];
+            unsigned long               m_nRecorded;
+    };
+};
+
+#endif
@@ -0,0 +1,508 @@
+/** @file
+  * EpsDiskId/probepool.cpp
+  *
+  * Bounded pool of worker threads for per-device probes.
+  */
+
+#ifdef _WIN32
+#   include <windows.h>
+#else
+#   include <errno.h>
+#   include <pthread.h>
+#   include <sched.h>
+#   include <time.h>
+#endif
+
+#include <vector>
+
+#include "probepool.h"
+
+namespace Utils
+{
+       //  Completion tracking of the workers taking part in one run()
+    struct probe_sync_t
+    {
+        volatile long       running;
+#ifdef _WIN32
+        HANDLE              hIdle;          // manual reset: set when running drops to 0
+#else
+        pthread_mutex_t     lock;
+        pthread_cond_t      idle;
+#endif
+    };
+
+       //  The worker threads of the process, shared by every ProbePool.  run() hands each worker it
+       //  wants a ticket, i.e. a reference on its tasks; a free worker takes it, or a new thread is
+       //  started when none is left free.  A worker inside a task is busy, so one held by a hung
+       //  device is simply not counted, and a fresh one takes its place in later runs.
+    struct probe_workers_t
+    {
+#ifdef _WIN32
+        CRITICAL_SECTION            cs;
+        HANDLE                      hTicket;    // semaphore: a count per ticket and per worker told to leave
+#else
+        pthread_mutex_t             lock;
+        pthread_cond_t              ticket;
+#endif
+        std::vector<ProbeTasks*>    tickets;    // not taken yet
+        size_t                      waiting;    // workers waiting for a ticket
+        size_t                      busy;       // workers inside a ticket
+        size_t                      threads;    // workers alive
+        bool                        bStopped;   // workers leave when done instead of waiting
+
+        probe_workers_t();
+        ~probe_workers_t();
+    };
+
+    static probe_workers_t s_workers;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    static long atomicIncrement( volatile long *p )
+    {
+#ifdef _WIN32
+        return ::InterlockedIncrement( p );
+#else
+        return __sync_add_and_fetch( p, 1 );
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static long atomicDecrement( volatile long *p )
+    {
+#ifdef _WIN32
+        return ::InterlockedDecrement( p );
+#else
+        return __sync_sub_and_fetch( p, 1 );
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    ProbeTasks::ProbeTasks()
+        : m_refs( 1 )
+        , m_next( 0 )
+        , m_cancelled( 0 )
+        , m_count( 0 )
+        , m_sync( new probe_sync_t )
+    {
+        m_sync->running = 0;
+#ifdef _WIN32
+        m_sync->hIdle = ::CreateEventW( nullptr, TRUE, TRUE, nullptr );
+#else
+        ::pthread_mutex_init( &m_sync->lock, nullptr );
+        ::pthread_cond_init( &m_sync->idle, nullptr );
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    ProbeTasks::~ProbeTasks()
+    {
+#ifdef _WIN32
+        if( nullptr != m_sync->hIdle )
+        {
+            ::CloseHandle( m_sync->hIdle );
+        }
+#else
+        ::pthread_cond_destroy( &m_sync->idle );
+        ::pthread_mutex_destroy( &m_sync->lock );
+#endif
+        delete m_sync;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void ProbeTasks::addRef()
+    {
+        atomicIncrement( &m_refs );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void ProbeTasks::release()
+    {
+        if( 0 == atomicDecrement( &m_refs ) )
+        {
+            delete this;
+        }
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool ProbeTasks::reusable()
+    {
+        if( m_cancelled )
+        {
+            return false;
+        }
+        while( m_refs > 1 )
+        {
+#ifdef _WIN32
+            ::Sleep( 0 );
+#else
+            ::sched_yield();
+#endif
+        }
+        return true;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    probe_workers_t::probe_workers_t()
+        : waiting( 0 )
+        , busy( 0 )
+        , threads( 0 )
+        , bStopped( false )
+    {
+#ifdef _WIN32
+        ::InitializeCriticalSection( &cs );
+        hTicket = ::CreateSemaphoreW( nullptr, 0, 0x7fffffff, nullptr );
+#else
+        ::pthread_mutex_init( &lock, nullptr );
+        ::pthread_cond_init( &ticket, nullptr );
+#endif
+        tickets.reserve( PROBE_POOL_MAX_WORKERS );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // workers still waiting at process exit keep what they wait on
+    probe_workers_t::~probe_workers_t()
+    {
+        if( 0 != threads )
+        {
+            return;
+        }
+#ifdef _WIN32
+        if( nullptr != hTicket )
+        {
+            ::CloseHandle( hTicket );
+        }
+        ::DeleteCriticalSection( &cs );
+#else
+        ::pthread_cond_destroy( &ticket );
+        ::pthread_mutex_destroy( &lock );
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    struct probe_worker_t
+    {
+        static void workLoop( ProbeTasks *tasks )
+        {
+            for( ;; )
+            {
+                if( tasks->m_cancelled )
+                {
+                    break;
+                }
+                const size_t i = (size_t)( atomicIncrement( &tasks->m_next ) - 1 );
+                if( i >= tasks->m_count )
+                {
+                    break;
+                }
+                try
+                {
+                    tasks->runTask( i );
+                }
+                catch(...)
+                {
+                    // a probe that throws leaves its slot empty; it must not take the worker down
+                }
+            }
+        }
+
+        static void finished( ProbeTasks *tasks )
+        {
+#ifdef _WIN32
+            if( 0 == atomicDecrement( &tasks->m_sync->running ) )
+            {
+                ::SetEvent( tasks->m_sync->hIdle );
+            }
+#else
+            ::pthread_mutex_lock( &tasks->m_sync->lock );
+            if( 0 == --tasks->m_sync->running )
+            {
+                ::pthread_cond_broadcast( &tasks->m_sync->idle );
+            }
+            ::pthread_mutex_unlock( &tasks->m_sync->lock );
+#endif
+            tasks->release();
+        }
+
+           // the next ticket, or nullptr when the worker is to leave; called with the lock held
+        static ProbeTasks *takeTicket()
+        {
+            probe_workers_t &w = s_workers;
+            for( ;; )
+            {
+                if( !w.tickets.empty() )
+                {
+                    ProbeTasks *tasks = w.tickets.back();
+                    w.tickets.pop_back();
+                    w.busy++;
+                    return tasks;
+                }
+                if( w.bStopped )
+                {
+                    return nullptr;
+                }
+                w.waiting++;
+#ifdef _WIN32
+                ::LeaveCriticalSection( &w.cs );
+                ::WaitForSingleObject( w.hTicket, INFINITE );
+                ::EnterCriticalSection( &w.cs );
+#else
+                ::pthread_cond_wait( &w.ticket, &w.lock );
+#endif
+                w.waiting--;
+            }
+        }
+
+           // tickets until told to leave.  A worker counts as free again before the run it served
+           // learns that it is done, so that the next run finds it; no more than
+           // PROBE_POOL_MAX_WORKERS stay free beyond the tickets waiting.
+        static void serve()
+        {
+            probe_workers_t &w = s_workers;
+#ifdef _WIN32
+            ::EnterCriticalSection( &w.cs );
+#else
+            ::pthread_mutex_lock( &w.lock );
+#endif
+            for( ;; )
+            {
+                ProbeTasks *tasks = takeTicket();
+                if( nullptr == tasks )
+                {
+                    break;
+                }
+#ifdef _WIN32
+                ::LeaveCriticalSection( &w.cs );
+                workLoop( tasks );
+                ::EnterCriticalSection( &w.cs );
+#else
+                ::pthread_mutex_unlock( &w.lock );
+                workLoop( tasks );
+                ::pthread_mutex_lock( &w.lock );
+#endif
+                w.busy--;
+                const bool bLeave = w.bStopped || w.threads - w.busy > PROBE_POOL_MAX_WORKERS + w.tickets.size();
+                if( bLeave )
+                {
+                    w.threads--;
+                }
+#ifdef _WIN32
+                ::LeaveCriticalSection( &w.cs );
+                finished( tasks );
+                if( bLeave )
+                {
+                    return;
+                }
+                ::EnterCriticalSection( &w.cs );
+#else
+                ::pthread_mutex_unlock( &w.lock );
+                finished( tasks );
+                if( bLeave )
+                {
+                    return;
+                }
+                ::pthread_mutex_lock( &w.lock );
+#endif
+            }
+            w.threads--;
+#ifdef _WIN32
+            ::LeaveCriticalSection( &w.cs );
+#else
+            ::pthread_mutex_unlock( &w.lock );
+#endif
+        }
+#ifdef _WIN32
+           // param: the reference on this module taken by post(), which the thread drops only as it
+           // exits, so that FreeLibrary by the host cannot unmap the code under a worker
+        static DWORD WINAPI thread( LPVOID param )
+        {
+            serve();
+            if( nullptr != param )
+            {
+                ::FreeLibraryAndExitThread( (HMODULE)param, 0 );
+            }
+            return 0;
+        }
+#else
+        static void *thread( void * )
+        {
+            serve();
+            return nullptr;
+        }
+#endif
+
+           // queues a ticket for tasks, holding a reference already, and wakes or starts a worker
+           // for it; false if no worker could be started
+        static bool post( ProbeTasks *tasks )
+        {
+            probe_workers_t &w  = s_workers;
+            bool             ok = true;
+#ifdef _WIN32
+            ::EnterCriticalSection( &w.cs );
+            if( w.threads - w.busy <= w.tickets.size() )
+            {
+                HMODULE hPin = nullptr;
+                ::GetModuleHandleExW( GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, (LPCWSTR)&probe_worker_t::thread, &hPin );
+
+                HANDLE hThread = ::CreateThread( NULL, 0, thread, hPin, 0, NULL );
+                ok = ( NULL != hThread );
+                if( ok )
+                {
+                    ::CloseHandle( hThread );
+                    w.threads++;
+                }
+                else if( nullptr != hPin )
+                {
+                    ::FreeLibrary( hPin );
+                }
+            }
+            if( ok )
+            {
+                w.tickets.push_back( tasks );
+                ::ReleaseSemaphore( w.hTicket, 1, nullptr );
+            }
+            ::LeaveCriticalSection( &w.cs );
+#else
+            ::pthread_mutex_lock( &w.lock );
+            if( w.threads - w.busy <= w.tickets.size() )
+            {
+                pthread_attr_t attr;
+                pthread_t      thread;
+                ::pthread_attr_init( &attr );
+                ::pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+                ok = ( 0 == ::pthread_create( &thread, &attr, probe_worker_t::thread, nullptr ) );
+                ::pthread_attr_destroy( &attr );
+                if( ok )
+                {
+                    w.threads++;
+                }
+            }
+            if( ok )
+            {
+                w.tickets.push_back( tasks );
+                ::pthread_cond_signal( &w.ticket );
+            }
+            ::pthread_mutex_unlock( &w.lock );
+#endif
+            return ok;
+        }
+    };
+    //----------------------------------------------------------------------------------------------------------------------
+    ProbePool::ProbePool( unsigned maxWorkers )
+        : m_maxWorkers( maxWorkers < 1 ? 1 : ( maxWorkers > PROBE_POOL_MAX_WORKERS ? PROBE_POOL_MAX_WORKERS : maxWorkers ) )
+    {
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool ProbePool::run( size_t count, ProbeTasks *tasks, unsigned long timeoutMs )
+    {
+        tasks->m_count     = count;
+        tasks->m_next      = 0;
+        tasks->m_cancelled = 0;
+
+        const bool   bTimed   = ( PROBE_POOL_INFINITE != timeoutMs );
+        const size_t nWorkers = ( count < m_maxWorkers ? count : m_maxWorkers );
+        const size_t nThreads = ( bTimed || 0 == nWorkers ) ? nWorkers : nWorkers - 1;
+        size_t       nStarted = 0;
+
+#ifdef _WIN32
+        ::ResetEvent( tasks->m_sync->hIdle );
+        for( ; nStarted < nThreads; nStarted++ )
+        {
+            tasks->addRef();
+            atomicIncrement( &tasks->m_sync->running );
+            if( !probe_worker_t::post( tasks ) )
+            {
+                atomicDecrement( &tasks->m_sync->running );
+                tasks->release();
+                break;      // fewer workers; the remaining indices are still taken by those running
+            }
+        }
+        if( !bTimed || 0 == nStarted )
+        {
+            probe_worker_t::workLoop( tasks );
+        }
+        bool bAllDone = true;
+        if( nStarted > 0 )
+        {
+            bAllDone = ( WAIT_TIMEOUT != ::WaitForSingleObject( tasks->m_sync->hIdle, bTimed ? timeoutMs : INFINITE ) );
+        }
+#else
+        for( ; nStarted < nThreads; nStarted++ )
+        {
+            tasks->addRef();
+            ::pthread_mutex_lock( &tasks->m_sync->lock );
+            tasks->m_sync->running++;
+            ::pthread_mutex_unlock( &tasks->m_sync->lock );
+
+            if( !probe_worker_t::post( tasks ) )
+            {
+                ::pthread_mutex_lock( &tasks->m_sync->lock );
+                tasks->m_sync->running--;
+                ::pthread_mutex_unlock( &tasks->m_sync->lock );
+                tasks->release();
+                break;
+            }
+        }
+
+        if( !bTimed || 0 == nStarted )
+        {
+            probe_worker_t::workLoop( tasks );
+        }
+
+        struct timespec until;
+        ::clock_gettime( CLOCK_REALTIME, &until );
+        until.tv_sec  += timeoutMs / 1000;
+        until.tv_nsec += (long)( timeoutMs % 1000 ) * 1000000L;
+        if( until.tv_nsec >= 1000000000L )
+        {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000L;
+        }
+
+        bool bAllDone = true;
+        ::pthread_mutex_lock( &tasks->m_sync->lock );
+        while( tasks->m_sync->running > 0 )
+        {
+            if( !bTimed )
+            {
+                ::pthread_cond_wait( &tasks->m_sync->idle, &tasks->m_sync->lock );
+            }
+            else if( ETIMEDOUT == ::pthread_cond_timedwait( &tasks->m_sync->idle, &tasks->m_sync->lock, &until ) )
+            {
+                bAllDone = ( 0 == tasks->m_sync->running );
+                break;
+            }
+        }
+        ::pthread_mutex_unlock( &tasks->m_sync->lock );
+#endif
+        if( !bAllDone )
+        {
+            tasks->m_cancelled = 1;     // indices not started yet are left alone
+        }
+        return bAllDone;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void ProbePool::stopWorkers()
+    {
+        probe_workers_t &w = s_workers;
+#ifdef _WIN32
+        ::EnterCriticalSection( &w.cs );
+        w.bStopped = true;
+        if( 0 != w.waiting )
+        {
+            ::ReleaseSemaphore( w.hTicket, (LONG)w.waiting, nullptr );
+        }
+        ::LeaveCriticalSection( &w.cs );
+#else
+        ::pthread_mutex_lock( &w.lock );
+        w.bStopped = true;
+        ::pthread_cond_broadcast( &w.ticket );
+        ::pthread_mutex_unlock( &w.lock );
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    unsigned ProbePool::workers()
+    {
+        probe_workers_t &w = s_workers;
+#ifdef _WIN32
+        ::EnterCriticalSection( &w.cs );
+        const size_t threads = w.threads;
+        ::LeaveCriticalSection( &w.cs );
+#else
+        ::pthread_mutex_lock( &w.lock );
+        const size_t threads = w.threads;
+        ::pthread_mutex_unlock( &w.lock );
+#endif
+        return (unsigned)threads;
+    }
+};
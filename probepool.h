@@ -0,0 +1,83 @@
+/** @file
+  * EpsDiskId/probepool.h
+  *
+  * Bounded pool of worker threads for per-device probes.
+  *
+  * run( count, tasks ) calls tasks->runTask( i ) once for every i in [0, count) on at most
+  * maxWorkers threads and returns when all calls are done, or when the time limit is up.
+  * Indices are handed out in order, and every call writes only its own slot i, so results are
+  * gathered in device order no matter which probe finishes first.
+  *
+  * The worker threads belong to the process, not to a ProbePool: a worker done with a run waits
+  * for the next one, so a steady caller starts no thread at all.  A worker still inside a task
+  * when run() gives up is left to finish it and replaced by a new thread where a later run needs
+  * one; it rejoins the waiting ones when the device lets go of it.  On Windows every worker holds
+  * a reference on the DLL until it exits, as the threads of diskrefresh.h do.
+  */
+
+#ifndef __Utils_PROBEPOOL_
+#define __Utils_PROBEPOOL_
+
+#include <stddef.h>
+
+namespace Utils
+{
+#define  PROBE_POOL_MAX_WORKERS  64             // MAXIMUM_WAIT_OBJECTS
+#define  PROBE_POOL_INFINITE     0xFFFFFFFFUL
+
+       //  Work handed to the pool.  Reference counted (created with one reference, owned by the
+       //  caller): a worker still inside runTask() when run() gives up keeps the object alive
+       //  until it returns, so a hung device never leaves a worker writing to freed memory.
+    class ProbeTasks
+    {
+        public:
+            ProbeTasks();
+
+            void            addRef();
+            void            release();
+
+               //  true when the owner may hand the tasks to another run(): the last one finished every
+               //  task it started and no worker holds a reference any more.  Waits for the workers of a
+               //  completed run() to let go, which they do as they finish; false after a run() that timed out.
+            bool            reusable();
+
+        protected:
+            virtual         ~ProbeTasks();
+            virtual void    runTask( size_t index ) = 0;
+
+        private:
+            friend class ProbePool;
+            friend struct probe_worker_t;
+
+            volatile long           m_refs;
+            volatile long           m_next;
+            volatile long           m_cancelled;
+            size_t                  m_count;
+            struct probe_sync_t    *m_sync;
+    };
+
+    class ProbePool
+    {
+        public:
+            explicit ProbePool( unsigned maxWorkers );
+
+            unsigned    maxWorkers() const  { return m_maxWorkers; }
+
+               //  Without a time limit the calling thread takes tasks as well and run() returns true
+               //  when all are done.  With one, only pool threads run tasks; once timeoutMs is up no
+               //  further index is started and run() returns false if any task is still running.
+            bool        run( size_t count, ProbeTasks *tasks, unsigned long timeoutMs = PROBE_POOL_INFINITE );
+
+               //  Lets the waiting workers exit, and the others as soon as their task returns; later
+               //  runs start workers that exit when done.  For the unloading of the DLL.
+            static void     stopWorkers();
+
+               //  Worker threads alive in the process, waiting or inside a task
+            static unsigned workers();
+
+        private:
+            unsigned    m_maxWorkers;
+    };
+};
+
+#endif
@@ -0,0 +1,242 @@
+/** @file
+  * EpsDiskId/probestats.cpp
+  *
+  * Counters and latency histograms of the enumeration phases, per device.
+  */
+
+#include <string.h>
+
+#ifdef _WIN32
+#   include <windows.h>
+#else
+#   include <pthread.h>
+#   include <time.h>
+#endif
+
+#include "probestats.h"
+
+namespace Utils
+{
+    struct probe_stats_cell_t
+    {
+        volatile __int64    totalUs;
+        volatile long       count;
+        volatile long       maxUs;
+        volatile long       buckets[PROBE_STATS_BUCKETS];
+    };
+
+    struct probe_stats_shard_t
+    {
+        probe_stats_cell_t  cells[PROBE_STATS_DEVICES + 1][PROBE_PHASE_COUNT];     // last row: no single device
+        char                pad[64];                                                // next shard on another cache line
+    };
+
+    //----------------------------------------------------------------------------------------------------------------------
+    static void atomicAdd( volatile long *p, long value )
+    {
+#ifdef _WIN32
+        ::InterlockedExchangeAdd( p, value );
+#else
+        __sync_fetch_and_add( p, value );
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static void atomicAdd64( volatile __int64 *p, __int64 value )
+    {
+#ifdef _WIN32
+        __int64 old;
+        do
+        {
+            old = *p;
+        }
+        while( ::InterlockedCompareExchange64( p, old + value, old ) != old );
+#else
+        __sync_fetch_and_add( p, value );
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static long atomicLoad( volatile long *p )
+    {
+#ifdef _WIN32
+        return ::InterlockedCompareExchange( p, 0, 0 );
+#else
+        return __sync_fetch_and_add( p, 0 );
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static __int64 atomicLoad64( volatile __int64 *p )
+    {
+#ifdef _WIN32
+        return ::InterlockedCompareExchange64( p, 0, 0 );
+#else
+        return __sync_fetch_and_add( p, 0 );
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static void atomicMax( volatile long *p, long value )
+    {
+        long old = atomicLoad( p );
+        while( value > old )
+        {
+#ifdef _WIN32
+            const long seen = ::InterlockedCompareExchange( p, value, old );
+#else
+            const long seen = __sync_val_compare_and_swap( p, old, value );
+#endif
+            if( seen == old )
+            {
+                break;
+            }
+            old = seen;
+        }
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // threads of the same pool have neighbouring ids; the multiplication spreads them over the shards
+    static size_t threadShard()
+    {
+#ifdef _WIN32
+        const unsigned int id = (unsigned int)::GetCurrentThreadId();
+#else
+        const unsigned int id = (unsigned int)(size_t)::pthread_self();
+#endif
+        return ( ( id * 2654435761U ) >> 16 ) % PROBE_STATS_SHARDS;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static size_t bucketOf( unsigned __int64 us )
+    {
+        size_t bucket = 0;
+        while( 0 != us && bucket < PROBE_STATS_BUCKETS - 1 )
+        {
+            us >>= 1;
+            bucket++;
+        }
+        return bucket;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+#ifdef _WIN32
+    static __int64 performanceFrequency()
+    {
+        LARGE_INTEGER frequency;
+        return ::QueryPerformanceFrequency( &frequency ) ? frequency.QuadPart : 0;
+    }
+       // read once while the DLL initialises; it does not change while the system runs
+    static const __int64 s_nFrequency = performanceFrequency();
+#endif
+
+       // leaves the last error alone: a scope may end between a failed call and its GetLastError()
+    unsigned __int64 ProbeStats::nowUs()
+    {
+#ifdef _WIN32
+        const DWORD   err = ::GetLastError();
+        LARGE_INTEGER counter;
+        unsigned __int64 us = 0;
+
+        if( s_nFrequency <= 0 || !::QueryPerformanceCounter( &counter ) )
+        {
+            us = (unsigned __int64)::GetTickCount() * 1000;
+        }
+        else
+        {
+            us = (unsigned __int64)( counter.QuadPart / s_nFrequency ) * 1000000 +
+                 (unsigned __int64)( counter.QuadPart % s_nFrequency ) * 1000000 / s_nFrequency;
+        }
+        ::SetLastError( err );
+        return us;
+#else
+        struct timespec ts;
+        ::clock_gettime( CLOCK_MONOTONIC, &ts );
+        return (unsigned __int64)ts.tv_sec * 1000000 + (unsigned __int64)ts.tv_nsec / 1000;
+#endif
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    ProbeStats::ProbeStats()
+        : m_shards( new probe_stats_shard_t[PROBE_STATS_SHARDS] )
+    {
+        clear();
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    ProbeStats::~ProbeStats()
+    {
+        delete [] m_shards;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void ProbeStats::record( int phase, int device, unsigned __int64 us )
+    {
+        if( phase < 0 || phase >= PROBE_PHASE_COUNT )
+        {
+            return;
+        }
+        const size_t row = ( device >= 0 && device < PROBE_STATS_DEVICES ) ? (size_t)device : PROBE_STATS_DEVICES;
+        probe_stats_cell_t &cell = m_shards[threadShard()].cells[row][phase];
+        const long capped = ( us > 0x7fffffffUL ) ? 0x7fffffffL : (long)us;
+
+        atomicAdd( &cell.count, 1 );
+        atomicAdd( &cell.buckets[bucketOf( us )], 1 );
+        atomicAdd64( &cell.totalUs, (__int64)us );
+        atomicMax( &cell.maxUs, capped );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void ProbeStats::snapshot( std::vector<probe_stat_t> &stats ) const
+    {
+        stats.clear();
+        for( size_t row = 0; row <= PROBE_STATS_DEVICES; row++ )
+        {
+            for( int phase = 0; phase < PROBE_PHASE_COUNT; phase++ )
+            {
+                probe_stat_t stat;
+                ::memset( &stat, 0, sizeof(stat) );
+                stat.phase  = phase;
+                stat.device = ( row < PROBE_STATS_DEVICES ) ? (int)row : -1;
+
+                for( size_t s = 0; s < PROBE_STATS_SHARDS; s++ )
+                {
+                    probe_stats_cell_t &cell = m_shards[s].cells[row][phase];
+                    const unsigned long maxUs = (unsigned long)atomicLoad( &cell.maxUs );
+
+                    stat.count   += (unsigned long)atomicLoad( &cell.count );
+                    stat.totalUs += (unsigned __int64)atomicLoad64( &cell.totalUs );
+                    stat.maxUs    = ( maxUs > stat.maxUs ) ? maxUs : stat.maxUs;
+                    for( size_t b = 0; b < PROBE_STATS_BUCKETS; b++ )
+                    {
+                        stat.buckets[b] += (unsigned long)atomicLoad( &cell.buckets[b] );
+                    }
+                }
+                if( stat.count > 0 )
+                {
+                    stats.push_back( stat );
+                }
+            }
+        }
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // not atomic as a whole: a phase recorded while the table is cleared may keep part of its counts
+    void ProbeStats::clear()
+    {
+        ::memset( (void*)m_shards, 0, sizeof(probe_stats_shard_t) * PROBE_STATS_SHARDS );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    const char *ProbeStats::phaseName( int phase )
+    {
+        switch( phase )
+        {
+            case PROBE_PHASE_OPEN:                  return "open";
+            case PROBE_PHASE_GET_VERSION:           return "DFP_GET_VERSION";
+            case PROBE_PHASE_RECEIVE_DRIVE_DATA:    return "DFP_RECEIVE_DRIVE_DATA";
+            case PROBE_PHASE_SCSI_MINIPORT:         return "IOCTL_SCSI_MINIPORT";
+            case PROBE_PHASE_QUERY_PROPERTY:        return "IOCTL_STORAGE_QUERY_PROPERTY";
+            case PROBE_PHASE_MEDIA_SERIAL:          return "IOCTL_STORAGE_GET_MEDIA_SERIAL_NUMBER";
+            case PROBE_PHASE_OTHER_IOCTL:           return "other IOCTL";
+            case PROBE_PHASE_PARSE:                 return "parse";
+            case PROBE_PHASE_CRC:                   return "crc";
+            case PROBE_PHASE_ROW_SEND:              return "row send";
+            case PROBE_PHASE_SYSFS:                 return "sysfs";
+        }
+        return "unknown";
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    unsigned __int64 ProbeStats::bucketLimitUs( int bucket )
+    {
+        return ( bucket >= 0 && bucket < PROBE_STATS_BUCKETS - 1 ) ? ( (unsigned __int64)1 << bucket ) : 0;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+};
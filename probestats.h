@@ -0,0 +1,108 @@
+/** @file
+  * EpsDiskId/probestats.h
+  *
+  * Counters and latency histograms of the enumeration phases, per device.
+  *
+  * Each phase (an open, an IOCTL, decoding a record, the CRC of a row, sending it) is timed by a
+  * ProbeStatScope and added to one of PROBE_STATS_SHARDS copies of the table.  The copy is picked
+  * from the id of the calling thread, so threads probing at the same time rarely share a cache
+  * line; an add is a few interlocked operations and never waits for a lock.  Shards are summed
+  * only when the table is read (xp_DiskIdStats).
+  *
+  * Histogram buckets are powers of two of microseconds: bucket 0 holds times under 1 us, bucket
+  * b > 0 holds [2^(b-1), 2^b) us, and the last one everything longer.
+  */
+
+#ifndef __Utils_PROBESTATS_
+#define __Utils_PROBESTATS_
+
+#include <vector>
+
+namespace Utils
+{
+#define  PROBE_STATS_DEVICES   16   // devices 0..15 are kept apart; others and work of no single device share one row
+#define  PROBE_STATS_BUCKETS   24
+#define  PROBE_STATS_SHARDS    8
+
+    enum probe_phase_t
+    {
+        PROBE_PHASE_OPEN                = 0,    // CreateFileW (open on Linux) on a drive or port
+        PROBE_PHASE_GET_VERSION         = 1,    // DFP_GET_VERSION
+        PROBE_PHASE_RECEIVE_DRIVE_DATA  = 2,    // DFP_RECEIVE_DRIVE_DATA (SMART IDENTIFY)
+        PROBE_PHASE_SCSI_MINIPORT       = 3,    // IOCTL_SCSI_MINIPORT IDENTIFY
+        PROBE_PHASE_QUERY_PROPERTY      = 4,    // IOCTL_STORAGE_QUERY_PROPERTY
+        PROBE_PHASE_MEDIA_SERIAL        = 5,    // IOCTL_STORAGE_GET_MEDIA_SERIAL_NUMBER
+        PROBE_PHASE_OTHER_IOCTL         = 6,    // e.g. IOCTL_SCSI_GET_ADDRESS
+        PROBE_PHASE_PARSE               = 7,    // IDENTIFY sector or descriptor to disk_t
+        PROBE_PHASE_CRC                 = 8,    // duuid of a row
+        PROBE_PHASE_ROW_SEND            = 9,    // srv_sendrow
+        PROBE_PHASE_SYSFS               = 10,   // attributes of a drive under /sys/block (Linux)
+        PROBE_PHASE_COUNT               = 11
+    };
+
+       //  One phase of one device, summed over the shards
+    struct probe_stat_t
+    {
+        int                 phase;                          // probe_phase_t
+        int                 device;                         // -1: the shared row
+        unsigned long       count;
+        unsigned __int64    totalUs;
+        unsigned long       maxUs;
+        unsigned long       buckets[PROBE_STATS_BUCKETS];
+    };
+
+    class ProbeStats
+    {
+        public:
+            ProbeStats();
+            ~ProbeStats();
+
+            void    record( int phase, int device, unsigned __int64 us );
+
+               //  the phases and devices recorded so far, by device then phase
+            void    snapshot( std::vector<probe_stat_t> &stats ) const;
+            void    clear();
+
+            static const char          *phaseName( int phase );
+               //  upper end of a bucket in microseconds, 0 for the open-ended last one
+            static unsigned __int64     bucketLimitUs( int bucket );
+               //  microseconds on a monotonic clock
+            static unsigned __int64     nowUs();
+
+        private:
+                            ProbeStats( const ProbeStats& );
+            ProbeStats&     operator=( const ProbeStats& );
+
+            struct probe_stats_shard_t *m_shards;
+    };
+
+       //  Times its own lifetime and records it on destruction; without a table (or with a negative
+       //  phase) it does nothing, not even read the clock
+    class ProbeStatScope
+    {
+        public:
+            ProbeStatScope( ProbeStats *pStats, int phase, int device )
+                : m_pStats( phase >= 0 ? pStats : nullptr ), m_phase( phase ), m_device( device )
+                , m_start( nullptr != m_pStats ? ProbeStats::nowUs() : 0 )
+            {
+            }
+            ~ProbeStatScope()
+            {
+                if( nullptr != m_pStats )
+                {
+                    m_pStats->record( m_phase, m_device, ProbeStats::nowUs() - m_start );
+                }
+            }
+
+        private:
+                                ProbeStatScope( const ProbeStatScope& );
+            ProbeStatScope&     operator=( const ProbeStatScope& );
+
+            ProbeStats         *m_pStats;
+            int                 m_phase;
+            int                 m_device;
+            unsigned __int64    m_start;
+    };
+};
+
+#endif
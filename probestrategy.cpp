@@ -0,0 +1,58 @@
+/** @file
+  * EpsDiskId/probestrategy.cpp
+  *
+  * What the probes learnt about the hardware on earlier calls.
+  */
+
+#include "probestrategy.h"
+
+namespace Utils
+{
+    //----------------------------------------------------------------------------------------------------------------------
+    ProbeStrategy::ProbeStrategy( unsigned long nTtlMs )
+        : m_nTtlMs( nTtlMs )
+    {
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    ProbeStrategy::~ProbeStrategy()
+    {
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool ProbeStrategy::fresh( unsigned long dwTaken ) const
+    {
+        return tickCount() - dwTaken < m_nTtlMs;      // wrap-around safe
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool ProbeStrategy::isUnsupported( const device_t &device, unsigned request, const std::string &identity ) const
+    {
+        OsLockGuard guard( m_lock );
+        negative_map_t::const_iterator it = m_unsupported.find( device.path );
+        if( it == m_unsupported.end() )
+        {
+            return false;
+        }
+        negatives_t::const_iterator entry = it->second.find( request );
+        return entry != it->second.end() && entry->second.identity == identity && fresh( entry->second.dwTaken );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void ProbeStrategy::setUnsupported( const device_t &device, unsigned request, const std::string &identity )
+    {
+        OsLockGuard guard( m_lock );
+        negative_t &entry = m_unsupported[device.path][request];
+        entry.identity = identity;
+        entry.dwTaken  = tickCount();
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void ProbeStrategy::forget( const device_t &device )
+    {
+        OsLockGuard guard( m_lock );
+        m_unsupported.erase( device.path );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void ProbeStrategy::clear()
+    {
+        OsLockGuard guard( m_lock );
+        m_unsupported.clear();
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+};
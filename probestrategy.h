@@ -0,0 +1,72 @@
+/** @file
+  * EpsDiskId/probestrategy.h
+  *
+  * What the probes learnt about the hardware on earlier calls.
+  *
+  * Each physical drive is probed once per call, with the requests that fit its bus (see
+  * DiskInfo::probePhysicalDrive()).  Some of those a device refuses every time: SMART on a drive
+  * whose driver has no IDE map, the miniport IDENTIFY behind a port that does not implement it,
+  * the media serial of most media.  ProbeStrategy remembers such answers so the requests are not
+  * sent again.  Entries expire after a TTL; a device is forgotten when it is replaced.
+  *
+  * Only definite answers are kept: errors caused by a missed deadline are never recorded.
+  */
+
+#ifndef __Utils_PROBESTRATEGY_
+#define __Utils_PROBESTRATEGY_
+
+#include <map>
+#include <string>
+
+#include "devenum.h"
+#include "osutil.h"
+
+namespace Utils
+{
+#define  PROBE_STRATEGY_DEFAULT_TTL_MS  ( 10UL * 60 * 1000 )
+
+       //  Requests a device has answered with "not supported"
+#define  PROBE_NO_SMART          0x01   // DFP_GET_VERSION / SMART IDENTIFY on a physical drive
+#define  PROBE_NO_MINIPORT       0x02   // IOCTL_SCSI_MINIPORT IDENTIFY on a SCSI port, or through the port of a drive
+#define  PROBE_NO_MEDIA_SERIAL   0x04   // IOCTL_STORAGE_GET_MEDIA_SERIAL_NUMBER (error 1 or 50)
+#define  PROBE_NO_RW_OPEN        0x08   // opening the drive for read and write (access denied)
+#define  PROBE_NO_ATA_IDENTIFY   0x10   // HDIO_GET_IDENTITY and SG_IO ATA PASS-THROUGH IDENTIFY (Linux)
+#define  PROBE_NO_NVME_IDENTIFY  0x20   // NVMe Identify Controller (protocol specific property, NVME_IOCTL_ADMIN_CMD)
+
+    class ProbeStrategy
+    {
+        public:
+            explicit ProbeStrategy( unsigned long nTtlMs = PROBE_STRATEGY_DEFAULT_TTL_MS );
+            ~ProbeStrategy();
+
+               //  identity names the medium the answer was about (e.g. model and serial) where the
+               //  probe knows it before sending the request; an entry only matches the same identity
+            bool    isUnsupported( const device_t &device, unsigned request, const std::string &identity = std::string() ) const;
+            void    setUnsupported( const device_t &device, unsigned request, const std::string &identity = std::string() );
+
+               //  drops what is known about one device (it was replaced) or about everything
+            void    forget( const device_t &device );
+            void    clear();
+
+        private:
+                            ProbeStrategy( const ProbeStrategy& );
+            ProbeStrategy&  operator=( const ProbeStrategy& );
+
+            struct negative_t
+            {
+                std::string     identity;
+                unsigned long   dwTaken;
+            };
+            typedef std::map< unsigned, negative_t >                negatives_t;        // by request
+               //  by path first, so that a lookup takes the path of the device as it is, without a copy
+            typedef std::map< device_path_t, negatives_t >          negative_map_t;
+
+            bool    fresh( unsigned long dwTaken ) const;
+
+            mutable OsLock                  m_lock;
+            negative_map_t                  m_unsupported;
+            unsigned long                   m_nTtlMs;
+    };
+};
+
+#endif
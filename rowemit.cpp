@@ -0,0 +1,125 @@
+/** @file
+  * EpsDiskId/rowemit.cpp
+  *
+  * Streams a result set held in column arrays to the client of an extended procedure.
+  */
+
+#include <string.h>
+
+#include "rowemit.h"
+#include "probestats.h"
+
+namespace Utils
+{
+#define  ROW_SLOT_ALIGN     8
+
+    //----------------------------------------------------------------------------------------------------------------------
+    RowEmitter::RowEmitter( SRV_PROC *pSrvProc, size_t nRows )
+        : m_pSrvProc( pSrvProc )
+        , m_nRows( nRows )
+        , m_bBound( false )
+        , m_bFailed( false )
+        , m_pStats( nullptr )
+        , m_pOwners( nullptr )
+    {
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool RowEmitter::bind( const char *name, int destType, int cbDest, int srcType, int cbSource,
+                           const void *data, size_t stride, const __int32 *lengths )
+    {
+        const int colnumber = (int)m_columns.size() + 1;
+
+        if( m_bFailed || m_bBound ||
+            colnumber != srv_describe( m_pSrvProc, colnumber, const_cast<char*>( name ), SRV_NULLTERM,
+                                       destType, cbDest, srcType, cbSource, NULL ) )
+        {
+            m_bFailed = true;
+            return false;
+        }
+           //  the slot holds the longest value of the column
+        size_t cbSlot = stride;
+        if( nullptr != lengths )
+        {
+            cbSlot = 0;
+            for( size_t i = 0; i < m_nRows; i++ )
+            {
+                cbSlot = ( (size_t)lengths[i] > cbSlot ) ? (size_t)lengths[i] : cbSlot;
+            }
+        }
+        column_t col;
+        col.data    = (const unsigned __int8 *)data;
+        col.stride  = stride;
+        col.lengths = lengths;
+        col.offSlot = m_slots.size();
+        col.cbSent  = -1;
+
+        m_slots.resize( m_slots.size() + ( cbSlot + ROW_SLOT_ALIGN - 1 ) / ROW_SLOT_ALIGN * ROW_SLOT_ALIGN + ROW_SLOT_ALIGN );
+        m_columns.push_back( col );
+        return true;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void RowEmitter::setStats( ProbeStats *pStats, const int *owners )
+    {
+        m_pStats  = pStats;
+        m_pOwners = owners;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool RowEmitter::sendRow( size_t row )
+    {
+        if( !m_bBound )
+        {
+               //  the slots no longer move once every column is bound
+            for( size_t c = 0; c < m_columns.size(); c++ )
+            {
+                srv_setcoldata( m_pSrvProc, (int)c + 1, &m_slots[m_columns[c].offSlot] );
+            }
+            m_bBound = true;
+        }
+        for( size_t c = 0; c < m_columns.size(); c++ )
+        {
+            column_t     &col = m_columns[c];
+            const __int32 cb  = ( nullptr != col.lengths ) ? col.lengths[row] : (__int32)col.stride;
+
+            unsigned __int8       *slot  = &m_slots[col.offSlot];
+            const unsigned __int8 *value = col.data + row * col.stride;
+            switch( cb )
+            {
+                case 0:                                                                 break;
+                case 4: *(unsigned __int32 *)slot = *(const unsigned __int32 *)value;   break;
+                case 8: *(unsigned __int64 *)slot = *(const unsigned __int64 *)value;   break;
+                default: ::memcpy( slot, value, cb );                                   break;
+            }
+            if( cb != col.cbSent )
+            {
+                srv_setcollen( m_pSrvProc, (int)c + 1, cb );
+                col.cbSent = cb;
+            }
+        }
+        ProbeStatScope timer( m_pStats, PROBE_PHASE_ROW_SEND, ( nullptr != m_pOwners ) ? m_pOwners[row] : -1 );
+        return SUCCEED == srv_sendrow( m_pSrvProc );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    int RowEmitter::send()
+    {
+        int nSent = 0;
+        for( size_t i = 0; i < m_nRows && !m_bFailed && !m_columns.empty(); i++ )
+        {
+            nSent += sendRow( i ) ? 1 : 0;
+        }
+        return nSent;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    int RowEmitter::send( const size_t *rows, size_t nRows )
+    {
+        int nSent = 0;
+        for( size_t i = 0; i < nRows && !m_bFailed && !m_columns.empty(); i++ )
+        {
+            if( rows[i] < m_nRows )
+            {
+                nSent += sendRow( rows[i] ) ? 1 : 0;
+            }
+        }
+        return nSent;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+};
@@ -0,0 +1,73 @@
+/** @file
+  * EpsDiskId/rowemit.h
+  *
+  * Streams a result set held in column arrays to the client of an extended procedure.
+  *
+  * The procedures used to describe their columns and then call srv_setcollen() and
+  * srv_setcoldata() for every column of every row.  RowEmitter describes each column once and
+  * binds it once to a slot of its own; srv_sendrow() reads the slots, so a row is sent by copying
+  * row i of every column array into them.  srv_setcollen() is only called again when the length
+  * of a value differs from the one before it, which for fixed-size columns is never.
+  *
+  * Column arrays are read in place and must outlive send().
+  */
+
+#ifndef __Utils_ROWEMIT_
+#define __Utils_ROWEMIT_
+
+#include <vector>
+
+#include "esp_lib.h"
+
+namespace Utils
+{
+    class ProbeStats;
+
+    class RowEmitter
+    {
+        public:
+            RowEmitter( SRV_PROC *pSrvProc, size_t nRows );
+
+               //  Describes the next column, as srv_describe() takes it, and binds it to a column
+               //  array: row i at data + i * stride, lengths[i] bytes long (0 sends NULL), or stride
+               //  bytes for every row when lengths is nullptr.  false if the server refused the column.
+            bool    bind( const char *name, int destType, int cbDest, int srcType, int cbSource,
+                          const void *data, size_t stride, const __int32 *lengths = nullptr );
+
+               //  times every srv_sendrow() as PROBE_PHASE_ROW_SEND of owners[i] (may be nullptr)
+            void    setStats( ProbeStats *pStats, const int *owners );
+
+               //  Sends every row, or the rows listed in order; returns how many the server took.
+               //  The caller sends the done packet.
+            int     send();
+            int     send( const size_t *rows, size_t nRows );
+
+            int     columns() const     { return (int)m_columns.size(); }
+
+        private:
+                            RowEmitter( const RowEmitter& );
+            RowEmitter&     operator=( const RowEmitter& );
+
+            struct column_t
+            {
+                const unsigned __int8  *data;
+                size_t                  stride;
+                const __int32          *lengths;
+                size_t                  offSlot;        // in m_slots
+                __int32                 cbSent;         // last srv_setcollen(), -1 before the first
+            };
+
+            bool    sendRow( size_t row );
+
+            SRV_PROC                       *m_pSrvProc;
+            size_t                          m_nRows;
+            std::vector<column_t>           m_columns;
+            std::vector<unsigned __int8>    m_slots;
+            bool                            m_bBound;       // srv_setcoldata() done for every column
+            bool                            m_bFailed;
+            ProbeStats                     *m_pStats;
+            const int                      *m_pOwners;
+    };
+};
+
+#endif
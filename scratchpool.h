@@ -0,0 +1,87 @@
+/** @file
+  * EpsDiskId/scratchpool.h
+  *
+  * Scratch objects kept from one call to the next.
+  *
+  * A probe needs kilobytes of IOCTL buffers, a sweep its result slots and device lists.  Taking
+  * them from the heap on every call is a cost a steady caller should not pay: a ScratchPool hands
+  * out what earlier calls gave back, and only allocates while more calls run at once than ever
+  * did before.  Objects are handed out as they were left, so the user resets what it reads.
+  * take() and give() may be called from any thread.
+  */
+
+#ifndef __Utils_SCRATCHPOOL_
+#define __Utils_SCRATCHPOOL_
+
+#include <stddef.h>
+#include <vector>
+
+#include "osutil.h"
+
+namespace Utils
+{
+    template< typename T >
+    class ScratchPool
+    {
+        public:
+            ScratchPool() : m_nMade( 0 ) {}
+            ~ScratchPool()
+            {
+                for( size_t i = 0; i < m_free.size(); i++ )
+                {
+                    delete m_free[i];
+                }
+            }
+
+               //  an object given back before, or a new one
+            T      *take()
+            {
+                OsLockGuard guard( m_lock );
+                if( !m_free.empty() )
+                {
+                    T *p = m_free.back();
+                    m_free.pop_back();
+                    return p;
+                }
+                   //  room for every object made, so that give() never allocates
+                m_free.reserve( ++m_nMade );
+                return new T;
+            }
+
+               //  keeps p, taken from this pool, for a later take()
+            void    give( T *p )
+            {
+                OsLockGuard guard( m_lock );
+                m_free.push_back( p );
+            }
+
+        private:
+                            ScratchPool( const ScratchPool& );
+            ScratchPool&    operator=( const ScratchPool& );
+
+            OsLock              m_lock;
+            std::vector<T*>     m_free;
+            size_t              m_nMade;
+    };
+
+       //  An object of a ScratchPool for the scope of a call
+    template< typename T >
+    class ScratchHold
+    {
+        public:
+            explicit ScratchHold( ScratchPool<T> &pool ) : m_pool( pool ), m_p( pool.take() )  {}
+            ~ScratchHold()                                                                   { m_pool.give( m_p ); }
+
+            T      &operator*() const      { return *m_p; }
+            T      *operator->() const     { return m_p; }
+
+        private:
+                            ScratchHold( const ScratchHold& );
+            ScratchHold&    operator=( const ScratchHold& );
+
+            ScratchPool<T>     &m_pool;
+            T                  *m_p;
+    };
+};
+
+#endif
@@ -0,0 +1,218 @@
+/** @file
+  * EpsDiskId/snapfile.cpp
+  *
+  * Last enumeration kept on disk, for answering right after a restart.
+  */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+
+#ifdef _WIN32
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <pthread.h>
+#   include <unistd.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#endif
+
+#include "snapfile.h"
+#include "crc64.h"
+
+namespace Utils
+{
+    static const size_t s_cbRecord = sizeof(disk_t) + sizeof(__int32);
+
+    //----------------------------------------------------------------------------------------------------------------------
+    unsigned __int64 diskSnapshotChecksum( const std::vector<disk_t> &lst_disk, const std::vector<int> &devices )
+    {
+        unsigned __int64 crc = ::crc64_init();
+        for( size_t i = 0; i < lst_disk.size(); i++ )
+        {
+            const __int32 device = ( i < devices.size() ) ? devices[i] : -1;
+            crc = ::crc64_update( crc, &lst_disk[i], sizeof(disk_t) );
+            crc = ::crc64_update( crc, &device, sizeof(device) );
+        }
+        return (unsigned __int64)::crc64_final( crc );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static bool parseSnapshot( const unsigned __int8 *data, size_t cb, unsigned long maxAgeSec,
+                               std::vector<disk_t> &lst_disk, std::vector<int> &devices )
+    {
+        disk_snapshot_header_t header;
+        if( cb < sizeof(header) )
+        {
+            return false;
+        }
+        ::memcpy( &header, data, sizeof(header) );
+
+        if( 0 != ::memcmp( header.magic, DISK_SNAPSHOT_MAGIC, sizeof(header.magic) ) ||
+            header.crcHeader != (unsigned __int64)::crc64( &header, offsetof( disk_snapshot_header_t, crcHeader ) ) ||
+            header.version   != DISK_SNAPSHOT_VERSION ||
+            header.cbHeader  != sizeof(header) ||
+            header.cbRecord  != s_cbRecord ||
+            ( cb - sizeof(header) ) / s_cbRecord < header.count )
+        {
+            return false;
+        }
+        const __int64 age = (__int64)::time( nullptr ) - header.written;
+        if( 0 != maxAgeSec && ( age < 0 || age > (__int64)maxAgeSec ) )
+        {
+            return false;
+        }
+        std::vector<disk_t> disks( header.count );
+        std::vector<int>    owners( header.count );
+        const unsigned __int8 *p = data + sizeof(header);
+
+        for( unsigned __int32 i = 0; i < header.count; i++, p += s_cbRecord )
+        {
+            __int32 device = -1;
+            ::memcpy( &disks[i], p, sizeof(disk_t) );
+            ::memcpy( &device, p + sizeof(disk_t), sizeof(device) );
+            owners[i] = device;
+        }
+        if( header.crcRecords != diskSnapshotChecksum( disks, owners ) )
+        {
+            return false;
+        }
+        lst_disk.swap( disks );
+        devices.swap( owners );
+        return true;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static void buildSnapshot( const std::vector<disk_t> &lst_disk, const std::vector<int> &devices, std::vector<unsigned __int8> &file )
+    {
+        disk_snapshot_header_t header;
+        ::memset( &header, 0, sizeof(header) );
+        ::memcpy( header.magic, DISK_SNAPSHOT_MAGIC, sizeof(header.magic) );
+        header.version    = DISK_SNAPSHOT_VERSION;
+        header.cbHeader   = sizeof(header);
+        header.cbRecord   = (unsigned __int32)s_cbRecord;
+        header.count      = (unsigned __int32)lst_disk.size();
+        header.written    = (__int64)::time( nullptr );
+        header.crcRecords = diskSnapshotChecksum( lst_disk, devices );
+        header.crcHeader  = (unsigned __int64)::crc64( &header, offsetof( disk_snapshot_header_t, crcHeader ) );
+
+        file.resize( sizeof(header) + lst_disk.size() * s_cbRecord );
+        ::memcpy( &file[0], &header, sizeof(header) );
+
+        unsigned __int8 *p = &file[0] + sizeof(header);
+        for( size_t i = 0; i < lst_disk.size(); i++, p += s_cbRecord )
+        {
+            const __int32 device = ( i < devices.size() ) ? devices[i] : -1;
+            ::memcpy( p, &lst_disk[i], sizeof(disk_t) );
+            ::memcpy( p + sizeof(disk_t), &device, sizeof(device) );
+        }
+    }
+
+#ifdef _WIN32
+    //----------------------------------------------------------------------------------------------------------------------
+    bool saveDiskSnapshot( const wchar_t *path, const std::vector<disk_t> &lst_disk, const std::vector<int> &devices )
+    {
+        std::vector<unsigned __int8> file;
+        buildSnapshot( lst_disk, devices, file );
+
+            // unique per thread: the refresher and an xp_DiskId call may save at the same time
+        wchar_t suffix[64] = {0};
+        ::_snwprintf( suffix, _countof(suffix)-1, L".%lu.%lu.tmp", ::GetCurrentProcessId(), ::GetCurrentThreadId() );
+        const std::wstring temp = std::wstring( path ) + suffix;
+
+        HANDLE hFile = ::CreateFileW( temp.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+        if( INVALID_HANDLE_VALUE == hFile )
+        {
+            return false;
+        }
+        DWORD cbWritten = 0;
+        bool  ok = ::WriteFile( hFile, &file[0], (DWORD)file.size(), &cbWritten, NULL ) && cbWritten == file.size() &&
+                   ::FlushFileBuffers( hFile );
+        ::CloseHandle( hFile );
+
+        if( !ok || !::MoveFileExW( temp.c_str(), path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) )
+        {
+            ::DeleteFileW( temp.c_str() );
+            return false;
+        }
+        return true;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool loadDiskSnapshot( const wchar_t *path, std::vector<disk_t> &lst_disk, std::vector<int> &devices, unsigned long maxAgeSec )
+    {
+        HANDLE hFile = ::CreateFileW( path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+        if( INVALID_HANDLE_VALUE == hFile )
+        {
+            return false;
+        }
+        bool          ok = false;
+        LARGE_INTEGER size;
+        if( ::GetFileSizeEx( hFile, &size ) && size.QuadPart >= (LONGLONG)sizeof(disk_snapshot_header_t) && size.QuadPart < 0x7fffffff )
+        {
+            HANDLE hMapping = ::CreateFileMappingW( hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+            if( NULL != hMapping )
+            {
+                const unsigned __int8 *view = (const unsigned __int8*)::MapViewOfFile( hMapping, FILE_MAP_READ, 0, 0, 0 );
+                if( NULL != view )
+                {
+                    ok = parseSnapshot( view, (size_t)size.QuadPart, maxAgeSec, lst_disk, devices );
+                    ::UnmapViewOfFile( view );
+                }
+                ::CloseHandle( hMapping );
+            }
+        }
+        ::CloseHandle( hFile );
+        return ok;
+    }
+#else
+    //----------------------------------------------------------------------------------------------------------------------
+    bool saveDiskSnapshot( const char *path, const std::vector<disk_t> &lst_disk, const std::vector<int> &devices )
+    {
+        std::vector<unsigned __int8> file;
+        buildSnapshot( lst_disk, devices, file );
+
+        char suffix[64] = {0};
+        ::snprintf( suffix, sizeof(suffix), ".%lu.%lu.tmp", (unsigned long)::getpid(), (unsigned long)::pthread_self() );
+        const std::string temp = std::string( path ) + suffix;
+
+        int fd = ::open( temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+        if( fd < 0 )
+        {
+            return false;
+        }
+        bool ok = ( (ssize_t)file.size() == ::write( fd, &file[0], file.size() ) ) && 0 == ::fsync( fd );
+        ::close( fd );
+
+        if( !ok || 0 != ::rename( temp.c_str(), path ) )
+        {
+            ::unlink( temp.c_str() );
+            return false;
+        }
+        return true;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool loadDiskSnapshot( const char *path, std::vector<disk_t> &lst_disk, std::vector<int> &devices, unsigned long maxAgeSec )
+    {
+        int fd = ::open( path, O_RDONLY | O_CLOEXEC );
+        if( fd < 0 )
+        {
+            return false;
+        }
+        bool        ok = false;
+        struct stat st;
+        if( 0 == ::fstat( fd, &st ) && st.st_size >= (off_t)sizeof(disk_snapshot_header_t) && st.st_size < 0x7fffffff )
+        {
+            void *view = ::mmap( nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+            if( MAP_FAILED != view )
+            {
+                ok = parseSnapshot( (const unsigned __int8*)view, (size_t)st.st_size, maxAgeSec, lst_disk, devices );
+                ::munmap( view, (size_t)st.st_size );
+            }
+        }
+        ::close( fd );
+        return ok;
+    }
+#endif
+};
@@ -0,0 +1,61 @@
+/** @file
+  * EpsDiskId/snapfile.h
+  *
+  * Last enumeration kept on disk, for answering right after a restart.
+  *
+  * File layout (little endian):
+  *     disk_snapshot_header_t
+  *     count records of  disk_t (sizeof(disk_t) bytes as in memory) + __int32 physical drive
+  *
+  * disk_t is stored as is, padding included, because the legacy duuid of xp_DiskId is a CRC over
+  * those bytes; the header therefore records sizeof(disk_t) and a file from a build with another
+  * layout is refused.  The header carries a CRC-64 of the records and one of itself, so a torn or
+  * corrupt file is never used.  Files are written to a temporary name and renamed over the old
+  * one, so a reader sees either the previous or the new snapshot, never a mix.
+  */
+
+#ifndef __Utils_SNAPFILE_
+#define __Utils_SNAPFILE_
+
+#include <vector>
+
+#include "diskid.h"
+
+namespace Utils
+{
+#define  DISK_SNAPSHOT_MAGIC        "EPSDSKSN"
+#define  DISK_SNAPSHOT_VERSION      2           // 2: NVMe records from Identify data (DSK_VERSION 5)
+
+#pragma pack(push, 1)
+    struct disk_snapshot_header_t
+    {
+        char                magic[8];           // DISK_SNAPSHOT_MAGIC, no terminator
+        unsigned __int32    version;            // DISK_SNAPSHOT_VERSION
+        unsigned __int32    cbHeader;           // sizeof(disk_snapshot_header_t)
+        unsigned __int32    cbRecord;           // sizeof(disk_t) + 4
+        unsigned __int32    count;
+        __int64             written;            // seconds since 1970-01-01 UTC
+        unsigned __int64    crcRecords;         // crc64 of all records
+        unsigned __int64    crcHeader;          // crc64 of the bytes above
+    };
+#pragma pack(pop)
+
+#ifdef _WIN32
+    typedef wchar_t snapshot_path_char_t;
+#else
+    typedef char    snapshot_path_char_t;
+#endif
+
+       //  devices: physical drive of each record, as DiskCache::store() takes it
+    bool    saveDiskSnapshot( const snapshot_path_char_t *path, const std::vector<disk_t> &lst_disk, const std::vector<int> &devices );
+
+       //  Maps the file and copies the records out; false if it is missing, of another version or
+       //  layout, fails a checksum, or was written more than maxAgeSec ago (0: any age)
+    bool    loadDiskSnapshot( const snapshot_path_char_t *path, std::vector<disk_t> &lst_disk, std::vector<int> &devices,
+                              unsigned long maxAgeSec );
+
+       //  crc64 of the records as they would be written; lets a caller skip rewriting an unchanged file
+    unsigned __int64    diskSnapshotChecksum( const std::vector<disk_t> &lst_disk, const std::vector<int> &devices );
+};
+
+#endif
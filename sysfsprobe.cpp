@@ -0,0 +1,565 @@
+/** @file
+  * EpsDiskId/sysfsprobe.cpp
+  *
+  * Drive records on Linux, read from sysfs.
+  */
+
+#ifndef _WIN32
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/ioctl.h>
+#include <linux/hdreg.h>
+#include <linux/nvme_ioctl.h>
+#include <scsi/sg.h>
+
+#include "sysfsprobe.h"
+#include "deviceio.h"
+#include "probestrategy.h"
+#include "probediag.h"
+#include "probestats.h"
+#include "identify.h"
+#include "nvme.h"
+
+namespace Utils
+{
+#define  ATA_PASS_THROUGH_16     0x85
+#define  ATA_PROTOCOL_PIO_IN     4
+#define  SYSFS_SECTOR_SIZE       512         // /sys/block/<name>/size counts these whatever the drive's own
+
+    //----------------------------------------------------------------------------------------------------------------------
+    static std::string trimmed( const std::string &value )
+    {
+        static const char blanks[] = " \t\r\n";
+        const size_t first = value.find_first_not_of( blanks );
+        if( std::string::npos == first )
+        {
+            return std::string();
+        }
+        return value.substr( first, value.find_last_not_of( blanks ) - first + 1 );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    static void copyField( char *dst, size_t cb, const std::string &value )
+    {
+        const size_t cch = ( value.size() < cb - 1 ) ? value.size() : cb - 1;
+        ::memcpy( dst, value.data(), cch );
+        dst[cch] = '\0';
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // unit serial number VPD page: 4 byte header with the length in bytes 2-3, then the serial
+    static std::string vpdSerial( const std::string &page )
+    {
+        if( page.size() < 4 || 0x80 != (unsigned char)page[1] )
+        {
+            return std::string();
+        }
+        const size_t cch = ( (unsigned char)page[2] << 8 ) | (unsigned char)page[3];
+        return trimmed( page.substr( 4, cch ) );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // "t10.ATA     <model> <serial>": the serial is the last word, the model what is before it
+    static bool wwidAta( const std::string &wwid, std::string &model, std::string &serial )
+    {
+        static const char prefix[] = "t10.ATA";
+        const std::string text = trimmed( wwid );
+
+        if( 0 != text.compare( 0, sizeof(prefix) - 1, prefix ) )
+        {
+            return false;
+        }
+        const size_t last = text.find_last_of( ' ' );
+        if( std::string::npos == last || last < sizeof(prefix) - 1 )
+        {
+            return false;
+        }
+        serial = text.substr( last + 1 );
+        model  = trimmed( text.substr( sizeof(prefix) - 1, last - ( sizeof(prefix) - 1 ) ) );
+        return !serial.empty();
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // "nvme<C>n<N>": controller "nvme<C>" and NSID N.  A "#k" a replayed fleet appends stays with the
+       // controller, so every copy of a drive is swept on its own.
+    static bool nvmeNamespace( const std::string &name, std::string &controller, unsigned long &nsid )
+    {
+        static const char prefix[] = "nvme";
+        if( 0 != name.compare( 0, sizeof(prefix) - 1, prefix ) )
+        {
+            return false;
+        }
+        size_t i = sizeof(prefix) - 1;
+        const size_t digits = i;
+        while( i < name.size() && ::isdigit( (unsigned char)name[i] ) )
+        {
+            i++;
+        }
+        if( i == digits || i >= name.size() || 'n' != name[i] )
+        {
+            return false;
+        }
+        const size_t end = i;
+        const size_t first = ++i;
+        while( i < name.size() && ::isdigit( (unsigned char)name[i] ) )
+        {
+            i++;
+        }
+        if( i == first || ( i < name.size() && '#' != name[i] ) )
+        {
+            return false;
+        }
+        nsid       = ::strtoul( name.c_str() + first, nullptr, 10 );
+        controller = name.substr( 0, end ) + name.substr( i );
+        return 0 != nsid;
+    }
+
+    //----------------------------------------------------------------------------------------------------------------------
+    SysfsProbe::SysfsProbe()
+        : m_root( "/sys" )
+        , m_bIdentify( true )
+        , m_nDeviceTimeoutMs( 0 )
+        , m_nTotalTimeoutMs( 0 )
+        , m_pStrategy( nullptr )
+        , m_pDiagnostics( nullptr )
+        , m_pStats( nullptr )
+        , m_pIo( nullptr )
+    {
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void SysfsProbe::setSysRoot( const std::string &root )
+    {
+        m_root = root;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void SysfsProbe::setIdentify( bool bIdentify )
+    {
+        m_bIdentify = bIdentify;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void SysfsProbe::setTimeouts( unsigned long nDeviceTimeoutMs, unsigned long nTotalTimeoutMs )
+    {
+        m_nDeviceTimeoutMs = nDeviceTimeoutMs;
+        m_nTotalTimeoutMs  = nTotalTimeoutMs;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void SysfsProbe::setStrategy( ProbeStrategy *pStrategy )
+    {
+        m_pStrategy = pStrategy;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void SysfsProbe::setDiagnostics( ProbeDiagnostics *pDiagnostics )
+    {
+        m_pDiagnostics = pDiagnostics;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void SysfsProbe::setStats( ProbeStats *pStats )
+    {
+        m_pStats = pStats;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void SysfsProbe::setDeviceIo( DeviceIo *pIo )
+    {
+        m_pIo = pIo;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    DeviceIo &SysfsProbe::io() const
+    {
+        return ( nullptr != m_pIo ) ? *m_pIo : liveDeviceIo();
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // <root>/block/<name>/<attribute>, blanks and the newline removed; false if missing or empty
+    bool SysfsProbe::readAttribute( const device_t &device, const char *name, std::string &value ) const
+    {
+        unsigned long error = 0;
+        std::string   text;
+
+        if( !io().readAttribute( m_root + "/block/" + device.name + "/" + name, text, error ) )
+        {
+            value.clear();
+            return false;
+        }
+        value = trimmed( text );
+        return !value.empty();
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    void SysfsProbe::readSysfs( const device_t &device, disk_t &_disk ) const
+    {
+        ProbeStatScope timer( m_pStats, PROBE_PHASE_SYSFS, device.index );
+        std::string    value;
+        std::string    model;
+        std::string    serial;
+        std::string    revision;
+
+        if( readAttribute( device, "device/vendor", value ) )
+        {
+            copyField( _disk.vendor, sizeof(_disk.vendor), value );
+        }
+        readAttribute( device, "device/model", model );
+
+        if( !readAttribute( device, "device/rev", revision ) )
+        {
+            readAttribute( device, "device/firmware_rev", revision );
+        }
+
+        if( !readAttribute( device, "device/serial", serial ) && !readAttribute( device, "serial", serial ) )
+        {
+            std::string page;
+            unsigned long error = 0;
+            if( io().readAttribute( m_root + "/block/" + device.name + "/device/vpd_pg80", page, error ) )
+            {
+                serial = vpdSerial( page );
+            }
+        }
+        if( serial.empty() || model.empty() )
+        {
+            std::string wwidModel;
+            std::string wwidSerial;
+            if( ( readAttribute( device, "device/wwid", value ) || readAttribute( device, "wwid", value ) ) &&
+                wwidAta( value, wwidModel, wwidSerial ) )
+            {
+                serial = serial.empty() ? wwidSerial : serial;
+                model  = model.empty()  ? wwidModel  : model;
+            }
+        }
+        copyField( _disk.model,    sizeof(_disk.model),    model );
+        copyField( _disk.serial,   sizeof(_disk.serial),   serial );
+        copyField( _disk.revision, sizeof(_disk.revision), revision );
+
+        if( readAttribute( device, "size", value ) )
+        {
+            _disk.sectors = ::strtoll( value.c_str(), nullptr, 10 );
+            _disk.size    = _disk.sectors * SYSFS_SECTOR_SIZE;
+        }
+        _disk.type = ( readAttribute( device, "removable", value ) && "1" == value ) ? 0 : 1;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // the IDENTIFY DEVICE sector, from the kernel's copy or from the drive; timedOut when SG_IO ran out of time
+    bool SysfsProbe::identify( const device_t &device, void *sector, unsigned long timeoutMs, bool &timedOut ) const
+    {
+        unsigned long error = 0;
+        void         *hDrive = nullptr;
+        {
+            ProbeStatScope timer( m_pStats, PROBE_PHASE_OPEN, device.index );
+            hDrive = io().open( device.path, DEVICE_IO_QUERY, false, error );
+        }
+        if( nullptr == hDrive )
+        {
+            if( nullptr != m_pDiagnostics )
+            {
+                m_pDiagnostics->record( PROBE_OP_OPEN_DRIVE, device.index, error );
+            }
+            return false;
+        }
+        unsigned long cbReturned = 0;
+        bool          done       = false;
+        {
+            ProbeStatScope timer( m_pStats, PROBE_PHASE_OTHER_IOCTL, device.index );
+            done = io().control( hDrive, HDIO_GET_IDENTITY, nullptr, 0, sector, 2 * IDENTIFY_SECTOR_WORDS,
+                                 cbReturned, timeoutMs, error );
+        }
+        if( !done )
+        {
+            unsigned char cdb[16] = {0};
+            cdb[0]  = ATA_PASS_THROUGH_16;
+            cdb[1]  = ATA_PROTOCOL_PIO_IN << 1;
+            cdb[2]  = 0x0e;                     // T_DIR from the device, BYT_BLOK, T_LENGTH in the sector count
+            cdb[6]  = 1;                        // one sector
+            cdb[14] = IDE_ATA_IDENTIFY;
+
+            ProbeStatScope timer( m_pStats, PROBE_PHASE_OTHER_IOCTL, device.index );
+            done = io().control( hDrive, SG_IO, cdb, sizeof(cdb), sector, 2 * IDENTIFY_SECTOR_WORDS,
+                                 cbReturned, timeoutMs, error ) && cbReturned == 2 * IDENTIFY_SECTOR_WORDS;
+            timedOut = !done && DEVICE_IO_TIMEOUT == error;
+        }
+        io().close( hDrive );
+
+        if( !done && !timedOut && nullptr != m_pDiagnostics )
+        {
+            m_pDiagnostics->record( PROBE_OP_IDENTIFY, device.index, error );
+        }
+        return done;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // one Identify on the controller handle; timedOut when it ran out of time
+    bool SysfsProbe::nvmeIdentify( const device_t &device, unsigned __int32 cns, unsigned __int32 nsid, void *hController,
+                                   std::vector<unsigned __int8> &data, unsigned long timeoutMs, bool &timedOut ) const
+    {
+        nvme_admin_t command;
+        ::memset( &command, 0, sizeof(command) );
+        command.opcode = NVME_ADMIN_IDENTIFY;
+        command.nsid   = nsid;
+        command.cdw10  = cns;
+
+        unsigned long error      = 0;
+        unsigned long cbReturned = 0;
+        bool          done       = false;
+
+        data.assign( NVME_IDENTIFY_SIZE, 0 );
+        {
+            ProbeStatScope timer( m_pStats, PROBE_PHASE_OTHER_IOCTL, device.index );
+            done = io().control( hController, NVME_IOCTL_ADMIN_CMD, &command, sizeof(command), &data[0], NVME_IDENTIFY_SIZE,
+                                 cbReturned, timeoutMs, error ) && NVME_IDENTIFY_SIZE == cbReturned;
+        }
+        timedOut = !done && DEVICE_IO_TIMEOUT == error;
+        if( !done && !timedOut && nullptr != m_pDiagnostics )
+        {
+            m_pDiagnostics->record( PROBE_OP_NVME_IDENTIFY, device.index, error );
+        }
+        return done;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // Identify Controller, the active namespace list and Identify Namespace of the NSIDs wanted, all
+       // on one handle of the controller.  A controller older than NVMe 1.1 has no namespace list; the
+       // wanted NSIDs are then asked directly.
+    void SysfsProbe::sweepController( const device_t &device, const std::string &controller, nvme_sweep_t &sweep,
+                                      unsigned long timeoutMs ) const
+    {
+        const device_path_t path = device.path.substr( 0, device.path.rfind( '/' ) + 1 ) + controller;
+        unsigned long       error       = 0;
+        void               *hController = nullptr;
+
+        sweep.swept = true;
+        {
+            ProbeStatScope timer( m_pStats, PROBE_PHASE_OPEN, device.index );
+            hController = io().open( path, DEVICE_IO_QUERY, false, error );
+        }
+        if( nullptr == hController )
+        {
+            if( nullptr != m_pDiagnostics )
+            {
+                m_pDiagnostics->record( PROBE_OP_OPEN_DRIVE, device.index, error );
+            }
+            return;
+        }
+        sweep.answered = nvmeIdentify( device, NVME_CNS_CONTROLLER, 0, hController, sweep.controller, timeoutMs, sweep.timedOut );
+
+        std::vector<unsigned __int8> data;
+        std::vector<unsigned long>   active;
+        if( sweep.answered && nvmeIdentify( device, NVME_CNS_ACTIVE_NAMESPACES, 0, hController, data, timeoutMs, sweep.timedOut ) )
+        {
+            unsigned __int32 nsids[NVME_NAMESPACE_LIST_MAX];
+            const size_t     n = nvmeActiveNamespaces( &data[0], nsids, NVME_NAMESPACE_LIST_MAX );
+            for( size_t i = 0; i < n; i++ )
+            {
+                if( sweep.wanted.count( nsids[i] ) )
+                {
+                    active.push_back( nsids[i] );
+                }
+            }
+        }
+        else if( sweep.answered && !sweep.timedOut )
+        {
+            active.assign( sweep.wanted.begin(), sweep.wanted.end() );
+        }
+        for( size_t i = 0; i < active.size() && !sweep.timedOut; i++ )
+        {
+            if( nvmeIdentify( device, NVME_CNS_NAMESPACE, (unsigned __int32)active[i], hController, data, timeoutMs, sweep.timedOut ) )
+            {
+                sweep.namespaces[active[i]].swap( data );
+            }
+        }
+        io().close( hController );
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+       // missing fields of an NVMe namespace from the Identify data of its controller, swept on first use
+    bool SysfsProbe::probeNvme( const device_t &device, disk_t &_disk, nvme_sweeps_t &sweeps, unsigned long timeoutMs,
+                                bool &timedOut ) const
+    {
+        std::string   controller;
+        unsigned long nsid = 0;
+
+        if( !nvmeNamespace( device.name, controller, nsid ) )
+        {
+            return false;
+        }
+        nvme_sweep_t &sweep = sweeps[controller];
+        if( !sweep.swept )
+        {
+            sweep.wanted.insert( nsid );
+            sweepController( device, controller, sweep, timeoutMs );
+        }
+        if( !sweep.answered )
+        {
+            timedOut = sweep.timedOut;
+            return false;
+        }
+        ProbeStatScope           timer( m_pStats, PROBE_PHASE_PARSE, device.index );
+        const NvmeControllerView id( &sweep.controller[0] );
+
+        if( '\0' == _disk.model[0] )
+        {
+            id.model().copyTo( _disk.model, sizeof(_disk.model) );
+        }
+        if( '\0' == _disk.serial[0] )
+        {
+            id.serial().copyTo( _disk.serial, sizeof(_disk.serial) );
+        }
+        if( '\0' == _disk.revision[0] )
+        {
+            id.firmware().copyTo( _disk.revision, sizeof(_disk.revision) );
+        }
+        std::map<unsigned long, std::vector<unsigned __int8> >::const_iterator ns = sweep.namespaces.find( nsid );
+        if( 0 == _disk.sectors && sweep.namespaces.end() != ns )
+        {
+            _disk.size    = NvmeNamespaceView( &ns->second[0] ).size();
+            _disk.sectors = _disk.size / SYSFS_SECTOR_SIZE;
+        }
+        return true;
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool SysfsProbe::probeDrive( const device_t &device, disk_t &_disk, unsigned __int64 callDeadlineUs,
+                                 nvme_sweeps_t &sweeps, bool &timedOut ) const
+    {
+        _disk = disk_t();
+        _disk.num_controller = device.index;
+        timedOut = false;
+
+        readSysfs( device, _disk );
+
+        const bool bMissing = ( '\0' == _disk.model[0] || '\0' == _disk.serial[0] || '\0' == _disk.revision[0] );
+        const std::string identity = std::string( _disk.model ) + "|" + _disk.serial;
+
+        unsigned long timeoutMs = ( 0 != m_nDeviceTimeoutMs ) ? m_nDeviceTimeoutMs : DEVICE_IO_INFINITE;
+        if( 0 != callDeadlineUs )
+        {
+            const unsigned __int64 now = ProbeStats::nowUs();
+            const unsigned long    left = ( now < callDeadlineUs ) ? (unsigned long)( ( callDeadlineUs - now ) / 1000 ) : 0;
+            timeoutMs = ( left < timeoutMs ) ? left : timeoutMs;
+        }
+        std::string   controller;
+        unsigned long nsid = 0;
+        if( bMissing && m_bIdentify && 0 != timeoutMs && nvmeNamespace( device.name, controller, nsid ) )
+        {
+            if( nullptr == m_pStrategy || !m_pStrategy->isUnsupported( device, PROBE_NO_NVME_IDENTIFY, identity ) )
+            {
+                if( !probeNvme( device, _disk, sweeps, timeoutMs, timedOut ) )
+                {
+                    if( timedOut )
+                    {
+                        if( nullptr != m_pDiagnostics )
+                        {
+                            m_pDiagnostics->record( PROBE_OP_TIMED_OUT, device.index, 0 );
+                        }
+                        return false;
+                    }
+                    if( nullptr != m_pStrategy )
+                    {
+                        m_pStrategy->setUnsupported( device, PROBE_NO_NVME_IDENTIFY, identity );
+                    }
+                }
+            }
+        }
+        else if( bMissing && m_bIdentify && 0 != timeoutMs &&
+            ( nullptr == m_pStrategy || !m_pStrategy->isUnsupported( device, PROBE_NO_ATA_IDENTIFY, identity ) ) )
+        {
+            unsigned __int8 sector[2 * IDENTIFY_SECTOR_WORDS] = {0};
+
+            if( identify( device, sector, timeoutMs, timedOut ) )
+            {
+                ProbeStatScope     timer( m_pStats, PROBE_PHASE_PARSE, device.index );
+                const IdentifyView id( sector );
+
+                if( '\0' == _disk.model[0] )
+                {
+                    id.model().copyTo( _disk.model, sizeof(_disk.model) );
+                }
+                if( '\0' == _disk.serial[0] )
+                {
+                    id.serial().copyTo( _disk.serial, sizeof(_disk.serial) );
+                }
+                if( '\0' == _disk.revision[0] )
+                {
+                    id.firmware().copyTo( _disk.revision, sizeof(_disk.revision) );
+                }
+                _disk.buffer = id.bufferSize();
+                if( 0 == _disk.sectors )
+                {
+                    _disk.sectors = id.sectors();
+                    _disk.size    = _disk.sectors * SYSFS_SECTOR_SIZE;
+                }
+            }
+            else if( timedOut )
+            {
+                if( nullptr != m_pDiagnostics )
+                {
+                    m_pDiagnostics->record( PROBE_OP_TIMED_OUT, device.index, 0 );
+                }
+                return false;
+            }
+            else if( nullptr != m_pStrategy )
+            {
+                m_pStrategy->setUnsupported( device, PROBE_NO_ATA_IDENTIFY, identity );
+            }
+        }
+        return '\0' != _disk.model[0] || '\0' != _disk.serial[0];
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool SysfsProbe::getDriveInfo( const device_t &device, std::vector<disk_t> &_disk, probe_report_t &report ) const
+    {
+        const unsigned __int64 callDeadlineUs = ( 0 != m_nTotalTimeoutMs ) ? ProbeStats::nowUs() + m_nTotalTimeoutMs * 1000ULL : 0;
+        disk_t        disk;
+        bool          timedOut = false;
+        nvme_sweeps_t sweeps;
+
+        _disk.clear();
+        report.timedOut.clear();
+        report.deviceOf.clear();
+
+        if( probeDrive( device, disk, callDeadlineUs, sweeps, timedOut ) )
+        {
+            _disk.push_back( disk );
+            report.deviceOf.push_back( device.index );
+        }
+        if( timedOut )
+        {
+            report.timedOut.push_back( device.index );
+        }
+        return !_disk.empty();
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    bool SysfsProbe::getDrivesInfo( std::vector<disk_t> &_disk, probe_report_t &report ) const
+    {
+        const unsigned __int64 callDeadlineUs = ( 0 != m_nTotalTimeoutMs ) ? ProbeStats::nowUs() + m_nTotalTimeoutMs * 1000ULL : 0;
+        std::vector<device_t>  devices;
+
+        _disk.clear();
+        report.timedOut.clear();
+        report.deviceOf.clear();
+
+        if( !io().listDevices( false, devices ) )
+        {
+            return false;
+        }
+           //  namespaces of each NVMe controller, so that one sweep of it answers for all of them
+        nvme_sweeps_t sweeps;
+        for( size_t i = 0; i < devices.size(); i++ )
+        {
+            std::string   controller;
+            unsigned long nsid = 0;
+            if( nvmeNamespace( devices[i].name, controller, nsid ) )
+            {
+                sweeps[controller].wanted.insert( nsid );
+            }
+        }
+        _disk.reserve( devices.size() );
+        for( size_t i = 0; i < devices.size(); i++ )
+        {
+            disk_t disk;
+            bool   timedOut = false;
+
+            if( probeDrive( devices[i], disk, callDeadlineUs, sweeps, timedOut ) )
+            {
+                _disk.push_back( disk );
+                report.deviceOf.push_back( devices[i].index );
+            }
+            if( timedOut )
+            {
+                report.timedOut.push_back( devices[i].index );
+            }
+        }
+        return !_disk.empty();
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+};
+
+#endif
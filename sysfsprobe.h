@@ -0,0 +1,113 @@
+/** @file
+  * EpsDiskId/sysfsprobe.h
+  *
+  * Drive records on Linux, read from sysfs.
+  *
+  * Every drive listed under /sys/block (see devenum.h) is described by small attribute files:
+  *     device/vendor, device/model, device/rev             SCSI disks, SATA disks behind libata
+  *     device/model, device/serial, device/firmware_rev    NVMe controllers
+  *     serial                                              virtio disks
+  *     device/vpd_pg80                                     unit serial number page as the kernel keeps it
+  *     device/wwid, wwid                                   "t10.ATA     <model> <serial>" for SATA disks
+  *     size, removable                                     512-byte sectors, removable media
+  * None of them opens the device, so a whole inventory is a few small file reads per drive.  Only
+  * when the model, serial or revision is still missing is the drive opened and asked for its
+  * IDENTIFY sector: HDIO_GET_IDENTITY first (libata answers it from memory), then SG_IO with an
+  * ATA PASS-THROUGH (16) IDENTIFY DEVICE.  A drive that refuses both is remembered by the strategy
+  * and not asked again.
+  *
+  * NVMe namespaces (nvme<C>n<N>) are asked through their controller instead, /dev/nvme<C>, with
+  * NVME_IOCTL_ADMIN_CMD: one Identify Controller and one active namespace list per controller and
+  * call, then one Identify Namespace per namespace listed under /sys/block.  The namespace block
+  * devices themselves are never opened.
+  *
+  * Records: vendor, model, serial and revision with surrounding blanks removed; fields IDENTIFY
+  * filled in are decoded as on Windows.  sectors in 512-byte units, size in bytes, type 0 for
+  * removable media and 1 otherwise, num_controller the device index.
+  *
+  * tools/diskinv prints the xp_DiskId rows SysfsProbe gives for a host or a recorded trace.
+  */
+
+#ifndef __Utils_SYSFSPROBE_
+#define __Utils_SYSFSPROBE_
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "diskid.h"
+#include "devenum.h"
+
+namespace Utils
+{
+#ifndef _WIN32
+    class SysfsProbe
+    {
+        public:
+            SysfsProbe();
+
+               //  One record per drive under /sys/block, in the order devenum lists them.
+               //  Reentrant like DiskInfo: a configured instance may serve any number of threads.
+            bool    getDrivesInfo( std::vector<disk_t> &_disk, probe_report_t &report ) const;
+            bool    getDriveInfo( const device_t &device, std::vector<disk_t> &_disk, probe_report_t &report ) const;
+
+               //  where the attributes are read ("/sys"), e.g. a copy of another host's tree; the
+               //  drives themselves are still listed by the backend
+            void    setSysRoot( const std::string &root );
+
+               //  false: records hold what sysfs has, the drives are never opened
+            void    setIdentify( bool bIdentify );
+
+               //  Bound for one IDENTIFY and for a whole getDrivesInfo() call, in ms (0 = none).  A
+               //  drive whose IDENTIFY times out is listed in timedOut and left out of the result;
+               //  once the budget is spent the remaining drives get their sysfs record only.
+            void    setTimeouts( unsigned long nDeviceTimeoutMs, unsigned long nTotalTimeoutMs );
+
+               //  as for DiskInfo; each must outlive the calls made with it, nullptr = none / the OS
+            void    setStrategy( ProbeStrategy *pStrategy );
+            void    setDiagnostics( ProbeDiagnostics *pDiagnostics );
+            void    setStats( ProbeStats *pStats );
+            void    setDeviceIo( DeviceIo *pIo );
+
+        private:
+               //  Identify data of one NVMe controller, fetched once per call for all its namespaces
+            struct nvme_sweep_t
+            {
+                std::set<unsigned long>                                     wanted;         // NSIDs under /sys/block
+                bool                                                        swept;
+                bool                                                        answered;       // Identify Controller
+                bool                                                        timedOut;
+                std::vector<unsigned __int8>                                controller;
+                std::map<unsigned long, std::vector<unsigned __int8> >      namespaces;     // by NSID
+
+                nvme_sweep_t() : swept( false ), answered( false ), timedOut( false ) {}
+            };
+            typedef std::map<std::string, nvme_sweep_t>     nvme_sweeps_t;                  // by controller name
+
+            DeviceIo   &io() const;
+            bool        readAttribute( const device_t &device, const char *name, std::string &value ) const;
+            void        readSysfs( const device_t &device, disk_t &_disk ) const;
+            bool        identify( const device_t &device, void *sector, unsigned long timeoutMs, bool &timedOut ) const;
+            bool        nvmeIdentify( const device_t &device, unsigned __int32 cns, unsigned __int32 nsid, void *hController,
+                                      std::vector<unsigned __int8> &data, unsigned long timeoutMs, bool &timedOut ) const;
+            void        sweepController( const device_t &device, const std::string &controller, nvme_sweep_t &sweep,
+                                         unsigned long timeoutMs ) const;
+            bool        probeNvme( const device_t &device, disk_t &_disk, nvme_sweeps_t &sweeps, unsigned long timeoutMs,
+                                   bool &timedOut ) const;
+            bool        probeDrive( const device_t &device, disk_t &_disk, unsigned __int64 callDeadlineUs,
+                                    nvme_sweeps_t &sweeps, bool &timedOut ) const;
+
+            std::string         m_root;
+            bool                m_bIdentify;
+            unsigned long       m_nDeviceTimeoutMs;
+            unsigned long       m_nTotalTimeoutMs;
+            ProbeStrategy      *m_pStrategy;
+            ProbeDiagnostics   *m_pDiagnostics;
+            ProbeStats         *m_pStats;
+            DeviceIo           *m_pIo;
+    };
+#endif
+};
+
+#endif
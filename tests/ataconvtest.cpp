@@ -0,0 +1,319 @@
+/** @file
+  * EpsDiskId/tests/ataconvtest.cpp
+  *
+  * The decoding kernels of ataconv.h against the code they replaced: FlipAndCodeBytes() and
+  * ConvertToString() of the old DiskInfo, kept here as they were.  Random and edge inputs (odd
+  * lengths, characters that are no hex digits, all blanks, fields of 0 and 1 byte) go through the
+  * scalar kernels and, where the CPU has SSSE3, through the SSSE3 ones, and every result has to be
+  * the old one.
+  *
+  * ataconvtest
+  */
+
+#include <string.h>
+
+#include <string>
+
+#include "ataconv.h"
+#include "identify.h"
+#include "testutil.h"
+
+using namespace Utils;
+
+#define  ATACONV_ROUNDS     4000
+
+//----------------------------------------------------------------------------------------------------------------------
+   // the old DiskInfo::FlipAndCodeBytes(); it reads up to 3 bytes past the NUL of str, so str comes
+   // with at least 3 more NULs
+static const char *oldFlipAndCodeBytes( const char *str, char (&flipped)[1024] )
+{
+    const size_t num = ::strlen( str );
+
+    ::memset( flipped, '\0', sizeof(flipped) );
+
+    for( size_t i = 0; i < num; i += 4 )
+    {
+        for( int j = 1; j >= 0; j-- )
+        {
+            size_t sum = 0;
+
+            for( int k = 0; k < 2; k++ )
+            {
+                sum *= 16;
+                switch (str [i + j * 2 + k])
+                {
+                case '0': sum += 0; break;
+                case '1': sum += 1; break;
+                case '2': sum += 2; break;
+                case '3': sum += 3; break;
+                case '4': sum += 4; break;
+                case '5': sum += 5; break;
+                case '6': sum += 6; break;
+                case '7': sum += 7; break;
+                case '8': sum += 8; break;
+                case '9': sum += 9; break;
+                case 'a': sum += 10; break;
+                case 'b': sum += 11; break;
+                case 'c': sum += 12; break;
+                case 'd': sum += 13; break;
+                case 'e': sum += 14; break;
+                case 'f': sum += 15; break;
+                case 'A': sum += 10; break;
+                case 'B': sum += 11; break;
+                case 'C': sum += 12; break;
+                case 'D': sum += 13; break;
+                case 'E': sum += 14; break;
+                case 'F': sum += 15; break;
+                }
+            }
+            if (sum > 0)
+            {
+                char sub [2] = { (char) sum, 0 };
+
+                ::strcat( flipped, sub );
+            }
+        }
+    }
+
+    return flipped;
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // the old DiskInfo::ConvertToString()
+static const char *oldConvertToString( unsigned __int32 diskdata [256], int firstIndex, int lastIndex, char (&cv)[1024] )
+{
+   int position = 0;
+   memset( cv, 0, sizeof(cv) );
+
+      //  each integer has two characters stored in it backwards
+   for(int index = firstIndex; index <= lastIndex; index++)
+   {
+         //  get high byte for 1st character
+      cv [position] = (char) (diskdata [index] / 256);
+      position++;
+
+         //  get low byte for 2nd character
+      cv [position] = (char) (diskdata [index] % 256);
+      position++;
+   }
+      //  end the string
+   cv[position] = '\0';
+
+      //  cut off the trailing blanks
+   for(int index = position - 1; index > 0 && ' ' == cv[index]; index-- )
+   {
+      cv [index] = '\0';
+   }
+   return cv;
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // a small generator of its own, so that every run sees the same inputs
+static unsigned s_seed = 0x2545F491;
+
+static unsigned nextRandom()
+{
+    s_seed = s_seed * 1103515245U + 12345U;
+    return s_seed >> 8;
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // characters the way drivers send them, with much of what is no hex digit
+static char randomChar( bool bNul )
+{
+    static const char alphabet[] = "0000000000123456789abcdefABCDEF    gGzZ-_.:/\x7f\x80\xff";
+    const unsigned    r          = nextRandom() % ( sizeof(alphabet) - 1 + ( bNul ? 2 : 0 ) );
+    return r < sizeof(alphabet) - 1 ? alphabet[r] : '\0';
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // hexFlipDecode() of src[0, strlen) against FlipAndCodeBytes()
+static bool sameFlip( const char *src )
+{
+    std::string padded( src );
+    padded.append( 4, '\0' );
+
+    char  flipped[1024];
+    const std::string expected( oldFlipAndCodeBytes( padded.c_str(), flipped ) );
+
+    char         dst[1024];
+    const size_t cch = hexFlipDecode( padded.c_str(), ::strlen( src ), dst, sizeof(dst) );
+    if( expected.size() != cch || expected != dst )
+    {
+        return false;
+    }
+
+       //  a short buffer gets the start of it
+    char         shortDst[5];
+    const size_t cchShort = hexFlipDecode( padded.c_str(), ::strlen( src ), shortDst, sizeof(shortDst) );
+    return expected.substr( 0, sizeof(shortDst) - 1 ) == shortDst && ::strlen( shortDst ) == cchShort;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testHexFlip()
+{
+    static const char *const edges[] =
+    {
+        "", "3", "35", "353", "3533", "35334", "3533453", "20202020", "    ", "0000", "zzzz", "g1h2",
+        "5744", "57442D57", "57442d57434336", "2057442D5743433659334B48", "ABCDEFabcdef", "0a0B0c0D0e",
+        "57 44 2D", "5744\x80\xff", "00000000000000000000000000000000004131"
+    };
+    bool ok = true;
+    for( size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++ )
+    {
+        ok = sameFlip( edges[i] ) && ok;
+    }
+    CHECK( ok );
+
+    char buffer[200];
+    ok = true;
+    for( int i = 0; i < ATACONV_ROUNDS; i++ )
+    {
+        const size_t cch = nextRandom() % ( sizeof(buffer) - 1 );
+        for( size_t c = 0; c < cch; c++ )
+        {
+            buffer[c] = randomChar( false );
+        }
+        buffer[cch] = '\0';
+        ok = sameFlip( buffer ) && ok;
+    }
+    CHECK( ok );
+
+       //  a buffer of one byte gets the NUL, none nothing
+    char one = 'x';
+    CHECK( 0 == hexFlipDecode( "3435", 4, &one, 1 ) && '\0' == one );
+    one = 'x';
+    CHECK( 0 == hexFlipDecode( "3435", 4, &one, 0 ) && 'x' == one );
+    CHECK( 0 == hexFlipDecode( nullptr, 4, &one, 1 ) && '\0' == one );
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // the fields of IdentifyView against ConvertToString() and the strncpy into disk_t that followed it
+static bool sameFields( const unsigned __int8 (&sector)[2 * IDENTIFY_SECTOR_WORDS] )
+{
+    unsigned __int32 diskdata[IDENTIFY_SECTOR_WORDS];
+    for( int w = 0; w < IDENTIFY_SECTOR_WORDS; w++ )
+    {
+        diskdata[w] = sector[2 * w] | ( sector[2 * w + 1] << 8 );
+    }
+
+    const IdentifyView identify( sector );
+    const struct { ata_string_t field; int first; int last; } fields[] =
+    {
+        { identify.serial(), 10, 19 }, { identify.firmware(), 23, 26 }, { identify.model(), 27, 46 }
+    };
+
+    bool ok = true;
+    for( size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); f++ )
+    {
+        char cv[1024];
+        char expected[256];
+        ::strncpy( expected, oldConvertToString( diskdata, fields[f].first, fields[f].last, cv ), sizeof(expected) - 1 );
+        expected[sizeof(expected) - 1] = '\0';
+
+        char         actual[256];
+        const size_t cch = fields[f].field.copyTo( actual, sizeof(actual) );
+        ok = ok && ::strlen( expected ) == cch && 0 == ::strcmp( expected, actual );
+    }
+    return ok;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testFields()
+{
+    unsigned __int8 sector[2 * IDENTIFY_SECTOR_WORDS];
+
+       //  all blanks, all NULs, a NUL up front, blanks before a NUL
+    bool ok = true;
+    ::memset( sector, ' ', sizeof(sector) );
+    ok = sameFields( sector ) && ok;
+    ::memset( sector, 0, sizeof(sector) );
+    ok = sameFields( sector ) && ok;
+    ::memset( sector, 'A', sizeof(sector) );
+    sector[2 * 10 + 1] = '\0';
+    sector[2 * 27]     = ' ';
+    sector[2 * 27 + 1] = ' ';
+    sector[2 * 28 + 1] = '\0';
+    ok = sameFields( sector ) && ok;
+
+    for( int i = 0; i < ATACONV_ROUNDS; i++ )
+    {
+        const bool bNul = 0 == nextRandom() % 4;
+        for( size_t b = 0; b < sizeof(sector); b++ )
+        {
+            sector[b] = (unsigned __int8)randomChar( bNul );
+        }
+           //  and often a blank tail of random length
+        const size_t blanks = nextRandom() % 48;
+        ::memset( sector + 2 * 47 - blanks, ' ', blanks );
+        ok = sameFields( sector ) && ok;
+    }
+    CHECK( ok );
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // the kernels at every start and length a field can have, 0 and 1 byte included
+static void testKernels()
+{
+    unsigned __int8 field[96];
+    bool            ok = true;
+    for( int i = 0; i < ATACONV_ROUNDS; i++ )
+    {
+        const bool bNul = 0 == nextRandom() % 3;
+        for( size_t b = 0; b < sizeof(field); b++ )
+        {
+            field[b] = (unsigned __int8)randomChar( bNul );
+        }
+        const size_t first = nextRandom() % 16;
+        const size_t count = nextRandom() % ( sizeof(field) - 16 );
+
+        char copy[96];
+        ataSwapCopy( field, first, count, copy );
+        for( size_t c = 0; c < count; c++ )
+        {
+            ok = ok && (char)field[( first + c ) ^ 1] == copy[c];
+        }
+
+           //  fields are whole words from the start of a word
+        const unsigned __int8 *word     = field + ( first & ~(size_t)1 );
+        const size_t           cb       = count & ~(size_t)1;
+        size_t                 expected = 0;
+        while( expected < cb && 0 != word[expected ^ 1] )
+        {
+            expected++;
+        }
+        if( expected == cb )
+        {
+            while( expected > 1 && ' ' == word[( expected - 1 ) ^ 1] )
+            {
+                expected--;
+            }
+        }
+        ok = ok && expected == ataStringLength( word, cb );
+
+        size_t blanks = 0;
+        while( blanks < count && ' ' == copy[blanks] )
+        {
+            blanks++;
+        }
+        ok = ok && blanks == countLeadingBlanks( copy, count );
+    }
+    CHECK( ok );
+
+    const char blanks[] = "                                         x";
+    CHECK( 0 == countLeadingBlanks( blanks, 0 ) && 1 == countLeadingBlanks( blanks, 1 ) );
+    CHECK( 41 == countLeadingBlanks( blanks, 41 ) && 41 == countLeadingBlanks( blanks, 42 ) );
+    CHECK( 0 == ataStringLength( field, 0 ) );
+    CHECK( 1 == ataStringLength( (const unsigned __int8 *)blanks, 1 ) );
+    CHECK( 1 == ataStringLength( (const unsigned __int8 *)blanks, 40 ) );
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testAll()
+{
+    testHexFlip();
+    testFields();
+    testKernels();
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main()
+{
+    ataconvUseVector( false );
+    testAll();
+    if( ataconvUseVector( true ) )
+    {
+        testAll();
+    }
+    return testResult( "ataconvtest" );
+}
@@ -0,0 +1,185 @@
+/** @file
+  * EpsDiskId/tests/diskrectest.cpp
+  *
+  * The compact records of diskrec.h: every disk_t comes back byte for byte, with the duuid it had,
+  * whatever its strings hold (40-character serials, a vendor that fills its 256 bytes, bytes after
+  * the NUL, padding that is not zero), in far less room than the disk_t; a record cut short or
+  * malformed is refused.
+  *
+  * diskrectest
+  */
+
+#include <string.h>
+
+#include <vector>
+
+#include "diskrec.h"
+#include "crc64.h"
+#include "testutil.h"
+
+using namespace Utils;
+
+//----------------------------------------------------------------------------------------------------------------------
+static disk_t makeDisk( int controller, const char *model, const char *serial, __int64 sectors )
+{
+    disk_t _disk;
+    _disk.num_controller = controller;
+    _disk.master_slave   = 0 != ( controller & 1 );
+    ::strcpy( _disk.vendor,   "ATA" );
+    ::strcpy( _disk.model,    model );
+    ::strcpy( _disk.serial,   serial );
+    ::strcpy( _disk.revision, "1A01" );
+    _disk.sectors = sectors;
+    _disk.size    = sectors * 512;
+    _disk.buffer  = 8192;
+    _disk.type    = 1;
+    return _disk;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static bool sameDisk( const disk_t &a, const disk_t &b )
+{
+    return 0 == ::memcmp( &a, &b, sizeof(disk_t) ) && crc64( &a, sizeof(disk_t) ) == crc64( &b, sizeof(disk_t) );
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // the drives the old fixed widths cut short, and some that are plain
+static void makeDisks( std::vector<disk_t> &disks )
+{
+    disks.clear();
+    disks.push_back( makeDisk( 0, "WDC WD10EZEX-08W", "WD-WCC6Y3HK1234", 1953525168LL ) );
+
+       //  SAS and USB bridges report 40-character serials
+    disks.push_back( makeDisk( 1, "SEAGATE ST4000NM0023", "Z1Z2ABCD0000C5123456789012345678901234AB", 7814037168LL ) );
+    disks.push_back( makeDisk( 2, "USB3.0 Bridge", "0123456789ABCDEF0123456789ABCDEF01234567", 0 ) );
+
+       //  a vendor copied with strncpy( sizeof ): 256 bytes and no NUL
+    disk_t full = makeDisk( 3, "Full Vendor", "FV0001", 1000 );
+    ::memset( full.vendor, 'V', sizeof(full.vendor) );
+    disks.push_back( full );
+
+       //  bytes left after the NUL by a probe that reused its buffer
+    disk_t stale = makeDisk( 0, "Stale", "ST0001", 2000 );
+    ::strcpy( stale.model + 10, "old model text" );
+    stale.serial[255] = 'x';
+    disks.push_back( stale );
+
+       //  padding that is not zero, as after a copy that did not go through the constructor
+    disk_t padded;
+    ::memset( &padded, 0xAB, sizeof(padded) );
+    ::strcpy( padded.serial, "PAD0001" );
+    disks.push_back( padded );
+
+       //  and nothing at all
+    disks.push_back( disk_t() );
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testPackUnpack()
+{
+    std::vector<disk_t> disks;
+    makeDisks( disks );
+
+    bool ok = true;
+    for( size_t i = 0; i < disks.size(); i++ )
+    {
+        unsigned __int8 buf[DISK_REC_MAX_SIZE];
+        const size_t    cb = packDisk( disks[i], buf, sizeof(buf) );
+
+        disk_t back;
+        ::memset( &back, 0x5A, sizeof(back) );
+        ok = 0 != cb && cb == unpackDisk( buf, cb, back ) && sameDisk( disks[i], back ) && ok;
+
+           //  one byte short is too small to pack into and too short to unpack
+        ok = 0 == packDisk( disks[i], buf, cb - 1 ) && ok;
+        ok = 0 == unpackDisk( buf, cb - 1, back ) && ok;
+    }
+    CHECK( ok );
+
+       //  a plain drive takes a small part of its disk_t
+    unsigned __int8 buf[DISK_REC_MAX_SIZE];
+    CHECK( packDisk( disks[0], buf, sizeof(buf) ) < sizeof(disk_t) / 4 );
+    CHECK( 0 == packDisk( disks[3], buf, 0 ) );
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testMalformed()
+{
+    const disk_t    _disk = makeDisk( 1, "Samsung SSD 970", "S466NX0K123456A", 976773168LL );
+    unsigned __int8 buf[DISK_REC_MAX_SIZE];
+    const size_t    cb = packDisk( _disk, buf, sizeof(buf) );
+    const size_t    offVendor = offsetof( disk_t, vendor );
+
+       //  a string longer than its field, and one that runs past the record
+    disk_t back = _disk;
+    back.num_controller = 7;
+    buf[offVendor]     = 0x01;
+    buf[offVendor + 1] = 0x01;
+    CHECK( 0 == unpackDisk( buf, sizeof(buf), back ) );
+    buf[offVendor]     = 0xFF;
+    buf[offVendor + 1] = 0x00;
+    CHECK( 0 == unpackDisk( buf, cb, back ) );
+
+       //  and nothing is written when refused
+    CHECK( 7 == back.num_controller && 0 == ::strcmp( back.serial, _disk.serial ) );
+
+       //  cut short in the head or in the lengths
+    packDisk( _disk, buf, sizeof(buf) );
+    CHECK( 0 == unpackDisk( buf, 0, back ) );
+    CHECK( 0 == unpackDisk( buf, offVendor + 1, back ) );
+    CHECK( cb == unpackDisk( buf, sizeof(buf), back ) && sameDisk( _disk, back ) );
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testRecords()
+{
+    std::vector<disk_t> disks;
+    makeDisks( disks );
+
+    DiskRecords records( disks );
+    CHECK( disks.size() == records.size() && !records.empty() );
+    CHECK( records.bytes() < disks.size() * sizeof(disk_t) / 2 );
+
+    std::vector<disk_t> back;
+    records.toDisks( back );
+    bool ok = disks.size() == back.size();
+    for( size_t i = 0; ok && i < disks.size(); i++ )
+    {
+        ok = sameDisk( disks[i], back[i] );
+    }
+    CHECK( ok );
+
+       //  the strings in place, up to the first NUL
+    size_t      cch;
+    const char *text = records.field( 1, DISK_REC_SERIAL, cch );
+    CHECK( 40 == cch && 0 == ::memcmp( text, disks[1].serial, 40 ) );
+    text = records.field( 3, DISK_REC_VENDOR, cch );
+    CHECK( 256 == cch && 'V' == text[255] );
+    text = records.field( 4, DISK_REC_MODEL, cch );
+    CHECK( 5 == cch && 0 == ::memcmp( text, "Stale", 5 ) );
+    records.field( 6, DISK_REC_REVISION, cch );
+    CHECK( 0 == cch );
+
+       //  serials match whole, not as a prefix
+    CHECK( 2 == records.findBySerial( "0123456789ABCDEF0123456789ABCDEF01234567" ) );
+    CHECK( records.size() == records.findBySerial( "0123456789ABCDEF" ) );
+    CHECK( 4 == records.findBySerial( "ST0001" ) );
+    CHECK( 6 == records.findBySerial( "" ) && 6 == records.findBySerial( "", 6 ) );
+    CHECK( records.size() == records.findBySerial( "WD-WCC6Y3HK1234", 1 ) );
+
+       //  added one at a time, the same bytes
+    DiskRecords one;
+    for( size_t i = 0; i < disks.size(); i++ )
+    {
+        one.push_back( disks[i] );
+    }
+    disk_t _disk;
+    one.get( 5, _disk );
+    CHECK( records.bytes() == one.bytes() && sameDisk( disks[5], _disk ) );
+
+    one.clear();
+    CHECK( one.empty() && 0 == one.bytes() );
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main()
+{
+    testPackUnpack();
+    testMalformed();
+    testRecords();
+    return testResult( "diskrectest" );
+}
@@ -0,0 +1,10 @@
+# Runs COMMAND (a ;-list) and compares its standard output with the file EXPECTED:
+#   cmake -DCOMMAND=... -DEXPECTED=... -P expect.cmake
+execute_process(COMMAND ${COMMAND} OUTPUT_VARIABLE actual RESULT_VARIABLE result)
+file(READ ${EXPECTED} expected)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${COMMAND} exited with ${result}")
+endif()
+if(NOT actual STREQUAL expected)
+    message(FATAL_ERROR "${COMMAND} printed\n${actual}\ninstead of ${EXPECTED}\n${expected}")
+endif()
@@ -0,0 +1,255 @@
+/** @file
+  * EpsDiskId/tests/filtertest.cpp
+  *
+  * The parameters of xp_DiskId as diskfilter.h reads them: LIKE patterns (likeMatch, also against a
+  * plain recursive matcher over every short pattern), @columns lists (parseColumns) and the rows a
+  * filter picks (select), blank-padded models and serials included.
+  *
+  * filtertest
+  */
+
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "diskfilter.h"
+#include "testutil.h"
+
+using namespace Utils;
+
+//----------------------------------------------------------------------------------------------------------------------
+static bool like( const char *text, const char *pattern )
+{
+    return likeMatch( text, ::strlen( text ), pattern );
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testLike()
+{
+       //  % at the start, in the middle, at the end
+    CHECK( like( "WD-WCC6Y3HK1234", "%1234" ) );
+    CHECK( like( "WD-WCC6Y3HK1234", "WD%1234" ) );
+    CHECK( like( "WD-WCC6Y3HK1234", "WD-%" ) );
+    CHECK( like( "WD-WCC6Y3HK1234", "%WCC6%" ) );
+    CHECK( like( "WD-WCC6Y3HK1234", "%" ) && like( "WD-WCC6Y3HK1234", "%%" ) );
+    CHECK( !like( "WD-WCC6Y3HK1234", "%1235" ) );
+    CHECK( !like( "WD-WCC6Y3HK1234", "XD%" ) );
+    CHECK( !like( "WD-WCC6Y3HK1234", "WD%XX%1234" ) );
+
+       //  the last % has to give back what the text ends with
+    CHECK( like( "aXbXc", "%X%c" ) && like( "abab", "%ab" ) && like( "aaab", "%aab" ) );
+    CHECK( !like( "abab", "%aba" ) );
+
+       //  _ takes exactly one character
+    CHECK( like( "ST1000", "ST1_00" ) && like( "ST1000", "______" ) );
+    CHECK( !like( "ST1000", "_____" ) && !like( "ST1000", "_______" ) );
+    CHECK( like( "ST1000", "%_" ) && !like( "", "%_" ) && like( "x", "_%" ) );
+
+       //  empty pattern, empty text
+    CHECK( like( "", "" ) && !like( "a", "" ) );
+    CHECK( like( "", "%" ) && like( "", "%%" ) && !like( "", "a" ) && !like( "", "_" ) );
+
+       //  letters in any case, nothing else folded
+    CHECK( like( "Samsung SSD 970", "samsung%" ) && like( "samsung ssd 970", "SAMSUNG SSD%" ) );
+    CHECK( !like( "WD-A", "WD_a_" ) && like( "WD-A", "wd-a" ) );
+
+       //  only text[0, cb) is looked at
+    CHECK( likeMatch( "S1234XYZ", 5, "S1234" ) && !likeMatch( "S1234XYZ", 5, "S1234X%" ) );
+    CHECK( likeMatch( "ABC", 0, "" ) && likeMatch( "ABC", 0, "%" ) );
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // LIKE the plain way: every split the % can take
+static bool slowLike( const char *text, size_t cb, const char *pattern )
+{
+    if( '\0' == *pattern )
+    {
+        return 0 == cb;
+    }
+    if( '%' == *pattern )
+    {
+        for( size_t skip = 0; skip <= cb; skip++ )
+        {
+            if( slowLike( text + skip, cb - skip, pattern + 1 ) )
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+    const bool same = 0 != cb && ( '_' == *pattern || ( *pattern | 0x20 ) == ( *text | 0x20 ) );
+    return same && slowLike( text + 1, cb - 1, pattern + 1 );
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // every pattern of up to 5 symbols over { a, B, %, _ } against every text of up to 6 of { A, b }
+static void testLikeExhaustive()
+{
+    static const char symbols[] = "aB%_";
+    static const char letters[] = "Ab";
+
+    bool ok = true;
+    for( size_t pn = 0; pn <= 5; pn++ )
+    {
+        size_t pCount = 1;
+        for( size_t i = 0; i < pn; i++ )    pCount *= 4;
+
+        for( size_t pi = 0; pi < pCount; pi++ )
+        {
+            char pattern[8] = { 0 };
+            for( size_t i = 0, v = pi; i < pn; i++, v /= 4 )
+            {
+                pattern[i] = symbols[v % 4];
+            }
+            for( size_t tn = 0; tn <= 6; tn++ )
+            {
+                for( size_t ti = 0; ti < ( 1u << tn ); ti++ )
+                {
+                    char text[8] = { 0 };
+                    for( size_t i = 0; i < tn; i++ )
+                    {
+                        text[i] = letters[( ti >> i ) & 1];
+                    }
+                    ok = ok && slowLike( text, tn, pattern ) == likeMatch( text, tn, pattern );
+                }
+            }
+        }
+    }
+    CHECK( ok );
+}
+//----------------------------------------------------------------------------------------------------------------------
+static bool columnsAre( const disk_filter_t &filter, int a, int b = -1, int c = -1 )
+{
+    std::vector<int> expected( 1, a );
+    if( b >= 0 )    expected.push_back( b );
+    if( c >= 0 )    expected.push_back( c );
+    return expected == filter.columns;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testColumns()
+{
+    disk_filter_t filter;
+    CHECK( DISK_COLUMNS == filter.columns.size() && DISK_COL_ALL == filter.sent() );
+
+    CHECK( filter.parseColumns( "size" ) && columnsAre( filter, DISK_COL_SIZE ) );
+    CHECK( filter.parseColumns( "serial,size" ) && columnsAre( filter, DISK_COL_SERIAL, DISK_COL_SIZE ) );
+
+       //  in the order given, names in any case, blanks, tabs and line ends around them
+    CHECK( filter.parseColumns( " DUUID ,\tModel\r\n,  controller" ) );
+    CHECK( columnsAre( filter, DISK_COL_DUUID, DISK_COL_MODEL, DISK_COL_CONTROLLER ) );
+    CHECK( ( DISK_COL_BIT( DISK_COL_DUUID ) | DISK_COL_BIT( DISK_COL_MODEL ) | DISK_COL_BIT( DISK_COL_CONTROLLER ) ) == filter.sent() );
+
+       //  refused lists leave the columns as they were
+    static const char *const bad[] =
+    {
+        "",  " ", ",", "serial,", ",serial", "serial,,size", "serial, ,size",      // empty entries
+        "serial,serial", "Serial, SERIAL", "size,model,size",                     // repeated
+        "serials", "ser ial", "serial;size", "s", "controller,disk",               // unknown
+        "serial size"
+    };
+    bool ok = true;
+    for( size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++ )
+    {
+        ok = !filter.parseColumns( bad[i] ) && ok;
+    }
+    CHECK( ok );
+    CHECK( columnsAre( filter, DISK_COL_DUUID, DISK_COL_MODEL, DISK_COL_CONTROLLER ) );
+
+       //  a pattern needs model and serial whatever is sent
+    CHECK( filter.parseColumns( "size" ) );
+    CHECK( DISK_COL_BIT( DISK_COL_SIZE ) == filter.needed() );
+    filter.pattern = "WD%";
+    CHECK( ( DISK_COL_BIT( DISK_COL_SIZE ) | DISK_COL_BIT( DISK_COL_MODEL ) | DISK_COL_BIT( DISK_COL_SERIAL ) ) == filter.needed() );
+}
+//----------------------------------------------------------------------------------------------------------------------
+static disk_t makeDisk( const char *model, const char *serial )
+{
+    disk_t _disk;
+    ::strcpy( _disk.model,  model );
+    ::strcpy( _disk.serial, serial );
+    return _disk;
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // the rows a filter picks, as "0 2 3"
+static std::string selected( const disk_filter_t &filter, const std::vector<disk_t> &disks, const std::vector<int> &owners )
+{
+    DiskRows rows;
+    rows.assign( disks, owners, nullptr, filter.needed() );
+
+    std::vector<size_t> picked;
+    filter.select( rows, owners, picked );
+
+    std::string text;
+    for( size_t i = 0; i < picked.size(); i++ )
+    {
+        text.append( text.empty() ? "" : " " ).append( 1, (char)( '0' + picked[i] ) );
+    }
+    return text;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testSelect()
+{
+    std::vector<disk_t> disks;
+    disks.push_back( makeDisk( "WDC WD10EZEX-08W",      "     WD-WCC6Y3HK1234" ) );     // serials as ATA
+    disks.push_back( makeDisk( "  Samsung SSD 970  ",   "S466NX0K123456A     " ) );     // drives pad them
+    disks.push_back( makeDisk( "ST1000DM003",           "    " ) );
+    disks.push_back( makeDisk( "",                      "Z1D5ABCD" ) );
+    disks.push_back( makeDisk( "Virtual Disk",          "" ) );
+
+    std::vector<int> owners;
+    owners.push_back( 0 );
+    owners.push_back( 1 );
+    owners.push_back( 1 );
+    owners.push_back( 3 );
+    owners.push_back( -1 );         // of no known drive
+
+    disk_filter_t filter;
+    CHECK( "0 1 2 3 4" == selected( filter, disks, owners ) );
+
+       //  drive range, both ends included; a row of no known drive only without one
+    filter.nFirst = filter.nLast = 1;
+    CHECK( "1 2" == selected( filter, disks, owners ) );
+    filter.nFirst = 0;
+    filter.nLast  = 2;
+    CHECK( "0 1 2" == selected( filter, disks, owners ) );
+    filter.nFirst = filter.nLast = 2;
+    CHECK( "" == selected( filter, disks, owners ) );
+
+       //  the pattern sees model and serial without their blanks
+    filter.nFirst = filter.nLast = -1;
+    filter.pattern = "WD-%";
+    CHECK( "0" == selected( filter, disks, owners ) );
+    filter.pattern = "%1234";
+    CHECK( "0" == selected( filter, disks, owners ) );
+    filter.pattern = "samsung%970";
+    CHECK( "1" == selected( filter, disks, owners ) );
+    filter.pattern = "%456A";
+    CHECK( "1" == selected( filter, disks, owners ) );
+    filter.pattern = "_________";
+    CHECK( "" == selected( filter, disks, owners ) );
+    filter.pattern = "%";
+    CHECK( "0 1 2 3 4" == selected( filter, disks, owners ) );
+
+       //  and both together
+    filter.pattern = "%S%";
+    CHECK( "1 2 4" == selected( filter, disks, owners ) );
+    filter.nFirst = filter.nLast = 1;
+    CHECK( "1 2" == selected( filter, disks, owners ) );
+    filter.nFirst = 3;
+    filter.nLast  = 3;
+    CHECK( "" == selected( filter, disks, owners ) );
+
+       //  owners shorter than the rows: the ones past it belong to no drive
+    owners.resize( 2 );
+    filter.pattern.clear();
+    filter.nFirst = 0;
+    filter.nLast  = 9;
+    CHECK( "0 1" == selected( filter, disks, owners ) );
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main()
+{
+    testLike();
+    testLikeExhaustive();
+    testColumns();
+    testSelect();
+    return testResult( "filtertest" );
+}
@@ -0,0 +1,222 @@
+/** @file
+  * EpsDiskId/tests/hotplugtest.cpp
+  *
+  * Arrival, removal and rescan events pushed through a DeviceEventQueue into a DeviceWatcher over
+  * a DiskCache, with stub probes in place of the device I/O: the snapshot is patched drive by
+  * drive, only the drive concerned is probed, and renumbered drives give one DEVICE_RESCAN that
+  * leaves the work to a full sweep of the DiskRefresher.
+  *
+  * hotplugtest
+  */
+
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "diskrefresh.h"
+#include "hotplug.h"
+#include "testutil.h"
+
+using namespace Utils;
+
+#define  HOTPLUG_WAIT_MS    5000
+
+//----------------------------------------------------------------------------------------------------------------------
+static device_t makeDevice( int index, const char *name )
+{
+    device_t dev;
+    dev.index = index;
+    dev.name  = name;
+    dev.path  = std::string( "/dev/" ) + name;
+    return dev;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static disk_t makeDisk( int device, const std::string &serial )
+{
+    disk_t _disk;
+    _disk.num_controller = device;
+    serial.copy( _disk.serial, sizeof(_disk.serial) - 1 );
+    _disk.sectors = 1000 + device;
+    return _disk;
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // what the stubs were asked; probes run on the threads of the watcher and the refresher
+struct stub_probes_t
+{
+    OsLock                      lock;
+    std::vector<std::string>    probed;         // drives probed one by one, in order
+    std::vector<device_t>       drives;         // what a full sweep finds
+    int                         sweeps;
+
+    stub_probes_t() : sweeps( 0 ) {}
+};
+
+static stub_probes_t s_probes;
+
+   // a drive answers with the serial "N-<name>"
+static bool probeDevice( const device_t &device, std::vector<disk_t> &lst_disk, void *ctx )
+{
+    stub_probes_t *probes = (stub_probes_t*)ctx;
+    OsLockGuard    guard( probes->lock );
+    probes->probed.push_back( device.name );
+    lst_disk.push_back( makeDisk( device.index, "N-" + device.name ) );
+    return true;
+}
+
+static bool probeAll( std::vector<disk_t> &lst_disk, std::vector<int> &devices, void *ctx )
+{
+    stub_probes_t *probes = (stub_probes_t*)ctx;
+    OsLockGuard    guard( probes->lock );
+    probes->sweeps++;
+    for( size_t i = 0; i < probes->drives.size(); i++ )
+    {
+        lst_disk.push_back( makeDisk( probes->drives[i].index, "F-" + probes->drives[i].name ) );
+        devices.push_back( probes->drives[i].index );
+    }
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // "serial@drive serial@drive ..." of the current snapshot, "-" without one
+static std::string snapshotOf( const DiskCache &cache )
+{
+    DiskSnapshotPin pin( cache );
+    if( nullptr == pin.get() )
+    {
+        return "-";
+    }
+    std::string text;
+    for( size_t i = 0; i < pin.get()->disks.size(); i++ )
+    {
+        text.append( text.empty() ? "" : " " ).append( pin.get()->disks[i].serial ).append( "@" );
+        text.append( 1, (char)( '0' + pin.get()->devices[i] ) );
+    }
+    return text;
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // the snapshot once the threads got to it, or what it was when they did not in time
+static std::string awaitSnapshot( const DiskCache &cache, const std::string &expected )
+{
+    std::string text = snapshotOf( cache );
+    for( int ms = 0; ms < HOTPLUG_WAIT_MS && text != expected; ms++ )
+    {
+        ::usleep( 1000 );
+        text = snapshotOf( cache );
+    }
+    return text;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static std::string probedSoFar()
+{
+    OsLockGuard guard( s_probes.lock );
+    std::string text;
+    for( size_t i = 0; i < s_probes.probed.size(); i++ )
+    {
+        text.append( text.empty() ? "" : " " ).append( s_probes.probed[i] );
+    }
+    return text;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static int sweepsSoFar()
+{
+    OsLockGuard guard( s_probes.lock );
+    return s_probes.sweeps;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testDiff()
+{
+    std::vector<device_t> before;
+    before.push_back( makeDevice( 0, "sda" ) );
+    before.push_back( makeDevice( 1, "sdb" ) );
+
+    std::vector<device_t> after;
+    after.push_back( makeDevice( 0, "sda" ) );
+    after.push_back( makeDevice( 2, "sdc" ) );
+
+    std::vector<device_event_t> events;
+    diffDevices( before, after, events );
+    CHECK( 2 == events.size() );
+    CHECK( DEVICE_REMOVED == events[0].kind && "sdb" == events[0].device.name );
+    CHECK( DEVICE_ARRIVED == events[1].kind && "sdc" == events[1].device.name && 2 == events[1].device.index );
+
+    diffDevices( before, before, events );
+    CHECK( events.empty() );
+
+       //  sdb moved to index 0 when sda went: one rescan, nothing else
+    after.clear();
+    after.push_back( makeDevice( 0, "sdb" ) );
+    after.push_back( makeDevice( 1, "sdc" ) );
+    diffDevices( before, after, events );
+    CHECK( 1 == events.size() && DEVICE_RESCAN == events[0].kind );
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testWatcher()
+{
+    s_probes.drives.push_back( makeDevice( 0, "sda" ) );
+    s_probes.drives.push_back( makeDevice( 1, "sdb" ) );
+
+    DiskCache     cache;
+    DiskRefresher refresher( cache, probeAll, &s_probes );
+    DeviceWatcher watcher( cache, &refresher, probeDevice, &s_probes );
+
+       //  the first sweep, as xp_DiskId stores it
+    unsigned long       generation = 0;
+    std::vector<disk_t> lst_disk;
+    std::vector<int>    devices;
+    DiskCache::release( cache.acquire( generation ) );
+    CHECK( probeAll( lst_disk, devices, &s_probes ) );
+    cache.store( lst_disk, devices, generation );
+    CHECK( "F-sda@0 F-sdb@1" == snapshotOf( cache ) );
+
+    CHECK( refresher.start( 3600UL * 1000 ) );
+    DeviceEventQueue *queue = new DeviceEventQueue;
+    CHECK( watcher.start( queue ) );
+
+       //  an arrival probes the new drive alone and patches it in
+    queue->push( device_event_t( DEVICE_ARRIVED, makeDevice( 2, "sdc" ) ) );
+    CHECK( "F-sda@0 F-sdb@1 N-sdc@2" == awaitSnapshot( cache, "F-sda@0 F-sdb@1 N-sdc@2" ) );
+    CHECK( "sdc" == probedSoFar() );
+
+       //  a removal probes nothing
+    queue->push( device_event_t( DEVICE_REMOVED, makeDevice( 1, "sdb" ) ) );
+    CHECK( "F-sda@0 N-sdc@2" == awaitSnapshot( cache, "F-sda@0 N-sdc@2" ) );
+
+       //  a drive back in the middle keeps the records ordered by drive
+    queue->push( device_event_t( DEVICE_ARRIVED, makeDevice( 1, "sdd" ) ) );
+    CHECK( "F-sda@0 N-sdd@1 N-sdc@2" == awaitSnapshot( cache, "F-sda@0 N-sdd@1 N-sdc@2" ) );
+    CHECK( "sdc sdd" == probedSoFar() );
+    CHECK( 1 == sweepsSoFar() );
+
+       //  sda gone and the others renumbered: the event of diffDevices wakes one full sweep
+    std::vector<device_t> before;
+    before.push_back( makeDevice( 0, "sda" ) );
+    before.push_back( makeDevice( 1, "sdd" ) );
+    before.push_back( makeDevice( 2, "sdc" ) );
+    {
+        OsLockGuard guard( s_probes.lock );
+        s_probes.drives.clear();
+        s_probes.drives.push_back( makeDevice( 0, "sdd" ) );
+        s_probes.drives.push_back( makeDevice( 1, "sdc" ) );
+    }
+    std::vector<device_event_t> events;
+    diffDevices( before, s_probes.drives, events );
+    CHECK( 1 == events.size() );
+    for( size_t i = 0; i < events.size(); i++ )
+    {
+        queue->push( events[i] );
+    }
+    CHECK( "F-sdd@0 F-sdc@1" == awaitSnapshot( cache, "F-sdd@0 F-sdc@1" ) );
+    CHECK( 2 == sweepsSoFar() );
+    CHECK( "sdc sdd" == probedSoFar() );
+
+    watcher.stop();
+    refresher.stop();
+    ::usleep( 100 * 1000 );         // the threads let go of the cache, which then goes
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main()
+{
+    testDiff();
+    testWatcher();
+    return testResult( "hotplugtest" );
+}
@@ -0,0 +1,101 @@
+/** @file
+  * EpsDiskId/tests/identitytest.cpp
+  *
+  * Known answers of the layout-independent drive identity: the versioned byte form of
+  * DiskInfo::serializeIdentity() and both fingerprints of DiskInfo::getFingerprint().  The values
+  * were computed apart from this code (reference MurmurHash3 x64/128 and CRC-64/XZ); a build that
+  * gives others would change the id of every drive already stored by callers.
+  *
+  * identitytest
+  */
+
+#include <string.h>
+
+#include "diskid.h"
+#include "hash128.h"
+#include "crc64.h"
+#include "testutil.h"
+
+using namespace Utils;
+
+//----------------------------------------------------------------------------------------------------------------------
+static void testHashes()
+{
+    const hash128_t empty = hash128( "", 0 );
+    CHECK( 0 == empty.lo && 0 == empty.hi );
+
+    const hash128_t hello = hash128( "hello", 5 );
+    CHECK( 0xcbd8a7b341bd9b02ULL == hello.lo && 0x5b1e906a48ae1d19ULL == hello.hi );
+
+       //  two blocks and an 8 byte tail, unseeded and seeded
+    unsigned __int8 bytes[40];
+    for( int i = 0; i < 40; i++ )
+    {
+        bytes[i] = (unsigned __int8)i;
+    }
+    const hash128_t h0 = hash128( bytes, sizeof(bytes) );
+    const hash128_t h7 = hash128( bytes, sizeof(bytes), 7 );
+    CHECK( 0xc3a054d8418c8064ULL == h0.lo && 0xa001ca30974c12adULL == h0.hi );
+    CHECK( 0x345a060429ccb14bULL == h7.lo && 0xe3e244e7186f73c9ULL == h7.hi );
+
+    CHECK( 0x995dc9bbdf1939faULL == (unsigned __int64)crc64( "123456789", 9 ) );
+}
+//----------------------------------------------------------------------------------------------------------------------
+static disk_t makeDisk()
+{
+    disk_t _disk;
+    ::strcpy( _disk.vendor,   "ATA" );
+    ::strcpy( _disk.model,    "  WDC WD10EZEX-08W  " );
+    ::strcpy( _disk.serial,   "     WD-WCC6Y3HK1234" );
+    ::strcpy( _disk.revision, "1A01" );
+    _disk.sectors = 1953525168LL;
+    _disk.size    = _disk.sectors * 512;
+    _disk.buffer  = 16 * 512;
+    _disk.type    = 1;
+    return _disk;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testIdentity()
+{
+    static const unsigned __int8 expected[] =
+    {
+        DISK_FINGERPRINT_VERSION,
+        16, 'W','D','C',' ','W','D','1','0','E','Z','E','X','-','0','8','W',
+        15, 'W','D','-','W','C','C','6','Y','3','H','K','1','2','3','4',
+        4,  '1','A','0','1',
+        0xb0, 0x6d, 0x70, 0x74, 0x00, 0x00, 0x00, 0x00
+    };
+    const disk_t    _disk = makeDisk();
+    unsigned __int8 buf[DISK_FINGERPRINT_MAX_SIZE];
+
+    const size_t len = DiskInfo::serializeIdentity( _disk, buf, sizeof(buf) );
+    CHECK( sizeof(expected) == len && 0 == ::memcmp( buf, expected, sizeof(expected) ) );
+    CHECK( 0 == DiskInfo::serializeIdentity( _disk, buf, sizeof(expected) - 1 ) );
+
+    const fingerprint_t crc = DiskInfo::getFingerprint( _disk );
+    const fingerprint_t mm  = DiskInfo::getFingerprint( _disk, FINGERPRINT_HASH128 );
+    CHECK( 0xd0e95b2533ab7aa1ULL == crc.lo && 0 == crc.hi );
+    CHECK( 0xaee8c2ecab451deaULL == mm.lo && 0x57d14843372ec21bULL == mm.hi );
+
+       //  what is not identity does not change it
+    disk_t other = makeDisk();
+    ::strcpy( other.vendor, "WDC" );
+    ::strcpy( other.model,  "WDC WD10EZEX-08W" );
+    other.num_controller = 3;
+    other.buffer         = 0;
+    other.type           = 0;
+    other.size           = 0;
+    CHECK( crc.lo == DiskInfo::getFingerprint( other ).lo );
+    CHECK( mm.lo == DiskInfo::getFingerprint( other, FINGERPRINT_HASH128 ).lo &&
+           mm.hi == DiskInfo::getFingerprint( other, FINGERPRINT_HASH128 ).hi );
+
+    other.sectors++;
+    CHECK( crc.lo != DiskInfo::getFingerprint( other ).lo );
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main()
+{
+    testHashes();
+    testIdentity();
+    return testResult( "identitytest" );
+}
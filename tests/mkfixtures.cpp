@@ -0,0 +1,342 @@
+/** @file
+  * EpsDiskId/tests/mkfixtures.cpp
+  *
+  * Writes the device traces under tests/fixtures: SysfsProbe runs once through a DeviceIoRecorder
+  * over scripted drives, which answer as the real ones did (sysfs attributes as the kernel shows
+  * them, IDENTIFY data as the drives return it), and the recording is saved.
+  *
+  * mkfixtures <directory>
+  *
+  * The tests only replay the files; run this when a script changes and commit the result.
+  */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sys/ioctl.h>
+#include <linux/hdreg.h>
+#include <linux/nvme_ioctl.h>
+#include <scsi/sg.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "sysfsprobe.h"
+#include "deviceio.h"
+#include "devtrace.h"
+#include "identify.h"
+#include "nvme.h"
+#include "probestrategy.h"
+
+using namespace Utils;
+
+typedef std::vector<unsigned __int8>    payload_t;
+
+   //  A drive as the scripts describe it: its sysfs attributes and its answers by request code.  An
+   //  NVMe controller is not listed, only opened, and answers admin Identify commands by CNS and NSID.
+struct scripted_drive_t
+{
+    std::string                                                 name;
+    bool                                                        listed;
+    unsigned long                                               refusal;        // error of every request, 0 = none
+    std::map<std::string, std::string>                          attributes;     // by name under /sys/block/<name>
+    std::map<unsigned long, payload_t>                          answers;        // by IOCTL; others fail with EINVAL
+    std::map<std::pair<unsigned long, unsigned long>, payload_t> identify;      // by CNS and NSID
+
+    scripted_drive_t() : listed( true ), refusal( 0 ) {}
+};
+
+class ScriptedDeviceIo : public DeviceIo
+{
+    public:
+        void    add( const scripted_drive_t &drive )    { m_drives.push_back( drive ); }
+
+        virtual bool listDevices( bool scsiPorts, std::vector<device_t> &devices )
+        {
+            devices.clear();
+            if( scsiPorts )
+            {
+                return false;
+            }
+            for( size_t i = 0; i < m_drives.size(); i++ )
+            {
+                if( !m_drives[i].listed )
+                {
+                    continue;
+                }
+                device_t device;
+                device.index = (int)devices.size();
+                device.name  = m_drives[i].name;
+                device.path  = "/dev/" + m_drives[i].name;
+                devices.push_back( device );
+            }
+            return true;
+        }
+        virtual void *open( const device_path_t &path, unsigned long, bool, unsigned long &error )
+        {
+            for( size_t i = 0; i < m_drives.size(); i++ )
+            {
+                if( path == "/dev/" + m_drives[i].name )
+                {
+                    error = 0;
+                    return &m_drives[i];
+                }
+            }
+            error = ENOENT;
+            return nullptr;
+        }
+        virtual bool control( void *hDevice, unsigned long code, const void *pIn, unsigned long cbIn,
+                              void *pOut, unsigned long cbOut, unsigned long &cbReturned,
+                              unsigned long, unsigned long &error )
+        {
+            const scripted_drive_t &drive  = *(const scripted_drive_t *)hDevice;
+            const payload_t        *answer = nullptr;
+
+            cbReturned = 0;
+            if( NVME_IOCTL_ADMIN_CMD == code && sizeof(nvme_admin_t) == cbIn )
+            {
+                const nvme_admin_t *command = (const nvme_admin_t *)pIn;
+                std::map<std::pair<unsigned long, unsigned long>, payload_t>::const_iterator it =
+                    drive.identify.find( std::make_pair( (unsigned long)command->cdw10, (unsigned long)command->nsid ) );
+                answer = ( drive.identify.end() != it && NVME_ADMIN_IDENTIFY == command->opcode ) ? &it->second : nullptr;
+            }
+            else
+            {
+                std::map<unsigned long, payload_t>::const_iterator it = drive.answers.find( code );
+                answer = ( drive.answers.end() != it ) ? &it->second : nullptr;
+            }
+            if( 0 != drive.refusal || nullptr == answer )
+            {
+                error = ( 0 != drive.refusal ) ? drive.refusal : EINVAL;
+                return false;
+            }
+            cbReturned = ( answer->size() < cbOut ) ? (unsigned long)answer->size() : cbOut;
+            ::memcpy( pOut, &(*answer)[0], cbReturned );
+            error = 0;
+            return true;
+        }
+        virtual void close( void * )
+        {
+        }
+        virtual bool readAttribute( const device_path_t &path, std::string &text, unsigned long &error )
+        {
+            static const std::string root = "/sys/block/";
+            for( size_t i = 0; i < m_drives.size(); i++ )
+            {
+                const std::string prefix = root + m_drives[i].name + "/";
+                if( 0 == path.compare( 0, prefix.size(), prefix ) )
+                {
+                    std::map<std::string, std::string>::const_iterator it = m_drives[i].attributes.find( path.substr( prefix.size() ) );
+                    if( m_drives[i].attributes.end() != it )
+                    {
+                        text  = it->second;
+                        error = 0;
+                        return true;
+                    }
+                }
+            }
+            error = ENOENT;
+            return false;
+        }
+
+    private:
+        std::vector<scripted_drive_t>   m_drives;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+   // ATA string field: blank padded, two characters per word with the first in the high byte
+static void putAtaString( payload_t &sector, size_t firstWord, size_t words, const char *text )
+{
+    const size_t cch = ::strlen( text );
+    for( size_t i = 0; i < 2 * words; i++ )
+    {
+        sector[2 * firstWord + ( i ^ 1 )] = (unsigned __int8)( i < cch ? text[i] : ' ' );
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void putWord( payload_t &sector, size_t word, unsigned value )
+{
+    sector[2 * word]     = (unsigned __int8)( value & 0xff );
+    sector[2 * word + 1] = (unsigned __int8)( ( value >> 8 ) & 0xff );
+}
+//----------------------------------------------------------------------------------------------------------------------
+static payload_t ataIdentify( const char *model, const char *serial, const char *firmware, unsigned __int64 sectors )
+{
+    payload_t sector( 2 * IDENTIFY_SECTOR_WORDS, 0 );
+
+    putWord( sector, 0, 0x0040 );                                   // fixed disk
+    putAtaString( sector, 10, 10, serial );
+    putWord( sector, 21, 16 );                                      // 8 KiB buffer
+    putAtaString( sector, 23, 4, firmware );
+    putAtaString( sector, 27, 20, model );
+    putWord( sector, 60, (unsigned)( ( sectors > 0x0fffffff ? 0x0fffffff : sectors ) & 0xffff ) );
+    putWord( sector, 61, (unsigned)( ( ( sectors > 0x0fffffff ? 0x0fffffff : sectors ) >> 16 ) & 0xffff ) );
+    putWord( sector, 83, 0x0400 );                                  // 48-bit addressing
+    for( size_t w = 0; w < 4; w++ )
+    {
+        putWord( sector, 100 + w, (unsigned)( ( sectors >> ( 16 * w ) ) & 0xffff ) );
+    }
+    return sector;
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // SATA disk behind libata: sysfs has the model cut to 16 characters and no serial, HDIO_GET_IDENTITY
+   // the whole sector; a SAS disk with its serial in the unit serial number page; a USB stick that
+   // answers no IDENTIFY at all
+static void scriptSata( ScriptedDeviceIo &io )
+{
+    scripted_drive_t sda;
+    sda.name = "sda";
+    sda.attributes["device/vendor"] = "ATA     \n";
+    sda.attributes["device/model"]  = "WDC WD10EZEX-08W\n";
+    sda.attributes["device/rev"]    = "1A01\n";
+    sda.attributes["size"]          = "1953525168\n";
+    sda.attributes["removable"]     = "0\n";
+    sda.answers[HDIO_GET_IDENTITY]  = ataIdentify( "WDC WD10EZEX-08WN4A0", "     WD-WCC6Y3HK1234", "01.01A01", 1953525168ULL );
+    io.add( sda );
+
+    const char serial[] = "S0M1ABCD0000K4521ZXY0A1B";
+    std::string page( 4, '\0' );
+    page[1] = (char)0x80;
+    page[3] = (char)( sizeof(serial) - 1 );
+    page   += serial;
+
+    scripted_drive_t sdb;
+    sdb.name = "sdb";
+    sdb.attributes["device/vendor"]   = "SEAGATE \n";
+    sdb.attributes["device/model"]    = "ST600MM0006     \n";
+    sdb.attributes["device/rev"]      = "0003\n";
+    sdb.attributes["device/vpd_pg80"] = page;
+    sdb.attributes["size"]            = "1172123568\n";
+    sdb.attributes["removable"]       = "0\n";
+    io.add( sdb );
+
+    scripted_drive_t sdc;
+    sdc.name = "sdc";
+    sdc.attributes["device/vendor"] = "SanDisk \n";
+    sdc.attributes["device/model"]  = "Cruzer Blade    \n";
+    sdc.attributes["device/rev"]    = "1.00\n";
+    sdc.attributes["size"]          = "30031872\n";
+    sdc.attributes["removable"]     = "1\n";
+    io.add( sdc );
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void putText( payload_t &data, size_t offset, size_t cb, const char *text )
+{
+    const size_t cch = ::strlen( text );
+    for( size_t i = 0; i < cb; i++ )
+    {
+        data[offset + i] = (unsigned __int8)( i < cch ? text[i] : ' ' );
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void putDword( payload_t &data, size_t offset, unsigned __int64 value, size_t cb = 4 )
+{
+    for( size_t i = 0; i < cb; i++ )
+    {
+        data[offset + i] = (unsigned __int8)( ( value >> ( 8 * i ) ) & 0xff );
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // Identify Controller: VID, serial, model, firmware and NN
+static payload_t nvmeController( unsigned vid, const char *serial, const char *model, const char *firmware, unsigned nn )
+{
+    payload_t data( NVME_IDENTIFY_SIZE, 0 );
+    putDword( data, 0, vid, 2 );
+    putText( data, 4, 20, serial );
+    putText( data, 24, 40, model );
+    putText( data, 64, 8, firmware );
+    putDword( data, 516, nn );
+    return data;
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // Identify Namespace: NSZE, and FLBAS picking format 0 (512-byte blocks) or 1 (4 KiB blocks)
+static payload_t nvmeNamespace( unsigned __int64 blocks, unsigned format )
+{
+    payload_t data( NVME_IDENTIFY_SIZE, 0 );
+    putDword( data, 0, blocks, 8 );
+    data[25]      = 1;                                      // NLBAF: two formats
+    data[26]      = (unsigned __int8)format;
+    data[128 + 2] = 9;
+    data[132 + 2] = 12;
+    return data;
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // Two namespaces of one controller whose sysfs has only the model (as before kernel 4.x exposed
+   // the serial and firmware), and a controller that refuses admin commands to a non-root caller
+static void scriptNvme( ScriptedDeviceIo &io )
+{
+    scripted_drive_t nvme0;
+    nvme0.name   = "nvme0";
+    nvme0.listed = false;
+    nvme0.identify[std::make_pair( NVME_CNS_CONTROLLER, 0UL )] =
+        nvmeController( 0x144d, "S4EWNX0R123456", "Samsung SSD 980 PRO 1TB", "5B2QGXA7", 2 );
+    payload_t active( NVME_IDENTIFY_SIZE, 0 );
+    putDword( active, 0, 1 );
+    putDword( active, 4, 2 );
+    nvme0.identify[std::make_pair( NVME_CNS_ACTIVE_NAMESPACES, 0UL )] = active;
+    nvme0.identify[std::make_pair( NVME_CNS_NAMESPACE, 1UL )] = nvmeNamespace( 1953525168ULL, 0 );
+    nvme0.identify[std::make_pair( NVME_CNS_NAMESPACE, 2UL )] = nvmeNamespace( 262144ULL, 1 );
+    io.add( nvme0 );
+
+    scripted_drive_t nvme1;
+    nvme1.name    = "nvme1";
+    nvme1.listed  = false;
+    nvme1.refusal = EACCES;
+    io.add( nvme1 );
+
+    scripted_drive_t n1;
+    n1.name = "nvme0n1";
+    n1.attributes["device/model"] = "Samsung SSD 980 PRO 1TB                 \n";
+    n1.attributes["size"]         = "1953525168\n";
+    n1.attributes["removable"]    = "0\n";
+    io.add( n1 );
+
+    scripted_drive_t n2;
+    n2.name = "nvme0n2";
+    n2.attributes["device/model"] = "Samsung SSD 980 PRO 1TB                 \n";
+    n2.attributes["size"]         = "2097152\n";
+    n2.attributes["removable"]    = "0\n";
+    io.add( n2 );
+
+    scripted_drive_t n3;
+    n3.name = "nvme1n1";
+    n3.attributes["device/model"] = "INTEL SSDPEKNW010T8                     \n";
+    n3.attributes["size"]         = "2000409264\n";
+    n3.attributes["removable"]    = "0\n";
+    io.add( n3 );
+}
+//----------------------------------------------------------------------------------------------------------------------
+static bool record( void (*script)( ScriptedDeviceIo& ), const std::string &file )
+{
+    ScriptedDeviceIo drives;
+    script( drives );
+
+    DeviceIoRecorder recorder( drives );
+    ProbeStrategy    strategy;
+    SysfsProbe       probe;
+    probe.setDeviceIo( &recorder );
+    probe.setStrategy( &strategy );
+
+    std::vector<disk_t> disks;
+    probe_report_t      report;
+    if( !probe.getDrivesInfo( disks, report ) || !recorder.save( file.c_str() ) )
+    {
+        ::fprintf( stderr, "mkfixtures: cannot record %s\n", file.c_str() );
+        return false;
+    }
+    ::printf( "%s: %lu requests, %lu records\n", file.c_str(), (unsigned long)recorder.records(), (unsigned long)disks.size() );
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main( int argc, char **argv )
+{
+    if( argc != 2 )
+    {
+        ::fprintf( stderr, "usage: %s <directory>\n", argv[0] );
+        return 2;
+    }
+    const std::string dir = std::string( argv[1] ) + "/";
+    return ( record( scriptSata, dir + "sata.trace" ) && record( scriptNvme, dir + "nvme.trace" ) ) ? 0 : 1;
+}
@@ -0,0 +1,155 @@
+/** @file
+  * EpsDiskId/tests/nvmetest.cpp
+  *
+  * The Identify payloads of tests/fixtures/nvme.trace, read back through the nvme.h views, and
+  * SysfsProbe's NVMe path replayed from them: one controller with two namespaces whose sysfs has
+  * only the model, and one that refuses admin commands.
+  *
+  * nvmetest <fixtures directory>
+  */
+
+#include <string.h>
+
+#include <sys/ioctl.h>
+#include <linux/nvme_ioctl.h>
+
+#include <string>
+#include <vector>
+
+#include "sysfsprobe.h"
+#include "deviceio.h"
+#include "devtrace.h"
+#include "nvme.h"
+#include "probestrategy.h"
+#include "testutil.h"
+
+using namespace Utils;
+
+//----------------------------------------------------------------------------------------------------------------------
+static bool identify( DeviceIo &io, void *hController, unsigned __int32 cns, unsigned __int32 nsid, std::vector<unsigned __int8> &data )
+{
+    nvme_admin_t command;
+    ::memset( &command, 0, sizeof(command) );
+    command.opcode = NVME_ADMIN_IDENTIFY;
+    command.nsid   = nsid;
+    command.cdw10  = cns;
+
+    unsigned long cbReturned = 0;
+    unsigned long error      = 0;
+    data.assign( NVME_IDENTIFY_SIZE, 0 );
+    return io.control( hController, NVME_IOCTL_ADMIN_CMD, &command, sizeof(command), &data[0], NVME_IDENTIFY_SIZE,
+                       cbReturned, DEVICE_IO_INFINITE, error ) && NVME_IDENTIFY_SIZE == cbReturned;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testPayloads( const std::string &trace )
+{
+    DeviceIoReplayer replayer;
+    CHECK( replayer.load( trace.c_str() ) );
+
+    unsigned long error       = 0;
+    void         *hController = replayer.open( "/dev/nvme0", DEVICE_IO_QUERY, false, error );
+    CHECK( nullptr != hController );
+    if( nullptr == hController )
+    {
+        return;
+    }
+    std::vector<unsigned __int8> data;
+    char                         text[64];
+
+    CHECK( identify( replayer, hController, NVME_CNS_CONTROLLER, 0, data ) );
+    const NvmeControllerView id( &data[0] );
+    CHECK( 0x144d == id.vendorId() && 2 == id.namespaces() );
+    CHECK( 14 == id.serial().copyTo( text, sizeof(text) ) && 0 == ::strcmp( text, "S4EWNX0R123456" ) );
+    CHECK( 0 == ::strcmp( ( id.model().copyTo( text, sizeof(text) ), text ), "Samsung SSD 980 PRO 1TB" ) );
+    CHECK( 0 == ::strcmp( ( id.firmware().copyTo( text, sizeof(text) ), text ), "5B2QGXA7" ) );
+    CHECK( 4 == id.serial().copyTo( text, 5 ) && 0 == ::strcmp( text, "S4EW" ) );
+
+    unsigned __int32 nsids[NVME_NAMESPACE_LIST_MAX];
+    CHECK( identify( replayer, hController, NVME_CNS_ACTIVE_NAMESPACES, 0, data ) );
+    CHECK( 2 == nvmeActiveNamespaces( &data[0], nsids, NVME_NAMESPACE_LIST_MAX ) && 1 == nsids[0] && 2 == nsids[1] );
+    CHECK( 1 == nvmeActiveNamespaces( &data[0], nsids, 1 ) );
+
+       //  namespace 1 in 512-byte blocks, namespace 2 in 4 KiB blocks
+    CHECK( identify( replayer, hController, NVME_CNS_NAMESPACE, 1, data ) );
+    CHECK( 1953525168ULL == NvmeNamespaceView( &data[0] ).blocks() && 512 == NvmeNamespaceView( &data[0] ).blockSize() );
+    CHECK( identify( replayer, hController, NVME_CNS_NAMESPACE, 2, data ) );
+    CHECK( 262144ULL == NvmeNamespaceView( &data[0] ).blocks() && 4096 == NvmeNamespaceView( &data[0] ).blockSize() );
+    CHECK( 1073741824LL == NvmeNamespaceView( &data[0] ).size() );
+
+    replayer.close( hController );
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testSweep( const std::string &trace )
+{
+    DeviceIoReplayer replayer;
+    CHECK( replayer.load( trace.c_str() ) );
+
+    CountingDeviceIo io( replayer );
+    ProbeStrategy    strategy;
+    SysfsProbe       probe;
+    probe.setDeviceIo( &io );
+    probe.setStrategy( &strategy );
+
+    std::vector<disk_t> disks;
+    probe_report_t      report;
+    CHECK( probe.getDrivesInfo( disks, report ) && 3 == disks.size() );
+    if( 3 != disks.size() )
+    {
+        return;
+    }
+       //  serial and firmware from Identify Controller, the rest from sysfs
+    for( size_t i = 0; i < 2; i++ )
+    {
+        CHECK( 0 == ::strcmp( disks[i].model,    "Samsung SSD 980 PRO 1TB" ) );
+        CHECK( 0 == ::strcmp( disks[i].serial,   "S4EWNX0R123456" ) );
+        CHECK( 0 == ::strcmp( disks[i].revision, "5B2QGXA7" ) );
+    }
+    CHECK( 1953525168LL == disks[0].sectors && 2097152LL == disks[1].sectors );
+    CHECK( 0 == ::strcmp( disks[2].model, "INTEL SSDPEKNW010T8" ) && '\0' == disks[2].serial[0] );
+
+       //  one open and four Identify commands for both namespaces, one refused open of nvme1's
+       //  controller; the refusal is remembered
+    CHECK( 2 == io.opens && 5 == io.controls );
+    io.opens    = 0;
+    io.controls = 0;
+    CHECK( probe.getDrivesInfo( disks, report ) && 3 == disks.size() );
+    CHECK( 1 == io.opens && 4 == io.controls );
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // a namespace asked alone sweeps its controller for that namespace only
+static void testOneNamespace( const std::string &trace )
+{
+    DeviceIoReplayer replayer;
+    CHECK( replayer.load( trace.c_str() ) );
+
+    CountingDeviceIo io( replayer );
+    SysfsProbe       probe;
+    probe.setDeviceIo( &io );
+
+    device_t n2;
+    n2.index = 1;
+    n2.name  = "nvme0n2";
+    n2.path  = "/dev/nvme0n2";
+
+    std::vector<disk_t> disks;
+    probe_report_t      report;
+    CHECK( probe.getDriveInfo( n2, disks, report ) && 1 == disks.size() );
+    CHECK( !disks.empty() && 0 == ::strcmp( disks[0].serial, "S4EWNX0R123456" ) && 1 == report.deviceOf[0] );
+    CHECK( 1 == io.opens && 3 == io.controls );
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main( int argc, char **argv )
+{
+    if( argc != 2 )
+    {
+        ::fprintf( stderr, "usage: %s <fixtures directory>\n", argv[0] );
+        return 2;
+    }
+    const std::string trace = std::string( argv[1] ) + "/nvme.trace";
+
+    testPayloads( trace );
+    testSweep( trace );
+    testOneNamespace( trace );
+
+    return testResult( "nvmetest" );
+}
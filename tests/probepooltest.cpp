@@ -0,0 +1,162 @@
+/** @file
+  * EpsDiskId/tests/probepooltest.cpp
+  *
+  * The workers of the ProbePool outlive a run: steady runs are served by the same threads, a
+  * worker held by a hung task is replaced for the next run and rejoins the others once it
+  * returns, a task that throws does not cost a worker, and stopWorkers() lets them all go.
+  *
+  * probepooltest
+  */
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include <set>
+#include <vector>
+
+#include "probepool.h"
+#include "osutil.h"
+#include "testutil.h"
+
+using namespace Utils;
+
+#define  POOL_WORKERS       4
+#define  POOL_ROUNDS        50
+#define  POOL_WAIT_MS       5000
+
+//----------------------------------------------------------------------------------------------------------------------
+   // tasks that note the thread they ran on, sleep, or throw as asked
+struct pool_tasks_t : public ProbeTasks
+{
+    OsLock                  lock;
+    std::set<pthread_t>     threads;
+    std::vector<int>        slots;
+    unsigned                sleepMs;
+    size_t                  throwAt;
+
+    pool_tasks_t( size_t count ) : slots( count, 0 ), sleepMs( 0 ), throwAt( (size_t)-1 ) {}
+
+    virtual void runTask( size_t index )
+    {
+        {
+            OsLockGuard guard( lock );
+            threads.insert( ::pthread_self() );
+        }
+        if( index == throwAt )
+        {
+            throw 1;
+        }
+        if( 0 != sleepMs )
+        {
+            ::usleep( sleepMs * 1000 );
+        }
+        slots[index] = (int)index + 1;
+    }
+
+    bool allDone() const
+    {
+        for( size_t i = 0; i < slots.size(); i++ )
+        {
+            if( (int)i + 1 != slots[i] && i != throwAt )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+//----------------------------------------------------------------------------------------------------------------------
+   // the number of workers once it is expected, or what it was when it did not come in time
+static unsigned awaitWorkers( unsigned expected )
+{
+    unsigned n = ProbePool::workers();
+    for( int ms = 0; ms < POOL_WAIT_MS && n != expected; ms++ )
+    {
+        ::usleep( 1000 );
+        n = ProbePool::workers();
+    }
+    return n;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testSteadyRuns()
+{
+    std::set<pthread_t> seen;
+    bool                ok = true;
+    for( int i = 0; i < POOL_ROUNDS; i++ )
+    {
+        pool_tasks_t *tasks = new pool_tasks_t( 12 );
+        tasks->sleepMs = ( 0 == i ) ? 20 : 0;       // all four get a task on the first run
+        ok = ProbePool( POOL_WORKERS ).run( tasks->slots.size(), tasks, POOL_WAIT_MS ) && tasks->allDone() && ok;
+        ok = tasks->reusable() && ok;
+        seen.insert( tasks->threads.begin(), tasks->threads.end() );
+        tasks->release();
+    }
+    CHECK( ok );
+    CHECK( POOL_WORKERS == seen.size() );
+    CHECK( POOL_WORKERS == ProbePool::workers() );
+
+       //  without a time limit the caller takes tasks too, and one worker fewer is woken
+    pool_tasks_t *tasks = new pool_tasks_t( 12 );
+    tasks->sleepMs = 5;
+    CHECK( ProbePool( POOL_WORKERS ).run( tasks->slots.size(), tasks ) && tasks->allDone() );
+    CHECK( tasks->threads.count( ::pthread_self() ) && POOL_WORKERS >= tasks->threads.size() );
+    CHECK( tasks->reusable() );
+    tasks->release();
+    CHECK( POOL_WORKERS == ProbePool::workers() );
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testHungWorker()
+{
+    pool_tasks_t *hung = new pool_tasks_t( 1 );
+    hung->sleepMs = 300;
+    CHECK( !ProbePool( 1 ).run( 1, hung, 10 ) );
+    CHECK( !hung->reusable() );
+    hung->release();
+
+       //  the next run does not wait for it: another worker, or a new one, takes its place
+    pool_tasks_t *tasks = new pool_tasks_t( POOL_WORKERS );
+    tasks->sleepMs = 20;
+    const unsigned long dwStart = tickCount();
+    CHECK( ProbePool( POOL_WORKERS ).run( tasks->slots.size(), tasks, POOL_WAIT_MS ) && tasks->allDone() );
+    CHECK( tickCount() - dwStart < 200 );
+    tasks->release();
+    CHECK( POOL_WORKERS + 1 == ProbePool::workers() );
+
+       //  once the device lets go, the worker waits with the others
+    ::usleep( 400 * 1000 );
+    CHECK( POOL_WORKERS + 1 == ProbePool::workers() );
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testThrowingTask()
+{
+    const unsigned before = ProbePool::workers();
+
+    pool_tasks_t *tasks = new pool_tasks_t( 8 );
+    tasks->throwAt = 3;
+    CHECK( ProbePool( POOL_WORKERS ).run( tasks->slots.size(), tasks, POOL_WAIT_MS ) && tasks->allDone() );
+    CHECK( 0 == tasks->slots[3] );
+    tasks->release();
+    CHECK( before == ProbePool::workers() );
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testStop()
+{
+    ProbePool::stopWorkers();
+    CHECK( 0 == awaitWorkers( 0 ) );
+
+       //  runs still work, on workers that do not stay
+    pool_tasks_t *tasks = new pool_tasks_t( 6 );
+    CHECK( ProbePool( 2 ).run( tasks->slots.size(), tasks, POOL_WAIT_MS ) && tasks->allDone() );
+    CHECK( tasks->reusable() );
+    tasks->release();
+    CHECK( 0 == awaitWorkers( 0 ) );
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main()
+{
+    testSteadyRuns();
+    testHungWorker();
+    testThrowingTask();
+    testStop();
+    return testResult( "probepooltest" );
+}
@@ -0,0 +1,174 @@
+/** @file
+  * EpsDiskId/tests/replaytest.cpp
+  *
+  * SysfsProbe against the recorded drives of tests/fixtures/sata.trace, through DeviceIoReplayer
+  * alone: nothing of this host's /sys or /dev is read.
+  *
+  * replaytest <fixtures directory>
+  */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "sysfsprobe.h"
+#include "deviceio.h"
+#include "devtrace.h"
+#include "probestrategy.h"
+#include "testutil.h"
+
+using namespace Utils;
+
+//----------------------------------------------------------------------------------------------------------------------
+static void testSweep( const std::string &trace )
+{
+    DeviceIoReplayer replayer;
+    CHECK( replayer.load( trace.c_str() ) );
+
+    CountingDeviceIo io( replayer );
+    ProbeStrategy    strategy;
+    SysfsProbe       probe;
+    probe.setDeviceIo( &io );
+    probe.setStrategy( &strategy );
+
+    std::vector<disk_t> disks;
+    probe_report_t      report;
+    CHECK( probe.getDrivesInfo( disks, report ) );
+    CHECK( 3 == disks.size() && 3 == report.deviceOf.size() && report.timedOut.empty() );
+    if( 3 != disks.size() )
+    {
+        return;
+    }
+
+       //  SATA: what sysfs has, the serial and the buffer from IDENTIFY, decoded as on Windows
+    CHECK( 0 == ::strcmp( disks[0].vendor,   "ATA" ) );
+    CHECK( 0 == ::strcmp( disks[0].model,    "WDC WD10EZEX-08W" ) );
+    CHECK( 0 == ::strcmp( disks[0].serial,   "     WD-WCC6Y3HK1234" ) );
+    CHECK( 0 == ::strcmp( disks[0].revision, "1A01" ) );
+    CHECK( 1953525168LL == disks[0].sectors && 1953525168LL * 512 == disks[0].size );
+    CHECK( 16 * 512 == disks[0].buffer && 1 == disks[0].type && 0 == disks[0].num_controller );
+
+       //  SAS: the whole unit serial number, longer than an ATA serial
+    CHECK( 0 == ::strcmp( disks[1].model,  "ST600MM0006" ) );
+    CHECK( 0 == ::strcmp( disks[1].serial, "S0M1ABCD0000K4521ZXY0A1B" ) );
+    CHECK( 1172123568LL == disks[1].sectors );
+
+       //  USB stick: no IDENTIFY, listed with what sysfs has
+    CHECK( 0 == ::strcmp( disks[2].model, "Cruzer Blade" ) && '\0' == disks[2].serial[0] );
+    CHECK( 0 == disks[2].type && 2 == report.deviceOf[2] );
+
+       //  sda and sdc were opened; sdc refused both IDENTIFY requests and is not asked again
+    CHECK( 2 == io.opens && 3 == io.controls );
+    io.opens    = 0;
+    io.controls = 0;
+    CHECK( probe.getDrivesInfo( disks, report ) && 3 == disks.size() );
+    CHECK( 1 == io.opens && 1 == io.controls );
+
+    device_t sdc;
+    sdc.index = 2;
+    sdc.name  = "sdc";
+    sdc.path  = "/dev/sdc";
+    CHECK( strategy.isUnsupported( sdc, PROBE_NO_ATA_IDENTIFY, "Cruzer Blade|" ) );
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testOneDrive( const std::string &trace )
+{
+    DeviceIoReplayer replayer;
+    CHECK( replayer.load( trace.c_str() ) );
+
+    SysfsProbe probe;
+    probe.setDeviceIo( &replayer );
+
+    device_t sda;
+    sda.index = 0;
+    sda.name  = "sda";
+    sda.path  = "/dev/sda";
+
+    std::vector<disk_t> disks;
+    probe_report_t      report;
+    CHECK( probe.getDriveInfo( sda, disks, report ) && 1 == disks.size() );
+    CHECK( !disks.empty() && 0 == ::strcmp( disks[0].serial, "     WD-WCC6Y3HK1234" ) );
+
+       //  without IDENTIFY the drive is never opened
+    probe.setIdentify( false );
+    CHECK( probe.getDriveInfo( sda, disks, report ) && 1 == disks.size() );
+    CHECK( !disks.empty() && '\0' == disks[0].serial[0] );
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testFleet( const std::string &trace )
+{
+    DeviceIoReplayer replayer;
+    CHECK( replayer.load( trace.c_str() ) );
+    replayer.setFleetSize( 300 );
+
+    SysfsProbe probe;
+    probe.setDeviceIo( &replayer );
+
+    std::vector<disk_t> disks;
+    probe_report_t      report;
+    CHECK( probe.getDrivesInfo( disks, report ) && 300 == disks.size() );
+    for( size_t k = 0; k < disks.size(); k++ )
+    {
+        static const char *models[3] = { "WDC WD10EZEX-08W", "ST600MM0006", "Cruzer Blade" };
+        if( 0 != ::strcmp( disks[k].model, models[k % 3] ) || (int)k != report.deviceOf[k] )
+        {
+            CHECK( !"fleet drive k answers like recorded drive k % 3" );
+            break;
+        }
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testFailures( const std::string &trace )
+{
+    DeviceIoReplayer replayer;
+    CHECK( replayer.load( trace.c_str() ) );
+    replayer.setFailures( 1000, 5, 1 );
+
+    SysfsProbe probe;
+    probe.setDeviceIo( &replayer );
+
+       //  every request fails: the drives are listed, nothing about them is known
+    std::vector<disk_t> disks;
+    probe_report_t      report;
+    CHECK( !probe.getDrivesInfo( disks, report ) && disks.empty() );
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testCorrupt( const std::string &trace )
+{
+    FILE *file = ::fopen( trace.c_str(), "rb" );
+    CHECK( nullptr != file );
+    if( nullptr == file )
+    {
+        return;
+    }
+    std::vector<unsigned __int8> data( 1 << 16 );
+    data.resize( ::fread( &data[0], 1, data.size(), file ) );
+    ::fclose( file );
+
+    DeviceIoReplayer replayer;
+    CHECK( replayer.attach( &data[0], data.size() ) );
+
+    data[data.size() / 2] ^= 0x01;
+    DeviceIoReplayer corrupt;
+    CHECK( !corrupt.attach( &data[0], data.size() ) );
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main( int argc, char **argv )
+{
+    if( argc != 2 )
+    {
+        ::fprintf( stderr, "usage: %s <fixtures directory>\n", argv[0] );
+        return 2;
+    }
+    const std::string trace = std::string( argv[1] ) + "/sata.trace";
+
+    testSweep( trace );
+    testOneDrive( trace );
+    testFleet( trace );
+    testFailures( trace );
+    testCorrupt( trace );
+
+    return testResult( "replaytest" );
+}
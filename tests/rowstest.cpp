@@ -0,0 +1,179 @@
+/** @file
+  * EpsDiskId/tests/rowstest.cpp
+  *
+  * The rows of xp_DiskId as the client gets them: DiskRows bound to a RowEmitter with
+  * bindDiskColumn() and sent through the ODS stand-in (odsstub.h).
+  *
+  * rowstest
+  */
+
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "diskrows.h"
+#include "diskfilter.h"
+#include "rowemit.h"
+#include "crc64.h"
+#include "testutil.h"
+
+using namespace Utils;
+
+//----------------------------------------------------------------------------------------------------------------------
+static disk_t makeDisk( int controller, const char *model, const char *serial, __int64 sectors )
+{
+    disk_t _disk;
+    _disk.num_controller = controller;
+    ::strcpy( _disk.model,  model );
+    ::strcpy( _disk.serial, serial );
+    _disk.sectors = sectors;
+    _disk.size    = sectors * 512;
+    return _disk;
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // four drives whose model and serial lengths change from row to row
+static void makeDisks( std::vector<disk_t> &disks, std::vector<int> &owners )
+{
+    disks.clear();
+    disks.push_back( makeDisk( 0, "M1",        "S0", 1000 ) );
+    disks.push_back( makeDisk( 0, "M1",        "S1", 2000 ) );
+    disks.push_back( makeDisk( 1, "MODEL-TWO", "S2", 3000 ) );
+    disks.push_back( makeDisk( 1, "M1",        "",   4000 ) );
+    owners.clear();
+    for( int i = 0; i < (int)disks.size(); i++ )
+    {
+        owners.push_back( i );
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+template< typename T >
+static bool sentAs( const SRV_PROC *srvproc, size_t row, int colnumber, T expected )
+{
+    std::string value;
+    return odsValue( srvproc, row, colnumber, value ) && sizeof(T) == value.size() &&
+           0 == ::memcmp( value.data(), &expected, sizeof(T) );
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // text values go out with their NUL, as xp_DiskId always sent them
+static bool sentText( const SRV_PROC *srvproc, size_t row, int colnumber, const char *expected )
+{
+    std::string value;
+    return odsValue( srvproc, row, colnumber, value ) && std::string( expected, ::strlen( expected ) + 1 ) == value;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testAllColumns()
+{
+    std::vector<disk_t> disks;
+    std::vector<int>    owners;
+    makeDisks( disks, owners );
+
+    DiskRows rows;
+    rows.assign( disks, owners );
+
+    SRV_PROC  *srvproc = odsCreate();
+    RowEmitter emitter( srvproc, rows.size() );
+    for( int col = 0; col < DISK_COLUMNS; col++ )
+    {
+        CHECK( bindDiskColumn( emitter, rows, col ) );
+    }
+    CHECK( 4 == emitter.send() );
+
+    CHECK( DISK_COLUMNS == odsColumns( srvproc ) && 4 == odsRows( srvproc ) );
+    for( int col = 0; col < DISK_COLUMNS; col++ )
+    {
+        CHECK( diskColumnName( col ) == odsColumnName( srvproc, col + 1 ) );
+    }
+    for( size_t i = 0; i < disks.size(); i++ )
+    {
+        CHECK( sentAs( srvproc, i, 1, (int)disks[i].num_controller ) );
+        CHECK( sentText( srvproc, i, 2, disks[i].model ) );
+        CHECK( sentText( srvproc, i, 3, disks[i].serial ) );
+        CHECK( sentAs( srvproc, i, 4, crc64( &disks[i], sizeof(disk_t) ) ) );
+        CHECK( sentAs( srvproc, i, 5, disks[i].sectors ) );
+    }
+
+       //  data bound once per column; lengths sent on the first row and then only when they change:
+       //  model 3 -> 3 -> 10 -> 3, serial 3 -> 3 -> 3 -> 1, the fixed columns once
+    size_t dataCalls = 0;
+    CHECK( 3 + 2 + 3 == odsColumnCalls( srvproc, &dataCalls ) );
+    CHECK( DISK_COLUMNS == dataCalls );
+
+       //  every column is bound by now
+    CHECK( !emitter.bind( "extra", SRVINT4, sizeof(int), SRVINT4, sizeof(int), rows.controller(), sizeof(int) ) );
+    CHECK( DISK_COLUMNS == emitter.columns() );
+
+    odsDestroy( srvproc );
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // rows picked by a filter and columns named by @columns, built alone
+static void testSubsets()
+{
+    std::vector<disk_t> disks;
+    std::vector<int>    owners;
+    makeDisks( disks, owners );
+
+    disk_filter_t filter;
+    filter.nFirst  = 1;
+    filter.nLast   = 3;
+    filter.pattern = "m1";
+    CHECK( filter.parseColumns( "serial, SIZE" ) );
+    CHECK( !filter.parseColumns( "serial,serial" ) && 2 == filter.columns.size() );
+
+    DiskRows rows;
+    rows.assign( disks, owners, nullptr, filter.needed() );
+    CHECK( rows.has( DISK_COL_MODEL ) && rows.has( DISK_COL_SERIAL ) && rows.has( DISK_COL_SIZE ) );
+    CHECK( !rows.has( DISK_COL_DUUID ) && nullptr == rows.duuid() && nullptr == rows.controller() );
+
+    std::vector<size_t> selected;
+    filter.select( rows, owners, selected );
+    CHECK( 2 == selected.size() && 1 == selected[0] && 3 == selected[1] );
+
+    SRV_PROC  *srvproc = odsCreate();
+    RowEmitter emitter( srvproc, rows.size() );
+    for( size_t c = 0; c < filter.columns.size(); c++ )
+    {
+        CHECK( bindDiskColumn( emitter, rows, filter.columns[c] ) );
+    }
+       //  a row past the end is skipped
+    selected.push_back( rows.size() );
+    CHECK( 2 == emitter.send( &selected[0], selected.size() ) );
+
+    CHECK( 2 == odsColumns( srvproc ) && 2 == odsRows( srvproc ) );
+    CHECK( "serial" == odsColumnName( srvproc, 1 ) && "size" == odsColumnName( srvproc, 2 ) );
+    CHECK( sentText( srvproc, 0, 1, "S1" ) && sentAs( srvproc, 0, 2, (__int64)2000 ) );
+    CHECK( sentText( srvproc, 1, 1, "" )   && sentAs( srvproc, 1, 2, (__int64)4000 ) );
+
+    size_t dataCalls = 0;
+    CHECK( 2 + 1 == odsColumnCalls( srvproc, &dataCalls ) && 2 == dataCalls );
+
+    odsDestroy( srvproc );
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // a length of 0 sends NULL, and the next value its own length again
+static void testNull()
+{
+    const char    text[3][4] = { "ab", "", "cd" };
+    const __int32 lengths[3] = { 3, 0, 3 };
+
+    SRV_PROC  *srvproc = odsCreate();
+    RowEmitter emitter( srvproc, 3 );
+    CHECK( emitter.bind( "text", SRVVARCHAR, 32, SRVVARCHAR, 32, text, sizeof(text[0]), lengths ) );
+    CHECK( 3 == emitter.send() );
+
+    std::string value;
+    CHECK( sentText( srvproc, 0, 1, "ab" ) );
+    CHECK( !odsValue( srvproc, 1, 1, value ) );
+    CHECK( sentText( srvproc, 2, 1, "cd" ) );
+    CHECK( 3 == odsColumnCalls( srvproc ) );
+
+    odsDestroy( srvproc );
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main()
+{
+    testAllColumns();
+    testSubsets();
+    testNull();
+    return testResult( "rowstest" );
+}
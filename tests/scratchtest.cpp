@@ -0,0 +1,229 @@
+/** @file
+  * EpsDiskId/tests/scratchtest.cpp
+  *
+  * A steady caller of the probes allocates nothing: what DiskInfo reuses from call to call
+  * (ScratchPool, batches of the ProbePool, device lists refilled in place, ProbeStrategy lookups)
+  * is run here the way DiskInfo runs it, with the global operator new of this program counting.
+  *
+  * scratchtest
+  */
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <new>
+#include <string>
+#include <vector>
+
+#include "scratchpool.h"
+#include "probepool.h"
+#include "probestrategy.h"
+#include "devenum.h"
+#include "testutil.h"
+
+static volatile long s_nAllocations = 0;
+
+void *operator new( size_t cb )
+{
+    __sync_add_and_fetch( &s_nAllocations, 1 );
+    void *p = ::malloc( cb ? cb : 1 );
+    if( nullptr == p )
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void *operator new[]( size_t cb )                                   { return operator new( cb ); }
+void *operator new( size_t cb, const std::nothrow_t& ) throw()
+{
+    __sync_add_and_fetch( &s_nAllocations, 1 );
+    return ::malloc( cb ? cb : 1 );
+}
+void *operator new[]( size_t cb, const std::nothrow_t &nt ) throw() { return operator new( cb, nt ); }
+void  operator delete( void *p ) throw()                            { ::free( p ); }
+void  operator delete[]( void *p ) throw()                          { ::free( p ); }
+void  operator delete( void *p, size_t ) throw()                    { ::free( p ); }
+void  operator delete[]( void *p, size_t ) throw()                  { ::free( p ); }
+
+using namespace Utils;
+
+#define  SCRATCH_WARMUP     3
+#define  SCRATCH_ROUNDS     50
+
+//----------------------------------------------------------------------------------------------------------------------
+   // paths longer than any short string buffer, so that a copy would have to allocate
+static void makeDevices( std::vector<device_t> &devices, size_t count )
+{
+    size_t n = 0;
+    for( size_t i = 0; i < count; i++ )
+    {
+        device_t &dev = nextDevice( devices, n );
+        dev.index = (int)i;
+        dev.name.assign( 1, (char)( 'a' + i ) ).insert( 0, "sd" );
+        dev.path.assign( "/dev/disk/by-path/pci-0000:00:17.0-ata-" ).append( dev.name );
+    }
+    devices.resize( n );
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // one sweep as DiskInfo hands it to the pool: its own copy of the devices and a slot each
+struct scratch_batch_t : public ProbeTasks
+{
+    std::vector<device_t>   devices;
+    std::vector<int>        slots;
+    unsigned                sleepMs;
+
+    scratch_batch_t() : sleepMs( 0 ) {}
+
+    virtual void runTask( size_t index )
+    {
+        if( 0 != sleepMs )
+        {
+            ::usleep( sleepMs * 1000 );
+        }
+        slots[index] = devices[index].index + 1;
+    }
+};
+//----------------------------------------------------------------------------------------------------------------------
+   // as DiskInfo::probe_scratch_t::giveBatch()
+static void giveBatch( ScratchPool<scratch_batch_t> &batches, scratch_batch_t *batch )
+{
+    if( batch->reusable() )
+    {
+        batches.give( batch );
+    }
+    else
+    {
+        batch->release();
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // a sweep: the device list and the batch from the scratch, the tasks on up to four workers
+static bool sweep( ScratchPool< std::vector<device_t> > &lists, ScratchPool<scratch_batch_t> &batches )
+{
+    ScratchHold< std::vector<device_t> > devices( lists );
+    makeDevices( *devices, 6 );
+
+    scratch_batch_t *batch = batches.take();
+    batch->devices = *devices;
+    batch->slots.assign( devices->size(), 0 );
+
+    bool ok = ProbePool( 4 ).run( devices->size(), batch, 5000 );
+    for( size_t d = 0; d < batch->slots.size(); d++ )
+    {
+        ok = ok && (int)d + 1 == batch->slots[d];
+    }
+    giveBatch( batches, batch );
+    return ok;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testSteadySweeps()
+{
+    ScratchPool< std::vector<device_t> > lists;
+    ScratchPool<scratch_batch_t>         batches;
+
+    for( int i = 0; i < SCRATCH_WARMUP; i++ )
+    {
+        CHECK( sweep( lists, batches ) );
+    }
+    const long before = s_nAllocations;
+    bool       ok     = true;
+    for( int i = 0; i < SCRATCH_ROUNDS; i++ )
+    {
+        ok = sweep( lists, batches ) && ok;
+    }
+    CHECK( ok );
+    CHECK( before == s_nAllocations );
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // a batch left to a hung worker is not reused: the next sweep gets another one
+static void testAbandonedBatch()
+{
+    ScratchPool<scratch_batch_t> batches;
+    scratch_batch_t             *batch = batches.take();
+
+    makeDevices( batch->devices, 1 );
+    batch->slots.assign( 1, 0 );
+    batch->sleepMs = 300;
+    CHECK( !ProbePool( 1 ).run( 1, batch, 10 ) );
+    CHECK( !batch->reusable() );
+    giveBatch( batches, batch );
+
+    scratch_batch_t *next = batches.take();
+    CHECK( next != batch );
+    batches.give( next );
+
+    ::usleep( 500 * 1000 );         // the worker lets go of the abandoned batch, which then goes
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // several holds at once, as a sweep that takes a device list for the drives and one for the wanted
+static void testHolds()
+{
+    ScratchPool<std::string> strings;
+    for( int i = 0; i < SCRATCH_WARMUP; i++ )
+    {
+        ScratchHold<std::string> a( strings );
+        ScratchHold<std::string> b( strings );
+        a->assign( 100, 'a' );
+        b->assign( 100, 'b' );
+    }
+    const long before = s_nAllocations;
+    for( int i = 0; i < SCRATCH_ROUNDS; i++ )
+    {
+        ScratchHold<std::string> a( strings );
+        ScratchHold<std::string> b( strings );
+        a->assign( 100, 'a' );
+        b->assign( 100, 'b' );
+        CHECK( 'a' == (*a)[99] && 'b' == (*b)[99] );
+    }
+    CHECK( before == s_nAllocations );
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // what a probe asks the strategy before every request
+static void testStrategyLookup()
+{
+    std::vector<device_t> devices;
+    makeDevices( devices, 2 );
+
+    ProbeStrategy strategy;
+    strategy.setUnsupported( devices[0], PROBE_NO_SMART );
+    strategy.setUnsupported( devices[0], PROBE_NO_MEDIA_SERIAL, "vendor|model|serial of the medium" );
+
+    const std::string identity( "vendor|model|serial of the medium" );
+    const long        before = s_nAllocations;
+    bool              ok     = true;
+    for( int i = 0; i < SCRATCH_ROUNDS; i++ )
+    {
+        ok = ok && strategy.isUnsupported( devices[0], PROBE_NO_SMART );
+        ok = ok && strategy.isUnsupported( devices[0], PROBE_NO_MEDIA_SERIAL, identity );
+        ok = ok && !strategy.isUnsupported( devices[0], PROBE_NO_MINIPORT );
+        ok = ok && !strategy.isUnsupported( devices[1], PROBE_NO_SMART );
+    }
+    CHECK( ok );
+    CHECK( before == s_nAllocations );
+
+    strategy.forget( devices[0] );
+    CHECK( !strategy.isUnsupported( devices[0], PROBE_NO_SMART ) );
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // a list refilled in place keeps the storage of its paths
+static void testRefill()
+{
+    std::vector<device_t> devices;
+    makeDevices( devices, 8 );
+
+    const long before = s_nAllocations;
+    makeDevices( devices, 8 );
+    makeDevices( devices, 5 );
+    CHECK( before == s_nAllocations );
+    CHECK( 5 == devices.size() && 4 == devices[4].index && "sde" == devices[4].name );
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main()
+{
+    testSteadySweeps();
+    testAbandonedBatch();
+    testHolds();
+    testStrategyLookup();
+    testRefill();
+    return testResult( "scratchtest" );
+}
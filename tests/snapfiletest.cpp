@@ -0,0 +1,247 @@
+/** @file
+  * EpsDiskId/tests/snapfiletest.cpp
+  *
+  * The snapshot file of snapfile.h: what saveDiskSnapshot() writes loadDiskSnapshot() gives back
+  * byte for byte, and a file that is corrupt, torn, of another version or layout, or too old is
+  * refused without touching the caller's lists.
+  *
+  * snapfiletest
+  */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "snapfile.h"
+#include "crc64.h"
+#include "testutil.h"
+
+using namespace Utils;
+
+//----------------------------------------------------------------------------------------------------------------------
+static disk_t makeDisk( int controller, const char *model, const char *serial, __int64 sectors )
+{
+    disk_t _disk;
+    _disk.num_controller = controller;
+    ::strcpy( _disk.vendor,   "ATA" );
+    ::strcpy( _disk.model,    model );
+    ::strcpy( _disk.serial,   serial );
+    ::strcpy( _disk.revision, "1A01" );
+    _disk.sectors = sectors;
+    _disk.size    = sectors * 512;
+    _disk.buffer  = 8192;
+    _disk.type    = 1;
+    return _disk;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void makeDisks( std::vector<disk_t> &disks, std::vector<int> &devices )
+{
+    disks.clear();
+    disks.push_back( makeDisk( 0, "WDC WD10EZEX-08W", "WD-WCC6Y3HK1234", 1953525168LL ) );
+    disks.push_back( makeDisk( 1, "Samsung SSD 970",  "S466NX0K123456A", 976773168LL ) );
+    disks.push_back( makeDisk( 1, "Samsung SSD 970",  "",                0 ) );
+    devices.clear();
+    devices.push_back( 0 );
+    devices.push_back( 2 );
+    devices.push_back( -1 );
+}
+//----------------------------------------------------------------------------------------------------------------------
+static bool readFile( const std::string &path, std::vector<unsigned __int8> &data )
+{
+    FILE *f = ::fopen( path.c_str(), "rb" );
+    if( nullptr == f )
+    {
+        return false;
+    }
+    unsigned __int8 buffer[4096];
+    size_t          cb;
+    data.clear();
+    while( 0 != ( cb = ::fread( buffer, 1, sizeof(buffer), f ) ) )
+    {
+        data.insert( data.end(), buffer, buffer + cb );
+    }
+    ::fclose( f );
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static bool writeFile( const std::string &path, const std::vector<unsigned __int8> &data, size_t cb )
+{
+    FILE *f = ::fopen( path.c_str(), "wb" );
+    if( nullptr == f )
+    {
+        return false;
+    }
+    const bool ok = cb == ::fwrite( &data[0], 1, cb, f );
+    return 0 == ::fclose( f ) && ok;
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // the header of data changed by the caller, with its own CRC made right again
+static void resealHeader( std::vector<unsigned __int8> &data, const disk_snapshot_header_t &header )
+{
+    disk_snapshot_header_t sealed = header;
+    sealed.crcHeader = (unsigned __int64)crc64( &sealed, offsetof( disk_snapshot_header_t, crcHeader ) );
+    ::memcpy( &data[0], &sealed, sizeof(sealed) );
+}
+//----------------------------------------------------------------------------------------------------------------------
+   // loadDiskSnapshot() of data written to path, and whether the lists came back as they were
+static bool loads( const std::string &path, const std::vector<unsigned __int8> &data, size_t cb, unsigned long maxAgeSec,
+                   bool &untouched )
+{
+    std::vector<disk_t> disks( 1 );
+    std::vector<int>    devices( 1, 42 );
+    if( !writeFile( path, data, cb ) )
+    {
+        return false;
+    }
+    const bool ok = loadDiskSnapshot( path.c_str(), disks, devices, maxAgeSec );
+    untouched = 1 == disks.size() && 1 == devices.size() && 42 == devices[0];
+    return ok;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static bool refused( const std::string &path, const std::vector<unsigned __int8> &data, size_t cb, unsigned long maxAgeSec = 0 )
+{
+    bool untouched = false;
+    return !loads( path, data, cb, maxAgeSec, untouched ) && untouched;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testRoundTrip( const std::string &path )
+{
+    std::vector<disk_t> disks;
+    std::vector<int>    devices;
+    makeDisks( disks, devices );
+    CHECK( saveDiskSnapshot( path.c_str(), disks, devices ) );
+
+    std::vector<disk_t> loaded;
+    std::vector<int>    owners;
+    CHECK( loadDiskSnapshot( path.c_str(), loaded, owners, 60 ) );
+    CHECK( disks.size() == loaded.size() && devices == owners );
+    CHECK( 0 == ::memcmp( &disks[0], &loaded[0], disks.size() * sizeof(disk_t) ) );
+    CHECK( crc64( &disks[1], sizeof(disk_t) ) == crc64( &loaded[1], sizeof(disk_t) ) );
+
+    std::vector<unsigned __int8> data;
+    CHECK( readFile( path, data ) );
+    CHECK( sizeof(disk_snapshot_header_t) + 3 * ( sizeof(disk_t) + 4 ) == data.size() );
+
+    disk_snapshot_header_t header;
+    ::memcpy( &header, &data[0], sizeof(header) );
+    CHECK( diskSnapshotChecksum( disks, devices ) == header.crcRecords );
+
+       //  no drives is a snapshot too
+    disks.clear();
+    devices.clear();
+    CHECK( saveDiskSnapshot( path.c_str(), disks, devices ) );
+    CHECK( loadDiskSnapshot( path.c_str(), loaded, owners, 0 ) && loaded.empty() && owners.empty() );
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testRefused( const std::string &path )
+{
+    std::vector<disk_t> disks;
+    std::vector<int>    devices;
+    makeDisks( disks, devices );
+    CHECK( saveDiskSnapshot( path.c_str(), disks, devices ) );
+
+    std::vector<unsigned __int8> data;
+    CHECK( readFile( path, data ) );
+    const std::vector<unsigned __int8> good = data;
+    const size_t                       cbHeader = sizeof(disk_snapshot_header_t);
+
+    bool untouched = false;
+    CHECK( loads( path, good, good.size(), 0, untouched ) );
+
+       //  a flipped byte anywhere in the records: serial of the first, last byte of the second,
+       //  physical drive of the last
+    const size_t records[] = { cbHeader + offsetof( disk_t, serial ) + 3,
+                               cbHeader + sizeof(disk_t) + 4 + sizeof(disk_t) - 1,
+                               good.size() - 1 };
+    for( size_t i = 0; i < sizeof(records) / sizeof(records[0]); i++ )
+    {
+        data = good;
+        data[records[i]] ^= 0x01;
+        CHECK( refused( path, data, data.size() ) );
+    }
+
+       //  a flipped byte in every byte of the header
+    bool ok = true;
+    for( size_t b = 0; b < cbHeader; b++ )
+    {
+        data = good;
+        data[b] ^= 0x40;
+        ok = refused( path, data, data.size() ) && ok;
+    }
+    CHECK( ok );
+
+       //  torn: short by a byte, by a record, down to the header, below it, empty
+    CHECK( refused( path, good, good.size() - 1 ) );
+    CHECK( refused( path, good, good.size() - sizeof(disk_t) - 4 ) );
+    CHECK( refused( path, good, cbHeader ) );
+    CHECK( refused( path, good, cbHeader - 1 ) );
+    CHECK( refused( path, good, 0 ) );
+
+       //  another version or layout, even with a header CRC that matches
+    disk_snapshot_header_t header;
+    ::memcpy( &header, &good[0], sizeof(header) );
+
+    disk_snapshot_header_t changed = header;
+    changed.version = DISK_SNAPSHOT_VERSION + 1;
+    data = good;
+    resealHeader( data, changed );
+    CHECK( refused( path, data, data.size() ) );
+
+    changed = header;
+    changed.cbRecord += 8;
+    data = good;
+    resealHeader( data, changed );
+    CHECK( refused( path, data, data.size() ) );
+
+    changed = header;
+    changed.count += 1;
+    data = good;
+    resealHeader( data, changed );
+    CHECK( refused( path, data, data.size() ) );
+
+       //  written an hour ago: fine without a limit or with a longer one, refused past maxAgeSec
+    changed = header;
+    changed.written -= 3600;
+    data = good;
+    resealHeader( data, changed );
+    CHECK( loads( path, data, data.size(), 0, untouched ) );
+    CHECK( loads( path, data, data.size(), 7200, untouched ) );
+    CHECK( refused( path, data, data.size(), 600 ) );
+
+       //  from the future, as after the clock was set back
+    changed = header;
+    changed.written = (__int64)::time( nullptr ) + 3600;
+    data = good;
+    resealHeader( data, changed );
+    CHECK( refused( path, data, data.size(), 600 ) );
+
+       //  and no file at all
+    ::unlink( path.c_str() );
+    std::vector<disk_t> loaded;
+    std::vector<int>    owners;
+    CHECK( !loadDiskSnapshot( path.c_str(), loaded, owners, 0 ) );
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main()
+{
+    char dir[] = "/tmp/snapfiletest.XXXXXX";
+    if( nullptr == ::mkdtemp( dir ) )
+    {
+        ::perror( "mkdtemp" );
+        return 1;
+    }
+    const std::string path = std::string( dir ) + "/diskid.snapshot";
+
+    testRoundTrip( path );
+    testRefused( path );
+
+    ::unlink( path.c_str() );
+    ::rmdir( dir );
+    return testResult( "snapfiletest" );
+}
@@ -0,0 +1,87 @@
+/** @file
+  * EpsDiskId/tests/testutil.h
+  *
+  * What the test programs share: CHECK(), which counts failures instead of stopping, and a DeviceIo
+  * that counts the requests passed on to another.
+  */
+
+#ifndef __Utils_TESTUTIL_
+#define __Utils_TESTUTIL_
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "deviceio.h"
+
+namespace Utils
+{
+    inline int &testFailures()
+    {
+        static int s_nFailed = 0;
+        return s_nFailed;
+    }
+
+    inline void testCheck( bool ok, const char *what, const char *file, int line )
+    {
+        if( !ok )
+        {
+            ::fprintf( stderr, "%s:%d: failed: %s\n", file, line, what );
+            testFailures()++;
+        }
+    }
+
+       //  exit code of a test program: 0 when every check passed
+    inline int testResult( const char *name )
+    {
+        if( 0 != testFailures() )
+        {
+            ::fprintf( stderr, "%s: %d checks failed\n", name, testFailures() );
+            return 1;
+        }
+        return 0;
+    }
+
+#define  CHECK( cond )      Utils::testCheck( (cond), #cond, __FILE__, __LINE__ )
+
+       //  Counts what reaches the backend
+    class CountingDeviceIo : public DeviceIo
+    {
+        public:
+            explicit CountingDeviceIo( DeviceIo &inner ) : opens( 0 ), controls( 0 ), m_inner( inner ) {}
+
+            virtual bool listDevices( bool scsiPorts, std::vector<device_t> &devices )
+            {
+                return m_inner.listDevices( scsiPorts, devices );
+            }
+            virtual void *open( const device_path_t &path, unsigned long access, bool bOverlapped, unsigned long &error )
+            {
+                opens++;
+                return m_inner.open( path, access, bOverlapped, error );
+            }
+            virtual bool control( void *hDevice, unsigned long code, const void *pIn, unsigned long cbIn,
+                                  void *pOut, unsigned long cbOut, unsigned long &cbReturned,
+                                  unsigned long timeoutMs, unsigned long &error )
+            {
+                controls++;
+                return m_inner.control( hDevice, code, pIn, cbIn, pOut, cbOut, cbReturned, timeoutMs, error );
+            }
+            virtual void close( void *hDevice )
+            {
+                m_inner.close( hDevice );
+            }
+            virtual bool readAttribute( const device_path_t &path, std::string &text, unsigned long &error )
+            {
+                return m_inner.readAttribute( path, text, error );
+            }
+
+            int     opens;
+            int     controls;
+
+        private:
+            DeviceIo   &m_inner;
+    };
+};
+
+#endif
@@ -0,0 +1,126 @@
+/** @file
+  * EpsDiskId/tools/diskinv.cpp
+  *
+  * The xp_DiskId result set of a Linux host, from SysfsProbe: one tab separated line per drive with
+  * controller, model, serial, duuid and size, built by DiskRows as the DLL builds them.
+  *
+  * diskinv [ --replay trace | --capture trace ] [ --sysroot dir ] [ --no-identify ]
+  *     --replay        answers every request from a trace instead of this host (devtrace.h)
+  *     --capture       probes this host and saves every request and answer as a trace
+  *     --sysroot       where the attributes are read, "/sys" by default
+  *     --no-identify   the drives are never opened, records hold what sysfs has
+  *
+  * Exit code 0 when drives were listed, 1 when none were, 2 on a usage or file error.
+  */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "sysfsprobe.h"
+#include "deviceio.h"
+#include "devtrace.h"
+#include "diskrows.h"
+#include "probestrategy.h"
+
+using namespace Utils;
+
+//----------------------------------------------------------------------------------------------------------------------
+   // text value of a row without its NUL
+static std::string rowText( const char *column, size_t stride, const __int32 *lengths, size_t row )
+{
+    const size_t cb = ( lengths[row] > 0 ) ? (size_t)lengths[row] - 1 : 0;
+    return std::string( column + row * stride, cb );
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main( int argc, char **argv )
+{
+    const char *replayPath  = nullptr;
+    const char *capturePath = nullptr;
+    const char *sysRoot     = nullptr;
+    bool        bIdentify   = true;
+
+    for( int i = 1; i < argc; i++ )
+    {
+        if( 0 == ::strcmp( argv[i], "--replay" ) && i + 1 < argc )
+        {
+            replayPath = argv[++i];
+        }
+        else if( 0 == ::strcmp( argv[i], "--capture" ) && i + 1 < argc )
+        {
+            capturePath = argv[++i];
+        }
+        else if( 0 == ::strcmp( argv[i], "--sysroot" ) && i + 1 < argc )
+        {
+            sysRoot = argv[++i];
+        }
+        else if( 0 == ::strcmp( argv[i], "--no-identify" ) )
+        {
+            bIdentify = false;
+        }
+        else
+        {
+            replayPath = capturePath = nullptr;
+            argc = 0;
+        }
+    }
+    if( 0 == argc || ( nullptr != replayPath && nullptr != capturePath ) )
+    {
+        ::fprintf( stderr, "usage: diskinv [ --replay trace | --capture trace ] [ --sysroot dir ] [ --no-identify ]\n" );
+        return 2;
+    }
+
+    DeviceIoReplayer replayer;
+    DeviceIoRecorder recorder( liveDeviceIo() );
+    ProbeStrategy    strategy;
+    SysfsProbe       probe;
+
+    if( nullptr != replayPath )
+    {
+        if( !replayer.load( replayPath ) )
+        {
+            ::fprintf( stderr, "diskinv: %s is not a device trace\n", replayPath );
+            return 2;
+        }
+        probe.setDeviceIo( &replayer );
+    }
+    else if( nullptr != capturePath )
+    {
+        probe.setDeviceIo( &recorder );
+    }
+    if( nullptr != sysRoot )
+    {
+        probe.setSysRoot( sysRoot );
+    }
+    probe.setIdentify( bIdentify );
+    probe.setStrategy( &strategy );
+
+    std::vector<disk_t> disks;
+    probe_report_t      report;
+    const bool          ok = probe.getDrivesInfo( disks, report );
+
+    if( nullptr != capturePath && !recorder.save( capturePath ) )
+    {
+        ::fprintf( stderr, "diskinv: cannot write %s\n", capturePath );
+        return 2;
+    }
+
+    DiskRows rows;
+    rows.assign( disks, report.deviceOf );
+
+    ::printf( "controller\tmodel\tserial\tduuid\tsize\n" );
+    for( size_t i = 0; i < rows.size(); i++ )
+    {
+        ::printf( "%d\t%s\t%s\t%lld\t%lld\n", rows.controller()[i],
+                  rowText( rows.model(),  rows.modelStride(),  rows.modelLengths(),  i ).c_str(),
+                  rowText( rows.serial(), rows.serialStride(), rows.serialLengths(), i ).c_str(),
+                  (long long)rows.duuid()[i], (long long)rows.sectors()[i] );
+    }
+    for( size_t i = 0; i < report.timedOut.size(); i++ )
+    {
+        ::fprintf( stderr, "diskinv: drive %d timed out\n", report.timedOut[i] );
+    }
+    return ok ? 0 : 1;
+}
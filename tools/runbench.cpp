@@ -0,0 +1,183 @@
+/** @file
+  * EpsDiskId/tools/runbench.cpp
+  *
+  * Runs the benchmarks of diskbench.h outside SQL Server and prints one tab separated line per
+  * benchmark: name, iterations, bytes/op, ns/op, MB/s, allocs/op.
+  *
+  * runbench [ iterations ] [ --baseline file ] [ --write file ]
+  *     --baseline  compares with a file written by --write: allocs/op must not grow, times are only
+  *                 shown as a ratio (they depend on the machine).  Runs the iterations the baseline
+  *                 was written with unless others are given; exit code 1 on a regression.
+  *     --write     saves the results as a baseline
+  *
+  * The allocations are counted by replacing the global operator new of this program.
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "diskbench.h"
+
+static unsigned __int64 s_nAllocations = 0;
+
+void *operator new( size_t cb )
+{
+    s_nAllocations++;
+    void *p = ::malloc( cb ? cb : 1 );
+    if( nullptr == p )
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void *operator new[]( size_t cb )                                   { return operator new( cb ); }
+void *operator new( size_t cb, const std::nothrow_t& ) throw()
+{
+    s_nAllocations++;
+    return ::malloc( cb ? cb : 1 );
+}
+void *operator new[]( size_t cb, const std::nothrow_t &nt ) throw() { return operator new( cb, nt ); }
+void  operator delete( void *p ) throw()                            { ::free( p ); }
+void  operator delete[]( void *p ) throw()                          { ::free( p ); }
+void  operator delete( void *p, size_t ) throw()                    { ::free( p ); }
+void  operator delete[]( void *p, size_t ) throw()                  { ::free( p ); }
+
+static unsigned __int64 allocations()
+{
+    return s_nAllocations;
+}
+
+using namespace Utils;
+
+   //  Baseline file: "# iterations N", then name <TAB> allocs/op <TAB> ns/op per benchmark
+struct baseline_t
+{
+    unsigned long                                   iterations;
+    std::map< std::string, std::pair<double, double> > results;   // allocs/op, ns/op
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+static bool readBaseline( const char *path, baseline_t &baseline )
+{
+    FILE *file = ::fopen( path, "r" );
+    if( nullptr == file )
+    {
+        return false;
+    }
+    char line[512];
+    baseline.iterations = 0;
+    while( nullptr != ::fgets( line, sizeof(line), file ) )
+    {
+        unsigned long iterations = 0;
+        if( 1 == ::sscanf( line, "# iterations %lu", &iterations ) )
+        {
+            baseline.iterations = iterations;
+            continue;
+        }
+        char  *tab = ::strchr( line, '\t' );
+        double allocs = 0.0;
+        double ns     = 0.0;
+        if( '#' == line[0] || nullptr == tab || 2 != ::sscanf( tab + 1, "%lf\t%lf", &allocs, &ns ) )
+        {
+            continue;
+        }
+        baseline.results[std::string( line, tab )] = std::make_pair( allocs, ns );
+    }
+    ::fclose( file );
+    return 0 != baseline.iterations && !baseline.results.empty();
+}
+//----------------------------------------------------------------------------------------------------------------------
+static bool writeBaseline( const char *path, unsigned long iterations, const std::vector<bench_result_t> &results )
+{
+    FILE *file = ::fopen( path, "w" );
+    if( nullptr == file )
+    {
+        return false;
+    }
+    ::fprintf( file, "# diskbench baseline: name, allocs/op, ns/op (tools/runbench --write)\n" );
+    ::fprintf( file, "# iterations %lu\n", iterations );
+    for( size_t i = 0; i < results.size(); i++ )
+    {
+        ::fprintf( file, "%s\t%.6f\t%.1f\n", results[i].name, results[i].allocsPerOp, results[i].nsPerOp );
+    }
+    return 0 == ::fclose( file );
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main( int argc, char **argv )
+{
+    unsigned long iterations    = 0;
+    const char   *baselinePath  = nullptr;
+    const char   *writePath     = nullptr;
+
+    for( int i = 1; i < argc; i++ )
+    {
+        if( 0 == ::strcmp( argv[i], "--baseline" ) && i + 1 < argc )
+        {
+            baselinePath = argv[++i];
+        }
+        else if( 0 == ::strcmp( argv[i], "--write" ) && i + 1 < argc )
+        {
+            writePath = argv[++i];
+        }
+        else if( 0 == ( iterations = ::strtoul( argv[i], nullptr, 10 ) ) )
+        {
+            ::fprintf( stderr, "usage: %s [ iterations ] [ --baseline file ] [ --write file ]\n", argv[0] );
+            return 2;
+        }
+    }
+
+    baseline_t baseline;
+    if( nullptr != baselinePath && !readBaseline( baselinePath, baseline ) )
+    {
+        ::fprintf( stderr, "%s: no baseline in %s\n", argv[0], baselinePath );
+        return 2;
+    }
+    if( 0 == iterations )
+    {
+        iterations = ( nullptr != baselinePath ) ? baseline.iterations : DISK_BENCH_DEFAULT_ITERATIONS;
+    }
+
+    std::vector<bench_result_t> results;
+    runDiskBenchmarks( iterations, results, allocations );
+
+    int regressions = 0;
+    ::printf( "benchmark\titerations\tbytes_per_op\tns_per_op\tmb_per_s\tallocs_per_op%s\n",
+              nullptr != baselinePath ? "\tns_vs_baseline" : "" );
+    for( size_t i = 0; i < results.size(); i++ )
+    {
+        const bench_result_t &result = results[i];
+        ::printf( "%s\t%lu\t%lu\t%.1f\t%.1f\t%.4f", result.name, result.iterations, result.cbPerOp,
+                  result.nsPerOp, result.mbPerSec, result.allocsPerOp );
+        if( nullptr != baselinePath )
+        {
+            std::map< std::string, std::pair<double, double> >::const_iterator it = baseline.results.find( result.name );
+            if( baseline.results.end() == it )
+            {
+                ::printf( "\tnew" );
+            }
+            else
+            {
+                ::printf( "\t%.2f", it->second.second > 0.0 ? result.nsPerOp / it->second.second : 0.0 );
+                   //  allocation counts do not vary between runs of the same iterations
+                if( iterations == baseline.iterations && result.allocsPerOp > it->second.first + 0.5 / iterations )
+                {
+                    ::printf( "\tREGRESSION allocs/op %.6f > %.6f", result.allocsPerOp, it->second.first );
+                    regressions++;
+                }
+            }
+        }
+        ::printf( "\n" );
+    }
+    if( nullptr != writePath && !writeBaseline( writePath, iterations, results ) )
+    {
+        ::fprintf( stderr, "%s: cannot write %s\n", argv[0], writePath );
+        return 2;
+    }
+    return ( 0 == regressions ) ? 0 : 1;
+}
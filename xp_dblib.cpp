@@ -15,9 +15,44 @@
 
 #include "esp_lib.h"
 #include "diskid.h"
-#include "crc64.h"
+#include "diskcache.h"
+#include "diskrows.h"
+#include "diskfilter.h"
+#include "rowemit.h"
+#include "diskrefresh.h"
+#include "snapfile.h"
+#include "probestrategy.h"
+#include "probepool.h"
+#include "probediag.h"
+#include "probestats.h"
+#include "diskbench.h"
+#include "deviceio.h"
+#include "devtrace.h"
 
-const int DSK_VERSION = 4;
+    // 5: NVMe drives are described by Identify Controller and Identify Namespace (model, serial,
+    //    firmware, size) rather than the storage descriptor, so their duuid differs from version 4;
+    //    ids stored for NVMe drives by an older version have to be taken again
+const int DSK_VERSION = 5;
+
+    // devices probed at once by xp_DiskId; wall time follows the slowest device, not the sum
+const unsigned DSK_MAX_PARALLEL_PROBES = 8;
+    // a hung device is skipped after DSK_DEVICE_TIMEOUT_MS; the whole sweep gets DSK_CALL_TIMEOUT_MS
+const unsigned long DSK_DEVICE_TIMEOUT_MS = 3000;
+const unsigned long DSK_CALL_TIMEOUT_MS   = 10000;
+    // xp_DiskId answers from the last complete sweep for this long; xp_DiskIdInvalidate resets it
+const unsigned long DSK_CACHE_TTL_MS      = 5 * 60 * 1000;
+    // a background thread, started by the first xp_DiskId, re-probes this often so that callers
+    // read the snapshot instead of waiting on devices; 0 leaves the refresh to xp_DiskId itself
+const unsigned long DSK_REFRESH_INTERVAL_MS = 60 * 1000;
+    // drives plugged in or removed are re-probed one by one as the OS reports them
+const bool          DSK_WATCH_DEVICES       = true;
+    // every changed sweep is saved to DSK_SNAPSHOT_FILE in the temp directory; after a restart the
+    // first xp_DiskId answers from it while the refresher runs a verification sweep at once.
+    // Files older than DSK_SNAPSHOT_MAX_AGE_S are ignored
+const wchar_t       DSK_SNAPSHOT_FILE[]     = L"EpsDiskId.snapshot";
+const unsigned long DSK_SNAPSHOT_MAX_AGE_S  = 7 * 24 * 60 * 60;
+    // xp_DiskIdCapture writes the requests of one sweep to DSK_TRACE_FILE in the temp directory
+const wchar_t       DSK_TRACE_FILE[]        = L"EpsDiskId.trace";
 
 // Extended procedure error codes
 #define SRV_MAXERROR            50000
@@ -37,6 +72,18 @@ RETCODE NFSLIB_API xp_GetVersion( SRV_PROC *srvproc );
 
 RETCODE NFSLIB_API xp_DiskId(SRV_PROC *srvproc); 
 
+RETCODE NFSLIB_API xp_DiskIdInvalidate(SRV_PROC *srvproc); 
+
+RETCODE NFSLIB_API xp_DiskIdShutdown(SRV_PROC *srvproc); 
+
+RETCODE NFSLIB_API xp_DiskIdDiagnostics(SRV_PROC *srvproc); 
+
+RETCODE NFSLIB_API xp_DiskIdStats(SRV_PROC *srvproc); 
+
+RETCODE NFSLIB_API xp_DiskIdBench(SRV_PROC *srvproc); 
+
+RETCODE NFSLIB_API xp_DiskIdCapture(SRV_PROC *srvproc); 
+
 #ifdef __cplusplus
 }
 #endif      // __cplusplus
@@ -44,55 +91,448 @@ RETCODE NFSLIB_API xp_DiskId(SRV_PROC *srvproc);
 
 #endif
 
+static volatile long    s_nWarmStartTried = 0;
+static unsigned __int64 s_nSavedChecksum  = 0;      // last file written or read; a race only costs a rewrite
+static ProbeStrategy    s_probeStrategy;            // what earlier sweeps learnt about the drives
+static ProbeDiagnostics s_probeDiagnostics;         // recent failed opens and requests, for xp_DiskIdDiagnostics
+static ProbeStats       s_probeStats;               // latency of every phase per device, for xp_DiskIdStats
+static DeviceIoRecorder s_deviceRecorder( liveDeviceIo() );     // for xp_DiskIdCapture; abandoned probes may still use it
+
+//--------------------------------------------------------------------------------------------------------
+static bool tempFilePath( const wchar_t *name, std::wstring &path )
+{
+    wchar_t dir[MAX_PATH + 1] = {0x00};
+    DWORD   cch = ::GetTempPathW( _countof(dir), dir );
+    if( 0 == cch || cch >= _countof(dir) )
+    {
+        return false;
+    }
+    path  = dir;
+    path += name;
+    return true;
+}
+//--------------------------------------------------------------------------------------------------------
+static bool snapshotPath( std::wstring &path )
+{
+    return tempFilePath( DSK_SNAPSHOT_FILE, path );
+}
+//--------------------------------------------------------------------------------------------------------
+static void saveSnapshot( const std::vector<disk_t> &lst_disk, const std::vector<int> &devices )
+{
+    std::wstring           path;
+    const unsigned __int64 checksum = diskSnapshotChecksum( lst_disk, devices );
+    if( checksum != s_nSavedChecksum && snapshotPath( path ) && saveDiskSnapshot( path.c_str(), lst_disk, devices ) )
+    {
+        s_nSavedChecksum = checksum;
+    }
+}
+//--------------------------------------------------------------------------------------------------------
+static bool backgroundRunning();
+
+    // the saved sweep, once per process and only when the refresher can verify it
+static bool loadSnapshot( std::vector<disk_t> &lst_disk, std::vector<int> &devices )
+{
+    std::wstring path;
+    if( !backgroundRunning() || 0 != ::InterlockedCompareExchange( &s_nWarmStartTried, 1, 0 ) ||
+        !snapshotPath( path ) || !loadDiskSnapshot( path.c_str(), lst_disk, devices, DSK_SNAPSHOT_MAX_AGE_S ) )
+    {
+        return false;
+    }
+    s_nSavedChecksum = diskSnapshotChecksum( lst_disk, devices );
+    return true;
+}
+//--------------------------------------------------------------------------------------------------------
+static DiskInfo makeDiskEngine( unsigned nMaxParallelProbes, unsigned long nDeviceTimeoutMs, unsigned long nTotalTimeoutMs )
+{
+    DiskInfo engine;
+    engine.setMaxParallelProbes( nMaxParallelProbes );
+    engine.setTimeouts( nDeviceTimeoutMs, nTotalTimeoutMs );
+    engine.setStrategy( &s_probeStrategy );
+    engine.setDiagnostics( &s_probeDiagnostics );
+    engine.setStats( &s_probeStats );
+    return engine;
+}
+
+    // settings only; their const calls keep all probe state on the caller's side and can run concurrently
+static const DiskInfo s_sweepEngine  = makeDiskEngine( DSK_MAX_PARALLEL_PROBES, DSK_DEVICE_TIMEOUT_MS, DSK_CALL_TIMEOUT_MS );
+static const DiskInfo s_deviceEngine = makeDiskEngine( 1, DSK_DEVICE_TIMEOUT_MS, DSK_DEVICE_TIMEOUT_MS );
+
+//--------------------------------------------------------------------------------------------------------
+    // one full sweep; false if a device timed out and the result should not be cached
+static bool probeDrives( std::vector<disk_t> &lst_disk, std::vector<int> &devices, void* )
+{
+    probe_report_t report;
+    s_sweepEngine.getDrivesInfo( lst_disk, report );
+    devices.swap( report.deviceOf );
+    if( !report.timedOut.empty() )
+    {
+        return false;
+    }
+    saveSnapshot( lst_disk, devices );
+    return true;
+}
+//--------------------------------------------------------------------------------------------------------
+    // one drive reported by the device watcher
+static bool probeDevice( const device_t &device, std::vector<disk_t> &lst_disk, void* )
+{
+    probe_report_t report;
+    s_probeStrategy.forget( device );               // it may be another drive than the one that failed before
+    s_deviceEngine.getDriveInfo( device, lst_disk, report );
+    return report.timedOut.empty();
+}
+
+static DiskCache     s_diskCache( DSK_CACHE_TTL_MS, &s_probeStats );
+static DiskRefresher s_diskRefresher( s_diskCache, probeDrives, nullptr );
+static DeviceWatcher s_deviceWatcher( s_diskCache, &s_diskRefresher, probeDevice, nullptr );
+static volatile long s_nBackgroundStarted = 0;      // 1 once started; 2 after xp_DiskIdShutdown, for good
+
+//--------------------------------------------------------------------------------------------------------
+static bool backgroundRunning()
+{
+    return 1 == ::InterlockedCompareExchange( &s_nBackgroundStarted, 0, 0 ) && DSK_REFRESH_INTERVAL_MS != 0;
+}
+//--------------------------------------------------------------------------------------------------------
+static void startBackground()
+{
+    if( 0 != ::InterlockedCompareExchange( &s_nBackgroundStarted, 1, 0 ) )
+    {
+        return;
+    }
+    if( DSK_REFRESH_INTERVAL_MS != 0 )
+    {
+        s_diskRefresher.start( DSK_REFRESH_INTERVAL_MS );
+    }
+    if( DSK_WATCH_DEVICES )
+    {
+        s_deviceWatcher.start( createSystemDeviceEventSource() );
+    }
+}
+
+//--------------------------------------------------------------------------------------------------------
+    // reads integer parameter nParam (tinyint, smallint, int or bigint); false if NULL or not an integer
+static bool getIntParam( SRV_PROC *pSrvProc, int nParam, __int64 &value )
+{
+    BYTE  bType    = 0;
+    ULONG cbMaxLen = 0;
+    ULONG cbActual = 0;
+    BOOL  fNull    = FALSE;
+    BYTE  data[8]  = {0x00};
+
+    if( srv_paraminfo( pSrvProc, nParam, &bType, &cbMaxLen, &cbActual, NULL, &fNull ) != SUCCEED ||
+        fNull || cbActual > sizeof(data) ||
+        srv_paraminfo( pSrvProc, nParam, &bType, &cbMaxLen, &cbActual, data, &fNull ) != SUCCEED )
+    {
+        return false;
+    }
+    if( bType != SRVINT1 && bType != SRVINT2 && bType != SRVINT4 && bType != SRVINT8 && bType != SRVINTN )
+    {
+        return false;
+    }
+    switch( cbActual )
+    {
+        case 1: value = *(unsigned __int8*)data;    return true;    // tinyint is unsigned
+        case 2: value = *(__int16*)data;            return true;
+        case 4: value = *(__int32*)data;            return true;
+        case 8: value = *(__int64*)data;            return true;
+    }
+    return false;
+}
+//--------------------------------------------------------------------------------------------------------
+static bool isNullParam( SRV_PROC *pSrvProc, int nParam )
+{
+    BYTE  bType    = 0;
+    ULONG cbMaxLen = 0;
+    ULONG cbActual = 0;
+    BOOL  fNull    = FALSE;
+
+    return srv_paraminfo( pSrvProc, nParam, &bType, &cbMaxLen, &cbActual, NULL, &fNull ) == SUCCEED && fNull;
+}
+//--------------------------------------------------------------------------------------------------------
+    // reads text parameter nParam (char or varchar); false if NULL or not single-byte text
+static bool getTextParam( SRV_PROC *pSrvProc, int nParam, std::string &value )
+{
+    BYTE  bType    = 0;
+    ULONG cbMaxLen = 0;
+    ULONG cbActual = 0;
+    BOOL  fNull    = FALSE;
+
+    if( srv_paraminfo( pSrvProc, nParam, &bType, &cbMaxLen, &cbActual, NULL, &fNull ) != SUCCEED || fNull ||
+        ( bType != SRVCHAR && bType != SRVVARCHAR && bType != SRVBIGCHAR && bType != SRVBIGVARCHAR ) )
+    {
+        return false;
+    }
+    std::vector<BYTE> data( cbActual + 1, 0x00 );
+    if( srv_paraminfo( pSrvProc, nParam, &bType, &cbMaxLen, &cbActual, &data[0], &fNull ) != SUCCEED )
+    {
+        return false;
+    }
+    value.assign( (const char *)&data[0], ::strnlen( (const char *)&data[0], cbActual ) );
+    return true;
+}
+//--------------------------------------------------------------------------------------------------------
+    // the optional parameters of xp_DiskId (see diskfilter.h); false with the message for the client
+static bool getDiskFilter( SRV_PROC *pSrvProc, disk_filter_t &filter, const char *&error )
+{
+    const int nParams = srv_rpcparams( pSrvProc );
+    __int64   first   = -1;
+    __int64   last    = -1;
+
+    if( nParams > 4 )
+    {
+        error = "xp_DiskId: expects at most @first, @last, @pattern and @columns";
+        return false;
+    }
+    if( nParams >= 1 && !isNullParam( pSrvProc, 1 ) && ( !getIntParam( pSrvProc, 1, first ) || first < 0 || first > 0x7fffffff ) )
+    {
+        error = "xp_DiskId: @first must be a non-negative int";
+        return false;
+    }
+    if( nParams >= 2 && !isNullParam( pSrvProc, 2 ) && ( !getIntParam( pSrvProc, 2, last ) || last < 0 || last > 0x7fffffff ) )
+    {
+        error = "xp_DiskId: @last must be a non-negative int";
+        return false;
+    }
+    if( first >= 0 || last >= 0 )
+    {
+        filter.nFirst = ( first >= 0 ) ? (int)first : 0;
+        filter.nLast  = ( last >= 0 )  ? (int)last  : filter.nFirst;
+        if( filter.nLast < filter.nFirst )
+        {
+            error = "xp_DiskId: @last must not be less than @first";
+            return false;
+        }
+    }
+    if( nParams >= 3 && !isNullParam( pSrvProc, 3 ) && !getTextParam( pSrvProc, 3, filter.pattern ) )
+    {
+        error = "xp_DiskId: @pattern must be a varchar";
+        return false;
+    }
+    std::string columns;
+    if( nParams >= 4 && !isNullParam( pSrvProc, 4 ) &&
+        ( !getTextParam( pSrvProc, 4, columns ) || !filter.parseColumns( columns ) ) )
+    {
+        error = "xp_DiskId: @columns must list controller, model, serial, duuid or size, each at most once";
+        return false;
+    }
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------
+/** xp_DiskId [ @first int [, @last int [, @pattern varchar [, @columns varchar ]]]]
+  *
+  * One row per drive: controller, model, serial, duuid, size.  The parameters narrow the drives
+  * and columns sent (see diskfilter.h); without them every drive and column is listed.  The duuid
+  * of a drive stays the same from one version to the next except where DSK_VERSION says otherwise.
+  */
 RETCODE NFSLIB_API xp_DiskId( SRV_PROC *pSrvProc )
 {
     if( pSrvProc == 0 )
     {
         return 0;
     }
-    DiskInfo comp;
     char str[255] = {0x00};
     int nRowsFetched = 0;
     try
     {
-        std::vector<disk_t> _disk;
-        comp.getDrivesInfo( _disk );
+        disk_filter_t filter;
+        const char   *error = nullptr;
+        if( !getDiskFilter( pSrvProc, filter, error ) )
+        {
+            srv_sendmsg( pSrvProc, SRV_MSG_ERROR, GETTABLE_ERROR, SRV_INFO, (DBTINYINT) 0, NULL, 0, 0,
+                         const_cast<char*>( error ), SRV_NULLTERM );
+            srv_senddone( pSrvProc, SRV_DONE_ERROR, (DBUSMALLINT) 0, (DBINT) 0 );
+            return XP_ERROR;
+        }
+        startBackground();
+            // rows are streamed straight from the pinned snapshot; only a miss probes here
+        DiskSnapshotPin pin( s_diskCache );
+        std::vector<disk_t> probed;
+        std::vector<int>    devices;
+        if( pin.get() == nullptr )
+        {
+            if( loadSnapshot( probed, devices ) )
+            {
+                s_diskCache.store( probed, devices, pin.generation() );
+                s_diskRefresher.wake();             // verification sweep
+            }
+                // only the drives asked for; a partial enumeration is not cached
+            else if( !filter.allDevices() )
+            {
+                probe_report_t report;
+                s_sweepEngine.getDrivesInfo( filter.nFirst, filter.nLast, probed, report );
+                devices.swap( report.deviceOf );
+            }
+                // a sweep cut short by a hung device is not kept: the next call tries again
+            else if( probeDrives( probed, devices, nullptr ) )
+            {
+                s_diskCache.store( probed, devices, pin.generation() );
+            }
+        }
+            // a snapshot carries its rows; what was probed here is put in the columns needed
+        DiskRows rows;
+        if( pin.get() == nullptr )
+        {
+            rows.assign( probed, devices, &s_probeStats, filter.needed() );
+        }
+        const DiskRows         &_rows  = ( pin.get() != nullptr ) ? pin.get()->rows : rows;
+        const std::vector<int> &owners = ( pin.get() != nullptr ) ? pin.get()->devices : devices;
+
+        RowEmitter emitter( pSrvProc, _rows.size() );
+        for( size_t c = 0; c < filter.columns.size(); c++ )
+        {
+            bindDiskColumn( emitter, _rows, filter.columns[c] );
+        }
+        emitter.setStats( &s_probeStats, ( owners.size() >= _rows.size() && !owners.empty() ) ? &owners[0] : nullptr );
+
+        std::vector<size_t> selected;
+        if( !filter.allRows() )
+        {
+            filter.select( _rows, owners, selected );
+        }
+        nRowsFetched = filter.allRows()  ? emitter.send() :
+                       selected.empty()  ? 0 : emitter.send( &selected[0], selected.size() );
+        if( nRowsFetched > 0 )
+        {
+            srv_senddone (pSrvProc, SRV_DONE_COUNT | SRV_DONE_MORE, (DBUSMALLINT) 0, nRowsFetched);
+        }
+        else 
+        {
+            srv_senddone (pSrvProc, SRV_DONE_MORE, (DBUSMALLINT) 0, (DBINT) 0);
+        }
+    }
+    catch(...)
+    {
+        srv_sendmsg(pSrvProc, SRV_MSG_INFO, 777, SRV_INFO, (DBTINYINT) 0, NULL, 0, 0, str, SRV_NULLTERM);
+    }
+    return -1;
+}
+
+
+//-------------------------------------------------------------------------------------------------------------------------------
+/** xp_DiskIdInvalidate [ @ttl_ms int ]
+  *
+  * Drops the cached enumeration and wakes the background refresher; until it has stored a new
+  * snapshot, xp_DiskId probes the hardware itself.
+  * With a parameter, also sets the cache lifetime in milliseconds (0 turns the cache off).
+  */
+RETCODE NFSLIB_API xp_DiskIdInvalidate( SRV_PROC *pSrvProc )
+{
+    if( pSrvProc == 0 )
+    {
+        return 0;
+    }
+    if( srv_rpcparams( pSrvProc ) > 0 )
+    {
+        __int64 ttl = 0;
+        if( !getIntParam( pSrvProc, 1, ttl ) || ttl < 0 || ttl > 0x7fffffff )
+        {
+            srv_sendmsg( pSrvProc, SRV_MSG_ERROR, GETTABLE_ERROR, SRV_INFO, (DBTINYINT) 0, NULL, 0, 0,
+                         "xp_DiskIdInvalidate: @ttl_ms must be a non-negative int", SRV_NULLTERM );
+            srv_senddone( pSrvProc, SRV_DONE_ERROR, (DBUSMALLINT) 0, (DBINT) 0 );
+            return XP_ERROR;
+        }
+        s_diskCache.setTtl( (unsigned long)ttl );
+    }
+    s_diskCache.invalidate();
+    s_probeStrategy.clear();
+    s_diskRefresher.wake();
+    srv_senddone( pSrvProc, SRV_DONE_MORE, (DBUSMALLINT) 0, (DBINT) 0 );
+    return XP_NOERROR;
+}
+
+
+//-------------------------------------------------------------------------------------------------------------------------------
+/** xp_DiskIdShutdown
+  *
+  * Stops the background refresher and the device watcher for as long as the DLL stays loaded,
+  * and lets the probe workers exit.  Each of these threads holds a reference on the DLL, so that
+  * the server cannot unload it under them, and lets go of it only as it exits: once the probe or
+  * event in hand is done, within DSK_CALL_TIMEOUT_MS unless a device hangs a worker for longer.
+  * DBCC EpsDiskId(FREE) drops the reference of the server, and the DLL is unloaded when the last
+  * thread is gone, e.g. to replace it without restarting the service; the next call loads it
+  * with fresh threads.  Until then xp_DiskId answers from the cache and probes by itself when
+  * the cache has nothing, on workers that exit when done.
+  */
+RETCODE NFSLIB_API xp_DiskIdShutdown( SRV_PROC *pSrvProc )
+{
+    if( pSrvProc == 0 )
+    {
+        return 0;
+    }
+        // also before the first xp_DiskId: stopped threads exit as soon as they start
+    ::InterlockedExchange( &s_nBackgroundStarted, 2 );
+    s_deviceWatcher.stop();
+    s_diskRefresher.stop();
+    ProbePool::stopWorkers();
+    srv_senddone( pSrvProc, SRV_DONE_MORE, (DBUSMALLINT) 0, (DBINT) 0 );
+    return XP_NOERROR;
+}
+
+
+//-------------------------------------------------------------------------------------------------------------------------------
+/** xp_DiskIdDiagnostics
+  *
+  * The failed opens and requests of recent probes, oldest first, one row each.  The probes only
+  * store what failed (see probediag.h); the text is made here.
+  */
+RETCODE NFSLIB_API xp_DiskIdDiagnostics( SRV_PROC *pSrvProc )
+{
+    if( pSrvProc == 0 )
+    {
+        return 0;
+    }
+    char str[255] = {0x00};
+    int nRowsFetched = 0;
+    try
+    {
+        std::vector<probe_diag_t> diags( PROBE_DIAG_RING_SIZE );
+        diags.resize( s_probeDiagnostics.copy( &diags[0], diags.size() ) );
+        const unsigned long dwNow = ::GetTickCount();
 
-        srv_describe(pSrvProc, 1, "controller", SRV_NULLTERM, SRVINT4,    sizeof(int),     SRVINT4,    sizeof(int), NULL); 
-        srv_describe(pSrvProc, 2, "model",      SRV_NULLTERM, SRVVARCHAR, 32,              SRVVARCHAR, 32, NULL); 
-        srv_describe(pSrvProc, 3, "serial",     SRV_NULLTERM, SRVVARCHAR, 32,              SRVVARCHAR, 32, NULL); 
-        srv_describe(pSrvProc, 4, "duuid",      SRV_NULLTERM, SRVINT8,    sizeof(__int64), SRVINT8,    sizeof(int), NULL); 
-        srv_describe(pSrvProc, 5, "size",       SRV_NULLTERM, SRVINT8,    sizeof(__int64), SRVINT8,    sizeof(__int64), NULL); 
+        srv_describe(pSrvProc, 1, "sequence",  SRV_NULLTERM, SRVINT8,    sizeof(__int64), SRVINT8,    sizeof(__int64), NULL);
+        srv_describe(pSrvProc, 2, "age_ms",    SRV_NULLTERM, SRVINT8,    sizeof(__int64), SRVINT8,    sizeof(__int64), NULL);
+        srv_describe(pSrvProc, 3, "device",    SRV_NULLTERM, SRVINT4,    sizeof(int),     SRVINT4,    sizeof(int),     NULL);
+        srv_describe(pSrvProc, 4, "operation", SRV_NULLTERM, SRVVARCHAR, 64,              SRVVARCHAR, 64,              NULL);
+        srv_describe(pSrvProc, 5, "error",     SRV_NULLTERM, SRVINT8,    sizeof(__int64), SRVINT8,    sizeof(__int64), NULL);
+        srv_describe(pSrvProc, 6, "message",   SRV_NULLTERM, SRVVARCHAR, 255,             SRVVARCHAR, 255,             NULL);
 
-        for( size_t i = 0; i < _disk.size(); i++ )
+        for( size_t i = 0; i < diags.size(); i++ )
         {
-            srv_setcollen  ( pSrvProc, 1, sizeof(_disk[i].num_controller) );    
-            srv_setcoldata ( pSrvProc, 1, &_disk[i].num_controller );
+            __int64     sequence  = diags[i].sequence;
+            __int64     age       = (unsigned long)( dwNow - diags[i].dwTick );
+            __int64     error     = diags[i].error;
+            const char *operation = ProbeDiagnostics::opName( diags[i].op );
+            char        message[255] = {0x00};
+            ProbeDiagnostics::describe( diags[i], message, sizeof(message) );
 
-            srv_setcollen  ( pSrvProc, 2, (__int32)::strlen( _disk[i].model ) + 1 );    
-            srv_setcoldata ( pSrvProc, 2, _disk[i].model );
+            srv_setcollen  ( pSrvProc, 1, sizeof(sequence) );
+            srv_setcoldata ( pSrvProc, 1, &sequence );
 
-            srv_setcollen  ( pSrvProc, 3, (__int32)::strlen( _disk[i].serial ) + 1 );    
-            srv_setcoldata ( pSrvProc, 3, _disk[i].serial );
+            srv_setcollen  ( pSrvProc, 2, sizeof(age) );
+            srv_setcoldata ( pSrvProc, 2, &age );
 
-            __int64 duuid = ::crc64( &_disk[i], sizeof(disk_t) );
+            srv_setcollen  ( pSrvProc, 3, sizeof(diags[i].device) );
+            srv_setcoldata ( pSrvProc, 3, (void*)&diags[i].device );
 
-            srv_setcollen  ( pSrvProc, 4, sizeof(duuid) );    
-            srv_setcoldata ( pSrvProc, 4, &duuid );
+            srv_setcollen  ( pSrvProc, 4, (__int32)::strlen( operation ) );
+            srv_setcoldata ( pSrvProc, 4, (void*)operation );
 
-            srv_setcollen  ( pSrvProc, 5, sizeof(_disk[i].sectors) );    
-            srv_setcoldata ( pSrvProc, 5, &_disk[i].sectors );
+            srv_setcollen  ( pSrvProc, 5, sizeof(error) );
+            srv_setcoldata ( pSrvProc, 5, &error );
+
+            srv_setcollen  ( pSrvProc, 6, (__int32)::strlen( message ) );
+            srv_setcoldata ( pSrvProc, 6, message );
 
             if( srv_sendrow (pSrvProc) == SUCCEED )
             {
-                nRowsFetched++;                        // Go to the next row. 
-            } 
+                nRowsFetched++;
+            }
         }
         if( nRowsFetched > 0 )
         {
             srv_senddone (pSrvProc, SRV_DONE_COUNT | SRV_DONE_MORE, (DBUSMALLINT) 0, nRowsFetched);
         }
-        else 
+        else
         {
             srv_senddone (pSrvProc, SRV_DONE_MORE, (DBUSMALLINT) 0, (DBINT) 0);
         }
@@ -101,8 +541,290 @@ RETCODE NFSLIB_API xp_DiskId( SRV_PROC *pSrvProc )
     {
         srv_sendmsg(pSrvProc, SRV_MSG_INFO, 777, SRV_INFO, (DBTINYINT) 0, NULL, 0, 0, str, SRV_NULLTERM);
     }
-    return -1;
+    return XP_NOERROR;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------
+    // percentile of a histogram row, as the upper end of the bucket it falls in
+static unsigned __int64 bucketPercentileUs( const probe_stat_t &stat, unsigned long permille )
+{
+    const unsigned __int64 rank = ( (unsigned __int64)stat.count * permille + 999 ) / 1000;
+    unsigned __int64       seen = 0;
+    for( int b = 0; b < PROBE_STATS_BUCKETS; b++ )
+    {
+        seen += stat.buckets[b];
+        if( seen >= rank && 0 != stat.buckets[b] )
+        {
+            const unsigned __int64 limit = ProbeStats::bucketLimitUs( b );
+            return ( 0 == limit || limit > stat.maxUs ) ? stat.maxUs : limit;
+        }
+    }
+    return stat.maxUs;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------
+/** xp_DiskIdStats [ @reset int ]
+  *
+  * Latency of every phase of the enumeration, one row per device and phase: opens, each kind of
+  * IOCTL, decoding the records, the duuid CRC and sending the rows of xp_DiskId.  device is the
+  * physical drive (or SCSI port) number, NULL for work that is not tied to one drive.  The
+  * percentiles are upper bounds taken from the power-of-two buckets of probestats.h; histogram
+  * lists the non-empty buckets as "<limit_us:count".
+  * With @reset <> 0 the counters start again from zero after they have been returned.
+  */
+RETCODE NFSLIB_API xp_DiskIdStats( SRV_PROC *pSrvProc )
+{
+    if( pSrvProc == 0 )
+    {
+        return 0;
+    }
+    __int64 reset = 0;
+    if( srv_rpcparams( pSrvProc ) > 0 && !getIntParam( pSrvProc, 1, reset ) )
+    {
+        srv_sendmsg( pSrvProc, SRV_MSG_ERROR, GETTABLE_ERROR, SRV_INFO, (DBTINYINT) 0, NULL, 0, 0,
+                     "xp_DiskIdStats: @reset must be an int", SRV_NULLTERM );
+        srv_senddone( pSrvProc, SRV_DONE_ERROR, (DBUSMALLINT) 0, (DBINT) 0 );
+        return XP_ERROR;
+    }
+    char str[255] = {0x00};
+    int nRowsFetched = 0;
+    try
+    {
+        std::vector<probe_stat_t> stats;
+        s_probeStats.snapshot( stats );
+        if( 0 != reset )
+        {
+            s_probeStats.clear();
+        }
+
+        srv_describe(pSrvProc, 1, "device",    SRV_NULLTERM, SRVINTN,    sizeof(int),     SRVINT4,    sizeof(int),     NULL);
+        srv_describe(pSrvProc, 2, "phase",     SRV_NULLTERM, SRVVARCHAR, 64,              SRVVARCHAR, 64,              NULL);
+        srv_describe(pSrvProc, 3, "count",     SRV_NULLTERM, SRVINT8,    sizeof(__int64), SRVINT8,    sizeof(__int64), NULL);
+        srv_describe(pSrvProc, 4, "total_us",  SRV_NULLTERM, SRVINT8,    sizeof(__int64), SRVINT8,    sizeof(__int64), NULL);
+        srv_describe(pSrvProc, 5, "avg_us",    SRV_NULLTERM, SRVINT8,    sizeof(__int64), SRVINT8,    sizeof(__int64), NULL);
+        srv_describe(pSrvProc, 6, "p50_us",    SRV_NULLTERM, SRVINT8,    sizeof(__int64), SRVINT8,    sizeof(__int64), NULL);
+        srv_describe(pSrvProc, 7, "p99_us",    SRV_NULLTERM, SRVINT8,    sizeof(__int64), SRVINT8,    sizeof(__int64), NULL);
+        srv_describe(pSrvProc, 8, "max_us",    SRV_NULLTERM, SRVINT8,    sizeof(__int64), SRVINT8,    sizeof(__int64), NULL);
+        srv_describe(pSrvProc, 9, "histogram", SRV_NULLTERM, SRVVARCHAR, 512,             SRVVARCHAR, 512,             NULL);
+
+        for( size_t i = 0; i < stats.size(); i++ )
+        {
+            const probe_stat_t &stat = stats[i];
+            const char *phase   = ProbeStats::phaseName( stat.phase );
+            __int64     count   = stat.count;
+            __int64     totalUs = (__int64)stat.totalUs;
+            __int64     avgUs   = (__int64)( stat.totalUs / stat.count );
+            __int64     p50Us   = (__int64)bucketPercentileUs( stat, 500 );
+            __int64     p99Us   = (__int64)bucketPercentileUs( stat, 990 );
+            __int64     maxUs   = stat.maxUs;
+            char        histogram[512] = {0x00};
+            size_t      cch     = 0;
+
+            for( int b = 0; b < PROBE_STATS_BUCKETS && cch + 32 < sizeof(histogram); b++ )
+            {
+                if( 0 != stat.buckets[b] )
+                {
+                    const unsigned __int64 limit = ProbeStats::bucketLimitUs( b );
+                    int n = 0 != limit
+                          ? ::_snprintf( histogram + cch, sizeof(histogram) - cch - 1, "%s<%I64u:%lu", cch ? " " : "", limit, stat.buckets[b] )
+                          : ::_snprintf( histogram + cch, sizeof(histogram) - cch - 1, "%s>=%I64u:%lu", cch ? " " : "",
+                                         ProbeStats::bucketLimitUs( b - 1 ), stat.buckets[b] );
+                    cch += ( n > 0 ) ? (size_t)n : 0;
+                }
+            }
+
+            srv_setcollen  ( pSrvProc, 1, stat.device < 0 ? 0 : sizeof(stat.device) );
+            srv_setcoldata ( pSrvProc, 1, (void*)&stat.device );
+
+            srv_setcollen  ( pSrvProc, 2, (__int32)::strlen( phase ) );
+            srv_setcoldata ( pSrvProc, 2, (void*)phase );
+
+            srv_setcollen  ( pSrvProc, 3, sizeof(count) );
+            srv_setcoldata ( pSrvProc, 3, &count );
+
+            srv_setcollen  ( pSrvProc, 4, sizeof(totalUs) );
+            srv_setcoldata ( pSrvProc, 4, &totalUs );
+
+            srv_setcollen  ( pSrvProc, 5, sizeof(avgUs) );
+            srv_setcoldata ( pSrvProc, 5, &avgUs );
+
+            srv_setcollen  ( pSrvProc, 6, sizeof(p50Us) );
+            srv_setcoldata ( pSrvProc, 6, &p50Us );
+
+            srv_setcollen  ( pSrvProc, 7, sizeof(p99Us) );
+            srv_setcoldata ( pSrvProc, 7, &p99Us );
+
+            srv_setcollen  ( pSrvProc, 8, sizeof(maxUs) );
+            srv_setcoldata ( pSrvProc, 8, &maxUs );
+
+            srv_setcollen  ( pSrvProc, 9, (__int32)::strlen( histogram ) );
+            srv_setcoldata ( pSrvProc, 9, histogram );
+
+            if( srv_sendrow (pSrvProc) == SUCCEED )
+            {
+                nRowsFetched++;
+            }
+        }
+        if( nRowsFetched > 0 )
+        {
+            srv_senddone (pSrvProc, SRV_DONE_COUNT | SRV_DONE_MORE, (DBUSMALLINT) 0, nRowsFetched);
+        }
+        else
+        {
+            srv_senddone (pSrvProc, SRV_DONE_MORE, (DBUSMALLINT) 0, (DBINT) 0);
+        }
+    }
+    catch(...)
+    {
+        srv_sendmsg(pSrvProc, SRV_MSG_INFO, 777, SRV_INFO, (DBTINYINT) 0, NULL, 0, 0, str, SRV_NULLTERM);
+    }
+    return XP_NOERROR;
 }
 
+//-------------------------------------------------------------------------------------------------------------------------------
+/** xp_DiskIdBench [ @iterations int ]
+  *
+  * Times the decoding and hashing paths on built-in fixtures (see diskbench.h), without touching
+  * a device: one row per benchmark with ns per operation and MB/s.  The result can be kept with
+  * INSERT ... EXEC and compared after an upgrade of the DLL.  @iterations defaults to 100000.
+  */
+RETCODE NFSLIB_API xp_DiskIdBench( SRV_PROC *pSrvProc )
+{
+    if( pSrvProc == 0 )
+    {
+        return 0;
+    }
+    __int64 iterations = DISK_BENCH_DEFAULT_ITERATIONS;
+    if( srv_rpcparams( pSrvProc ) > 0 &&
+        ( !getIntParam( pSrvProc, 1, iterations ) || iterations < 1 || iterations > 100000000 ) )
+    {
+        srv_sendmsg( pSrvProc, SRV_MSG_ERROR, GETTABLE_ERROR, SRV_INFO, (DBTINYINT) 0, NULL, 0, 0,
+                     "xp_DiskIdBench: @iterations must be an int between 1 and 100000000", SRV_NULLTERM );
+        srv_senddone( pSrvProc, SRV_DONE_ERROR, (DBUSMALLINT) 0, (DBINT) 0 );
+        return XP_ERROR;
+    }
+    char str[255] = {0x00};
+    int nRowsFetched = 0;
+    try
+    {
+        std::vector<bench_result_t> results;
+        runDiskBenchmarks( (unsigned long)iterations, results );
+
+        srv_describe(pSrvProc, 1, "benchmark",    SRV_NULLTERM, SRVVARCHAR, 64,              SRVVARCHAR, 64,              NULL);
+        srv_describe(pSrvProc, 2, "iterations",   SRV_NULLTERM, SRVINT8,    sizeof(__int64), SRVINT8,    sizeof(__int64), NULL);
+        srv_describe(pSrvProc, 3, "bytes_per_op", SRV_NULLTERM, SRVINT4,    sizeof(int),     SRVINT4,    sizeof(int),     NULL);
+        srv_describe(pSrvProc, 4, "ns_per_op",    SRV_NULLTERM, SRVFLT8,    sizeof(double),  SRVFLT8,    sizeof(double),  NULL);
+        srv_describe(pSrvProc, 5, "mb_per_s",     SRV_NULLTERM, SRVFLT8,    sizeof(double),  SRVFLT8,    sizeof(double),  NULL);
+
+        for( size_t i = 0; i < results.size(); i++ )
+        {
+            bench_result_t &result = results[i];
+            __int64         count  = result.iterations;
+            int             cb     = (int)result.cbPerOp;
+
+            srv_setcollen  ( pSrvProc, 1, (__int32)::strlen( result.name ) );
+            srv_setcoldata ( pSrvProc, 1, (void*)result.name );
+
+            srv_setcollen  ( pSrvProc, 2, sizeof(count) );
+            srv_setcoldata ( pSrvProc, 2, &count );
+
+            srv_setcollen  ( pSrvProc, 3, sizeof(cb) );
+            srv_setcoldata ( pSrvProc, 3, &cb );
+
+            srv_setcollen  ( pSrvProc, 4, sizeof(result.nsPerOp) );
+            srv_setcoldata ( pSrvProc, 4, &result.nsPerOp );
+
+            srv_setcollen  ( pSrvProc, 5, sizeof(result.mbPerSec) );
+            srv_setcoldata ( pSrvProc, 5, &result.mbPerSec );
+
+            if( srv_sendrow (pSrvProc) == SUCCEED )
+            {
+                nRowsFetched++;
+            }
+        }
+        if( nRowsFetched > 0 )
+        {
+            srv_senddone (pSrvProc, SRV_DONE_COUNT | SRV_DONE_MORE, (DBUSMALLINT) 0, nRowsFetched);
+        }
+        else
+        {
+            srv_senddone (pSrvProc, SRV_DONE_MORE, (DBUSMALLINT) 0, (DBINT) 0);
+        }
+    }
+    catch(...)
+    {
+        srv_sendmsg(pSrvProc, SRV_MSG_INFO, 777, SRV_INFO, (DBTINYINT) 0, NULL, 0, 0, str, SRV_NULLTERM);
+    }
+    return XP_NOERROR;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------
+/** xp_DiskIdCapture
+  *
+  * Runs one sweep past the cache and the strategy, with every open and IOCTL recorded, and saves
+  * the trace to DSK_TRACE_FILE in the temp directory (see devtrace.h).  A DeviceIoReplayer then
+  * answers the same requests without this host's drives.  One row: the file, the number of
+  * requests recorded and the number of records the sweep found.  Run one capture at a time.
+  */
+RETCODE NFSLIB_API xp_DiskIdCapture( SRV_PROC *pSrvProc )
+{
+    if( pSrvProc == 0 )
+    {
+        return 0;
+    }
+    char str[255] = {0x00};
+    try
+    {
+        DiskInfo engine = makeDiskEngine( DSK_MAX_PARALLEL_PROBES, DSK_DEVICE_TIMEOUT_MS, DSK_CALL_TIMEOUT_MS );
+        engine.setStrategy( nullptr );              // every request is sent, including those known to fail
+        engine.setDeviceIo( &s_deviceRecorder );
+
+        std::vector<disk_t> lst_disk;
+        probe_report_t      report;
+        std::wstring        path;
+
+        s_deviceRecorder.clear();
+        engine.getDrivesInfo( lst_disk, report );
+
+        if( !tempFilePath( DSK_TRACE_FILE, path ) || !s_deviceRecorder.save( path.c_str() ) )
+        {
+            srv_sendmsg( pSrvProc, SRV_MSG_ERROR, GETTABLE_ERROR, SRV_INFO, (DBTINYINT) 0, NULL, 0, 0,
+                         "xp_DiskIdCapture: the trace could not be written to the temp directory", SRV_NULLTERM );
+            srv_senddone( pSrvProc, SRV_DONE_ERROR, (DBUSMALLINT) 0, (DBINT) 0 );
+            return XP_ERROR;
+        }
+        char file[MAX_PATH * 2 + 1] = {0x00};
+        ::WideCharToMultiByte( CP_ACP, 0, path.c_str(), -1, file, _countof(file) - 1, NULL, NULL );
+        int               requests = (int)s_deviceRecorder.records();
+        int               records  = (int)lst_disk.size();
+
+        srv_describe(pSrvProc, 1, "trace_file", SRV_NULLTERM, SRVVARCHAR, MAX_PATH,    SRVVARCHAR, MAX_PATH,    NULL);
+        srv_describe(pSrvProc, 2, "requests",   SRV_NULLTERM, SRVINT4,    sizeof(int), SRVINT4,    sizeof(int), NULL);
+        srv_describe(pSrvProc, 3, "records",    SRV_NULLTERM, SRVINT4,    sizeof(int), SRVINT4,    sizeof(int), NULL);
+
+        srv_setcollen  ( pSrvProc, 1, (__int32)::strlen( file ) );
+        srv_setcoldata ( pSrvProc, 1, file );
+
+        srv_setcollen  ( pSrvProc, 2, sizeof(requests) );
+        srv_setcoldata ( pSrvProc, 2, &requests );
+
+        srv_setcollen  ( pSrvProc, 3, sizeof(records) );
+        srv_setcoldata ( pSrvProc, 3, &records );
+
+        if( srv_sendrow (pSrvProc) == SUCCEED )
+        {
+            srv_senddone (pSrvProc, SRV_DONE_COUNT | SRV_DONE_MORE, (DBUSMALLINT) 0, 1);
+        }
+        else
+        {
+            srv_senddone (pSrvProc, SRV_DONE_MORE, (DBUSMALLINT) 0, (DBINT) 0);
+        }
+    }
+    catch(...)
+    {
+        srv_sendmsg(pSrvProc, SRV_MSG_INFO, 777, SRV_INFO, (DBTINYINT) 0, NULL, 0, 0, str, SRV_NULLTERM);
+    }
+    return XP_NOERROR;
+}
 
 //-------------------------------------------------------------------------------------------------------------------------------